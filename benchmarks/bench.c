@@ -0,0 +1,702 @@
+/*
+ * Benchmark suite.
+ *
+ * Generates the synthetic corpora of corpus.c and times yaml_parser_scan(),
+ * yaml_parser_parse(), yaml_parser_skip_node(), yaml_parser_parse_callbacks(),
+ * yaml_parser_load(), yaml_parser_load_tape(), yaml_parser_load_all(),
+ * yaml_parser_load_paths(), compiled path lookups and yaml_emitter_dump() over
+ * each of them, reporting the throughput, the tokens, events, nodes or
+ * lookups per second, and the allocations made per megabyte of input.
+ *
+ * Usage: myyaml_bench [-s megabytes] [-r repeats] [-c corpus] [-b bench] [-t threads]
+ *        myyaml_bench -w directory [-s megabytes] [-c corpus]
+ *
+ * With -w, the corpora are written to the directory instead, as
+ * <corpus>.yaml.
+ */
+
+#include <myyaml/myyaml.h>
+
+#include "corpus.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * An allocator that counts the allocations and reallocations.
+ */
+
+static size_t allocations;
+
+/* The threads of yaml_parser_load_all(), 0 for one per processor. */
+
+static int threads;
+
+static void *count_allocate(void *data, size_t size) {
+    (void)data;
+    allocations++;
+    return malloc(size);
+}
+
+static void *count_reallocate(void *data, void *pointer, size_t size) {
+    (void)data;
+    allocations++;
+    return realloc(pointer, size);
+}
+
+static void count_release(void *data, void *pointer) {
+    (void)data;
+    free(pointer);
+}
+
+static const YamlAllocator counting = {count_allocate, count_reallocate, count_release, NULL};
+
+/*
+ * The outcome of a run: its time, the number of items it went through and
+ * the number of allocations it made.
+ */
+
+typedef struct Result {
+    double seconds;
+    size_t items;
+    size_t allocations;
+} Result;
+
+static int start_parser(YamlParser *parser, const Corpus *corpus) {
+    if (!yaml_parser_initialize(parser)) return 0;
+    if (!yaml_parser_set_allocator(parser, &counting)) {
+        yaml_parser_delete(parser);
+        return 0;
+    }
+    yaml_parser_set_input_string(parser, corpus->data, corpus->size);
+    return 1;
+}
+
+static int bench_scan(const Corpus *corpus, Result *result) {
+    YamlParser parser;
+    YamlToken token;
+    double start;
+
+    if (!start_parser(&parser, corpus)) return 0;
+
+    allocations = 0;
+    start = now();
+    for (;;) {
+        int done;
+
+        if (!yaml_parser_scan(&parser, &token)) {
+            fprintf(stderr, "%s: scanner error: %s\n", corpus->name, parser.problem);
+            yaml_parser_delete(&parser);
+            return 0;
+        }
+        result->items++;
+        done = (token.type == YAML_STREAM_END_TOKEN);
+        yaml_token_delete(&token);
+        if (done) break;
+    }
+    result->seconds = now() - start;
+    result->allocations = allocations;
+
+    yaml_parser_delete(&parser);
+
+    return 1;
+}
+
+static int bench_parse(const Corpus *corpus, Result *result) {
+    YamlParser parser;
+    YamlEvent event;
+    double start;
+
+    if (!start_parser(&parser, corpus)) return 0;
+
+    allocations = 0;
+    start = now();
+    for (;;) {
+        int done;
+
+        if (!yaml_parser_parse(&parser, &event)) {
+            fprintf(stderr, "%s: parser error: %s\n", corpus->name, parser.problem);
+            yaml_parser_delete(&parser);
+            return 0;
+        }
+        result->items++;
+        done = (event.type == YAML_STREAM_END_EVENT);
+        yaml_event_delete(&event);
+        if (done) break;
+    }
+    result->seconds = now() - start;
+    result->allocations = allocations;
+
+    yaml_parser_delete(&parser);
+
+    return 1;
+}
+
+/*
+ * Read the top two levels of the documents and skip the collections below.
+ */
+
+static int bench_skip(const Corpus *corpus, Result *result) {
+    YamlParser parser;
+    YamlEvent event;
+    int depth = 0;
+    double start;
+
+    if (!start_parser(&parser, corpus)) return 0;
+
+    allocations = 0;
+    start = now();
+    for (;;) {
+        int done;
+
+        if (!yaml_parser_parse(&parser, &event)) {
+            fprintf(stderr, "%s: parser error: %s\n", corpus->name, parser.problem);
+            yaml_parser_delete(&parser);
+            return 0;
+        }
+        result->items++;
+        done = (event.type == YAML_STREAM_END_EVENT);
+        if (event.type == YAML_SEQUENCE_START_EVENT || event.type == YAML_MAPPING_START_EVENT) {
+            depth++;
+        } else if (event.type == YAML_SEQUENCE_END_EVENT || event.type == YAML_MAPPING_END_EVENT) {
+            depth--;
+        }
+        yaml_event_delete(&event);
+        if (done) break;
+
+        if (depth > 2) {
+            if (!yaml_parser_skip_node(&parser)) {
+                fprintf(stderr, "%s: parser error: %s\n", corpus->name, parser.problem);
+                yaml_parser_delete(&parser);
+                return 0;
+            }
+            depth--;
+        }
+    }
+    result->seconds = now() - start;
+    result->allocations = allocations;
+
+    yaml_parser_delete(&parser);
+
+    return 1;
+}
+
+/*
+ * Handlers that count the events.
+ */
+
+static int count_event(void *data) {
+    (*(size_t *)data)++;
+    return 1;
+}
+
+static int count_stream_start(void *data, YamlEncoding encoding) {
+    (void)encoding;
+    return count_event(data);
+}
+
+static int count_document_start(void *data, const YamlVersionDirective *version_directive, const YamlTagDirective *tag_directives_start,
+                                const YamlTagDirective *tag_directives_end, int implicit) {
+    (void)version_directive, (void)tag_directives_start, (void)tag_directives_end, (void)implicit;
+    return count_event(data);
+}
+
+static int count_document_end(void *data, int implicit) {
+    (void)implicit;
+    return count_event(data);
+}
+
+static int count_alias(void *data, const YamlChar_t *anchor) {
+    (void)anchor;
+    return count_event(data);
+}
+
+static int count_scalar(void *data, const YamlChar_t *value, size_t length, const YamlChar_t *tag, YamlScalarStyle style, const YamlChar_t *anchor) {
+    (void)value, (void)length, (void)tag, (void)style, (void)anchor;
+    return count_event(data);
+}
+
+static int count_sequence_start(void *data, const YamlChar_t *tag, YamlSequenceStyle style, const YamlChar_t *anchor) {
+    (void)tag, (void)style, (void)anchor;
+    return count_event(data);
+}
+
+static int count_mapping_start(void *data, const YamlChar_t *tag, YamlMappingStyle style, const YamlChar_t *anchor) {
+    (void)tag, (void)style, (void)anchor;
+    return count_event(data);
+}
+
+static int bench_sax(const Corpus *corpus, Result *result) {
+    YamlParser parser;
+    YamlParserCallbacks callbacks = {count_stream_start, count_event,          count_document_start, count_document_end,
+                                     count_alias,        count_scalar,         count_sequence_start, count_event,
+                                     count_mapping_start, count_event, NULL};
+    double start;
+
+    if (!start_parser(&parser, corpus)) return 0;
+
+    callbacks.data = &result->items;
+
+    allocations = 0;
+    start = now();
+    if (!yaml_parser_parse_callbacks(&parser, &callbacks)) {
+        fprintf(stderr, "%s: parser error: %s\n", corpus->name, parser.problem);
+        yaml_parser_delete(&parser);
+        return 0;
+    }
+    result->seconds = now() - start;
+    result->allocations = allocations;
+
+    yaml_parser_delete(&parser);
+
+    return 1;
+}
+
+static int load(const Corpus *corpus, YamlDocument *document, int index_mappings) {
+    YamlParser parser;
+
+    if (!start_parser(&parser, corpus)) return 0;
+    yaml_parser_set_index_mappings(&parser, index_mappings);
+
+    if (!yaml_parser_load(&parser, document)) {
+        fprintf(stderr, "%s: loader error: %s\n", corpus->name, parser.problem);
+        yaml_parser_delete(&parser);
+        return 0;
+    }
+
+    yaml_parser_delete(&parser);
+
+    return 1;
+}
+
+static int bench_load(const Corpus *corpus, Result *result) {
+    YamlParser parser;
+    YamlDocument document;
+    double start;
+
+    allocations = 0;
+    start = now();
+    if (!start_parser(&parser, corpus)) return 0;
+
+    for (;;) {
+        size_t nodes;
+
+        if (!yaml_parser_load(&parser, &document)) {
+            fprintf(stderr, "%s: loader error: %s\n", corpus->name, parser.problem);
+            yaml_parser_delete(&parser);
+            return 0;
+        }
+        nodes = document.nodes.top - document.nodes.start;
+        result->items += nodes;
+        yaml_document_delete(&document);
+        if (!nodes) break;
+    }
+
+    result->seconds = now() - start;
+    result->allocations = allocations;
+
+    yaml_parser_delete(&parser);
+
+    return 1;
+}
+
+static int bench_tape(const Corpus *corpus, Result *result) {
+    YamlParser parser;
+    YamlTape tape;
+    double start;
+
+    allocations = 0;
+    start = now();
+    if (!start_parser(&parser, corpus)) return 0;
+
+    for (;;) {
+        size_t entries;
+
+        if (!yaml_parser_load_tape(&parser, &tape)) {
+            fprintf(stderr, "%s: loader error: %s\n", corpus->name, parser.problem);
+            yaml_parser_delete(&parser);
+            return 0;
+        }
+        entries = tape.entries.top - tape.entries.start;
+        result->items += entries;
+        yaml_tape_delete(&tape);
+        if (!entries) break;
+    }
+
+    result->seconds = now() - start;
+    result->allocations = allocations;
+
+    yaml_parser_delete(&parser);
+
+    return 1;
+}
+
+static int bench_load_all(const Corpus *corpus, Result *result) {
+    YamlParser parser;
+    YamlDocument *documents;
+    size_t count, k;
+    double start;
+
+    allocations = 0;
+    start = now();
+    if (!start_parser(&parser, corpus)) return 0;
+
+    if (!yaml_parser_load_all(&parser, threads, &documents, &count)) {
+        fprintf(stderr, "%s: loader error: %s\n", corpus->name, parser.problem);
+        yaml_parser_delete(&parser);
+        return 0;
+    }
+
+    result->seconds = now() - start;
+    result->allocations = allocations;
+    for (k = 0; k < count; k++) {
+        result->items += documents[k].nodes.top - documents[k].nodes.start;
+    }
+
+    yaml_documents_delete(documents, count);
+    yaml_parser_delete(&parser);
+
+    return 1;
+}
+
+static int discard(void *data, unsigned char *buffer, size_t size) {
+    (void)buffer;
+    *(size_t *)data += size;
+    return 1;
+}
+
+static int bench_dump(const Corpus *corpus, Result *result) {
+    YamlDocument document;
+    YamlEmitter emitter;
+    size_t written = 0;
+    double start;
+
+    if (!load(corpus, &document, 0)) return 0;
+    result->items = document.nodes.top - document.nodes.start;
+
+    if (!yaml_emitter_initialize(&emitter) || !yaml_emitter_set_allocator(&emitter, &counting)) {
+        yaml_document_delete(&document);
+        return 0;
+    }
+    yaml_emitter_set_output(&emitter, discard, &written);
+    yaml_emitter_set_unicode(&emitter, 1);
+
+    allocations = 0;
+    start = now();
+    if (!yaml_emitter_open(&emitter)) {
+        fprintf(stderr, "%s: emitter error: %s\n", corpus->name, emitter.problem);
+        yaml_document_delete(&document);
+        yaml_emitter_delete(&emitter);
+        return 0;
+    }
+    if (!yaml_emitter_dump(&emitter, &document) || !yaml_emitter_close(&emitter)) {
+        fprintf(stderr, "%s: emitter error: %s\n", corpus->name, emitter.problem);
+        yaml_emitter_delete(&emitter);
+        return 0;
+    }
+    result->seconds = now() - start;
+    result->allocations = allocations;
+
+    yaml_emitter_delete(&emitter);
+
+    return 1;
+}
+
+/*
+ * Append a path segment selecting the given mapping key or sequence index.
+ */
+
+static void path_append(char *path, size_t size, const YamlChar_t *key, size_t length, int index) {
+    size_t used = strlen(path);
+    size_t k;
+
+    if (!key) {
+        snprintf(path + used, size - used, "[%d]", index);
+        return;
+    }
+
+    if (used + 2 * length + 5 > size) return;
+
+    path[used++] = '[';
+    path[used++] = '"';
+    for (k = 0; k < length; k++) {
+        if (key[k] == '"' || key[k] == '\\') path[used++] = '\\';
+        path[used++] = (char)key[k];
+    }
+    path[used++] = '"';
+    path[used++] = ']';
+    path[used] = '\0';
+}
+
+#define PATHS 1024
+#define LOOKUPS (1 << 20)
+
+/*
+ * Compile paths to random nodes of the document.
+ */
+
+static int random_paths(const Corpus *corpus, YamlDocument *document, YamlPath **paths, size_t total) {
+    unsigned int seed = 12345;
+    size_t count = 0;
+
+    while (count < total) {
+        char path[4096] = "";
+        int id = (int)(yaml_document_get_root_node(document) - document->nodes.start) + 1;
+
+        for (;;) {
+            YamlNode *node = yaml_document_get_node(document, id);
+            size_t size;
+
+            seed = seed * 1103515245u + 12345u;
+
+            if (node->type == YAML_MAPPING_NODE && (size = node->data.mapping.pairs.top - node->data.mapping.pairs.start)) {
+                YamlNodePair *pair = node->data.mapping.pairs.start + (seed >> 8) % size;
+                YamlNode *key = yaml_document_get_node(document, pair->key);
+
+                if (key->type != YAML_SCALAR_NODE) break;
+                path_append(path, sizeof(path), key->data.scalar.value, key->data.scalar.length, 0);
+                id = pair->value;
+            } else if (node->type == YAML_SEQUENCE_NODE && (size = node->data.sequence.items.top - node->data.sequence.items.start)) {
+                int index = (int)((seed >> 8) % size);
+
+                path_append(path, sizeof(path), NULL, 0, index);
+                id = node->data.sequence.items.start[index];
+            } else {
+                break;
+            }
+        }
+
+        if (!(paths[count] = yaml_path_compile(path))) {
+            fprintf(stderr, "%s: cannot compile %s\n", corpus->name, path);
+            while (count) yaml_path_delete(paths[--count]);
+            return 0;
+        }
+        count++;
+    }
+
+    return 1;
+}
+
+/*
+ * Compile paths to random nodes of the document, then time the lookups.
+ */
+
+static int bench_path(const Corpus *corpus, Result *result) {
+    static YamlPath *paths[PATHS];
+    YamlDocument document;
+    size_t lookup;
+    double start;
+    int found = 1;
+
+    if (!load(corpus, &document, 1)) return 0;
+
+    if (!random_paths(corpus, &document, paths, PATHS)) {
+        yaml_document_delete(&document);
+        return 0;
+    }
+
+    allocations = 0;
+    start = now();
+    for (lookup = 0; lookup < LOOKUPS; lookup++) {
+        found &= (yaml_path_eval(&document, paths[lookup % PATHS]) != 0);
+    }
+    result->seconds = now() - start;
+    result->allocations = allocations;
+    result->items = LOOKUPS;
+
+    for (lookup = 0; lookup < PATHS; lookup++) {
+        yaml_path_delete(paths[lookup]);
+    }
+    yaml_document_delete(&document);
+
+    if (!found) {
+        fprintf(stderr, "%s: a path lookup failed\n", corpus->name);
+        return 0;
+    }
+
+    return 1;
+}
+
+#define LOADED_PATHS 3
+
+/*
+ * Load only the nodes three random paths of the first document lead to,
+ * from every document.
+ */
+
+static int bench_load_paths(const Corpus *corpus, Result *result) {
+    YamlPath *paths[LOADED_PATHS];
+    YamlDocument document;
+    YamlParser parser;
+    double start;
+    int k;
+
+    if (!load(corpus, &document, 0)) return 0;
+
+    k = random_paths(corpus, &document, paths, LOADED_PATHS);
+    yaml_document_delete(&document);
+    if (!k) return 0;
+
+    if (!start_parser(&parser, corpus)) {
+        for (k = 0; k < LOADED_PATHS; k++) yaml_path_delete(paths[k]);
+        return 0;
+    }
+
+    allocations = 0;
+    start = now();
+    for (;;) {
+        int done;
+
+        if (!yaml_parser_load_paths(&parser, &document, (const YamlPath *const *)paths, LOADED_PATHS)) {
+            fprintf(stderr, "%s: loader error: %s\n", corpus->name, parser.problem);
+            yaml_parser_delete(&parser);
+            for (k = 0; k < LOADED_PATHS; k++) yaml_path_delete(paths[k]);
+            return 0;
+        }
+        done = !yaml_document_get_root_node(&document);
+        result->items += document.nodes.top - document.nodes.start;
+        yaml_document_delete(&document);
+        if (done) break;
+    }
+    result->seconds = now() - start;
+    result->allocations = allocations;
+
+    yaml_parser_delete(&parser);
+    for (k = 0; k < LOADED_PATHS; k++) yaml_path_delete(paths[k]);
+
+    return 1;
+}
+
+static const struct {
+    const char *name;
+    const char *items;
+    int (*run)(const Corpus *corpus, Result *result);
+} benches[] = {
+    {"scan", "tokens", bench_scan},       {"parse", "events", bench_parse}, {"skip", "events", bench_skip},
+    {"sax", "events", bench_sax},         {"load", "nodes", bench_load},    {"tape", "nodes", bench_tape},
+    {"loadall", "nodes", bench_load_all}, {"loadpaths", "nodes", bench_load_paths}, {"path", "lookups", bench_path},
+    {"dump", "nodes", bench_dump},
+};
+
+static int write_corpus(const char *directory, const Corpus *corpus) {
+    char path[4096];
+    FILE *file;
+    int ok;
+
+    snprintf(path, sizeof(path), "%s/%s.yaml", directory, corpus->name);
+    if (!(file = fopen(path, "wb"))) {
+        perror(path);
+        return 0;
+    }
+    ok = (fwrite(corpus->data, 1, corpus->size, file) == corpus->size);
+    ok &= (fclose(file) == 0);
+    if (ok) printf("%-8s %10zu octets  %s\n", path, corpus->size, corpus->description);
+
+    return ok;
+}
+
+static int usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [-s megabytes] [-r repeats] [-c corpus] [-b bench] [-t threads]\n"
+            "       %s -w directory [-s megabytes] [-c corpus]\n",
+            program, program);
+    return 2;
+}
+
+int main(int argc, char *argv[]) {
+    size_t megabytes = 8;
+    int repeats = 3;
+    const char *only_corpus = NULL;
+    const char *only_bench = NULL;
+    const char *directory = NULL;
+    int status = 0;
+    int c, b, i;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) return usage(argv[0]);
+        switch (argv[i][1]) {
+            case 's':
+                megabytes = (size_t)atoi(argv[++i]);
+                break;
+            case 'r':
+                repeats = atoi(argv[++i]);
+                break;
+            case 'c':
+                only_corpus = argv[++i];
+                break;
+            case 'b':
+                only_bench = argv[++i];
+                break;
+            case 't':
+                threads = atoi(argv[++i]);
+                break;
+            case 'w':
+                directory = argv[++i];
+                break;
+            default:
+                return usage(argv[0]);
+        }
+    }
+    if (!megabytes || repeats < 1 || threads < 0) return usage(argv[0]);
+
+    if (!directory) {
+        printf("%-8s %-7s %10s %20s %9s\n", "corpus", "bench", "MB/s", "items/s", "allocs/MB");
+    }
+
+    for (c = 0; corpus_names[c]; c++) {
+        Corpus corpus;
+
+        if (only_corpus && strcmp(only_corpus, corpus_names[c]) != 0) continue;
+
+        if (!corpus_generate(corpus_names[c], megabytes << 20, &corpus)) {
+            fprintf(stderr, "%s: cannot generate the corpus\n", corpus_names[c]);
+            return 1;
+        }
+
+        if (directory) {
+            if (!write_corpus(directory, &corpus)) status = 1;
+            corpus_free(&corpus);
+            continue;
+        }
+
+        for (b = 0; b < (int)(sizeof(benches) / sizeof(benches[0])); b++) {
+            Result best = {0, 0, 0};
+            double megabytes_in = corpus.size / 1e6;
+            int r;
+
+            if (only_bench && strcmp(only_bench, benches[b].name) != 0) continue;
+
+            for (r = 0; r < repeats; r++) {
+                Result result = {0, 0, 0};
+
+                if (!benches[b].run(&corpus, &result)) {
+                    status = 1;
+                    break;
+                }
+                if (!r || result.seconds < best.seconds) best = result;
+            }
+            if (r < repeats) continue;
+
+            /* The lookups do not go through the input, so they have no throughput. */
+
+            if (strcmp(benches[b].name, "path") == 0) {
+                printf("%-8s %-7s %10s", corpus.name, benches[b].name, "-");
+            } else {
+                printf("%-8s %-7s %10.1f", corpus.name, benches[b].name, megabytes_in / best.seconds);
+            }
+            printf(" %12.0f %-7s %9.1f\n", best.items / best.seconds, benches[b].items, best.allocations / megabytes_in);
+        }
+
+        corpus_free(&corpus);
+    }
+
+    return status;
+}
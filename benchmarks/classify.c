@@ -0,0 +1,207 @@
+/*
+ * Character classification benchmark.
+ *
+ * Measures the per-octet cost of the scanner's character class checks, once
+ * as the chains of comparisons the macros used to expand to and once as
+ * lookups in a 256-entry class table like the one in myyaml.c, and then the
+ * per-octet cost of yaml_parser_scan() over the same input.
+ *
+ * Usage: myyaml_bench_classify [megabytes]
+ */
+
+#include <myyaml/myyaml.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Build a block-style document of about `size` octets with a mix of plain,
+ * quoted and block scalars, comments and tags.
+ */
+
+static unsigned char *make_document(size_t size, size_t *length) {
+    static const char *lines[] = {
+        "  name: service-%06u\n",
+        "  description: \"Zoë's café configuration, revision %u\"\n",
+        "  path: !!str /usr/local/share/service/%u/data\n",
+        "  tags: [alpha, beta, gamma, delta]\n",
+        "  # a comment line that the scanner skips over %u\n",
+        "  script: |\n    echo starting %u\n    exec service --config /etc/service.conf\n",
+        "  note: plain text without any special characters at all %u\n",
+    };
+    unsigned char *data = (unsigned char *)malloc(size + 512);
+    size_t done = 0;
+    unsigned int n = 0;
+
+    while (done < size) {
+        done += sprintf((char *)data + done, "item%u:\n", n);
+        for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+            done += sprintf((char *)data + done, lines[i], n);
+        }
+        n++;
+    }
+
+    *length = done;
+    return data;
+}
+
+/*
+ * The class checks as comparison chains.
+ */
+
+#define CHAIN_IS_BREAK(p)                                                                                             \
+    ((p)[0] == '\r' || (p)[0] == '\n' || ((p)[0] == 0xC2 && (p)[1] == 0x85) || ((p)[0] == 0xE2 && (p)[1] == 0x80 && \
+                                                                               ((p)[2] == 0xA8 || (p)[2] == 0xA9)))
+
+#define CHAIN_IS_BLANKZ(p) ((p)[0] == ' ' || (p)[0] == '\t' || (p)[0] == '\0' || CHAIN_IS_BREAK(p))
+
+#define CHAIN_IS_ALPHA(p) \
+    (((p)[0] >= '0' && (p)[0] <= '9') || ((p)[0] >= 'A' && (p)[0] <= 'Z') || ((p)[0] >= 'a' && (p)[0] <= 'z') || (p)[0] == '_' || (p)[0] == '-')
+
+#define CHAIN_WIDTH(p) \
+    (((p)[0] & 0x80) == 0x00 ? 1 : ((p)[0] & 0xE0) == 0xC0 ? 2 : ((p)[0] & 0xF0) == 0xE0 ? 3 : ((p)[0] & 0xF8) == 0xF0 ? 4 : 0)
+
+/*
+ * The same checks through a class table.
+ */
+
+#define CLASS_BLANKZ 0x01
+#define CLASS_BREAK_LEAD 0x02
+#define CLASS_ALPHA 0x04
+#define CLASS_WIDTH_SHIFT 4
+
+static unsigned char classes[256];
+
+static void build_classes(void) {
+    for (int octet = 0; octet < 256; octet++) {
+        unsigned char probe[3] = {(unsigned char)octet, 0, 0};
+
+        classes[octet] = (unsigned char)(CHAIN_WIDTH(probe) << CLASS_WIDTH_SHIFT);
+        if (CHAIN_IS_BLANKZ(probe)) classes[octet] |= CLASS_BLANKZ;
+        if (octet == 0xC2 || octet == 0xE2) classes[octet] |= CLASS_BREAK_LEAD;
+        if (CHAIN_IS_ALPHA(probe)) classes[octet] |= CLASS_ALPHA;
+    }
+}
+
+#define TABLE_IS_BLANKZ(p) \
+    ((classes[(p)[0]] & CLASS_BLANKZ) || ((classes[(p)[0]] & CLASS_BREAK_LEAD) && CHAIN_IS_BREAK(p)))
+
+#define TABLE_IS_ALPHA(p) (classes[(p)[0]] & CLASS_ALPHA)
+
+#define TABLE_WIDTH(p) (classes[(p)[0]] >> CLASS_WIDTH_SHIFT)
+
+/*
+ * Classify every octet of the input: count the blanks, the alphanumerical
+ * characters and the widths.
+ */
+
+static double bench_chain(const unsigned char *input, size_t size, size_t *count) {
+    const unsigned char *pointer = input;
+    const unsigned char *end = input + size;
+    size_t found = 0;
+    double start = now();
+
+    while (pointer < end) {
+        if (CHAIN_IS_BLANKZ(pointer)) found++;
+        if (CHAIN_IS_ALPHA(pointer)) found++;
+        found += CHAIN_WIDTH(pointer);
+        pointer++;
+    }
+
+    start = now() - start;
+    *count = found;
+
+    return start;
+}
+
+static double bench_table(const unsigned char *input, size_t size, size_t *count) {
+    const unsigned char *pointer = input;
+    const unsigned char *end = input + size;
+    size_t found = 0;
+    double start = now();
+
+    while (pointer < end) {
+        if (TABLE_IS_BLANKZ(pointer)) found++;
+        if (TABLE_IS_ALPHA(pointer)) found++;
+        found += TABLE_WIDTH(pointer);
+        pointer++;
+    }
+
+    start = now() - start;
+    *count = found;
+
+    return start;
+}
+
+/*
+ * Scan the whole input into tokens.
+ */
+
+static double bench_scanner(const unsigned char *input, size_t size) {
+    YamlParser parser;
+    YamlToken token;
+    double start;
+
+    if (!yaml_parser_initialize(&parser)) return -1;
+    yaml_parser_set_input_string(&parser, input, size);
+
+    start = now();
+    for (;;) {
+        int done;
+
+        if (!yaml_parser_scan(&parser, &token)) {
+            fprintf(stderr, "scanner error: %s\n", parser.problem);
+            yaml_parser_delete(&parser);
+            return -1;
+        }
+        done = (token.type == YAML_STREAM_END_TOKEN);
+        yaml_token_delete(&token);
+        if (done) break;
+    }
+
+    start = now() - start;
+    yaml_parser_delete(&parser);
+
+    return start;
+}
+
+static void report(const char *name, size_t size, double seconds) {
+    printf("%-28s %10.3f ns/octet %10.1f MB/s\n", name, seconds * 1e9 / size, size / seconds / 1e6);
+}
+
+int main(int argc, char *argv[]) {
+    size_t megabytes = argc > 1 ? (size_t)atoi(argv[1]) : 64;
+    size_t size, chain_count, table_count;
+    unsigned char *input = make_document(megabytes << 20, &size);
+    double chain, table;
+
+    build_classes();
+
+    /* The padding keeps the three-octet break checks inside the buffer. */
+
+    memset(input + size, 0, 3);
+
+    chain = bench_chain(input, size, &chain_count);
+    table = bench_table(input, size, &table_count);
+    if (chain_count != table_count) {
+        fprintf(stderr, "class counts differ: %zu != %zu\n", chain_count, table_count);
+        free(input);
+        return 1;
+    }
+
+    report("comparison chains", size, chain);
+    report("class table", size, table);
+    report("yaml_parser_scan()", size, bench_scanner(input, size));
+
+    free(input);
+
+    return 0;
+}
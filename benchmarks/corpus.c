@@ -0,0 +1,346 @@
+/*
+ * Synthetic corpus generator for the benchmarks.
+ */
+
+#include "corpus.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char *const corpus_names[] = {"deep", "wide", "literal", "json", "anchors", "utf16", "stream", NULL};
+
+/*
+ * A growable output buffer.
+ */
+
+typedef struct Buffer {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+    int failed;
+} Buffer;
+
+static void append(Buffer *buffer, const char *format, ...) {
+    va_list args;
+    int length;
+
+    if (buffer->failed) return;
+
+    for (;;) {
+        size_t room = buffer->capacity - buffer->size;
+
+        va_start(args, format);
+        length = vsnprintf((char *)buffer->data + buffer->size, room, format, args);
+        va_end(args);
+
+        if (length < 0) {
+            buffer->failed = 1;
+            return;
+        }
+        if ((size_t)length < room) break;
+
+        {
+            size_t capacity = buffer->capacity * 2 + length + 1;
+            unsigned char *data = (unsigned char *)realloc(buffer->data, capacity);
+
+            if (!data) {
+                buffer->failed = 1;
+                return;
+            }
+            buffer->data = data;
+            buffer->capacity = capacity;
+        }
+    }
+
+    buffer->size += length;
+}
+
+static void indent(Buffer *buffer, int level) {
+    append(buffer, "%*s", level * 2, "");
+}
+
+/*
+ * A xorshift generator with a fixed seed.
+ */
+
+static uint64_t state;
+
+static uint32_t next(void) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (uint32_t)(state >> 32);
+}
+
+static uint32_t below(uint32_t limit) {
+    return next() % limit;
+}
+
+static const char *const words[] = {
+    "alpha",  "beta",    "gamma",   "delta",  "service", "config", "replica", "region",  "volume", "network",
+    "policy", "backend", "timeout", "secret", "port",    "host",   "label",   "version", "enable", "channel",
+};
+
+#define WORD() (words[below(sizeof(words) / sizeof(words[0]))])
+
+static const char *const foreign[] = {
+    "café", "naïve", "Zoë", "東京", "Ελληνικά", "русский", "中文", "日本語", "\xF0\x9F\x9A\x80",
+};
+
+/*
+ * Block mappings nested eight to twenty-four levels deep.
+ */
+
+static void make_deep(Buffer *buffer, size_t size) {
+    unsigned int n = 0;
+
+    while (buffer->size < size && !buffer->failed) {
+        int depth = 8 + below(17);
+        int level;
+
+        append(buffer, "section%u:\n", n++);
+        for (level = 1; level <= depth; level++) {
+            int leaves = below(4);
+
+            while (leaves--) {
+                indent(buffer, level);
+                append(buffer, "%s%u: %s-%u\n", WORD(), below(1000), WORD(), below(100000));
+            }
+            indent(buffer, level);
+            append(buffer, "level%d:\n", level);
+        }
+        indent(buffer, level);
+        append(buffer, "leaf: %u\n", next());
+    }
+}
+
+/*
+ * Long block sequences of short scalars and flow sequences of numbers.
+ */
+
+static void make_wide(Buffer *buffer, size_t size) {
+    unsigned int n = 0;
+
+    while (buffer->size < size && !buffer->failed) {
+        int items = 500 + below(1000);
+
+        append(buffer, "list%u:\n", n);
+        while (items--) {
+            append(buffer, "  - %s-%u\n", WORD(), below(100000));
+        }
+        append(buffer, "numbers%u: [", n);
+        for (items = 0; items < 200; items++) {
+            append(buffer, items ? ", %u" : "%u", below(1000000));
+        }
+        append(buffer, "]\n");
+        n++;
+    }
+}
+
+/*
+ * Long literal and folded block scalars.
+ */
+
+static void make_literal(Buffer *buffer, size_t size) {
+    unsigned int n = 0;
+
+    while (buffer->size < size && !buffer->failed) {
+        int lines = 20 + below(60);
+
+        append(buffer, "text%u: %s\n", n++, below(2) ? "|" : ">-");
+        while (lines--) {
+            int count = 4 + below(10);
+
+            append(buffer, "  ");
+            while (count--) {
+                append(buffer, count ? "%s " : "%s", WORD());
+            }
+            append(buffer, "\n");
+        }
+    }
+}
+
+/*
+ * An array of JSON objects.
+ */
+
+static void make_json(Buffer *buffer, size_t size) {
+    unsigned int n = 0;
+
+    append(buffer, "[\n");
+    while (buffer->size < size && !buffer->failed) {
+        append(buffer, "%s  {\"id\": %u, \"name\": \"%s-%u\", \"active\": %s, \"score\": %u.%02u, \"tags\": [\"%s\", \"%s\", \"%s\"], ",
+               n ? ",\n" : "", n, WORD(), below(100000), below(2) ? "true" : "false", below(100), below(100), WORD(), WORD(), WORD());
+        append(buffer, "\"owner\": {\"name\": \"%s\", \"email\": \"%s@example.com\", \"manager\": null}, ", WORD(), WORD());
+        append(buffer, "\"limits\": {\"cpu\": %u, \"memory\": \"%uMi\", \"ports\": [%u, %u]}}", 1 + below(16), 64 << below(6),
+               below(65536), below(65536));
+        n++;
+    }
+    append(buffer, "\n]\n");
+}
+
+/*
+ * Records that define anchors and refer back to earlier ones.
+ */
+
+static void make_anchors(Buffer *buffer, size_t size) {
+    unsigned int n = 0;
+
+    while (buffer->size < size && !buffer->failed) {
+        append(buffer, "- &r%u\n  name: %s-%u\n  port: %u\n", n, WORD(), n, below(65536));
+        if (n) {
+            int references = 1 + below(3);
+
+            append(buffer, "  uses: [");
+            while (references--) {
+                append(buffer, references ? "*r%u, " : "*r%u", below(n));
+            }
+            append(buffer, "]\n");
+        }
+        if (n && !below(4)) {
+            append(buffer, "- *r%u\n", below(n));
+        }
+        n++;
+    }
+}
+
+/*
+ * A stream of small deployment manifests, some of them with directives.
+ */
+
+static void make_stream(Buffer *buffer, size_t size) {
+    unsigned int n = 0;
+
+    while (buffer->size < size && !buffer->failed) {
+        if (n && !below(8)) {
+            append(buffer, "...\n%%YAML 1.1\n");
+        }
+        append(buffer, "---\nkind: %s\nmetadata:\n  name: %s-%u\n  labels: {app: %s, tier: %s}\nspec:\n  replicas: %u\n", below(2) ? "Deployment" : "Service",
+               WORD(), n, WORD(), WORD(), 1 + below(5));
+        append(buffer, "  containers:\n    - name: %s\n      image: \"registry/%s:%u\"\n      args: [--port, '%u']\n      script: |\n        run %s\n        exit\n",
+               WORD(), WORD(), below(100), 1024 + below(60000), WORD());
+        n++;
+    }
+}
+
+/*
+ * Mixed UTF-8 text, encoded as UTF-16LE with a BOM afterwards.
+ */
+
+static void make_mixed(Buffer *buffer, size_t size) {
+    unsigned int n = 0;
+
+    while (buffer->size < size && !buffer->failed) {
+        append(buffer, "entry%u:\n  title: \"%s %s\"\n  city: %s\n  note: %s %s %s\n", n++, foreign[below(9)], WORD(), foreign[below(9)],
+               WORD(), foreign[below(9)], WORD());
+    }
+}
+
+static unsigned char *utf16le(const unsigned char *input, size_t size, size_t *length) {
+    unsigned char *data = (unsigned char *)malloc(2 * size + 2);
+    unsigned char *out = data;
+    size_t i = 0;
+
+    if (!data) return NULL;
+
+    *out++ = 0xFF;
+    *out++ = 0xFE;
+
+    while (i < size) {
+        uint32_t rune;
+        unsigned int units[2];
+        int count = 1;
+        int k;
+
+        if (input[i] < 0x80) {
+            rune = input[i++];
+        } else if ((input[i] & 0xE0) == 0xC0) {
+            rune = ((input[i] & 0x1Fu) << 6) | (input[i + 1] & 0x3Fu);
+            i += 2;
+        } else if ((input[i] & 0xF0) == 0xE0) {
+            rune = ((input[i] & 0x0Fu) << 12) | ((input[i + 1] & 0x3Fu) << 6) | (input[i + 2] & 0x3Fu);
+            i += 3;
+        } else {
+            rune = ((input[i] & 0x07u) << 18) | ((input[i + 1] & 0x3Fu) << 12) | ((input[i + 2] & 0x3Fu) << 6) | (input[i + 3] & 0x3Fu);
+            i += 4;
+        }
+
+        if (rune >= 0x10000) {
+            units[0] = 0xD800 + ((rune - 0x10000) >> 10);
+            units[1] = 0xDC00 + ((rune - 0x10000) & 0x3FF);
+            count = 2;
+        } else {
+            units[0] = rune;
+        }
+        for (k = 0; k < count; k++) {
+            *out++ = units[k] & 0xFF;
+            *out++ = units[k] >> 8;
+        }
+    }
+
+    *length = out - data;
+    return data;
+}
+
+int corpus_generate(const char *name, size_t size, Corpus *corpus) {
+    Buffer buffer = {NULL, 0, 0, 0};
+
+    memset(corpus, 0, sizeof(*corpus));
+    state = 0x9E3779B97F4A7C15ull;
+
+    buffer.capacity = size + 4096;
+    buffer.data = (unsigned char *)malloc(buffer.capacity);
+    if (!buffer.data) return 0;
+
+    if (strcmp(name, "deep") == 0) {
+        corpus->description = "block mappings nested 8 to 24 levels deep";
+        make_deep(&buffer, size);
+    } else if (strcmp(name, "wide") == 0) {
+        corpus->description = "long block sequences and flow sequences of numbers";
+        make_wide(&buffer, size);
+    } else if (strcmp(name, "literal") == 0) {
+        corpus->description = "long literal and folded block scalars";
+        make_literal(&buffer, size);
+    } else if (strcmp(name, "json") == 0) {
+        corpus->description = "a JSON array of nested objects";
+        make_json(&buffer, size);
+    } else if (strcmp(name, "anchors") == 0) {
+        corpus->description = "records with anchors and aliases to earlier ones";
+        make_anchors(&buffer, size);
+    } else if (strcmp(name, "utf16") == 0) {
+        corpus->description = "mixed-script block mappings in UTF-16LE";
+        make_mixed(&buffer, size / 2);
+        if (!buffer.failed) {
+            unsigned char *data = utf16le(buffer.data, buffer.size, &buffer.size);
+
+            free(buffer.data);
+            buffer.data = data;
+            buffer.failed = !data;
+        }
+    } else if (strcmp(name, "stream") == 0) {
+        corpus->description = "thousands of small manifests separated by ---";
+        make_stream(&buffer, size);
+    } else {
+        free(buffer.data);
+        return 0;
+    }
+
+    if (buffer.failed) {
+        free(buffer.data);
+        return 0;
+    }
+
+    corpus->name = name;
+    corpus->data = buffer.data;
+    corpus->size = buffer.size;
+
+    return 1;
+}
+
+void corpus_free(Corpus *corpus) {
+    free(corpus->data);
+    memset(corpus, 0, sizeof(*corpus));
+}
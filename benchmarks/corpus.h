@@ -0,0 +1,32 @@
+/*
+ * Synthetic corpus generator for the benchmarks.
+ *
+ * Every corpus is a YAML stream of about the requested size, built from a
+ * fixed seed so that runs and machines can be compared.  All of them hold a
+ * single document but `stream`.
+ */
+
+#ifndef MYYAML_BENCH_CORPUS_H
+#define MYYAML_BENCH_CORPUS_H
+
+#include <stddef.h>
+
+typedef struct Corpus {
+    const char *name;        /* The corpus name. */
+    const char *description; /* What the corpus is made of. */
+    unsigned char *data;     /* The document, owned by the corpus. */
+    size_t size;             /* The size of the document in octets. */
+} Corpus;
+
+/* The names of the corpora, NULL-terminated. */
+extern const char *const corpus_names[];
+
+/*
+ * Generate the named corpus of about `size` octets.  Returns 0 if there is
+ * no such corpus or not enough memory.
+ */
+int corpus_generate(const char *name, size_t size, Corpus *corpus);
+
+void corpus_free(Corpus *corpus);
+
+#endif /* MYYAML_BENCH_CORPUS_H */
@@ -0,0 +1,209 @@
+/*
+ * Transcoding benchmark.
+ *
+ * Times the UTF-16 decoding done by yaml_parser_update_buffer() and the
+ * UTF-16 recoding done by yaml_emitter_flush(), once with the vectorized
+ * kernels and once with the scalar loops (yaml_set_simd(0)).
+ *
+ * Usage: myyaml_bench_transcode [megabytes]
+ */
+
+#include <myyaml/myyaml.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Build a block-style UTF-8 document of about `size` octets, mostly ASCII
+ * with a sprinkling of two-, three- and four-octet characters.
+ */
+
+static unsigned char *make_utf8(size_t size, size_t *length) {
+    static const char *lines[] = {
+        "  name: service-%06u\n",
+        "  description: \"Zoë's café configuration\"\n",
+        "  region: 東京-%u\n",
+        "  tags: [alpha, beta, gamma, delta]\n",
+        "  note: plain text without any special characters at all %u\n",
+        "  icon: \xF0\x9F\x9A\x80\n",
+    };
+    unsigned char *data = (unsigned char *)malloc(size + 256);
+    size_t done = 0;
+    unsigned int n = 0;
+
+    while (done < size) {
+        done += sprintf((char *)data + done, "item%u:\n", n);
+        for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+            done += sprintf((char *)data + done, lines[i], n);
+        }
+        n++;
+    }
+
+    *length = done;
+    return data;
+}
+
+/*
+ * Encode UTF-8 as UTF-16 with a BOM.
+ */
+
+static unsigned char *make_utf16(const unsigned char *input, size_t size, int big_endian, size_t *length) {
+    unsigned char *data = (unsigned char *)malloc(2 * size + 2);
+    unsigned char *out = data;
+    size_t i = 0;
+
+    *out++ = big_endian ? 0xFE : 0xFF;
+    *out++ = big_endian ? 0xFF : 0xFE;
+
+    while (i < size) {
+        uint32_t rune;
+        size_t width = utf8_decode((const char *)input + i, size - i, &rune);
+        unsigned int units[2];
+        int count = 1;
+
+        if (rune >= 0x10000) {
+            units[0] = 0xD800 + ((rune - 0x10000) >> 10);
+            units[1] = 0xDC00 + ((rune - 0x10000) & 0x3FF);
+            count = 2;
+        } else {
+            units[0] = rune;
+        }
+        for (int k = 0; k < count; k++) {
+            *out++ = big_endian ? units[k] >> 8 : units[k] & 0xFF;
+            *out++ = big_endian ? units[k] & 0xFF : units[k] >> 8;
+        }
+        i += width;
+    }
+
+    *length = out - data;
+    return data;
+}
+
+/*
+ * Run the reader over the whole input, draining the working buffer the way
+ * the scanner would.
+ */
+
+static double bench_reader(const unsigned char *input, size_t size) {
+    YamlParser parser;
+    double start;
+
+    if (!yaml_parser_initialize(&parser)) return -1;
+    yaml_parser_set_input_string(&parser, input, size);
+
+    start = now();
+    for (;;) {
+        if (!yaml_parser_update_buffer(&parser, 1024)) {
+            fprintf(stderr, "reader error: %s\n", parser.problem);
+            yaml_parser_delete(&parser);
+            return -1;
+        }
+        if (parser.eof && parser.raw_buffer.pointer == parser.raw_buffer.last) break;
+        parser.buffer.pointer = parser.buffer.last;
+        parser.unread = 0;
+    }
+
+    start = now() - start;
+    yaml_parser_delete(&parser);
+
+    return start;
+}
+
+static int discard(void *data, unsigned char *buffer, size_t size) {
+    (void)data;
+    (void)buffer;
+    (void)size;
+    return 1;
+}
+
+/*
+ * Push the input through the emitter output buffer and flush it.
+ */
+
+static double bench_emitter(const unsigned char *input, size_t size, YamlEncoding encoding) {
+    YamlEmitter emitter;
+    size_t chunk;
+    size_t done = 0;
+    double start;
+
+    if (!yaml_emitter_initialize(&emitter)) return -1;
+    yaml_emitter_set_output(&emitter, discard, NULL);
+    yaml_emitter_set_encoding(&emitter, encoding);
+
+    chunk = emitter.buffer.end - emitter.buffer.start - 8;
+
+    start = now();
+    while (done < size) {
+        size_t length = size - done < chunk ? size - done : chunk;
+
+        /* Never split a character across two flushes. */
+
+        while (done + length < size && (input[done + length] & 0xC0) == 0x80) length--;
+
+        memcpy(emitter.buffer.start, input + done, length);
+        emitter.buffer.pointer = emitter.buffer.start + length;
+        if (!yaml_emitter_flush(&emitter)) {
+            yaml_emitter_delete(&emitter);
+            return -1;
+        }
+        done += length;
+    }
+
+    start = now() - start;
+    yaml_emitter_delete(&emitter);
+
+    return start;
+}
+
+static void report(const char *name, size_t size, double scalar, double simd) {
+    printf("%-28s %10.1f MB/s %10.1f MB/s %8.2fx\n", name, size / scalar / 1e6, size / simd / 1e6, scalar / simd);
+}
+
+int main(int argc, char *argv[]) {
+    size_t megabytes = argc > 1 ? (size_t)atoi(argv[1]) : 64;
+    size_t utf8_size, le_size, be_size;
+    unsigned char *utf8 = make_utf8(megabytes << 20, &utf8_size);
+    unsigned char *le = make_utf16(utf8, utf8_size, 0, &le_size);
+    unsigned char *be = make_utf16(utf8, utf8_size, 1, &be_size);
+    double scalar, simd;
+
+    printf("%-28s %15s %15s %9s\n", "", "scalar", "simd", "speedup");
+
+    yaml_set_simd(0);
+    scalar = bench_reader(le, le_size);
+    yaml_set_simd(1);
+    simd = bench_reader(le, le_size);
+    report("reader UTF-16LE -> UTF-8", le_size, scalar, simd);
+
+    yaml_set_simd(0);
+    scalar = bench_reader(be, be_size);
+    yaml_set_simd(1);
+    simd = bench_reader(be, be_size);
+    report("reader UTF-16BE -> UTF-8", be_size, scalar, simd);
+
+    yaml_set_simd(0);
+    scalar = bench_emitter(utf8, utf8_size, YAML_UTF16LE_ENCODING);
+    yaml_set_simd(1);
+    simd = bench_emitter(utf8, utf8_size, YAML_UTF16LE_ENCODING);
+    report("emitter UTF-8 -> UTF-16LE", utf8_size, scalar, simd);
+
+    yaml_set_simd(0);
+    scalar = bench_emitter(utf8, utf8_size, YAML_UTF16BE_ENCODING);
+    yaml_set_simd(1);
+    simd = bench_emitter(utf8, utf8_size, YAML_UTF16BE_ENCODING);
+    report("emitter UTF-8 -> UTF-16BE", utf8_size, scalar, simd);
+
+    free(utf8);
+    free(le);
+    free(be);
+
+    return 0;
+}
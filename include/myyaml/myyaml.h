@@ -170,6 +170,50 @@
 #ifndef MYYAML_DISABLE_ENCODING
 #endif
 
+/**
+ * @def MYYAML_DISABLE_SIMD
+ * @brief Exclude SSE2/AVX2 code paths.
+ * Define as 1 to force the portable scalar loops in the reader.
+ *
+ * @note The vector paths are only compiled in when the target supports them.
+ */
+#ifndef MYYAML_DISABLE_SIMD
+#endif
+
+/**
+ * @def MYYAML_ENABLE_PROFILING
+ * @brief Include parser counters and stage timings.
+ * Define as 1 to keep a YamlParserProfile in every parser (see
+ * yaml_parser_get_profile()).
+ *
+ * @warning This changes the layout of YamlParser: the library and the
+ * programs using it must be compiled alike.
+ */
+#ifndef MYYAML_ENABLE_PROFILING
+#endif
+
+/**
+ * @def MYYAML_DISABLE_THREADS
+ * @brief Exclude the worker threads of yaml_parser_load_all().
+ * Define as 1 to load every document in the calling thread, without
+ * linking to a threads library.
+ */
+#ifndef MYYAML_DISABLE_THREADS
+#endif
+
+/**
+ * @def MYYAML_DISABLE_NODE_MARKS
+ * @brief Exclude the marks of document nodes.
+ * Define as 1 to leave @c start_mark and @c end_mark out of YamlNode,
+ * which takes a node from 104 to 56 octets on 64-bit targets.  Tokens,
+ * events and errors keep their marks.
+ *
+ * @warning This changes the layout of YamlNode: the library and the
+ * programs using it must be compiled alike.
+ */
+#ifndef MYYAML_DISABLE_NODE_MARKS
+#endif
+
 /**
  * @def MYYAML_ASSERT
  * @brief Apply the default assert.
@@ -186,6 +230,9 @@
 #define MYYAML_SUCCESS 1
 #define MYYAML_FAILURE 0
 
+/** Returned by the parser when fed input runs out (see yaml_parser_feed()). */
+#define YAML_NEED_MORE_INPUT 2
+
 /** The tag @c !!str for string values. */
 #define MYYAML_YAML_STR_TAG "tag:yaml.org,2002:str"
 
@@ -858,6 +905,33 @@ typedef struct YamlMark {
 
 } YamlMark;
 
+/**
+ * The allocator interface.
+ *
+ * A parser, an emitter or a document may be given an allocator (see
+ * yaml_parser_set_allocator(), yaml_emitter_set_allocator() and
+ * yaml_document_set_allocator()).  All of its memory then comes from the
+ * allocator, and so does the data of the tokens, events and nodes it
+ * produces; these remember the allocator and give the data back to it when
+ * deleted.  The allocator must outlive all of them.
+ *
+ * Without an allocator, the C library malloc(), realloc() and free() are
+ * used.
+ */
+typedef struct YamlAllocator {
+    /** Allocate @a size octets, or return @c NULL. */
+    void *(*allocate)(void *data, size_t size);
+
+    /** Resize a block to @a size octets, or return @c NULL and keep it. */
+    void *(*reallocate)(void *data, void *pointer, size_t size);
+
+    /** Free a block. */
+    void (*release)(void *data, void *pointer);
+
+    void *data; /** A pointer for passing to the functions. */
+
+} YamlAllocator;
+
 /**
  * @defgroup styles Node Styles
  * @{
@@ -957,6 +1031,7 @@ typedef struct YamlToken {
             YamlChar_t *value;     /** The scalar value. */
             size_t length;         /** The length of the scalar value. */
             YamlScalarStyle style; /** The scalar style. */
+            int borrowed;          /** Does the value point into the input? */
         } scalar;
 
         /** The version directive (for @c YAML_VERSION_DIRECTIVE_TOKEN). */
@@ -978,6 +1053,8 @@ typedef struct YamlToken {
     YamlMark start_mark; /** The beginning of the token. */
     YamlMark end_mark;   /** The end of the token. */
 
+    const YamlAllocator *allocator; /** The allocator of the token data, or @c NULL. */
+
 } YamlToken;
 
 /**
@@ -1050,6 +1127,7 @@ typedef struct YamlEvent {
             YamlChar_t *value;     /** The scalar value. */
             YamlChar_t *tag;       /** The tag. */
             size_t length;         /** The length of the scalar value. */
+            int borrowed;          /** Does the value point into the input? */
 
         } scalar;
 
@@ -1075,6 +1153,10 @@ typedef struct YamlEvent {
     YamlMark start_mark; /** The beginning of the event. */
     YamlMark end_mark;   /** The end of the event. */
 
+    const YamlAllocator *allocator; /** The allocator of the event data, or @c NULL. */
+
+    int borrowed_anchor; /** Does the anchor belong to someone else, like the emitter that dumps a document? */
+
 } YamlEvent;
 
 /** Node types. */
@@ -1132,15 +1214,31 @@ typedef struct YamlNode {
 
             YamlMappingStyle style; /** The mapping style. */
 
+            /** The hash index of the scalar keys, or @c NULL (see yaml_document_mapping_get_value()). */
+            struct YamlMappingIndex *index;
+
         } mapping;
 
     } data;
 
+#if !defined(MYYAML_DISABLE_NODE_MARKS) || !MYYAML_DISABLE_NODE_MARKS
     YamlMark start_mark; /** The beginning of the node. */
     YamlMark end_mark;   /** The end of the node. */
+#endif
 
 } YamlNode;
 
+/**
+ * A block allocator the data of a loaded document may live in (see
+ * yaml_parser_set_arena()).
+ */
+typedef struct YamlArena YamlArena;
+
+/**
+ * A compiled path expression (see yaml_path_compile()).
+ */
+typedef struct YamlPath YamlPath;
+
 /** The document structure. */
 typedef struct YamlDocument {
     YamlVersionDirective *version_directive; /** The version directive. */
@@ -1166,12 +1264,110 @@ typedef struct YamlDocument {
     YamlMark start_mark; /** The beginning of the document. */
     YamlMark end_mark;   /** The end of the document. */
 
+    YamlArena *arena; /** The arena of the node tags, values and child stacks, or @c NULL. */
+
+    const YamlAllocator *allocator; /** The allocator of the document, or @c NULL. */
+
 } YamlDocument;
 
+/**
+ * A node of a tape (see yaml_parser_load_tape()).
+ *
+ * The entries of a tape are its nodes in document order, each collection
+ * followed by its descendants; the children of a mapping alternate between
+ * keys and values.  Entries are identified, like document nodes, by their
+ * position plus one.
+ */
+typedef struct YamlTapeEntry {
+    unsigned char type;  /** The node type (a YamlNodeType), or the type of the node an alias refers to. */
+    unsigned char style; /** The scalar, sequence or mapping style. */
+    unsigned char alias; /** Is the entry an alias? */
+
+    /** The string pool offset of the tag, or @c 0 for the default tag of the node type. */
+    uint32_t tag;
+
+    /**
+     * The string pool offset of the value of a scalar, the id of the entry
+     * after the last descendant of a collection, or the id of the node an
+     * alias refers to.
+     */
+    uint32_t data;
+
+    /** The length of the value of a scalar, or the number of items or pairs of a collection. */
+    uint32_t length;
+
+} YamlTapeEntry;
+
+/** A document loaded into one array of nodes and one pool of strings. */
+typedef struct YamlTape {
+    /** The nodes. */
+    struct {
+        YamlTapeEntry *start; /** The beginning of the stack. */
+        YamlTapeEntry *end;   /** The end of the stack. */
+        YamlTapeEntry *top;   /** The top of the stack. */
+
+    } entries;
+
+    /** The NUL-terminated tags and scalar values. */
+    struct {
+        YamlChar_t *start;   /** The beginning of the pool. */
+        YamlChar_t *end;     /** The end of the pool. */
+        YamlChar_t *pointer; /** The end of the strings. */
+
+    } strings;
+
+    const YamlAllocator *allocator; /** The allocator of the tape, or @c NULL. */
+
+} YamlTape;
+
 #if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
 
 typedef int YamlReadHandler(void *data, unsigned char *buffer, size_t size, size_t *size_read);
 
+/**
+ * The handlers of yaml_parser_parse_callbacks().
+ *
+ * A handler may be @c NULL to ignore the events of its kind, and returns
+ * @c 1 to go on parsing or @c 0 to stop.  The strings a handler is given
+ * belong to the parser and are valid until it returns; a scalar value is
+ * not always NUL-terminated.
+ */
+typedef struct YamlParserCallbacks {
+    /** The start of the stream, in the given encoding. */
+    int (*stream_start)(void *data, YamlEncoding encoding);
+
+    /** The end of the stream. */
+    int (*stream_end)(void *data);
+
+    /** The start of a document, with its %YAML directive or @c NULL and its %TAG directives. */
+    int (*document_start)(void *data, const YamlVersionDirective *version_directive, const YamlTagDirective *tag_directives_start,
+                          const YamlTagDirective *tag_directives_end, int implicit);
+
+    /** The end of a document. */
+    int (*document_end)(void *data, int implicit);
+
+    /** An alias. */
+    int (*alias)(void *data, const YamlChar_t *anchor);
+
+    /** A scalar, with its tag and anchor or @c NULL. */
+    int (*scalar)(void *data, const YamlChar_t *value, size_t length, const YamlChar_t *tag, YamlScalarStyle style, const YamlChar_t *anchor);
+
+    /** The start of a sequence, with its tag and anchor or @c NULL. */
+    int (*sequence_start)(void *data, const YamlChar_t *tag, YamlSequenceStyle style, const YamlChar_t *anchor);
+
+    /** The end of a sequence. */
+    int (*sequence_end)(void *data);
+
+    /** The start of a mapping, with its tag and anchor or @c NULL. */
+    int (*mapping_start)(void *data, const YamlChar_t *tag, YamlMappingStyle style, const YamlChar_t *anchor);
+
+    /** The end of a mapping. */
+    int (*mapping_end)(void *data);
+
+    void *data; /** A pointer for passing to the handlers. */
+
+} YamlParserCallbacks;
+
 /**
  * This structure holds information about a potential simple key.
  */
@@ -1190,6 +1386,7 @@ typedef struct YamlAliasData {
     YamlChar_t *anchor; /** The anchor. */
     YamlMark mark;      /** The anchor mark. */
     int index;          /** The node id. */
+    unsigned int hash;  /** The hash of the anchor. */
 
 } YamlAliasData;
 
@@ -1228,6 +1425,42 @@ typedef enum YamlParserState {
 
 } YamlParserState;
 
+/** The stages of the parser, as timed by the profile. */
+typedef enum YamlParserStage {
+    YAML_READER_STAGE,   /** Filling and decoding the input buffer. */
+    YAML_SCANNER_STAGE,  /** Producing tokens. */
+    YAML_PARSER_STAGE,   /** Producing events. */
+    YAML_COMPOSER_STAGE  /** Composing documents. */
+
+} YamlParserStage;
+
+/** The number of parser stages. */
+#define YAML_PARSER_STAGES 4
+
+/**
+ * The parser profile.
+ *
+ * Only maintained when the library is compiled with
+ * MYYAML_ENABLE_PROFILING (see yaml_parser_get_profile()).
+ */
+typedef struct YamlParserProfile {
+    size_t bytes_decoded;                      /** The octets of input the reader has decoded. */
+    size_t tokens[YAML_SCALAR_TOKEN + 1];      /** The tokens scanned, by type. */
+    size_t events[YAML_MAPPING_END_EVENT + 1]; /** The events parsed, by type. */
+    size_t simple_keys_saved;                  /** The possible simple keys saved. */
+    size_t simple_keys_removed;                /** The possible simple keys dropped without becoming keys. */
+    size_t stack_extensions;                   /** The stacks grown. */
+    size_t queue_extensions;                   /** The queues grown. */
+    size_t allocations;                        /** The allocations and reallocations. */
+
+    /**
+     * The time spent in each stage, without the stages it called: CPU
+     * time-stamp counter ticks on x86 targets, nanoseconds elsewhere.
+     */
+    uint64_t ticks[YAML_PARSER_STAGES];
+
+} YamlParserProfile;
+
 /**
  * The parser structure.
  *
@@ -1252,6 +1485,8 @@ typedef struct YamlParser {
      * @}
      */
 
+    const YamlAllocator *allocator; /** The allocator, or @c NULL. */
+
     /**
      * @name Reader stuff
      * @{
@@ -1274,6 +1509,28 @@ typedef struct YamlParser {
 
     } input;
 
+    /** Memory-mapped file input data. */
+    struct {
+        unsigned char *start; /** The beginning of the mapping. */
+        size_t size;          /** The size of the mapped file in bytes. */
+        size_t length;        /** The length of the mapping, padding included. */
+        int checked;          /** Has the mapping been validated? */
+        int passthrough;      /** Does the working buffer point into the mapping? */
+
+    } mapping;
+
+    /** Fed input data (see yaml_parser_feed()). */
+    struct {
+        unsigned char *start;   /** The beginning of the buffer. */
+        unsigned char *pointer; /** The next octet to read. */
+        unsigned char *last;    /** The last filled position of the buffer. */
+        unsigned char *end;     /** The end of the buffer. */
+        size_t offset;          /** The stream offset of the buffer start. */
+        int final;              /** Has the last chunk been fed? */
+        int starved;            /** Did the reader run out of fed input? */
+
+    } feed;
+
     int eof; /** EOF flag */
 
     /** The working buffer. */
@@ -1312,13 +1569,14 @@ typedef struct YamlParser {
     int stream_start_produced; /** Have we started to scan the input stream? */
     int stream_end_produced;   /** Have we reached the end of the input stream? */
     int flow_level;            /** The number of unclosed '[' and '{' indicators. */
+    int zero_copy;             /** May scalars borrow their value from the input? */
 
     /** The tokens queue. */
     struct {
-        YamlToken *start; /** The beginning of the tokens queue. */
-        YamlToken *head;  /** The head of the tokens queue. */
-        YamlToken *tail;  /** The tail of the tokens queue. */
-        YamlToken *end;   /** The end of the tokens queue. */
+        YamlToken *start; /** The beginning of the tokens ring. */
+        YamlToken *end;   /** The end of the tokens ring. */
+        size_t head;      /** The head position, masked into the ring. */
+        size_t tail;      /** The tail position, masked into the ring. */
 
     } tokens;
 
@@ -1346,6 +1604,51 @@ typedef struct YamlParser {
 
     } simple_keys;
 
+    size_t simple_keys_first; /** The lowest simple key that may still be possible. */
+
+    /** The scanner state saved before fetching a token from fed input. */
+    struct {
+        size_t offset;             /** The stream offset of the token start. */
+        YamlMark mark;             /** The mark of the token start. */
+        YamlEncoding encoding;     /** The input encoding. */
+        size_t tokens;             /** The number of queued tokens. */
+        int stream_start_produced; /** Saved stream start flag. */
+        int stream_end_produced;   /** Saved stream end flag. */
+        int flow_level;            /** Saved flow level. */
+        size_t simple_keys_first;  /** Saved lowest possible simple key. */
+        int simple_key_allowed;    /** Saved simple key flag. */
+        int indent;                /** Saved indentation level. */
+
+        /** Saved indentation levels stack. */
+        struct {
+            int *start; /** The beginning of the stack. */
+            int *end;   /** The end of the stack. */
+            int *top;   /** The top of the stack. */
+
+        } indents;
+
+        /** Saved simple keys stack. */
+        struct {
+            YamlSimpleKey *start; /** The beginning of the stack. */
+            YamlSimpleKey *end;   /** The end of the stack. */
+            YamlSimpleKey *top;   /** The top of the stack. */
+
+        } simple_keys;
+
+    } checkpoint;
+
+    /** The scratch strings of the scalar scanners, kept from one scalar to the next. */
+    struct {
+        YamlChar_t *pointer; /** The current position of the string. */
+        YamlChar_t *start;   /** The beginning of the string. */
+        YamlChar_t *end;     /** The end of the string. */
+
+    } scratch[4];
+
+    int callbacks;     /** Are the scalar values copied into @c values (see yaml_parser_parse_callbacks())? */
+    YamlArena *values; /** The arena of the scalar values of dropped events, or @c NULL. */
+    int skip_depth;    /** The collections a skip waiting for more input is in (see yaml_parser_skip_node()). */
+
     /**
      * @}
      */
@@ -1398,7 +1701,33 @@ typedef struct YamlParser {
 
     } aliases;
 
+    /** The hash table of the anchors. */
+    struct {
+        int *slots;  /** The alias data numbers plus one, or @c 0 for free slots. */
+        size_t mask; /** The number of slots minus one. */
+
+    } anchors;
+
     YamlDocument *document; /** The currently parsed document. */
+    int arena;              /** Do loaded documents allocate from an arena? */
+    int index_mappings;     /** Are the keys of loaded mappings indexed as they are closed? */
+
+    size_t max_expanded_nodes;  /** The most nodes a loaded document may expand to, or @c 0. */
+    int max_alias_depth;        /** The deepest nesting of aliases in a loaded document, or @c 0. */
+    size_t max_document_length; /** The most characters a loaded document may span, or @c 0. */
+
+#if defined(MYYAML_ENABLE_PROFILING) && MYYAML_ENABLE_PROFILING
+    /** The profile (see yaml_parser_get_profile()). */
+    struct {
+        YamlParserProfile counters; /** The counters since the last reset. */
+        size_t offset;              /** The input offset at the last reset. */
+        uint64_t start;             /** The ticks when the running stage was last entered or resumed. */
+        int depth;                  /** The number of stages running. */
+        YamlParserStage stages[8];  /** The stages running, innermost last. */
+        YamlParserProfile *outer;   /** The profile current on the thread before the outermost stage. */
+
+    } profile;
+#endif
 
     /**
      * @}
@@ -1469,6 +1798,8 @@ typedef struct YamlEmitter {
      * @}
      */
 
+    const YamlAllocator *allocator; /** The allocator, or @c NULL. */
+
     /**
      * @name Writer stuff
      * @{
@@ -1537,10 +1868,10 @@ typedef struct YamlEmitter {
 
     /** The event queue. */
     struct {
-        YamlEvent *start; /** The beginning of the event queue. */
-        YamlEvent *head;  /** The head of the event queue. */
-        YamlEvent *tail;  /** The tail of the event queue. */
-        YamlEvent *end;   /** The end of the event queue. */
+        YamlEvent *start; /** The beginning of the event ring. */
+        YamlEvent *end;   /** The end of the event ring. */
+        size_t head;      /** The head position, masked into the ring. */
+        size_t tail;      /** The tail position, masked into the ring. */
 
     } events;
 
@@ -1619,6 +1950,8 @@ typedef struct YamlEmitter {
     YamlDocument *document; /** The currently emitted document. */
     YamlAnchors *anchors;   /** The information associated with the document nodes. */
 
+    YamlChar_t *anchor_names; /** The generated anchors, by anchor id. */
+
     int last_anchor_id; /** The last assigned anchor id. */
     int opened;         /** If the stream was already opened? */
     int closed;         /** If the stream was already closed? */
@@ -1655,6 +1988,18 @@ extern "C" {
  */
 MYYAML_API void yaml_set_max_nest_level(int max);
 
+/**
+ * Enable or disable the vectorized reader and emitter kernels.
+ *
+ * Default: enabled
+ *
+ * When enabled, the widest kernels the running CPU supports (AVX2 or SSE2)
+ * are used; otherwise the scalar loops are.  This does not change results.
+ *
+ * @param[in]       enabled     @c 0 to force the scalar loops.
+ */
+MYYAML_API void yaml_set_simd(int enabled);
+
 /**
  * Free any memory allocated for a token object.
  *
@@ -1885,6 +2230,20 @@ MYYAML_API void yaml_event_delete(YamlEvent *event);
 MYYAML_API int yaml_document_initialize(YamlDocument *document, YamlVersionDirective *version_directive, YamlTagDirective *tag_directives_start,
                                         YamlTagDirective *tag_directives_end, int start_implicit, int end_implicit);
 
+/**
+ * Set the allocator of a document.
+ *
+ * The document must not have any nodes yet; its directives are moved to the
+ * allocator.  Documents produced by yaml_parser_load() use the allocator of
+ * the parser.
+ *
+ * @param[in,out]   document    An empty document object.
+ * @param[in]       allocator   An allocator, or @c NULL for the C library.
+ *
+ * @returns @c 1 if the function succeeded, @c 0 on error.
+ */
+MYYAML_API int yaml_document_set_allocator(YamlDocument *document, const YamlAllocator *allocator);
+
 /**
  * Delete a YAML document and all its nodes.
  *
@@ -1892,6 +2251,14 @@ MYYAML_API int yaml_document_initialize(YamlDocument *document, YamlVersionDirec
  */
 MYYAML_API void yaml_document_delete(YamlDocument *document);
 
+/**
+ * Delete the documents produced by yaml_parser_load_all().
+ *
+ * @param[in,out]   documents       The documents, or @c NULL.
+ * @param[in]       count           The number of documents.
+ */
+MYYAML_API void yaml_documents_delete(YamlDocument *documents, size_t count);
+
 /**
  * Get the root of a YAML document node.
  *
@@ -2008,7 +2375,14 @@ MYYAML_API int yaml_document_sequence_get_item(YamlDocument *document, int seque
  * Convenience: find a mapping value node id by scalar key string.
  * The key is matched by exact byte equality. If key_length < 0 the key is
  * treated as a NUL-terminated string and its length is computed with strlen.
+ * If several keys match, the value of the first one is returned.
  * Returns the value node id on success or 0 if not found or on error.
+ *
+ * The first lookup in a mapping of at least MYYAML_MAPPING_INDEX_THRESHOLD
+ * pairs builds a hash index of its scalar keys, which later lookups and
+ * yaml_document_append_mapping_pair() keep using.  Lookups may therefore
+ * write to the document; index the mappings at load time with
+ * yaml_parser_set_index_mappings() to look up from several threads at once.
  */
 MYYAML_API int yaml_document_mapping_get_value(YamlDocument *document, int mapping_node_id, const YamlChar_t *key, int key_length);
 
@@ -2034,6 +2408,156 @@ MYYAML_API const YamlChar_t *yaml_document_get_value_by_path(YamlDocument *docum
  */
 MYYAML_API int yaml_document_get_value_length_by_path(YamlDocument *document, const YamlChar_t **keys, int key_count);
 
+/**
+ * Compile a path expression for yaml_path_eval().
+ *
+ * The expression is a list of segments: keys separated by dots, like
+ * @c a.b.c, and bracketed decimal indices, like @c a[3].  A key that holds
+ * dots or brackets may be quoted inside brackets, as in @c a["b.c"] or
+ * @c a['b.c'], with a backslash escaping the next character.  Keys are
+ * matched against the scalar keys of mappings, and decimal segments of
+ * either form also select the items of sequences.  An empty expression
+ * selects the starting node.
+ *
+ * The keys are hashed and the indices parsed once, here, so a path compiled
+ * at startup may be evaluated any number of times, from several threads.
+ *
+ * @param[in]       expression  The path expression.
+ *
+ * @returns a path object, or @c NULL if the expression is malformed or
+ * there is not enough memory.  Free it with yaml_path_delete().
+ */
+MYYAML_API YamlPath *yaml_path_compile(const char *expression);
+
+/**
+ * Compile a path expression with the given allocator (see
+ * yaml_path_compile()).
+ *
+ * @param[in]       expression  The path expression.
+ * @param[in]       allocator   The allocator of the path, or @c NULL.
+ *
+ * @returns a path object, or @c NULL on error.
+ */
+MYYAML_API YamlPath *yaml_path_compile_allocator(const char *expression, const YamlAllocator *allocator);
+
+/**
+ * Destroy a compiled path.
+ *
+ * @param[in,out]   path    A path object, or @c NULL.
+ */
+MYYAML_API void yaml_path_delete(YamlPath *path);
+
+/**
+ * Find the node a compiled path leads to from the root of a document.
+ *
+ * This neither allocates nor writes to the document: the key indexes the
+ * mappings already have are used (see yaml_parser_set_index_mappings()),
+ * and the other mappings are searched linearly.
+ *
+ * @param[in]       document    A document object.
+ * @param[in]       path        A compiled path.
+ *
+ * @returns the node id, or @c 0 if there is no such node.
+ */
+MYYAML_API int yaml_path_eval(YamlDocument *document, const YamlPath *path);
+
+/**
+ * Find the node a compiled path leads to from a given node (see
+ * yaml_path_eval()).
+ *
+ * @param[in]       document    A document object.
+ * @param[in]       node_id     The id of the starting node.
+ * @param[in]       path        A compiled path.
+ *
+ * @returns the node id, or @c 0 if there is no such node.
+ */
+MYYAML_API int yaml_path_eval_from(YamlDocument *document, int node_id, const YamlPath *path);
+
+/**
+ * Delete a tape produced by yaml_parser_load_tape().
+ *
+ * @param[in,out]   tape        A tape object.
+ */
+MYYAML_API void yaml_tape_delete(YamlTape *tape);
+
+/**
+ * Get an entry of a tape.
+ *
+ * The root of a non-empty tape is the entry @c 1.  The children of a
+ * collection are the entries from its id plus one up to, but excluding,
+ * its @c data, stepping from one child to the next with yaml_tape_next().
+ *
+ * @param[in]       tape        A tape object.
+ * @param[in]       id          The entry id.
+ *
+ * @returns the entry or @c NULL if @c id is out of range.
+ */
+MYYAML_API YamlTapeEntry *yaml_tape_get_entry(YamlTape *tape, int id);
+
+/**
+ * Skip an entry and its descendants.
+ *
+ * @param[in]       tape        A tape object.
+ * @param[in]       id          The entry id.
+ *
+ * @returns the id of the entry after the node, or @c 0 if @c id is out of
+ * range.
+ */
+MYYAML_API int yaml_tape_next(YamlTape *tape, int id);
+
+/**
+ * Get the tag of a tape entry, with the default tags of the node types
+ * filled in.
+ *
+ * @param[in]       tape        A tape object.
+ * @param[in]       id          The entry id.
+ *
+ * @returns the tag or @c NULL if @c id is out of range.
+ */
+MYYAML_API const YamlChar_t *yaml_tape_get_tag(YamlTape *tape, int id);
+
+/**
+ * Get the value of a scalar entry, or of the scalar an alias refers to.
+ *
+ * @param[in]       tape        A tape object.
+ * @param[in]       id          The entry id.
+ * @param[out]      length      The length of the value, or @c NULL.
+ *
+ * @returns the NUL-terminated value or @c NULL if the entry is not a
+ * scalar or @c id is out of range.
+ */
+MYYAML_API const YamlChar_t *yaml_tape_get_scalar_value(YamlTape *tape, int id, size_t *length);
+
+/**
+ * Get an item of a sequence entry by zero-based index.
+ *
+ * Aliases are followed, both to the sequence and to the item.
+ *
+ * @param[in]       tape        A tape object.
+ * @param[in]       id          The sequence entry id.
+ * @param[in]       index       The index of the item.
+ *
+ * @returns the item id or @c 0 if there is no such item.
+ */
+MYYAML_API int yaml_tape_sequence_get_item(YamlTape *tape, int id, int index);
+
+/**
+ * Find the value of a mapping entry by scalar key (see
+ * yaml_document_mapping_get_value()).
+ *
+ * The pairs are searched linearly.  Aliases are followed, to the mapping,
+ * to the keys and to the value.
+ *
+ * @param[in]       tape        A tape object.
+ * @param[in]       id          The mapping entry id.
+ * @param[in]       key         The key.
+ * @param[in]       key_length  The length of the key, or @c -1 if it is
+ *                              NUL-terminated.
+ *
+ * @returns the value id or @c 0 if there is no such key.
+ */
+MYYAML_API int yaml_tape_mapping_get_value(YamlTape *tape, int id, const YamlChar_t *key, int key_length);
+
 #pragma endregion  // Document
 
 #if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
@@ -2067,10 +2591,16 @@ MYYAML_API int yaml_parser_initialize(YamlParser *parser);
  * calls of yaml_parser_scan() or yaml_parser_load(). Doing this will break the
  * parser.
  *
+ * With fed input (see yaml_parser_feed()), the function returns
+ * @c YAML_NEED_MORE_INPUT and leaves @a event empty when the next event
+ * cannot be produced from the input fed so far.  Feed more input and call the
+ * function again.
+ *
  * @param[in,out]   parser      A parser object.
  * @param[out]      event       An empty event object.
  *
- * @returns @c 1 if the function succeeded, @c 0 on error.
+ * @returns @c 1 if the function succeeded, @c YAML_NEED_MORE_INPUT if more
+ * input must be fed, @c 0 on error.
  */
 MYYAML_API int yaml_parser_parse(YamlParser *parser, YamlEvent *event);
 
@@ -2090,6 +2620,9 @@ MYYAML_API int yaml_parser_parse(YamlParser *parser, YamlEvent *event);
  * calls of yaml_parser_scan() or yaml_parser_parse(). Doing this will break
  * the parser.
  *
+ * With fed input, the whole stream must be fed (the last chunk included)
+ * before the function is called.
+ *
  * @param[in,out]   parser      A parser object.
  * @param[out]      document    An empty document object.
  *
@@ -2097,6 +2630,135 @@ MYYAML_API int yaml_parser_parse(YamlParser *parser, YamlEvent *event);
  */
 MYYAML_API int yaml_parser_load(YamlParser *parser, YamlDocument *document);
 
+/**
+ * Parse the input stream and produce the next YAML document, composing only
+ * the nodes that compiled paths lead to.
+ *
+ * This is yaml_parser_load() for reading a few parts of a large document:
+ * the nodes the paths end at are composed whole, the collections on the way
+ * to them get only the pairs and items the paths go through, and the rest
+ * of the document is skipped at the event level, its scalar values going
+ * through a block of the parser as with yaml_parser_skip_node().  The root
+ * node is always composed.
+ *
+ * The paths evaluate to the same nodes in the produced document as in a
+ * fully loaded one (see yaml_path_eval()).  To that end the skipped items
+ * of a sequence before the last one a path selects are replaced by a shared
+ * empty scalar node tagged @c !!null, so that the selected items keep their
+ * numbers.  Mapping pairs are only selected by their scalar keys.
+ *
+ * The anchored nodes of the skipped parts are composed all the same, so
+ * that the aliases in the selected nodes can refer to them, but are not
+ * linked into the tree.
+ *
+ * @param[in,out]   parser      A parser object.
+ * @param[out]      document    An empty document object.
+ * @param[in]       paths       The compiled paths (see yaml_path_compile()).
+ * @param[in]       count       The number of paths.
+ *
+ * @returns @c 1 if the function succeeded, @c 0 on error.
+ */
+MYYAML_API int yaml_parser_load_paths(YamlParser *parser, YamlDocument *document, const YamlPath *const *paths, size_t count);
+
+/**
+ * Parse the rest of the input stream and produce all its documents, loading
+ * several of them at a time on worker threads.
+ *
+ * The input of a parser that has produced nothing yet, set with
+ * yaml_parser_set_input_string() or yaml_parser_set_input_mmap(), is first
+ * split at the document start markers (@c ---) at the beginning of a line
+ * into runs of whole documents, and each run is loaded by its own parser
+ * with the settings of this one.  Any other input is loaded document by
+ * document in the calling thread, as with yaml_parser_load().
+ *
+ * The documents come in stream order, with their marks in the stream.  On
+ * error, the parser reports the first error of the stream and no documents
+ * are produced.  The allocator of the parser, if any, must be safe to call
+ * from several threads.
+ *
+ * An application is responsible for freeing the documents using the
+ * yaml_documents_delete() function.
+ *
+ * @param[in,out]   parser      A parser object.
+ * @param[in]       threads     The most threads to use, or @c 0 for one per
+ *                              processor.
+ * @param[out]      documents   The documents, or @c NULL if there are none.
+ * @param[out]      count       The number of documents.
+ *
+ * @returns @c 1 if the function succeeded, @c 0 on error.
+ */
+MYYAML_API int yaml_parser_load_all(YamlParser *parser, int threads, YamlDocument **documents, size_t *count);
+
+/**
+ * Parse the input stream and produce the next document as a tape.
+ *
+ * A tape holds the nodes of a document in a single array of 16-octet
+ * entries, in document order, with all the tags and scalar values in a
+ * single pool of strings.  It takes a fraction of the memory of a
+ * YamlDocument, with one allocation for the nodes and one for the strings,
+ * and a full traversal reads both in order.  A tape leaves out the marks of
+ * the nodes and the directives of the document.
+ *
+ * Anchors, aliases and the limits of the parser are handled as with
+ * yaml_parser_load().  If the produced tape has no entries, the end of the
+ * stream has been reached.
+ *
+ * An application is responsible for freeing the tape using the
+ * yaml_tape_delete() function.  An application must not alternate the
+ * calls of yaml_parser_load_tape() with the calls of yaml_parser_scan() or
+ * yaml_parser_parse().
+ *
+ * @param[in,out]   parser      A parser object.
+ * @param[out]      tape        An empty tape object.
+ *
+ * @returns @c 1 if the function succeeded, @c 0 on error.
+ */
+MYYAML_API int yaml_parser_load_tape(YamlParser *parser, YamlTape *tape);
+
+/**
+ * Parse the input stream and pass its events to handlers.
+ *
+ * This is yaml_parser_parse() without the event objects: the strings of an
+ * event are handed to its handler as borrowed views, and the scalar values
+ * are carved out of a block of the parser that is used over again once the
+ * values in it have been passed on, so that parsing a stream allocates
+ * little beyond the tags and anchors.
+ *
+ * Parsing goes on until the end of the stream, a handler returns @c 0, or
+ * an error.  A parser stopped by a handler may be passed to this function
+ * or to yaml_parser_parse() again to go on.
+ *
+ * @param[in,out]   parser      A parser object.
+ * @param[in]       callbacks   The handlers.
+ *
+ * @returns @c 1 if the function succeeded, @c 0 on error, or
+ * #YAML_NEED_MORE_INPUT if the fed input runs out.
+ */
+MYYAML_API int yaml_parser_parse_callbacks(YamlParser *parser, const YamlParserCallbacks *callbacks);
+
+/**
+ * Skip the rest of a collection.
+ *
+ * Called after yaml_parser_parse() has produced a SEQUENCE-START or
+ * MAPPING-START event, the function goes through the events of the
+ * collection up to and including its SEQUENCE-END or MAPPING-END event, so
+ * that the next call of yaml_parser_parse() produces the event after it.
+ * Called later, it skips what is left of the innermost open collection;
+ * outside of any collection, it does nothing.
+ *
+ * The skipped events are never handed out, and their scalar values are not
+ * allocated but scanned into a block of the parser that is used over again.
+ *
+ * With fed input, the function may return #YAML_NEED_MORE_INPUT halfway;
+ * call it again after feeding more input to finish the skip.
+ *
+ * @param[in,out]   parser  A parser object.
+ *
+ * @returns @c 1 if the function succeeded, @c 0 on error, or
+ * #YAML_NEED_MORE_INPUT if the fed input runs out.
+ */
+MYYAML_API int yaml_parser_skip_node(YamlParser *parser);
+
 /**
  * Scan the input stream and produce the next token.
  *
@@ -2112,10 +2774,14 @@ MYYAML_API int yaml_parser_load(YamlParser *parser, YamlDocument *document);
  * calls of yaml_parser_parse() or yaml_parser_load(). Doing this will break
  * the parser.
  *
+ * With fed input, the function returns @c YAML_NEED_MORE_INPUT and leaves
+ * @a token empty when the next token is not complete yet.
+ *
  * @param[in,out]   parser      A parser object.
  * @param[out]      token       An empty token object.
  *
- * @returns @c 1 if the function succeeded, @c 0 on error.
+ * @returns @c 1 if the function succeeded, @c YAML_NEED_MORE_INPUT if more
+ * input must be fed, @c 0 on error.
  */
 MYYAML_API int yaml_parser_scan(YamlParser *parser, YamlToken *token);
 
@@ -2126,6 +2792,21 @@ MYYAML_API int yaml_parser_scan(YamlParser *parser, YamlToken *token);
  */
 MYYAML_API void yaml_parser_delete(YamlParser *parser);
 
+/**
+ * Reset a parser to the state yaml_parser_initialize() leaves it in, keeping
+ * its buffers, token queue and stacks at the capacity they have grown to.
+ *
+ * The input and its encoding, the error and any pending tokens are
+ * dropped; the allocator and the other settings made with the
+ * @c yaml_parser_set_ functions are kept.  Set the input again before using
+ * the parser.  This makes a parser cheap to reuse for many small streams.
+ *
+ * @param[in,out]   parser  A parser object.
+ *
+ * @returns @c 1 if the function succeeded, @c 0 on error.
+ */
+MYYAML_API int yaml_parser_reset(YamlParser *parser);
+
 MYYAML_API int yaml_parser_update_buffer(YamlParser *parser, size_t length);
 
 /**
@@ -2152,6 +2833,34 @@ MYYAML_API void yaml_parser_set_input_string(YamlParser *parser, const unsigned
  */
 MYYAML_API void yaml_parser_set_input_file(YamlParser *parser, FILE *file);
 
+/**
+ * Set a memory-mapped file input.
+ *
+ * The file at @a path is mapped once for the lifetime of the @a parser.  A
+ * UTF-8 input is validated on the first read and then scanned directly from
+ * the mapping, so yaml_parser_update_buffer() never copies it.  UTF-16 input
+ * is decoded from the mapping like a string input.
+ *
+ * @param[in,out]   parser  A parser object.
+ * @param[in]       path    The path of a regular file.
+ *
+ * @returns @c 1 if the function succeeded, @c 0 on error.
+ */
+MYYAML_API int yaml_parser_set_input_mmap(YamlParser *parser, const char *path);
+
+/**
+ * Set a memory-mapped file input from an open file descriptor.
+ *
+ * Same as yaml_parser_set_input_mmap().  The mapping does not keep @a fd
+ * alive; the application may close it as soon as the function returns.
+ *
+ * @param[in,out]   parser  A parser object.
+ * @param[in]       fd      A file descriptor open for reading.
+ *
+ * @returns @c 1 if the function succeeded, @c 0 on error.
+ */
+MYYAML_API int yaml_parser_set_input_mmap_fd(YamlParser *parser, int fd);
+
 /**
  * Set a generic input handler.
  *
@@ -2162,6 +2871,31 @@ MYYAML_API void yaml_parser_set_input_file(YamlParser *parser, FILE *file);
  */
 MYYAML_API void yaml_parser_set_input(YamlParser *parser, YamlReadHandler *handler, void *data);
 
+/**
+ * Feed a chunk of input to the parser.
+ *
+ * Instead of pulling the input through a read handler, the application pushes
+ * it as it arrives, e.g. from a non-blocking socket.  The chunk is copied, so
+ * @a data may be reused as soon as the function returns.  Chunks may split a
+ * token or a character anywhere.
+ *
+ * Whenever yaml_parser_parse() or yaml_parser_scan() runs out of fed input,
+ * it returns @c YAML_NEED_MORE_INPUT without changing the parser state, and
+ * the call can be repeated after the next chunk is fed.  Set @a is_last with
+ * the final chunk (which may be empty) so that the end of the stream is
+ * recognized; no input may be fed after it.
+ *
+ * Fed input cannot be combined with any other input source.
+ *
+ * @param[in,out]   parser  A parser object.
+ * @param[in]       data    The chunk data.
+ * @param[in]       size    The length of the chunk in bytes.
+ * @param[in]       is_last Is it the last chunk of the stream?
+ *
+ * @returns @c 1 if the function succeeded, @c 0 on error.
+ */
+MYYAML_API int yaml_parser_feed(YamlParser *parser, const unsigned char *data, size_t size, int is_last);
+
 /**
  * Set the source encoding.
  *
@@ -2170,6 +2904,128 @@ MYYAML_API void yaml_parser_set_input(YamlParser *parser, YamlReadHandler *handl
  */
 MYYAML_API void yaml_parser_set_encoding(YamlParser *parser, YamlEncoding encoding);
 
+/**
+ * Let scalar values borrow from the input instead of being copied.
+ *
+ * Only a memory-mapped UTF-8 input (see yaml_parser_set_input_mmap()) stays
+ * in place for the lifetime of the parser, so only such an input is
+ * borrowed from.  A plain scalar that is a single slice of the input (no
+ * folded line breaks) then gets a value pointing into the mapping, and the
+ * @c borrowed member of the token or event is set.
+ *
+ * A borrowed value is not NUL-terminated, must not be modified, and is valid
+ * until the parser is destroyed.  yaml_token_delete() and yaml_event_delete()
+ * leave it alone; yaml_parser_load() copies it into the document.
+ *
+ * @param[in,out]   parser  A parser object.
+ * @param[in]       enabled Borrow values if non-zero.
+ */
+MYYAML_API void yaml_parser_set_zero_copy(YamlParser *parser, int enabled);
+
+/**
+ * Allocate the documents produced by yaml_parser_load() from an arena.
+ *
+ * The node tags, scalar values and the item and pair stacks of a document
+ * are then carved out of a few large blocks owned by the document instead of
+ * being allocated one by one, and yaml_document_delete() releases them a
+ * block at a time.  The nodes behave the same otherwise: they may still be
+ * added and appended to with the yaml_document_*() functions, and the
+ * document may be passed to yaml_emitter_dump().
+ *
+ * The pointers in such a document must not be freed or reallocated
+ * individually.
+ *
+ * @param[in,out]   parser  A parser object.
+ * @param[in]       enabled Use an arena if non-zero.
+ */
+MYYAML_API void yaml_parser_set_arena(YamlParser *parser, int enabled);
+
+/**
+ * Index the scalar keys of the mappings produced by yaml_parser_load().
+ *
+ * The mappings with at least MYYAML_MAPPING_INDEX_THRESHOLD pairs get the
+ * hash index yaml_document_mapping_get_value() would otherwise build on the
+ * first lookup, so the lookups in a loaded document do not write to it.
+ *
+ * @param[in,out]   parser  A parser object.
+ * @param[in]       enabled Index the mappings if non-zero.
+ */
+MYYAML_API void yaml_parser_set_index_mappings(YamlParser *parser, int enabled);
+
+/**
+ * Limit the number of nodes the documents produced by yaml_parser_load()
+ * may expand to.
+ *
+ * The loader shares the node an alias refers to, but a consumer walking
+ * the document sees it once per alias, so a small document with nested
+ * aliases may expand exponentially.  With a limit, the loader weighs every
+ * node with its aliases expanded as it composes it, in time linear in the
+ * number of nodes, and fails with a composer error as soon as the weight
+ * of a collection or the number of nodes goes over the limit.  Aliases to
+ * an enclosing collection, which expand forever, are then errors too.
+ *
+ * @param[in,out]   parser  A parser object.
+ * @param[in]       limit   The largest number of nodes, or @c 0 for none.
+ */
+MYYAML_API void yaml_parser_set_max_expanded_nodes(YamlParser *parser, size_t limit);
+
+/**
+ * Limit the nesting of aliases in the documents produced by
+ * yaml_parser_load(): an alias to a node holding aliases nests one level
+ * deeper than they do.  Aliases to an enclosing collection are errors with
+ * a limit (see yaml_parser_set_max_expanded_nodes()).
+ *
+ * @param[in,out]   parser  A parser object.
+ * @param[in]       limit   The deepest nesting, or @c 0 for none.
+ */
+MYYAML_API void yaml_parser_set_max_alias_depth(YamlParser *parser, int limit);
+
+/**
+ * Limit the length of the documents yaml_parser_load() composes, counted in
+ * characters of input from the start of the document.  The loader fails
+ * with a composer error as soon as an event ends past the limit.
+ *
+ * @param[in,out]   parser  A parser object.
+ * @param[in]       limit   The largest length, or @c 0 for none.
+ */
+MYYAML_API void yaml_parser_set_max_document_length(YamlParser *parser, size_t limit);
+
+/**
+ * Get the profile of a parser: what it did since it was initialized or the
+ * profile was last reset, and how long each stage took.
+ *
+ * Allocations and stack and queue growth are counted while one of the
+ * stages of the parser runs on the calling thread.
+ *
+ * @param[in]       parser  A parser object.
+ * @param[out]      profile An empty profile object.
+ *
+ * @returns @c 1 if the function succeeded, @c 0 if the library was compiled
+ * without MYYAML_ENABLE_PROFILING (the profile is then zeroed).
+ */
+MYYAML_API int yaml_parser_get_profile(const YamlParser *parser, YamlParserProfile *profile);
+
+/**
+ * Reset the profile of a parser.
+ *
+ * @param[in,out]   parser  A parser object.
+ */
+MYYAML_API void yaml_parser_reset_profile(YamlParser *parser);
+
+/**
+ * Set the allocator of a parser.
+ *
+ * This must be done right after yaml_parser_initialize(): the parser is
+ * initialized again with its buffers taken from the allocator, and so are
+ * the tokens, events and documents it produces.
+ *
+ * @param[in,out]   parser      A parser object.
+ * @param[in]       allocator   An allocator, or @c NULL for the C library.
+ *
+ * @returns @c 1 if the function succeeded, @c 0 on error.
+ */
+MYYAML_API int yaml_parser_set_allocator(YamlParser *parser, const YamlAllocator *allocator);
+
 #pragma endregion  // Reader
 
 #endif  // MYYAML_DISABLE_READER
@@ -2212,6 +3068,20 @@ MYYAML_API int yaml_emitter_emit(YamlEmitter *emitter, YamlEvent *event);
  */
 MYYAML_API void yaml_emitter_delete(YamlEmitter *emitter);
 
+/**
+ * Reset an emitter to the state yaml_emitter_initialize() leaves it in,
+ * keeping its buffers, event queue and stacks at the capacity they have
+ * grown to.
+ *
+ * The output, the error, the pending events and any unflushed output are
+ * dropped; the allocator and the settings made with the
+ * @c yaml_emitter_set_ functions, but the encoding, are kept.  Set the
+ * output again before using the emitter.
+ *
+ * @param[in,out]   emitter     An emitter object.
+ */
+MYYAML_API void yaml_emitter_reset(YamlEmitter *emitter);
+
 /**
  * Emit a YAML document.
  *
@@ -2313,6 +3183,20 @@ MYYAML_API void yaml_emitter_set_unicode(YamlEmitter *emitter, int unicode);
  */
 MYYAML_API void yaml_emitter_set_break(YamlEmitter *emitter, YamlBreakType line_break);
 
+/**
+ * Set the allocator of an emitter.
+ *
+ * This must be done right after yaml_emitter_initialize(): the emitter is
+ * initialized again with its buffers taken from the allocator.  The events
+ * given to the emitter are freed through their own allocators.
+ *
+ * @param[in,out]   emitter     An emitter object.
+ * @param[in]       allocator   An allocator, or @c NULL for the C library.
+ *
+ * @returns @c 1 if the function succeeded, @c 0 on error.
+ */
+MYYAML_API int yaml_emitter_set_allocator(YamlEmitter *emitter, const YamlAllocator *allocator);
+
 /**
  * Start a YAML stream.
  *
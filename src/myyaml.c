@@ -64,10 +64,78 @@
 // [SECTION] INCLUDES
 //-------------------------------------------------------------------------
 
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS, strdup() */
+#endif
+
 #include <stdint.h>
 
 #include "../include/myyaml/myyaml.h"
 
+#if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
+#if MYYAML_PLATFORM_IS(WINDOWS)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+#endif  // MYYAML_DISABLE_READER
+
+#if !defined(MYYAML_DISABLE_SIMD) || !MYYAML_DISABLE_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MYYAML_SIMD_SSE2 1
+#include <immintrin.h>
+#if defined(__AVX2__) || MYYAML_COMPILER_IS(MSVC)
+#define MYYAML_SIMD_AVX2 1
+#define MYYAML_TARGET_AVX2
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MYYAML_SIMD_AVX2 1
+#define MYYAML_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+#endif  // MYYAML_DISABLE_SIMD
+
+#if MYYAML_COMPILER_IS(MSVC)
+#include <intrin.h>
+#endif
+
+#if (!defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER) && defined(MYYAML_ENABLE_PROFILING) && MYYAML_ENABLE_PROFILING
+#define MYYAML_PROFILING 1
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MYYAML_PROFILE_RDTSC 1
+#include <x86intrin.h>
+#elif MYYAML_COMPILER_IS(MSVC) && (defined(_M_X64) || defined(_M_IX86))
+#define MYYAML_PROFILE_RDTSC 1
+#else
+#include <time.h>
+#endif
+#if MYYAML_COMPILER_IS(MSVC)
+#define MYYAML_THREAD_LOCAL __declspec(thread)
+#else
+#define MYYAML_THREAD_LOCAL _Thread_local
+#endif
+#endif  // MYYAML_ENABLE_PROFILING
+
+#if (!defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER) && (!defined(MYYAML_DISABLE_THREADS) || !MYYAML_DISABLE_THREADS)
+#define MYYAML_THREADS 1
+#if MYYAML_PLATFORM_IS(WINDOWS)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <process.h>
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#endif  // MYYAML_DISABLE_THREADS
+
 #pragma region Internal
 
 //-------------------------------------------------------------------------
@@ -128,6 +196,16 @@
 #define MYYAML_INPUT_BUFFER_SIZE (MYYAML_INPUT_RAW_BUFFER_SIZE * 3)
 #endif // MYYAML_INPUT_BUFFER_SIZE
 
+#ifndef MYYAML_INPUT_MAP_PADDING
+/**
+ * @def MYYAML_INPUT_MAP_PADDING
+ * @brief Zeroed bytes kept readable past the end of a mapped input.
+ * @note The scanner looks a few octets ahead of the current character.
+ * @note Default is 64.
+ */
+#define MYYAML_INPUT_MAP_PADDING 64
+#endif // MYYAML_INPUT_MAP_PADDING
+
 #ifndef MYYAML_OUTPUT_RAW_BUFFER_SIZE
 /**
  * @def MYYAML_OUTPUT_RAW_BUFFER_SIZE
@@ -169,11 +247,15 @@
 /**
  * @def MYYAML_INITIAL_QUEUE_SIZE
  * @brief Initial queue size.
- * @note Default is 16.
+ * @note Default is 16.  Must be a power of two.
  */
 #define MYYAML_INITIAL_QUEUE_SIZE 16
 #endif // MYYAML_INITIAL_QUEUE_SIZE
 
+#if (MYYAML_INITIAL_QUEUE_SIZE) < 2 || ((MYYAML_INITIAL_QUEUE_SIZE) & ((MYYAML_INITIAL_QUEUE_SIZE) - 1))
+#error MYYAML_INITIAL_QUEUE_SIZE must be a power of two
+#endif
+
 #ifndef MYYAML_INITIAL_STRING_SIZE
 /**
  * @def MYYAML_INITIAL_STRING_SIZE
@@ -183,6 +265,33 @@
 #define MYYAML_INITIAL_STRING_SIZE 16
 #endif // MYYAML_INITIAL_STRING_SIZE
 
+#ifndef MYYAML_ARENA_BLOCK_SIZE
+/**
+ * @def MYYAML_ARENA_BLOCK_SIZE
+ * @brief Size of the first block of a document arena.
+ * @note Default is 64 KiB; the next blocks double in size, up to 64 times that.
+ */
+#define MYYAML_ARENA_BLOCK_SIZE (64 * 1024)
+#endif // MYYAML_ARENA_BLOCK_SIZE
+
+#ifndef MYYAML_LOAD_BATCH_SIZE
+/**
+ * @def MYYAML_LOAD_BATCH_SIZE
+ * @brief Smallest run of documents yaml_parser_load_all() hands to a thread.
+ * @note Default is 64 KiB; larger streams are split into about four runs per thread.
+ */
+#define MYYAML_LOAD_BATCH_SIZE (64 * 1024)
+#endif // MYYAML_LOAD_BATCH_SIZE
+
+#ifndef MYYAML_MAPPING_INDEX_THRESHOLD
+/**
+ * @def MYYAML_MAPPING_INDEX_THRESHOLD
+ * @brief Number of pairs from which the keys of a mapping are hash indexed.
+ * @note Default is 8; smaller mappings are searched linearly.
+ */
+#define MYYAML_MAPPING_INDEX_THRESHOLD 8
+#endif // MYYAML_MAPPING_INDEX_THRESHOLD
+
 /*
  * String Management Macros.
  */
@@ -192,41 +301,48 @@
 	 (value).pointer = (string))
 
 #define STRING_INIT(context, string, size)          \
-	(((string).start = YAML_MALLOC(size))           \
+	(((string).start = YAML_MALLOC((context)->allocator, size))           \
 		 ? ((string).pointer = (string).start,      \
 			(string).end = (string).start + (size), \
 			memset((string).start, 0, (size)), 1)   \
 		 : ((context)->error = YAML_MEMORY_ERROR, 0))
 
-#define STRING_DEL(context, string) \
-	(_myyaml_free((string).start),  \
+#define STRING_DEL(context, string)                     \
+	(_myyaml_free((context)->allocator, (string).start), \
 	 (string).start = (string).pointer = (string).end = 0)
 
 #define STRING_EXTEND(context, string)                                          \
 	((((string).pointer + 5 < (string).end) ||                                  \
-	  _myyaml_string_extend(&(string).start, &(string).pointer, &(string).end)) \
+	  _myyaml_string_extend((context)->allocator, &(string).start, &(string).pointer, &(string).end)) \
 		 ? 1                                                                    \
 		 : ((context)->error = YAML_MEMORY_ERROR, 0))
 
+#define STRING_RESERVE(context, string, length)                                               \
+	((((string).pointer + (length) + 5 < (string).end) ||                                       \
+	  _myyaml_string_reserve((context)->allocator, &(string).start, &(string).pointer, &(string).end, (length))) \
+		 ? 1                                                                                    \
+		 : ((context)->error = YAML_MEMORY_ERROR, 0))
+
 #define CLEAR(context, string)          \
 	((string).pointer = (string).start, \
 	 memset((string).start, 0, (string).end - (string).start))
 
 #define JOIN(context, string_a, string_b)                         \
-	((_myyaml_string_join(&(string_a).start, &(string_a).pointer, \
+	((_myyaml_string_join((context)->allocator,                  \
+						  &(string_a).start, &(string_a).pointer, \
 						  &(string_a).end, &(string_b).start,     \
 						  &(string_b).pointer, &(string_b).end))  \
 		 ? ((string_b).pointer = (string_b).start, 1)             \
 		 : ((context)->error = YAML_MEMORY_ERROR, 0))
 
 #define MYYAML_STRING_INIT(context, string)  \
-	if (!_myyaml_string_initialize(string))  \
+	if (!_myyaml_string_initialize((context)->allocator, string))  \
 	{                                        \
 		(context)->error = YAML_MEMORY_ERROR \
 	}
 
 #define MYYAML_STRING_FREE(context, string) \
-	(_myyaml_string_delete(string))
+	(_myyaml_string_delete((context)->allocator, string))
 
 #define MYYAML_STRING_CLEAR(context, string) \
 	((string).pointer = (string).start,      \
@@ -239,20 +355,84 @@
  */
 
 #define MYYAML_BUFFER_INIT(context, buffer, size)                     \
-	(((buffer).start = (YamlChar_t *)_myyaml_malloc(size))     \
+	(((buffer).start = (YamlChar_t *)_myyaml_malloc((context)->allocator, size)) \
 		 ? ((buffer).last = (buffer).pointer = (buffer).start, \
 			(buffer).end = (buffer).start + (size), 1)         \
 		 : ((context)->error = YAML_MEMORY_ERROR, 0))
 
 #define MYYAML_BUFFER_FREE(context, buffer) \
-	(_myyaml_free((buffer).start),  \
+	(_myyaml_free((context)->allocator, (buffer).start),  \
 	 (buffer).start = (buffer).pointer = (buffer).end = 0)
 
 	 
 #define BUFFER_DEL(context, buffer) \
-	(_myyaml_free((buffer).start),  \
+	(_myyaml_free((context)->allocator, (buffer).start),  \
 	 (buffer).start = (buffer).pointer = (buffer).end = 0)
 
+/*
+ * Character classes.
+ *
+ * Every octet maps to a set of class flags and, in the top bits, the width
+ * of the UTF-8 character it starts (0 for continuation and invalid octets).
+ * The multi-octet line breaks NEL, LS and PS only get a flag on their lead
+ * octet; the macros below check the rest of the sequence.
+ */
+
+#define YAML_CLASS_ALPHA 0x0001      /* '0'-'9', 'A'-'Z', 'a'-'z', '_', '-' */
+#define YAML_CLASS_DIGIT 0x0002      /* '0'-'9' */
+#define YAML_CLASS_HEX 0x0004        /* '0'-'9', 'A'-'F', 'a'-'f' */
+#define YAML_CLASS_SPACE 0x0008      /* ' ' */
+#define YAML_CLASS_TAB 0x0010        /* '\t' */
+#define YAML_CLASS_BREAK 0x0020      /* '\r', '\n' */
+#define YAML_CLASS_BREAK_LEAD 0x0040 /* first octet of NEL, LS and PS */
+#define YAML_CLASS_Z 0x0080          /* '\0' */
+#define YAML_CLASS_INDICATOR 0x0100  /* characters a plain scalar may not start with */
+#define YAML_CLASS_FLOW 0x0200       /* ',', '[', ']', '{', '}' */
+#define YAML_CLASS_URI 0x0400        /* characters allowed in a tag URI */
+#define YAML_CLASS_WIDTH_SHIFT 12
+
+static const unsigned short yaml_char_classes[256] = {
+	/* 0x00 */ 0x1080, 0x1000, 0x1000, 0x1000, 0x1000, 0x1000, 0x1000, 0x1000,
+	/* 0x08 */ 0x1000, 0x1010, 0x1020, 0x1000, 0x1000, 0x1020, 0x1000, 0x1000,
+	/* 0x10 */ 0x1000, 0x1000, 0x1000, 0x1000, 0x1000, 0x1000, 0x1000, 0x1000,
+	/* 0x18 */ 0x1000, 0x1000, 0x1000, 0x1000, 0x1000, 0x1000, 0x1000, 0x1000,
+	/* 0x20 */ 0x1008, 0x1500, 0x1100, 0x1100, 0x1400, 0x1500, 0x1500, 0x1500,
+	/* 0x28 */ 0x1400, 0x1400, 0x1500, 0x1400, 0x1300, 0x1501, 0x1400, 0x1400,
+	/* 0x30 */ 0x1407, 0x1407, 0x1407, 0x1407, 0x1407, 0x1407, 0x1407, 0x1407,
+	/* 0x38 */ 0x1407, 0x1407, 0x1500, 0x1400, 0x1000, 0x1400, 0x1100, 0x1500,
+	/* 0x40 */ 0x1500, 0x1405, 0x1405, 0x1405, 0x1405, 0x1405, 0x1405, 0x1401,
+	/* 0x48 */ 0x1401, 0x1401, 0x1401, 0x1401, 0x1401, 0x1401, 0x1401, 0x1401,
+	/* 0x50 */ 0x1401, 0x1401, 0x1401, 0x1401, 0x1401, 0x1401, 0x1401, 0x1401,
+	/* 0x58 */ 0x1401, 0x1401, 0x1401, 0x1300, 0x1000, 0x1300, 0x1000, 0x1401,
+	/* 0x60 */ 0x1100, 0x1405, 0x1405, 0x1405, 0x1405, 0x1405, 0x1405, 0x1401,
+	/* 0x68 */ 0x1401, 0x1401, 0x1401, 0x1401, 0x1401, 0x1401, 0x1401, 0x1401,
+	/* 0x70 */ 0x1401, 0x1401, 0x1401, 0x1401, 0x1401, 0x1401, 0x1401, 0x1401,
+	/* 0x78 */ 0x1401, 0x1401, 0x1401, 0x1300, 0x1100, 0x1300, 0x1400, 0x1000,
+	/* 0x80 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	/* 0x88 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	/* 0x90 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	/* 0x98 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	/* 0xA0 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	/* 0xA8 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	/* 0xB0 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	/* 0xB8 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	/* 0xC0 */ 0x2000, 0x2000, 0x2040, 0x2000, 0x2000, 0x2000, 0x2000, 0x2000,
+	/* 0xC8 */ 0x2000, 0x2000, 0x2000, 0x2000, 0x2000, 0x2000, 0x2000, 0x2000,
+	/* 0xD0 */ 0x2000, 0x2000, 0x2000, 0x2000, 0x2000, 0x2000, 0x2000, 0x2000,
+	/* 0xD8 */ 0x2000, 0x2000, 0x2000, 0x2000, 0x2000, 0x2000, 0x2000, 0x2000,
+	/* 0xE0 */ 0x3000, 0x3000, 0x3040, 0x3000, 0x3000, 0x3000, 0x3000, 0x3000,
+	/* 0xE8 */ 0x3000, 0x3000, 0x3000, 0x3000, 0x3000, 0x3000, 0x3000, 0x3000,
+	/* 0xF0 */ 0x4000, 0x4000, 0x4000, 0x4000, 0x4000, 0x4000, 0x4000, 0x4000,
+	/* 0xF8 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+};
+
+/*
+ * Get the classes of the octet at the specified position.
+ */
+#define CLASS_AT(string, offset) (yaml_char_classes[(string).pointer[offset]])
+
+#define CLASS(string) CLASS_AT((string), 0)
+
 /*
  * String check operations.
  */
@@ -272,23 +452,14 @@
  * Check if the character at the specified position is an alphabetical
  * character, a digit, '_', or '-'.
  */
-#define IS_ALPHA_AT(string, offset)                   \
-	(((string).pointer[offset] >= (YamlChar_t)'0' &&  \
-	  (string).pointer[offset] <= (YamlChar_t)'9') || \
-	 ((string).pointer[offset] >= (YamlChar_t)'A' &&  \
-	  (string).pointer[offset] <= (YamlChar_t)'Z') || \
-	 ((string).pointer[offset] >= (YamlChar_t)'a' &&  \
-	  (string).pointer[offset] <= (YamlChar_t)'z') || \
-	 (string).pointer[offset] == '_' || (string).pointer[offset] == '-')
+#define IS_ALPHA_AT(string, offset) (CLASS_AT((string), (offset)) & YAML_CLASS_ALPHA)
 
 #define IS_ALPHA(string) IS_ALPHA_AT((string), 0)
 
 /*
  * Check if the character at the specified position is a digit.
  */
-#define IS_DIGIT_AT(string, offset)                  \
-	(((string).pointer[offset] >= (YamlChar_t)'0' && \
-	  (string).pointer[offset] <= (YamlChar_t)'9'))
+#define IS_DIGIT_AT(string, offset) (CLASS_AT((string), (offset)) & YAML_CLASS_DIGIT)
 
 #define IS_DIGIT(string) IS_DIGIT_AT((string), 0)
 
@@ -302,13 +473,7 @@
 /*
  * Check if the character at the specified position is a hex-digit.
  */ 
-#define IS_HEX_AT(string, offset)                     \
-	(((string).pointer[offset] >= (YamlChar_t)'0' &&  \
-	  (string).pointer[offset] <= (YamlChar_t)'9') || \
-	 ((string).pointer[offset] >= (YamlChar_t)'A' &&  \
-	  (string).pointer[offset] <= (YamlChar_t)'F') || \
-	 ((string).pointer[offset] >= (YamlChar_t)'a' &&  \
-	  (string).pointer[offset] <= (YamlChar_t)'f'))
+#define IS_HEX_AT(string, offset) (CLASS_AT((string), (offset)) & YAML_CLASS_HEX)
 
 #define IS_HEX(string) IS_HEX_AT((string), 0)
 
@@ -391,24 +556,27 @@
  * Check if the character at the specified position is blank (space or tab).
  */
 #define IS_BLANK_AT(string, offset) \
-	(IS_SPACE_AT((string), (offset)) || IS_TAB_AT((string), (offset)))
+	(CLASS_AT((string), (offset)) & (YAML_CLASS_SPACE | YAML_CLASS_TAB))
 
 #define IS_BLANK(string) IS_BLANK_AT((string), 0)
 
 /*
  * Check if the character at the specified position is a line break.
  */
-#define IS_BREAK_AT(string, offset)                                  \
-	(CHECK_AT((string), '\r', (offset))	   /* CR (#xD)*/             \
-	 || CHECK_AT((string), '\n', (offset)) /* LF (#xA) */            \
-	 || (CHECK_AT((string), '\xC2', (offset)) &&                     \
-		 CHECK_AT((string), '\x85', (offset) + 1)) /* NEL (#x85) */  \
-	 || (CHECK_AT((string), '\xE2', (offset)) &&                     \
-		 CHECK_AT((string), '\x80', (offset) + 1) &&                 \
-		 CHECK_AT((string), '\xA8', (offset) + 2)) /* LS (#x2028) */ \
-	 || (CHECK_AT((string), '\xE2', (offset)) &&                     \
-		 CHECK_AT((string), '\x80', (offset) + 1) &&                 \
-		 CHECK_AT((string), '\xA9', (offset) + 2))) /* PS (#x2029) */
+#define IS_BREAK_AT(string, offset)                        \
+	((CLASS_AT((string), (offset)) & YAML_CLASS_BREAK) /* CR, LF */ \
+	 || IS_UNICODE_BREAK_AT((string), (offset)))
+
+/*
+ * Check if the character at the specified position is NEL, LS or PS.
+ */
+#define IS_UNICODE_BREAK_AT(string, offset)                              \
+	((CLASS_AT((string), (offset)) & YAML_CLASS_BREAK_LEAD) &&          \
+	 (CHECK_AT((string), '\xC2', (offset))                              \
+		  ? CHECK_AT((string), '\x85', (offset) + 1) /* NEL (#x85) */    \
+		  : (CHECK_AT((string), '\x80', (offset) + 1) &&                 \
+			 (CHECK_AT((string), '\xA8', (offset) + 2) /* LS (#x2028) */ \
+			  || CHECK_AT((string), '\xA9', (offset) + 2))))) /* PS (#x2029) */
 
 #define IS_BREAK(string) IS_BREAK_AT((string), 0)
 
@@ -420,36 +588,59 @@
 /*
  * Check if the character is a line break or NUL.
  */
-#define IS_BREAKZ_AT(string, offset) \
-	(IS_BREAK_AT((string), (offset)) || IS_Z_AT((string), (offset)))
+#define IS_BREAKZ_AT(string, offset)                                        \
+	((CLASS_AT((string), (offset)) & (YAML_CLASS_BREAK | YAML_CLASS_Z)) || \
+	 IS_UNICODE_BREAK_AT((string), (offset)))
 
 #define IS_BREAKZ(string) IS_BREAKZ_AT((string), 0)
 
 /*
  * Check if the character is a line break, space, or NUL.
  */
-#define IS_SPACEZ_AT(string, offset) \
-	(IS_SPACE_AT((string), (offset)) || IS_BREAKZ_AT((string), (offset)))
+#define IS_SPACEZ_AT(string, offset)                                                           \
+	((CLASS_AT((string), (offset)) & (YAML_CLASS_SPACE | YAML_CLASS_BREAK | YAML_CLASS_Z)) || \
+	 IS_UNICODE_BREAK_AT((string), (offset)))
 
 #define IS_SPACEZ(string) IS_SPACEZ_AT((string), 0)
 
 /*
  * Check if the character is a line break, space, tab, or NUL.
  */
-#define IS_BLANKZ_AT(string, offset) \
-	(IS_BLANK_AT((string), (offset)) || IS_BREAKZ_AT((string), (offset)))
+#define IS_BLANKZ_AT(string, offset)                                                                              \
+	((CLASS_AT((string), (offset)) & (YAML_CLASS_SPACE | YAML_CLASS_TAB | YAML_CLASS_BREAK | YAML_CLASS_Z)) || \
+	 IS_UNICODE_BREAK_AT((string), (offset)))
 
 #define IS_BLANKZ(string) IS_BLANKZ_AT((string), 0)
 
+/*
+ * Check if the character is an indicator a plain scalar may not start with:
+ * '-', '?', ':', ',', '[', ']', '{', '}', '#', '&', '*', '!', '|', '>',
+ * '\'', '"', '%', '@', '`'.
+ */
+#define IS_INDICATOR_AT(string, offset) (CLASS_AT((string), (offset)) & YAML_CLASS_INDICATOR)
+
+#define IS_INDICATOR(string) IS_INDICATOR_AT((string), 0)
+
+/*
+ * Check if the character is a flow indicator: ',', '[', ']', '{', '}'.
+ */
+#define IS_FLOW_INDICATOR_AT(string, offset) (CLASS_AT((string), (offset)) & YAML_CLASS_FLOW)
+
+#define IS_FLOW_INDICATOR(string) IS_FLOW_INDICATOR_AT((string), 0)
+
+/*
+ * Check if the character may appear in a tag URI: an alphanumerical
+ * character, '_', '-', ';', '/', '?', ':', '@', '&', '=', '+', '$', '.',
+ * '%', '!', '~', '*', '\'', '(', ')'.
+ */
+#define IS_URI_AT(string, offset) (CLASS_AT((string), (offset)) & YAML_CLASS_URI)
+
+#define IS_URI(string) IS_URI_AT((string), 0)
+
 /*
  * Determine the width of the character.
  */
-#define WIDTH_AT(string, offset)                     \
-	(((string).pointer[offset] & 0x80) == 0x00	 ? 1 \
-	 : ((string).pointer[offset] & 0xE0) == 0xC0 ? 2 \
-	 : ((string).pointer[offset] & 0xF0) == 0xE0 ? 3 \
-	 : ((string).pointer[offset] & 0xF8) == 0xF0 ? 4 \
-												 : 0)
+#define WIDTH_AT(string, offset) (CLASS_AT((string), (offset)) >> YAML_CLASS_WIDTH_SHIFT)
 
 #define WIDTH(string) WIDTH_AT((string), 0)
 
@@ -479,14 +670,15 @@
 		 : 0)
 
 #define STACK_INIT(context, stack, type)                                \
-	(((stack).start = (type)_myyaml_malloc(MYYAML_INITIAL_STACK_SIZE *  \
+	(((stack).start = (type)_myyaml_malloc((context)->allocator,       \
+										   MYYAML_INITIAL_STACK_SIZE *  \
 										   sizeof(*(stack).start)))     \
 		 ? ((stack).top = (stack).start,                                \
 			(stack).end = (stack).start + MYYAML_INITIAL_STACK_SIZE, 1) \
 		 : ((context)->error = YAML_MEMORY_ERROR, 0))
 
 #define STACK_DEL(context, stack) \
-	(_myyaml_free((stack).start), (stack).start = (stack).top = (stack).end = 0)
+	(_myyaml_free((context)->allocator, (stack).start), (stack).start = (stack).top = (stack).end = 0)
 
 #define STACK_EMPTY(context, stack) ((stack).start == (stack).top)
 
@@ -497,42 +689,86 @@
 
 #define PUSH(context, stack, value)                                        \
 	(((stack).top != (stack).end ||                                        \
-	  _myyaml_stack_extend((void **)&(stack).start, (void **)&(stack).top, \
+	  _myyaml_stack_extend((context)->allocator,                          \
+						   (void **)&(stack).start, (void **)&(stack).top, \
 						   (void **)&(stack).end))                         \
 		 ? (*((stack).top++) = value, 1)                                   \
 		 : ((context)->error = YAML_MEMORY_ERROR, 0))
 
 #define POP(context, stack) (*(--(stack).top))
 
+/*
+ * Document stack operations: the same as STACK_INIT and PUSH, but allocating
+ * from the arena of the document if it has one.
+ */
+
+#define DOCUMENT_STACK_INIT(context, document, stack, type)                         \
+	(((stack).start = (type)yaml_document_malloc((document),                       \
+												 MYYAML_INITIAL_STACK_SIZE *        \
+													 sizeof(*(stack).start)))       \
+		 ? ((stack).top = (stack).start,                                            \
+			(stack).end = (stack).start + MYYAML_INITIAL_STACK_SIZE, 1)             \
+		 : ((context)->error = YAML_MEMORY_ERROR, 0))
+
+#define DOCUMENT_PUSH(context, document, stack, value)                              \
+	(((stack).top != (stack).end ||                                                 \
+	  ((document)->arena                                                            \
+		   ? yaml_arena_stack_extend((document)->arena, (void **)&(stack).start,    \
+									 (void **)&(stack).top, (void **)&(stack).end) \
+		   : _myyaml_stack_extend((document)->allocator, (void **)&(stack).start,   \
+								  (void **)&(stack).top, (void **)&(stack).end)))   \
+		 ? (*((stack).top++) = value, 1)                                            \
+		 : ((context)->error = YAML_MEMORY_ERROR, 0))
+
+/*
+ * Queues are rings over a power-of-two buffer.  The head and the tail are
+ * free-running positions masked into the buffer, so that dequeuing never
+ * moves the items behind the head; they are only copied when the ring grows.
+ */
+
 #define QUEUE_INIT(context, queue, size, type)                               \
-	(((queue).start = (type)_myyaml_malloc((size) * sizeof(*(queue).start))) \
-		 ? ((queue).head = (queue).tail = (queue).start,                     \
+	(((queue).start = (type)_myyaml_malloc((context)->allocator,           \
+										   (size) * sizeof(*(queue).start))) \
+		 ? ((queue).head = (queue).tail = 0,                                  \
 			(queue).end = (queue).start + (size), 1)                         \
 		 : ((context)->error = YAML_MEMORY_ERROR, 0))
 
 #define QUEUE_DEL(context, queue) \
-	(_myyaml_free((queue).start), \
-	 (queue).start = (queue).head = (queue).tail = (queue).end = 0)
+	(_myyaml_free((context)->allocator, (queue).start), \
+	 (queue).start = (queue).end = 0, (queue).head = (queue).tail = 0)
 
 #define QUEUE_EMPTY(context, queue) ((queue).head == (queue).tail)
 
+#define QUEUE_LENGTH(context, queue) ((queue).tail - (queue).head)
+
+#define QUEUE_SLOT(context, queue, position) \
+	((queue).start[(position) & (size_t)((queue).end - (queue).start - 1)])
+
+#define QUEUE_AT(context, queue, index) \
+	QUEUE_SLOT(context, queue, (queue).head + (index))
+
 #define ENQUEUE(context, queue, value)                                      \
-	(((queue).tail != (queue).end ||                                        \
-	  _myyaml_queue_extend((void **)&(queue).start, (void **)&(queue).head, \
-						   (void **)&(queue).tail, (void **)&(queue).end))  \
-		 ? (*((queue).tail++) = value, 1)                                   \
+	((QUEUE_LENGTH(context, queue) != (size_t)((queue).end - (queue).start) || \
+	  _myyaml_queue_extend((context)->allocator,                          \
+						   (void **)&(queue).start, &(queue).head,         \
+						   &(queue).tail, (void **)&(queue).end,           \
+						   sizeof(*(queue).start)))                        \
+		 ? (QUEUE_SLOT(context, queue, (queue).tail) = value,              \
+			(queue).tail++, 1)                                               \
 		 : ((context)->error = YAML_MEMORY_ERROR, 0))
 
-#define DEQUEUE(context, queue) (*((queue).head++))
+#define DEQUEUE(context, queue) QUEUE_SLOT(context, queue, (queue).head++)
 
 #define QUEUE_INSERT(context, queue, index, value)                          \
-	(((queue).tail != (queue).end ||                                        \
-	  _myyaml_queue_extend((void **)&(queue).start, (void **)&(queue).head, \
-						   (void **)&(queue).tail, (void **)&(queue).end))  \
-		 ? (memmove((queue).head + (index) + 1, (queue).head + (index),     \
-					((queue).tail - (queue).head - (index)) *               \
-						sizeof(*(queue).start)),                            \
-			*((queue).head + (index)) = value, (queue).tail++, 1)           \
+	((QUEUE_LENGTH(context, queue) != (size_t)((queue).end - (queue).start) || \
+	  _myyaml_queue_extend((context)->allocator,                          \
+						   (void **)&(queue).start, &(queue).head,         \
+						   &(queue).tail, (void **)&(queue).end,           \
+						   sizeof(*(queue).start)))                        \
+		 ? (_myyaml_queue_open((queue).start, (queue).end, &(queue).head,    \
+								&(queue).tail, (index),                        \
+								sizeof(*(queue).start)),                       \
+			QUEUE_AT(context, queue, index) = value, 1)                       \
 		 : ((context)->error = YAML_MEMORY_ERROR, 0))
 
 /*
@@ -647,10 +883,16 @@
  * Node initializers.
  */
 
+#if !defined(MYYAML_DISABLE_NODE_MARKS) || !MYYAML_DISABLE_NODE_MARKS
 #define NODE_INIT(node, node_type, node_tag, node_start_mark, node_end_mark) \
 	(memset(&(node), 0, sizeof(YamlNode)), (node).type = (node_type),        \
 	(node).tag = (node_tag), (node).start_mark = (node_start_mark),          \
 	(node).end_mark = (node_end_mark))
+#else
+#define NODE_INIT(node, node_type, node_tag, node_start_mark, node_end_mark) \
+	(memset(&(node), 0, sizeof(YamlNode)), (node).type = (node_type),        \
+	(node).tag = (node_tag), (void)(node_start_mark), (void)(node_end_mark))
+#endif
 
 #define SCALAR_NODE_INIT(node, node_tag, node_value, node_length, node_style, start_mark, end_mark)	\
 	(NODE_INIT((node), YAML_SCALAR_NODE, (node_tag), (start_mark), (end_mark)), 					\
@@ -694,9 +936,26 @@
 	(document).start_mark = (document_start_mark),                     	\
 	(document).end_mark = (document_end_mark))
 
-#define YAML_MALLOC_STATIC(type) (type *)_myyaml_malloc(sizeof(type))
+#define YAML_MALLOC_STATIC(allocator, type) (type *)_myyaml_malloc((allocator), sizeof(type))
+
+#define YAML_MALLOC(allocator, size) (YamlChar_t *)_myyaml_malloc((allocator), (size))
 
-#define YAML_MALLOC(size) (YamlChar_t *)_myyaml_malloc(size)
+/*
+ * Profiling: time a call as a parser stage and count what the parser does
+ * (see MYYAML_ENABLE_PROFILING).  PROFILE_CURRENT counts in the profile of
+ * the parser running on this thread, for code that has no parser at hand.
+ */
+
+#if MYYAML_PROFILING
+	#define PROFILE_STAGE(parser, stage, call) \
+		(yaml_parser_enter_stage((parser), (stage)), yaml_parser_leave_stage((parser), (call)))
+	#define PROFILE_COUNT(parser, counter) ((void)(parser)->profile.counters.counter++)
+	#define PROFILE_CURRENT(counter) ((void)(yaml_profile_current ? yaml_profile_current->counter++ : 0))
+#else
+	#define PROFILE_STAGE(parser, stage, call) (call)
+	#define PROFILE_COUNT(parser, counter) ((void)0)
+	#define PROFILE_CURRENT(counter) ((void)0)
+#endif // MYYAML_PROFILING
 
 // clang-format on
 
@@ -709,7 +968,15 @@
  * Return 1 on success, 0 on failure (reader error or memory error).
  */
 
-#define CACHE(parser, length) (parser->unread >= (length) ? 1 : yaml_parser_update_buffer(parser, (length)))
+#define CACHE(parser, length) \
+    (parser->unread >= (length) ? 1 : PROFILE_STAGE(parser, YAML_READER_STAGE, yaml_parser_update_buffer(parser, (length))))
+
+/*
+ * Check if the input is fed and more of it may still come, in which case a
+ * token fetch may have to be rolled back and retried.
+ */
+
+#define FEEDING(parser) ((parser)->feed.start && !(parser)->feed.final)
 
 /*
  * Advance the buffer pointer.
@@ -724,6 +991,14 @@
          ? (parser->mark.index++, parser->mark.column = 0, parser->mark.line++, parser->unread--, parser->buffer.pointer += WIDTH(parser->buffer)) \
          : 0)
 
+/*
+ * Advance the buffer pointer over a run of `length` ASCII characters on the
+ * current line.
+ */
+
+#define SKIP_RUN(parser, length) \
+    (parser->mark.index += (length), parser->mark.column += (length), parser->unread -= (length), parser->buffer.pointer += (length))
+
 /*
  * Copy a character to a string buffer and advance pointers.
  */
@@ -731,6 +1006,16 @@
 #define READ(parser, string) \
     (STRING_EXTEND(parser, string) ? (COPY(string, parser->buffer), parser->mark.index++, parser->mark.column++, parser->unread--, 1) : 0)
 
+/*
+ * Copy a run of `length` ASCII characters on the current line to a string
+ * buffer and advance pointers.
+ */
+
+#define READ_RUN(parser, string, length)                                                                                      \
+    (STRING_RESERVE(parser, string, length)                                                                                   \
+         ? (memcpy((string).pointer, parser->buffer.pointer, (length)), (string).pointer += (length), SKIP_RUN(parser, length), 1) \
+         : 0)
+
 /*
  * Copy a line break character to a string buffer and advance pointers.
  */
@@ -769,14 +1054,16 @@
 /*
  * Peek the next token in the token queue.
  */
-#define PEEK_TOKEN(parser) ((parser->token_available || yaml_parser_fetch_more_tokens(parser)) ? parser->tokens.head : NULL)
+#define PEEK_TOKEN(parser)                                                                                                          \
+    ((parser->token_available || PROFILE_STAGE(parser, YAML_SCANNER_STAGE, yaml_parser_fetch_more_tokens(parser))) ? &QUEUE_AT(parser, parser->tokens, 0) \
+                                                                                                                    : NULL)
 
 /*
  * Remove the next token from the queue (must be called after PEEK_TOKEN).
  */
 #define SKIP_TOKEN(parser)                                                                                                                     \
-    (parser->token_available = 0, parser->tokens_parsed++, parser->stream_end_produced = (parser->tokens.head->type == YAML_STREAM_END_TOKEN), \
-     parser->tokens.head++)
+    (parser->token_available = 0, parser->tokens_parsed++, parser->stream_end_produced = (QUEUE_AT(parser, parser->tokens, 0).type == YAML_STREAM_END_TOKEN), \
+     PROFILE_COUNT(parser, tokens[QUEUE_AT(parser, parser->tokens, 0).type]), parser->tokens.head++)
 
 //-----------------------------------------------------------------------------
 // [SECTION] Reader
@@ -842,6 +1129,13 @@
 
 int MAX_NESTING_LEVEL = 1000;
 
+#if MYYAML_PROFILING
+/*
+ * The profile of the parser whose stage runs on this thread, if any.
+ */
+static MYYAML_THREAD_LOCAL YamlParserProfile *yaml_profile_current;
+#endif // MYYAML_PROFILING
+
 /*
  * String management.
  */
@@ -851,6 +1145,132 @@ typedef struct {
     YamlChar_t *end;
 } YamlString_t;
 
+/*
+ * SIMD kernel table.
+ */
+typedef struct YamlKernels_t {
+    /* Length of the leading run of octets allowed as is in a stream. */
+    size_t (*utf8_ascii_span)(const unsigned char *start, const unsigned char *end);
+    /* Narrow leading UTF-16 code units of that run to octets. */
+    size_t (*utf16_ascii_narrow)(const unsigned char *input, size_t units, int big_endian, unsigned char *output);
+    /* Widen leading ASCII octets to UTF-16 code units. */
+    size_t (*utf8_ascii_widen)(const unsigned char *input, size_t size, int big_endian, unsigned char *output);
+    /* Length of the leading run of spaces. */
+    size_t (*space_span)(const unsigned char *start, const unsigned char *end);
+    /* Length of the leading run of printable ASCII and tabs. */
+    size_t (*text_span)(const unsigned char *start, const unsigned char *end);
+    /* Length of the leading run of ASCII a plain scalar may hold unchecked. */
+    size_t (*plain_span)(const unsigned char *start, const unsigned char *end);
+    /* Length of the leading run of ASCII a quoted scalar may hold unchecked. */
+    size_t (*quoted_span)(const unsigned char *start, const unsigned char *end);
+} YamlKernels_t;
+
+/*
+ * A block of a document arena; the allocations follow the header.
+ */
+typedef struct YamlArenaBlock_t {
+    struct YamlArenaBlock_t *next;
+    size_t size;
+    size_t used;
+} YamlArenaBlock_t;
+
+/*
+ * Document arena.
+ */
+struct YamlArena {
+    const YamlAllocator *allocator; /* The allocator of the blocks. */
+    YamlArenaBlock_t *blocks;       /* The block allocations come from, then the older ones. */
+    size_t block_size;              /* The size of the next block. */
+    YamlChar_t *default_tags[3];    /* Shared copies of the default scalar, sequence and mapping tags. */
+};
+
+/*
+ * A slot of a mapping key index.
+ */
+typedef struct YamlMappingIndexSlot_t {
+    unsigned int hash; /* The hash of the key. */
+    int pair;          /* The pair number plus one, or 0 if the slot is free. */
+} YamlMappingIndexSlot_t;
+
+/*
+ * Open addressing hash index of the scalar keys of a mapping node.
+ */
+struct YamlMappingIndex {
+    size_t mask;                    /* The number of slots minus one. */
+    size_t count;                   /* The number of pairs looked at so far. */
+    YamlMappingIndexSlot_t slots[]; /* The slots; a key is only in the first of them. */
+};
+
+/*
+ * A step of a compiled path: a mapping key, and the sequence index it
+ * spells if it is a decimal number.
+ */
+typedef struct YamlPathSegment_t {
+    const YamlChar_t *key; /* The key, inside the path allocation. */
+    size_t length;         /* The length of the key. */
+    unsigned int hash;     /* The hash of the key. */
+    int index;             /* The sequence index, or -1. */
+} YamlPathSegment_t;
+
+/*
+ * Compiled path; the keys follow the segments.
+ */
+struct YamlPath {
+    const YamlAllocator *allocator; /* The allocator of the path. */
+    size_t count;                   /* The number of segments. */
+    YamlPathSegment_t segments[];   /* The segments. */
+};
+
+/*
+ * The size of a node with its aliases expanded.
+ */
+typedef struct YamlNodeWeight_t {
+    size_t nodes; /* The number of nodes. */
+    int depth;    /* The deepest nesting of aliases. */
+    int open;     /* Is the node a collection still being composed? */
+} YamlNodeWeight_t;
+
+#if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
+
+/*
+ * A run of whole documents of a stream, loaded by its own parser for
+ * yaml_parser_load_all().
+ */
+typedef struct YamlStreamBatch_t {
+    const unsigned char *start; /* The first octet of the run. */
+    size_t size;                /* The number of octets. */
+    size_t offset;              /* The stream offset of the run. */
+    YamlMark mark;              /* The stream position of the run. */
+
+    /* The loaded documents. */
+    struct {
+        YamlDocument *start;
+        YamlDocument *end;
+        YamlDocument *top;
+    } documents;
+
+    /* The error of the parser that loaded the run. */
+    YamlErrorType error;
+    const char *problem;
+    const char *context;
+    size_t problem_offset;
+    int problem_value;
+    YamlMark problem_mark;
+    YamlMark context_mark;
+} YamlStreamBatch_t;
+
+/*
+ * The work shared by the threads of yaml_parser_load_all().
+ */
+typedef struct YamlStreamLoad_t {
+    YamlParser *parser;         /* The parser whose settings the runs are loaded with. */
+    YamlStreamBatch_t *batches; /* The runs. */
+    long count;                 /* The number of runs. */
+    volatile long next;         /* The next run to load. */
+} YamlStreamLoad_t;
+
+#endif  // MYYAML_DISABLE_READER
+
 /*
  * Document loading context.
  */
@@ -858,8 +1278,66 @@ typedef struct LoaderCtx_t {
     int *start;
     int *end;
     int *top;
+
+    /* The expansion weights of the nodes, when the parser has limits. */
+    struct {
+        struct YamlNodeWeight_t *start;
+        struct YamlNodeWeight_t *end;
+        struct YamlNodeWeight_t *top;
+    } weights;
 } LoaderCtx_t;
 
+/*
+ * How a path-filtered load takes a node (see yaml_parser_load_paths()).
+ */
+
+#define YAML_PATH_SKIP 1    /* Skip the node. */
+#define YAML_PATH_PARTIAL 2 /* Compose the node with the children the paths lead to. */
+#define YAML_PATH_FULL 3    /* Compose the whole node. */
+
+/*
+ * A collection a path-filtered load composes in part.  The paths that go
+ * through it are a range of the path stack of the filter.
+ */
+typedef struct YamlPathFrame_t {
+    size_t first;   /* The first of its paths on the path stack. */
+    size_t count;   /* The number of its paths. */
+    size_t segment; /* The segment of the paths that selects its children. */
+    int sequence;   /* Is it a sequence? */
+    int item;       /* The number of the next item of a sequence. */
+    int last;       /* The last item of a sequence a path selects, or -1. */
+    int value;      /* How to take the next value of a mapping, or 0 for a key. */
+} YamlPathFrame_t;
+
+/*
+ * The state of a path-filtered load.
+ */
+typedef struct YamlPathFilter_t {
+    const YamlPath *const *paths; /* The paths. */
+    size_t count;                 /* The number of paths. */
+    int full;                     /* The nesting inside a node composed whole, or 0. */
+    int skip;                     /* The nesting inside a skipped node, or 0. */
+    int orphan;                   /* The nesting inside an anchored node of a skipped one, or 0. */
+    int placeholder;              /* The node standing for the skipped items of sequences, or 0. */
+
+    /* The context of the anchored nodes of the skipped ones, composed outside of the tree. */
+    struct LoaderCtx_t orphans;
+
+    /* The collections composed in part. */
+    struct {
+        YamlPathFrame_t *start;
+        YamlPathFrame_t *end;
+        YamlPathFrame_t *top;
+    } frames;
+
+    /* The numbers of the paths that go through them. */
+    struct {
+        size_t *start;
+        size_t *end;
+        size_t *top;
+    } selected;
+} YamlPathFilter_t;
+
 //-----------------------------------------------------------------------------
 // [SECTION] C Only Functions
 //-----------------------------------------------------------------------------
@@ -881,36 +1359,41 @@ extern "C" {
 /*
  * Allocate a dynamic memory block.
  */
-MYYAML_API void *_myyaml_malloc(size_t size);
+MYYAML_API void *_myyaml_malloc(const YamlAllocator *allocator, size_t size);
 
 /*
  * Reallocate a dynamic memory block.
  */
-MYYAML_API void *_myyaml_realloc(void *ptr, size_t size);
+MYYAML_API void *_myyaml_realloc(const YamlAllocator *allocator, void *ptr, size_t size);
 
 /*
  * Free a dynamic memory block.
  */
-MYYAML_API void _myyaml_free(void *ptr);
+MYYAML_API void _myyaml_free(const YamlAllocator *allocator, void *ptr);
 
 /*
  * Duplicate a string.
  */
-MYYAML_API YamlChar_t *_myyaml_strdup(const YamlChar_t *);
+MYYAML_API YamlChar_t *_myyaml_strdup(const YamlAllocator *allocator, const YamlChar_t *);
 
 /*
  * Extend a string.
  */
-MYYAML_API int _myyaml_string_extend(YamlChar_t **start, YamlChar_t **pointer, YamlChar_t **end);
+MYYAML_API int _myyaml_string_extend(const YamlAllocator *allocator, YamlChar_t **start, YamlChar_t **pointer, YamlChar_t **end);
+
+/*
+ * Extend a string until it has room for `length` more octets.
+ */
+MYYAML_API int _myyaml_string_reserve(const YamlAllocator *allocator, YamlChar_t **start, YamlChar_t **pointer, YamlChar_t **end, size_t length);
 
 /*
  * Append a string B to a string A.
  */
-MYYAML_API int _myyaml_string_join(YamlChar_t **a_start, YamlChar_t **a_pointer, YamlChar_t **a_end, YamlChar_t **b_start, YamlChar_t **b_pointer,
-                                   YamlChar_t **b_end);
+MYYAML_API int _myyaml_string_join(const YamlAllocator *allocator, YamlChar_t **a_start, YamlChar_t **a_pointer, YamlChar_t **a_end,
+                                   YamlChar_t **b_start, YamlChar_t **b_pointer, YamlChar_t **b_end);
 
-MYYAML_API int _myyaml_string_initialize(YamlString_t *string) {
-    string->start = YAML_MALLOC(MYYAML_INITIAL_STRING_SIZE);
+MYYAML_API int _myyaml_string_initialize(const YamlAllocator *allocator, YamlString_t *string) {
+    string->start = YAML_MALLOC(allocator, MYYAML_INITIAL_STRING_SIZE);
     if (!string->start) {
         string->start = 0;
         return MYYAML_FAILURE;
@@ -922,20 +1405,82 @@ MYYAML_API int _myyaml_string_initialize(YamlString_t *string) {
     return MYYAML_SUCCESS;
 };
 
-MYYAML_API void _myyaml_string_delete(YamlString_t *string) {
-    _myyaml_free(string->start);
+MYYAML_API void _myyaml_string_delete(const YamlAllocator *allocator, YamlString_t *string) {
+    _myyaml_free(allocator, string->start);
     string->start = string->pointer = string->end = 0;
 };
 
 /*
  * Extend a stack.
  */
-MYYAML_API int _myyaml_stack_extend(void **start, void **top, void **end);
+MYYAML_API int _myyaml_stack_extend(const YamlAllocator *allocator, void **start, void **top, void **end);
+
+/*
+ * Extend a queue.
+ */
+MYYAML_API int _myyaml_queue_extend(const YamlAllocator *allocator, void **start, size_t *head, size_t *tail, void **end, size_t size);
+
+/*
+ * Make room for an item in the middle of a queue.
+ */
+MYYAML_API void _myyaml_queue_open(void *start, void *end, size_t *head, size_t *tail, size_t index, size_t size);
+
+/*
+ * Select the SIMD kernels for the running CPU.
+ */
+static const YamlKernels_t *yaml_get_kernels(void);
+
+/*
+ * Document arenas.
+ */
+
+static YamlArena *yaml_arena_create(const YamlAllocator *allocator);
+
+static void yaml_arena_destroy(YamlArena *arena);
+
+static void *yaml_arena_malloc(YamlArena *arena, size_t size);
+
+static int yaml_arena_stack_extend(YamlArena *arena, void **start, void **top, void **end);
+
+#if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
+static void yaml_arena_reset(YamlArena *arena);
+
+static int yaml_arena_contains(const YamlArena *arena, const void *pointer);
+#endif
+
+/*
+ * Allocate node data for a document, from its arena if it has one.
+ */
+
+static void *yaml_document_malloc(YamlDocument *document, size_t size);
+
+static YamlChar_t *yaml_document_strdup(YamlDocument *document, const YamlChar_t *string, size_t length);
+
+/*
+ * Get a tape entry, following an alias to the node it refers to.
+ */
+
+static YamlTapeEntry *yaml_tape_resolve(YamlTape *tape, int *id);
+
+/*
+ * Mapping key indexes.
+ */
+
+static unsigned int yaml_hash_string(const YamlChar_t *string, size_t length);
+
+static int yaml_document_update_mapping_index(YamlDocument *document, YamlNode *node);
+
+static void yaml_document_delete_mapping_index(YamlDocument *document, YamlNode *node);
+
+static int yaml_document_mapping_find(YamlDocument *document, YamlNode *node, const YamlChar_t *key, size_t length, unsigned int hash);
 
 /*
- * Extend or move a queue.
+ * Create a document whose memory comes from `allocator`.
  */
-MYYAML_API int _myyaml_queue_extend(void **start, void **head, void **tail, void **end);
+
+static int yaml_document_initialize_allocator(YamlDocument *document, const YamlAllocator *allocator, YamlVersionDirective *version_directive,
+                                              YamlTagDirective *tag_directives_start, YamlTagDirective *tag_directives_end, int start_implicit,
+                                              int end_implicit);
 
 #if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
 
@@ -960,6 +1505,25 @@ MYYAML_API int yaml_parser_fetch_more_tokens(YamlParser *parser);
 
 static int yaml_parser_fetch_next_token(YamlParser *parser);
 
+/*
+ * Scanner: Free a token that has not left the parser.
+ */
+static void yaml_parser_delete_token(YamlParser *parser, YamlToken *token);
+
+/*
+ * Fed input checkpoints.
+ */
+
+static int yaml_parser_fetch_fed_token(YamlParser *parser);
+
+static int yaml_parser_fetch_lookahead(YamlParser *parser);
+
+static int yaml_parser_save_checkpoint(YamlParser *parser);
+
+static void yaml_parser_restore_checkpoint(YamlParser *parser);
+
+static int yaml_stack_copy(const YamlAllocator *allocator, void **start, void **top, void **end, const void *from_start, const void *from_top);
+
 /*
  * Potential simple keys.
  */
@@ -1050,6 +1614,21 @@ static int yaml_parser_scan_flow_scalar(YamlParser *parser, YamlToken *token, in
 
 static int yaml_parser_scan_plain_scalar(YamlParser *parser, YamlToken *token);
 
+/*
+ * The scratch strings of the scalar scanners.
+ */
+
+#define YAML_SCRATCH_VALUE 0
+#define YAML_SCRATCH_LEADING_BREAK 1
+#define YAML_SCRATCH_TRAILING_BREAKS 2
+#define YAML_SCRATCH_WHITESPACES 3
+
+static int yaml_parser_take_scratch(YamlParser *parser, int slot, YamlString_t *string);
+
+static void yaml_parser_keep_scratch(YamlParser *parser, int slot, YamlString_t *string);
+
+static int yaml_parser_borrow_value(YamlParser *parser, YamlToken *token, YamlString_t *string);
+
 //-----------------------------------------------------------------------------
 // [SECTION] Parser
 //-----------------------------------------------------------------------------
@@ -1062,6 +1641,14 @@ static int yaml_string_read_handler(void *data, unsigned char *buffer, size_t si
  * File read handler.
  */
 static int yaml_file_read_handler(void *data, unsigned char *buffer, size_t size, size_t *size_read);
+/*
+ * Fed input read handler.
+ */
+static int yaml_feed_read_handler(void *data, unsigned char *buffer, size_t size, size_t *size_read);
+/*
+ * Allocate the buffers and stacks of a cleared parser.
+ */
+static int yaml_parser_allocate(YamlParser *parser);
 /*
  * Error handling.
  */
@@ -1120,6 +1707,14 @@ static int yaml_parser_process_directives(YamlParser *parser, YamlVersionDirecti
 
 static int yaml_parser_append_tag_directive(YamlParser *parser, YamlTagDirective value, int allow_duplicates, YamlMark mark);
 
+static int yaml_parser_dispatch_event(const YamlParserCallbacks *callbacks, YamlEvent *event);
+
+static int yaml_parser_start_values(YamlParser *parser);
+
+static void yaml_parser_recycle_values(YamlParser *parser);
+
+static int yaml_parser_stop_values(YamlParser *parser);
+
 //-----------------------------------------------------------------------------
 // [SECTION] Reader
 //-----------------------------------------------------------------------------
@@ -1130,6 +1725,27 @@ static int yaml_parser_determine_encoding(YamlParser *parser);
 
 static int yaml_parser_update_raw_buffer(YamlParser *parser);
 
+static int yaml_parser_read_input(YamlParser *parser, unsigned char *buffer, size_t size, size_t *size_read);
+
+static size_t yaml_parser_input_position(YamlParser *parser);
+
+/*
+ * UTF-8 passthrough.
+ */
+
+static int yaml_parser_check_utf8_block(YamlParser *parser, const unsigned char *start, const unsigned char *end, int eof, size_t *length,
+                                        size_t *count);
+
+static int yaml_parser_read_utf8_buffer(YamlParser *parser);
+
+/*
+ * Memory-mapped input.
+ */
+
+static int yaml_parser_map_buffer(YamlParser *parser);
+
+static void yaml_parser_unmap_input(YamlParser *parser);
+
 /*
  * Reader: Ensure that the buffer contains at least `length` characters.
  */
@@ -1152,7 +1768,7 @@ static int yaml_parser_set_composer_error_context(YamlParser *parser, const char
  * Alias handling.
  */
 
-static int yaml_parser_register_anchor(YamlParser *parser, int index, YamlChar_t *anchor);
+static int yaml_parser_register_anchor(YamlParser *parser, int index, YamlChar_t *anchor, YamlMark mark);
 
 /*
  * Clean up functions.
@@ -1160,15 +1776,29 @@ static int yaml_parser_register_anchor(YamlParser *parser, int index, YamlChar_t
 
 static void yaml_parser_delete_aliases(YamlParser *parser);
 
+/*
+ * Anchor table.
+ */
+
+static YamlAliasData *yaml_parser_find_anchor(YamlParser *parser, const YamlChar_t *anchor, unsigned int hash);
+
+static int yaml_parser_index_anchor(YamlParser *parser);
+
 /*
  * Composer functions.
  */
+static int yaml_parser_compose(YamlParser *parser, YamlDocument *document, YamlPathFilter_t *filter);
+
 static int yaml_parser_load_nodes(YamlParser *parser, struct LoaderCtx_t *ctx);
 
-static int yaml_parser_load_document(YamlParser *parser, YamlEvent *event);
+static int yaml_parser_load_document(YamlParser *parser, YamlEvent *event, YamlPathFilter_t *filter);
+
+static int yaml_parser_load_event(YamlParser *parser, YamlEvent *event, struct LoaderCtx_t *ctx);
 
 static int yaml_parser_load_alias(YamlParser *parser, YamlEvent *event, struct LoaderCtx_t *ctx);
 
+static YamlChar_t *yaml_parser_load_tag(YamlParser *parser, YamlChar_t **event_tag, int kind);
+
 static int yaml_parser_load_scalar(YamlParser *parser, YamlEvent *event, struct LoaderCtx_t *ctx);
 
 static int yaml_parser_load_sequence(YamlParser *parser, YamlEvent *event, struct LoaderCtx_t *ctx);
@@ -1179,6 +1809,70 @@ static int yaml_parser_load_sequence_end(YamlParser *parser, YamlEvent *event, s
 
 static int yaml_parser_load_mapping_end(YamlParser *parser, YamlEvent *event, struct LoaderCtx_t *ctx);
 
+static int yaml_parser_weigh_node(YamlParser *parser, struct LoaderCtx_t *ctx, int open, YamlMark mark);
+
+static int yaml_parser_weigh_child(YamlParser *parser, struct LoaderCtx_t *ctx, int index, int alias, YamlMark mark);
+
+/*
+ * Path-filtered composer functions.
+ */
+
+static int yaml_parser_load_path_nodes(YamlParser *parser, struct LoaderCtx_t *ctx, YamlPathFilter_t *filter);
+
+static int yaml_parser_select_path(YamlParser *parser, YamlPathFilter_t *filter, const YamlChar_t *key, size_t length, int item);
+
+static int yaml_parser_skip_path_event(YamlParser *parser, struct LoaderCtx_t *ctx, YamlPathFilter_t *filter, YamlEvent *event);
+
+static int yaml_parser_load_placeholder(YamlParser *parser, struct LoaderCtx_t *ctx, YamlPathFilter_t *filter, YamlMark mark);
+
+/*
+ * Tape composer functions.
+ */
+
+static int yaml_parser_load_tape_nodes(YamlParser *parser, YamlTape *tape, struct LoaderCtx_t *ctx, YamlMark start_mark);
+
+static int yaml_parser_load_tape_node(YamlParser *parser, YamlTape *tape, YamlEvent *event, struct LoaderCtx_t *ctx, uint32_t *last_tag);
+
+static int yaml_parser_load_tape_end(YamlParser *parser, YamlTape *tape, YamlEvent *event, struct LoaderCtx_t *ctx);
+
+static uint32_t yaml_parser_tape_string(YamlParser *parser, YamlTape *tape, const YamlChar_t *string, size_t length);
+
+/*
+ * Stream loading.
+ */
+
+static int yaml_parser_load_stream(YamlParser *parser, YamlStreamBatch_t *batch);
+
+static int yaml_parser_split_stream(YamlParser *parser, size_t target, YamlStreamLoad_t *load);
+
+static int yaml_stream_marker_at(const unsigned char *pointer, const unsigned char *end, unsigned char octet);
+
+static void yaml_stream_load_batch(YamlParser *settings, YamlStreamBatch_t *batch);
+
+static void yaml_stream_load_batches(YamlStreamLoad_t *load);
+
+#if MYYAML_THREADS
+static int yaml_stream_processors(void);
+
+#if MYYAML_PLATFORM_IS(WINDOWS)
+static unsigned __stdcall yaml_stream_load_thread(void *data);
+#else
+static void *yaml_stream_load_thread(void *data);
+#endif
+#endif // MYYAML_THREADS
+
+#if MYYAML_PROFILING
+/*
+ * Profiling.
+ */
+
+static uint64_t yaml_profile_ticks(void);
+
+static void yaml_parser_enter_stage(YamlParser *parser, YamlParserStage stage);
+
+static int yaml_parser_leave_stage(YamlParser *parser, int result);
+#endif // MYYAML_PROFILING
+
 #endif  // MYYAML_DISABLE_READER
 
 #if !defined(MYYAML_DISABLE_WRITER) || !MYYAML_DISABLE_WRITER
@@ -1207,9 +1901,9 @@ static void yaml_emitter_delete_document_and_anchors(YamlEmitter *emitter);
  * Anchor functions.
  */
 
-static void yaml_emitter_anchor_node(YamlEmitter *emitter, int index);
+static int yaml_emitter_anchor_nodes(YamlEmitter *emitter);
 
-static YamlChar_t *yaml_emitter_generate_anchor(YamlEmitter *emitter, int anchor_id);
+static int yaml_emitter_generate_anchors(YamlEmitter *emitter);
 
 /*
  * Serialize functions.
@@ -1219,6 +1913,8 @@ static int yaml_emitter_dump_node(YamlEmitter *emitter, int index);
 
 static int yaml_emitter_dump_alias(YamlEmitter *emitter, YamlChar_t *anchor);
 
+static YamlChar_t *yaml_emitter_dump_tag(YamlEmitter *emitter, YamlNode *node);
+
 static int yaml_emitter_dump_scalar(YamlEmitter *emitter, YamlNode *node, YamlChar_t *anchor);
 
 static int yaml_emitter_dump_sequence(YamlEmitter *emitter, YamlNode *node, YamlChar_t *anchor);
@@ -1239,6 +1935,11 @@ static int yaml_string_write_handler(void *data, unsigned char *buffer, size_t s
  */
 static int yaml_file_write_handler(void *data, unsigned char *buffer, size_t size);
 
+/*
+ * Allocate the buffers and stacks of a cleared emitter.
+ */
+static int yaml_emitter_allocate(YamlEmitter *emitter);
+
 /*
  * Utility functions.
  */
@@ -1361,24 +2062,49 @@ static int yaml_emitter_write_folded_scalar(YamlEmitter *emitter, YamlChar_t *va
 
 #pragma region C Def
 
-MYYAML_API void *_myyaml_malloc(size_t size) { return malloc(size ? size : 1); };
-
-MYYAML_API void *_myyaml_realloc(void *ptr, size_t size) { return ptr ? realloc(ptr, size ? size : 1) : malloc(size ? size : 1); };
+MYYAML_API void *_myyaml_malloc(const YamlAllocator *allocator, size_t size) {
+    if (!size) size = 1;
+    PROFILE_CURRENT(allocations);
 
-MYYAML_API void _myyaml_free(void *ptr) {
-    if (ptr) free(ptr);
+    return allocator ? allocator->allocate(allocator->data, size) : malloc(size);
 };
 
-MYYAML_API YamlChar_t *_myyaml_strdup(const YamlChar_t *str) {
-    if (!str) return NULL;
+MYYAML_API void *_myyaml_realloc(const YamlAllocator *allocator, void *ptr, size_t size) {
+    if (!ptr) return _myyaml_malloc(allocator, size);
+    if (!size) size = 1;
+    PROFILE_CURRENT(allocations);
 
-    return (YamlChar_t *)strdup((char *)str);
+    return allocator ? allocator->reallocate(allocator->data, ptr, size) : realloc(ptr, size);
 };
 
-MYYAML_API int _myyaml_string_extend(YamlChar_t **start, YamlChar_t **pointer, YamlChar_t **end) {
-    YamlChar_t *new_start = (YamlChar_t *)_myyaml_realloc((void *)*start, (*end - *start) * 2);
+MYYAML_API void _myyaml_free(const YamlAllocator *allocator, void *ptr) {
+    if (!ptr) return;
 
-    if (!new_start) return MYYAML_FAILURE;
+    if (allocator) {
+        allocator->release(allocator->data, ptr);
+    } else {
+        free(ptr);
+    }
+};
+
+MYYAML_API YamlChar_t *_myyaml_strdup(const YamlAllocator *allocator, const YamlChar_t *str) {
+    YamlChar_t *copy;
+    size_t size;
+
+    if (!str) return NULL;
+    if (!allocator) return PROFILE_CURRENT(allocations), (YamlChar_t *)strdup((char *)str);
+
+    size = strlen((char *)str) + 1;
+    copy = YAML_MALLOC(allocator, size);
+    if (copy) memcpy(copy, str, size);
+
+    return copy;
+};
+
+MYYAML_API int _myyaml_string_extend(const YamlAllocator *allocator, YamlChar_t **start, YamlChar_t **pointer, YamlChar_t **end) {
+    YamlChar_t *new_start = (YamlChar_t *)_myyaml_realloc(allocator, (void *)*start, (*end - *start) * 2);
+
+    if (!new_start) return MYYAML_FAILURE;
 
     memset(new_start + (*end - *start), 0, *end - *start);
 
@@ -1389,13 +2115,21 @@ MYYAML_API int _myyaml_string_extend(YamlChar_t **start, YamlChar_t **pointer, Y
     return MYYAML_SUCCESS;
 };
 
-MYYAML_API int _myyaml_string_join(YamlChar_t **a_start, YamlChar_t **a_pointer, YamlChar_t **a_end, YamlChar_t **b_start, YamlChar_t **b_pointer,
-                                   SHIM(YamlChar_t **b_end)) {
+MYYAML_API int _myyaml_string_reserve(const YamlAllocator *allocator, YamlChar_t **start, YamlChar_t **pointer, YamlChar_t **end, size_t length) {
+    while ((size_t)(*end - *pointer) <= length + 5) {
+        if (!_myyaml_string_extend(allocator, start, pointer, end)) return MYYAML_FAILURE;
+    }
+
+    return MYYAML_SUCCESS;
+}
+
+MYYAML_API int _myyaml_string_join(const YamlAllocator *allocator, YamlChar_t **a_start, YamlChar_t **a_pointer, YamlChar_t **a_end,
+                                   YamlChar_t **b_start, YamlChar_t **b_pointer, SHIM(YamlChar_t **b_end)) {
     UNUSED_PARAM(b_end)
     if (*b_start == *b_pointer) return MYYAML_SUCCESS;
 
     while (*a_end - *a_pointer <= *b_pointer - *b_start) {
-        if (!_myyaml_string_extend(a_start, a_pointer, a_end)) return MYYAML_FAILURE;
+        if (!_myyaml_string_extend(allocator, a_start, a_pointer, a_end)) return MYYAML_FAILURE;
     }
 
     memcpy(*a_pointer, *b_start, *b_pointer - *b_start);
@@ -1404,12 +2138,13 @@ MYYAML_API int _myyaml_string_join(YamlChar_t **a_start, YamlChar_t **a_pointer,
     return MYYAML_SUCCESS;
 }
 
-MYYAML_API int _myyaml_stack_extend(void **start, void **top, void **end) {
+MYYAML_API int _myyaml_stack_extend(const YamlAllocator *allocator, void **start, void **top, void **end) {
     void *new_start;
 
     if ((char *)*end - (char *)*start >= INT_MAX / 2) return MYYAML_FAILURE;
+    PROFILE_CURRENT(stack_extensions);
 
-    new_start = _myyaml_realloc(*start, ((char *)*end - (char *)*start) * 2);
+    new_start = _myyaml_realloc(allocator, *start, ((char *)*end - (char *)*start) * 2);
 
     if (!new_start) return MYYAML_FAILURE;
 
@@ -1420,106 +2155,975 @@ MYYAML_API int _myyaml_stack_extend(void **start, void **top, void **end) {
     return MYYAML_SUCCESS;
 }
 
-MYYAML_API int _myyaml_queue_extend(void **start, void **head, void **tail, void **end) {
-    /* Check if we need to resize the queue. */
+MYYAML_API int _myyaml_queue_extend(const YamlAllocator *allocator, void **start, size_t *head, size_t *tail, void **end, size_t size) {
+    size_t capacity = ((char *)*end - (char *)*start) / size;
+    size_t first = *head & (capacity - 1);
+    size_t length = *tail - *head;
+    char *new_start;
+
+    PROFILE_CURRENT(queue_extensions);
+
+    new_start = (char *)_myyaml_malloc(allocator, capacity * size * 2);
+
+    if (!new_start) return MYYAML_FAILURE;
+
+    /* Unwrap the ring at the beginning of the new buffer. */
+
+    if (first + length <= capacity) {
+        memcpy(new_start, (char *)*start + first * size, length * size);
+    } else {
+        memcpy(new_start, (char *)*start + first * size, (capacity - first) * size);
+        memcpy(new_start + (capacity - first) * size, *start, (length - capacity + first) * size);
+    }
+
+    _myyaml_free(allocator, *start);
+
+    *head = 0;
+    *tail = length;
+    *end = new_start + capacity * size * 2;
+    *start = new_start;
+
+    return MYYAML_SUCCESS;
+}
+
+MYYAML_API void _myyaml_queue_open(void *start, void *end, size_t *head, size_t *tail, size_t index, size_t size) {
+    size_t mask = ((char *)end - (char *)start) / size - 1;
+    size_t position;
 
-    if (*start == *head && *tail == *end) {
-        void *new_start = _myyaml_realloc(*start, ((char *)*end - (char *)*start) * 2);
+    /* Move whichever side of the index is shorter by one item. */
 
-        if (!new_start) return MYYAML_FAILURE;
+    if (index < *tail - *head - index) {
+        for (position = *head - 1; position != *head - 1 + index; position++) {
+            memcpy((char *)start + (position & mask) * size, (char *)start + ((position + 1) & mask) * size, size);
+        }
+        (*head)--;
+    } else {
+        for (position = *tail; position != *head + index; position--) {
+            memcpy((char *)start + (position & mask) * size, (char *)start + ((position - 1) & mask) * size, size);
+        }
+        (*tail)++;
+    }
+}
+
+/*
+ * Document arenas.
+ *
+ * An arena hands out memory from a list of large blocks and is released a
+ * block at a time.  Nothing is freed individually: a stack that outgrows its
+ * space moves to a new allocation and leaves the old one behind, unless it
+ * is the last allocation of the current block and can grow in place.
+ */
+
+#define YAML_ARENA_ALIGN 16
+
+#define YAML_ARENA_ROUND(size) (((size) + YAML_ARENA_ALIGN - 1) & ~(size_t)(YAML_ARENA_ALIGN - 1))
+
+#define YAML_ARENA_DATA(block) ((char *)(block) + YAML_ARENA_ROUND(sizeof(YamlArenaBlock_t)))
+
+static YamlArena *yaml_arena_create(const YamlAllocator *allocator) {
+    YamlArena *arena = (YamlArena *)_myyaml_malloc(allocator, sizeof(YamlArena));
+
+    if (!arena) return NULL;
+
+    memset(arena, 0, sizeof(YamlArena));
+    arena->allocator = allocator;
+    arena->block_size = MYYAML_ARENA_BLOCK_SIZE;
+
+    return arena;
+}
+
+static void yaml_arena_destroy(YamlArena *arena) {
+    if (!arena) return;
 
-        *head = (char *)new_start + ((char *)*head - (char *)*start);
-        *tail = (char *)new_start + ((char *)*tail - (char *)*start);
-        *end = (char *)new_start + ((char *)*end - (char *)*start) * 2;
-        *start = new_start;
+    while (arena->blocks) {
+        YamlArenaBlock_t *next = arena->blocks->next;
+        _myyaml_free(arena->allocator, arena->blocks);
+        arena->blocks = next;
     }
+    _myyaml_free(arena->allocator, arena);
+}
+
+static void *yaml_arena_malloc(YamlArena *arena, size_t size) {
+    YamlArenaBlock_t *block = arena->blocks;
+    void *pointer;
+
+    if (size > (size_t)INT_MAX) return NULL;
+
+    size = YAML_ARENA_ROUND(size ? size : 1);
+
+    if (!block || block->size - block->used < size) {
+        /*
+         * A large request gets a block of its own, linked behind the current
+         * one so that the rest of the current block is still used.
+         */
+
+        if (size > arena->block_size / 4) {
+            block = (YamlArenaBlock_t *)_myyaml_malloc(arena->allocator, YAML_ARENA_ROUND(sizeof(YamlArenaBlock_t)) + size);
+            if (!block) return NULL;
+
+            block->size = block->used = size;
+            if (arena->blocks) {
+                block->next = arena->blocks->next;
+                arena->blocks->next = block;
+            } else {
+                block->next = NULL;
+                arena->blocks = block;
+            }
+
+            return YAML_ARENA_DATA(block);
+        }
+
+        block = (YamlArenaBlock_t *)_myyaml_malloc(arena->allocator, YAML_ARENA_ROUND(sizeof(YamlArenaBlock_t)) + arena->block_size);
+        if (!block) return NULL;
 
-    /* Check if we need to move the queue at the beginning of the buffer. */
+        block->next = arena->blocks;
+        block->size = arena->block_size;
+        block->used = 0;
+        arena->blocks = block;
 
-    if (*tail == *end) {
-        if (*head != *tail) {
-            memmove(*start, *head, (char *)*tail - (char *)*head);
+        if (arena->block_size < (size_t)MYYAML_ARENA_BLOCK_SIZE * 64) {
+            arena->block_size *= 2;
         }
-        *tail = (char *)*tail - (char *)*head + (char *)*start;
-        *head = *start;
     }
 
+    pointer = YAML_ARENA_DATA(block) + block->used;
+    block->used += size;
+
+    return pointer;
+}
+
+static int yaml_arena_stack_extend(YamlArena *arena, void **start, void **top, void **end) {
+    size_t size = (char *)*end - (char *)*start;
+    YamlArenaBlock_t *block = arena->blocks;
+    void *new_start;
+
+    if (size >= INT_MAX / 2) return MYYAML_FAILURE;
+    PROFILE_CURRENT(stack_extensions);
+
+    /* Grow in place if the stack is the last allocation of the block. */
+
+    if (block && (char *)*end == YAML_ARENA_DATA(block) + block->used && block->size - block->used >= size) {
+        block->used += size;
+        *end = (char *)*end + size;
+        return MYYAML_SUCCESS;
+    }
+
+    new_start = yaml_arena_malloc(arena, size * 2);
+
+    if (!new_start) return MYYAML_FAILURE;
+
+    memcpy(new_start, *start, size);
+
+    *top = (char *)new_start + ((char *)*top - (char *)*start);
+    *end = (char *)new_start + size * 2;
+    *start = new_start;
+
     return MYYAML_SUCCESS;
 }
 
 #if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
 
-#pragma region Scanner
+/*
+ * Empty an arena, keeping its current block for the next allocations.
+ */
+
+static void yaml_arena_reset(YamlArena *arena) {
+    YamlArenaBlock_t *block = arena->blocks;
+
+    if (!block) return;
+
+    while (block->next) {
+        YamlArenaBlock_t *next = block->next->next;
+        _myyaml_free(arena->allocator, block->next);
+        block->next = next;
+    }
+    block->used = 0;
+}
 
 /*
- * Introduction
- * ************
- *
- * The following notes assume that you are familiar with the YAML specification
- * (http://yaml.org/spec/cvs/current.html).  We mostly follow it, although in
- * some cases we are less restrictive that it requires.
- *
- * The process of transforming a YAML stream into a sequence of events is
- * divided on two steps: Scanning and Parsing.
- *
- * The Scanner transforms the input stream into a sequence of tokens, while the
- * parser transform the sequence of tokens produced by the Scanner into a
- * sequence of parsing events.
- *
- * The Scanner is rather clever and complicated. The Parser, on the contrary,
- * is a straightforward implementation of a recursive-descendant parser (or,
- * LL(1) parser, as it is usually called).
- *
- * Actually there are two issues of Scanning that might be called "clever", the
- * rest is quite straightforward.  The issues are "block collection start" and
- * "simple keys".  Both issues are explained below in details.
- *
- * Here the Scanning step is explained and implemented.  We start with the list
- * of all the tokens produced by the Scanner together with short descriptions.
- *
- * Now, tokens:
- *
- *      STREAM-START(encoding)          # The stream start.
- *      STREAM-END                      # The stream end.
- *      VERSION-DIRECTIVE(major,minor)  # The '%YAML' directive.
- *      TAG-DIRECTIVE(handle,prefix)    # The '%TAG' directive.
- *      DOCUMENT-START                  # '---'
- *      DOCUMENT-END                    # '...'
- *      BLOCK-SEQUENCE-START            # Indentation increase denoting a block
- *      BLOCK-MAPPING-START             # sequence or a block mapping.
- *      BLOCK-END                       # Indentation decrease.
- *      FLOW-SEQUENCE-START             # '['
- *      FLOW-SEQUENCE-END               # ']'
- *      FLOW-MAPPING-START              # '{'
- *      FLOW-MAPPING-END                # '}'
- *      BLOCK-ENTRY                     # '-'
- *      FLOW-ENTRY                      # ','
- *      KEY                             # '?' or nothing (simple keys).
- *      VALUE                           # ':'
- *      ALIAS(anchor)                   # '*anchor'
- *      ANCHOR(anchor)                  # '&anchor'
- *      TAG(handle,suffix)              # '!handle!suffix'
- *      SCALAR(value,style)             # A scalar.
- *
- * The following two tokens are "virtual" tokens denoting the beginning and the
- * end of the stream:
- *
- *      STREAM-START(encoding)
- *      STREAM-END
- *
- * We pass the information about the input stream encoding with the
- * STREAM-START token.
- *
- * The next two tokens are responsible for tags:
- *
- *      VERSION-DIRECTIVE(major,minor)
- *      TAG-DIRECTIVE(handle,prefix)
+ * Check if a pointer points into the blocks of an arena.
+ */
+
+static int yaml_arena_contains(const YamlArena *arena, const void *pointer) {
+    const YamlArenaBlock_t *block;
+
+    for (block = arena->blocks; block; block = block->next) {
+        const char *data = YAML_ARENA_DATA(block);
+
+        if ((const char *)pointer >= data && (const char *)pointer < data + block->size) return 1;
+    }
+
+    return 0;
+}
+
+#endif  // MYYAML_DISABLE_READER
+
+static void *yaml_document_malloc(YamlDocument *document, size_t size) {
+    return document->arena ? yaml_arena_malloc(document->arena, size) : _myyaml_malloc(document->allocator, size);
+}
+
+static YamlChar_t *yaml_document_strdup(YamlDocument *document, const YamlChar_t *string, size_t length) {
+    YamlChar_t *copy = (YamlChar_t *)yaml_document_malloc(document, length + 1);
+
+    if (!copy) return NULL;
+
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+
+    return copy;
+}
+
+/*
+ * Hash a mapping key or an anchor (32-bit FNV-1a).
+ */
+
+static unsigned int yaml_hash_string(const YamlChar_t *string, size_t length) {
+    uint32_t hash = 2166136261u;
+
+    while (length--) {
+        hash = (hash ^ *string++) * 16777619u;
+    }
+
+    return (unsigned int)hash;
+}
+
+/*
+ * Bring the key index of a mapping node up to date with its pairs, creating
+ * it or making it larger if needed.  A key already in the index is not
+ * added again, so that lookups find the first pair with a given key.
+ */
+
+static int yaml_document_update_mapping_index(YamlDocument *document, YamlNode *node) {
+    struct YamlMappingIndex *index = node->data.mapping.index;
+    size_t count = node->data.mapping.pairs.top - node->data.mapping.pairs.start;
+
+    /* Keep the index at most half full. */
+
+    if (!index || count * 2 > index->mask + 1) {
+        size_t size = 16;
+
+        while (size < count * 2) size *= 2;
+
+        yaml_document_delete_mapping_index(document, node);
+
+        index = (struct YamlMappingIndex *)yaml_document_malloc(document, sizeof(struct YamlMappingIndex) + size * sizeof(YamlMappingIndexSlot_t));
+        if (!index) return MYYAML_FAILURE;
+
+        memset(index->slots, 0, size * sizeof(YamlMappingIndexSlot_t));
+        index->mask = size - 1;
+        index->count = 0;
+        node->data.mapping.index = index;
+    }
+
+    for (; index->count < count; index->count++) {
+        YamlNode *key = yaml_document_get_node(document, node->data.mapping.pairs.start[index->count].key);
+        unsigned int hash;
+        size_t slot;
+
+        if (!key || key->type != YAML_SCALAR_NODE) continue;
+
+        hash = yaml_hash_string(key->data.scalar.value, key->data.scalar.length);
+
+        for (slot = hash & index->mask; index->slots[slot].pair; slot = (slot + 1) & index->mask) {
+            YamlNode *other;
+
+            if (index->slots[slot].hash != hash) continue;
+            other = document->nodes.start + node->data.mapping.pairs.start[index->slots[slot].pair - 1].key - 1;
+            if (other->data.scalar.length == key->data.scalar.length &&
+                memcmp(other->data.scalar.value, key->data.scalar.value, key->data.scalar.length) == 0) {
+                break;
+            }
+        }
+
+        if (!index->slots[slot].pair) {
+            index->slots[slot].hash = hash;
+            index->slots[slot].pair = (int)index->count + 1;
+        }
+    }
+
+    return MYYAML_SUCCESS;
+}
+
+static void yaml_document_delete_mapping_index(YamlDocument *document, YamlNode *node) {
+    /* The index of an arena document goes with the arena. */
+
+    if (!document->arena) {
+        _myyaml_free(document->allocator, node->data.mapping.index);
+    }
+    node->data.mapping.index = NULL;
+}
+
+/*
+ * Find the value of the first pair of a mapping node with the given scalar
+ * key, without writing to the document.  The hash of the key is only used
+ * if the mapping has an index; the pairs the index has not seen yet are
+ * searched linearly.
+ */
+
+static int yaml_document_mapping_find(YamlDocument *document, YamlNode *node, const YamlChar_t *key, size_t length, unsigned int hash) {
+    struct YamlMappingIndex *index = node->data.mapping.index;
+    YamlNodePair *pair = node->data.mapping.pairs.start;
+
+    if (index) {
+        size_t slot;
+
+        for (slot = hash & index->mask; index->slots[slot].pair; slot = (slot + 1) & index->mask) {
+            if (index->slots[slot].hash == hash) {
+                YamlNodePair *candidate = pair + index->slots[slot].pair - 1;
+                YamlNode *other = document->nodes.start + candidate->key - 1;
+                if (other->data.scalar.length == length && memcmp(other->data.scalar.value, key, length) == 0) {
+                    return candidate->value;
+                }
+            }
+        }
+
+        pair += index->count;
+    }
+
+    for (; pair < node->data.mapping.pairs.top; pair++) {
+        YamlNode *other = yaml_document_get_node(document, pair->key);
+        if (!other || other->type != YAML_SCALAR_NODE) continue;
+        if (other->data.scalar.length == length && memcmp(other->data.scalar.value, key, length) == 0) {
+            return pair->value;
+        }
+    }
+
+    return MYYAML_FAILURE;
+}
+
+/*
+ * SIMD kernels.
  *
- * Example:
+ * Each kernel handles the longest prefix of a block it can process without
+ * decoding and returns its length; the scalar code takes over from there.
+ * The variants are picked once, from the features of the running CPU.
+ */
+
+/*
+ * Return the index of the lowest set bit of a non-zero mask.
+ */
+
+static MYYAML_INLINE unsigned int yaml_count_trailing_zeros(unsigned int mask) {
+#if MYYAML_COMPILER_IS(MSVC)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned int)index;
+#elif defined(__GNUC__)
+    return (unsigned int)__builtin_ctz(mask);
+#else
+    unsigned int index = 0;
+    while (!(mask & 1u)) {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+/*
+ * Check if an ASCII octet may appear in a YAML stream as is: TAB, LF, CR
+ * and #x20-#x7E.
+ */
+
+#define IS_STREAM_ASCII(octet) (((octet) >= 0x20 && (octet) <= 0x7E) || (octet) == '\t' || (octet) == '\n' || (octet) == '\r')
+
+static size_t yaml_utf8_ascii_span_scalar(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+
+    while (pointer < end && IS_STREAM_ASCII(*pointer)) {
+        pointer++;
+    }
+
+    return pointer - start;
+}
+
+static size_t yaml_utf16_ascii_narrow_scalar(const unsigned char *input, size_t units, int big_endian, unsigned char *output) {
+    size_t done = 0;
+
+    while (done < units) {
+        unsigned int value = big_endian ? (input[2 * done] << 8) + input[2 * done + 1] : input[2 * done] + (input[2 * done + 1] << 8);
+        if (!IS_STREAM_ASCII(value)) break;
+        output[done++] = (unsigned char)value;
+    }
+
+    return done;
+}
+
+static size_t yaml_utf8_ascii_widen_scalar(const unsigned char *input, size_t size, int big_endian, unsigned char *output) {
+    size_t done = 0;
+
+    while (done < size && input[done] < 0x80) {
+        output[2 * done + big_endian] = input[done];
+        output[2 * done + !big_endian] = 0;
+        done++;
+    }
+
+    return done;
+}
+
+/*
+ * Block classification for the scanner.
  *
- *      %YAML   1.1
- *      %TAG    !   !foo
- *      %TAG    !yaml!  tag:yaml.org,2002:
+ * The spans below cover the runs of ASCII the scanner would otherwise walk
+ * one character at a time: indentation, comment and block scalar text, and
+ * the body of plain and quoted scalars between the characters that need a
+ * closer look (indicators, blanks, quotes and escapes).
+ */
+
+#define IS_TEXT_ASCII(octet) (((octet) >= 0x20 && (octet) <= 0x7E) || (octet) == '\t')
+
+#define IS_PLAIN_ASCII(octet) \
+    ((octet) > 0x20 && (octet) < 0x7F && (octet) != ':' && (octet) != ',' && (octet) != '[' && (octet) != ']' && (octet) != '{' && (octet) != '}')
+
+#define IS_QUOTED_ASCII(octet) ((octet) > 0x20 && (octet) < 0x7F && (octet) != '\'' && (octet) != '"' && (octet) != '\\')
+
+static size_t yaml_space_span_scalar(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+
+    while (pointer < end && *pointer == ' ') {
+        pointer++;
+    }
+
+    return pointer - start;
+}
+
+static size_t yaml_text_span_scalar(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+
+    while (pointer < end && IS_TEXT_ASCII(*pointer)) {
+        pointer++;
+    }
+
+    return pointer - start;
+}
+
+static size_t yaml_plain_span_scalar(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+
+    while (pointer < end && IS_PLAIN_ASCII(*pointer)) {
+        pointer++;
+    }
+
+    return pointer - start;
+}
+
+static size_t yaml_quoted_span_scalar(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+
+    while (pointer < end && IS_QUOTED_ASCII(*pointer)) {
+        pointer++;
+    }
+
+    return pointer - start;
+}
+
+#if defined(MYYAML_SIMD_SSE2)
+
+/*
+ * The compares are signed: octets and code units with the high bit set are
+ * negative and fail `> 0x1F`.
+ */
+
+static size_t yaml_utf8_ascii_span_sse2(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+    const __m128i low = _mm_set1_epi8(0x1F);
+    const __m128i high = _mm_set1_epi8(0x7F);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+
+    while (end - pointer >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)pointer);
+        __m128i allowed = _mm_and_si128(_mm_cmpgt_epi8(chunk, low), _mm_cmplt_epi8(chunk, high));
+        unsigned int mask;
+
+        allowed = _mm_or_si128(allowed, _mm_cmpeq_epi8(chunk, tab));
+        allowed = _mm_or_si128(allowed, _mm_cmpeq_epi8(chunk, lf));
+        allowed = _mm_or_si128(allowed, _mm_cmpeq_epi8(chunk, cr));
+        mask = (unsigned int)_mm_movemask_epi8(allowed);
+
+        if (mask != 0xFFFFu) return (pointer - start) + yaml_count_trailing_zeros(~mask);
+        pointer += 16;
+    }
+
+    return (pointer - start) + yaml_utf8_ascii_span_scalar(pointer, end);
+}
+
+static size_t yaml_utf16_ascii_narrow_sse2(const unsigned char *input, size_t units, int big_endian, unsigned char *output) {
+    size_t done = 0;
+    const __m128i low = _mm_set1_epi16(0x1F);
+    const __m128i high = _mm_set1_epi16(0x7F);
+    const __m128i tab = _mm_set1_epi16('\t');
+    const __m128i lf = _mm_set1_epi16('\n');
+    const __m128i cr = _mm_set1_epi16('\r');
+
+    while (units - done >= 8) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(input + 2 * done));
+        __m128i allowed;
+        unsigned int mask;
+
+        if (big_endian) chunk = _mm_or_si128(_mm_slli_epi16(chunk, 8), _mm_srli_epi16(chunk, 8));
+
+        allowed = _mm_and_si128(_mm_cmpgt_epi16(chunk, low), _mm_cmplt_epi16(chunk, high));
+        allowed = _mm_or_si128(allowed, _mm_cmpeq_epi16(chunk, tab));
+        allowed = _mm_or_si128(allowed, _mm_cmpeq_epi16(chunk, lf));
+        allowed = _mm_or_si128(allowed, _mm_cmpeq_epi16(chunk, cr));
+        mask = (unsigned int)_mm_movemask_epi8(allowed);
+
+        _mm_storel_epi64((__m128i *)(output + done), _mm_packus_epi16(chunk, chunk));
+
+        if (mask != 0xFFFFu) return done + yaml_count_trailing_zeros(~mask) / 2;
+        done += 8;
+    }
+
+    return done + yaml_utf16_ascii_narrow_scalar(input + 2 * done, units - done, big_endian, output + done);
+}
+
+static size_t yaml_utf8_ascii_widen_sse2(const unsigned char *input, size_t size, int big_endian, unsigned char *output) {
+    size_t done = 0;
+    const __m128i zero = _mm_setzero_si128();
+
+    while (size - done >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(input + done));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(chunk);
+
+        if (big_endian) {
+            _mm_storeu_si128((__m128i *)(output + 2 * done), _mm_unpacklo_epi8(zero, chunk));
+            _mm_storeu_si128((__m128i *)(output + 2 * done + 16), _mm_unpackhi_epi8(zero, chunk));
+        } else {
+            _mm_storeu_si128((__m128i *)(output + 2 * done), _mm_unpacklo_epi8(chunk, zero));
+            _mm_storeu_si128((__m128i *)(output + 2 * done + 16), _mm_unpackhi_epi8(chunk, zero));
+        }
+
+        if (mask) return done + yaml_count_trailing_zeros(mask);
+        done += 16;
+    }
+
+    return done + yaml_utf8_ascii_widen_scalar(input + done, size - done, big_endian, output + 2 * done);
+}
+
+static size_t yaml_space_span_sse2(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+    const __m128i space = _mm_set1_epi8(' ');
+
+    while (end - pointer >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)pointer);
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, space));
+
+        if (mask != 0xFFFFu) return (pointer - start) + yaml_count_trailing_zeros(~mask);
+        pointer += 16;
+    }
+
+    return (pointer - start) + yaml_space_span_scalar(pointer, end);
+}
+
+static size_t yaml_text_span_sse2(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+    const __m128i low = _mm_set1_epi8(0x1F);
+    const __m128i high = _mm_set1_epi8(0x7F);
+    const __m128i tab = _mm_set1_epi8('\t');
+
+    while (end - pointer >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)pointer);
+        __m128i allowed = _mm_and_si128(_mm_cmpgt_epi8(chunk, low), _mm_cmplt_epi8(chunk, high));
+        unsigned int mask;
+
+        allowed = _mm_or_si128(allowed, _mm_cmpeq_epi8(chunk, tab));
+        mask = (unsigned int)_mm_movemask_epi8(allowed);
+
+        if (mask != 0xFFFFu) return (pointer - start) + yaml_count_trailing_zeros(~mask);
+        pointer += 16;
+    }
+
+    return (pointer - start) + yaml_text_span_scalar(pointer, end);
+}
+
+/*
+ * Setting the 0x20 bit folds '[' onto '{' and ']' onto '}' and leaves ':'
+ * and ',' as they are; the control characters it folds onto them are
+ * already rejected by the range check.
+ */
+
+static size_t yaml_plain_span_sse2(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+    const __m128i low = _mm_set1_epi8(0x20);
+    const __m128i high = _mm_set1_epi8(0x7F);
+    const __m128i fold = _mm_set1_epi8(0x20);
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+
+    while (end - pointer >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)pointer);
+        __m128i allowed = _mm_and_si128(_mm_cmpgt_epi8(chunk, low), _mm_cmplt_epi8(chunk, high));
+        __m128i folded = _mm_or_si128(chunk, fold);
+        __m128i indicator = _mm_or_si128(_mm_cmpeq_epi8(folded, colon), _mm_cmpeq_epi8(folded, comma));
+        unsigned int mask;
+
+        indicator = _mm_or_si128(indicator, _mm_cmpeq_epi8(folded, open));
+        indicator = _mm_or_si128(indicator, _mm_cmpeq_epi8(folded, close));
+        mask = (unsigned int)_mm_movemask_epi8(_mm_andnot_si128(indicator, allowed));
+
+        if (mask != 0xFFFFu) return (pointer - start) + yaml_count_trailing_zeros(~mask);
+        pointer += 16;
+    }
+
+    return (pointer - start) + yaml_plain_span_scalar(pointer, end);
+}
+
+static size_t yaml_quoted_span_sse2(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+    const __m128i low = _mm_set1_epi8(0x20);
+    const __m128i high = _mm_set1_epi8(0x7F);
+    const __m128i single = _mm_set1_epi8('\'');
+    const __m128i twin = _mm_set1_epi8('"');
+    const __m128i escape = _mm_set1_epi8('\\');
+
+    while (end - pointer >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)pointer);
+        __m128i allowed = _mm_and_si128(_mm_cmpgt_epi8(chunk, low), _mm_cmplt_epi8(chunk, high));
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, single), _mm_cmpeq_epi8(chunk, twin));
+        unsigned int mask;
+
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(chunk, escape));
+        mask = (unsigned int)_mm_movemask_epi8(_mm_andnot_si128(special, allowed));
+
+        if (mask != 0xFFFFu) return (pointer - start) + yaml_count_trailing_zeros(~mask);
+        pointer += 16;
+    }
+
+    return (pointer - start) + yaml_quoted_span_scalar(pointer, end);
+}
+
+#endif  // MYYAML_SIMD_SSE2
+
+#if defined(MYYAML_SIMD_AVX2)
+
+MYYAML_TARGET_AVX2 static size_t yaml_utf8_ascii_span_avx2(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+    const __m256i low = _mm256_set1_epi8(0x1F);
+    const __m256i high = _mm256_set1_epi8(0x7F);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+
+    while (end - pointer >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)pointer);
+        __m256i allowed = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, low), _mm256_cmpgt_epi8(high, chunk));
+        unsigned int mask;
+
+        allowed = _mm256_or_si256(allowed, _mm256_cmpeq_epi8(chunk, tab));
+        allowed = _mm256_or_si256(allowed, _mm256_cmpeq_epi8(chunk, lf));
+        allowed = _mm256_or_si256(allowed, _mm256_cmpeq_epi8(chunk, cr));
+        mask = (unsigned int)_mm256_movemask_epi8(allowed);
+
+        if (mask != 0xFFFFFFFFu) return (pointer - start) + yaml_count_trailing_zeros(~mask);
+        pointer += 32;
+    }
+
+    return (pointer - start) + yaml_utf8_ascii_span_sse2(pointer, end);
+}
+
+MYYAML_TARGET_AVX2 static size_t yaml_utf16_ascii_narrow_avx2(const unsigned char *input, size_t units, int big_endian, unsigned char *output) {
+    size_t done = 0;
+    const __m256i low = _mm256_set1_epi16(0x1F);
+    const __m256i high = _mm256_set1_epi16(0x7F);
+    const __m256i tab = _mm256_set1_epi16('\t');
+    const __m256i lf = _mm256_set1_epi16('\n');
+    const __m256i cr = _mm256_set1_epi16('\r');
+
+    while (units - done >= 16) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(input + 2 * done));
+        __m256i allowed;
+        unsigned int mask;
+
+        if (big_endian) chunk = _mm256_or_si256(_mm256_slli_epi16(chunk, 8), _mm256_srli_epi16(chunk, 8));
+
+        allowed = _mm256_and_si256(_mm256_cmpgt_epi16(chunk, low), _mm256_cmpgt_epi16(high, chunk));
+        allowed = _mm256_or_si256(allowed, _mm256_cmpeq_epi16(chunk, tab));
+        allowed = _mm256_or_si256(allowed, _mm256_cmpeq_epi16(chunk, lf));
+        allowed = _mm256_or_si256(allowed, _mm256_cmpeq_epi16(chunk, cr));
+        mask = (unsigned int)_mm256_movemask_epi8(allowed);
+
+        /* The pack works per 128-bit lane; gather the two halves. */
+
+        _mm_storeu_si128((__m128i *)(output + done),
+                         _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi16(chunk, chunk), 0xD8)));
+
+        if (mask != 0xFFFFFFFFu) return done + yaml_count_trailing_zeros(~mask) / 2;
+        done += 16;
+    }
+
+    return done + yaml_utf16_ascii_narrow_sse2(input + 2 * done, units - done, big_endian, output + done);
+}
+
+MYYAML_TARGET_AVX2 static size_t yaml_utf8_ascii_widen_avx2(const unsigned char *input, size_t size, int big_endian, unsigned char *output) {
+    size_t done = 0;
+
+    while (size - done >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(input + done));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(chunk);
+        __m256i first = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(chunk));
+        __m256i second = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(chunk, 1));
+
+        if (big_endian) {
+            first = _mm256_slli_epi16(first, 8);
+            second = _mm256_slli_epi16(second, 8);
+        }
+
+        _mm256_storeu_si256((__m256i *)(output + 2 * done), first);
+        _mm256_storeu_si256((__m256i *)(output + 2 * done + 32), second);
+
+        if (mask) return done + yaml_count_trailing_zeros(mask);
+        done += 32;
+    }
+
+    return done + yaml_utf8_ascii_widen_sse2(input + done, size - done, big_endian, output + 2 * done);
+}
+
+MYYAML_TARGET_AVX2 static size_t yaml_space_span_avx2(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+    const __m256i space = _mm256_set1_epi8(' ');
+
+    while (end - pointer >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)pointer);
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, space));
+
+        if (mask != 0xFFFFFFFFu) return (pointer - start) + yaml_count_trailing_zeros(~mask);
+        pointer += 32;
+    }
+
+    return (pointer - start) + yaml_space_span_sse2(pointer, end);
+}
+
+MYYAML_TARGET_AVX2 static size_t yaml_text_span_avx2(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+    const __m256i low = _mm256_set1_epi8(0x1F);
+    const __m256i high = _mm256_set1_epi8(0x7F);
+    const __m256i tab = _mm256_set1_epi8('\t');
+
+    while (end - pointer >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)pointer);
+        __m256i allowed = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, low), _mm256_cmpgt_epi8(high, chunk));
+        unsigned int mask;
+
+        allowed = _mm256_or_si256(allowed, _mm256_cmpeq_epi8(chunk, tab));
+        mask = (unsigned int)_mm256_movemask_epi8(allowed);
+
+        if (mask != 0xFFFFFFFFu) return (pointer - start) + yaml_count_trailing_zeros(~mask);
+        pointer += 32;
+    }
+
+    return (pointer - start) + yaml_text_span_sse2(pointer, end);
+}
+
+MYYAML_TARGET_AVX2 static size_t yaml_plain_span_avx2(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+    const __m256i low = _mm256_set1_epi8(0x20);
+    const __m256i high = _mm256_set1_epi8(0x7F);
+    const __m256i fold = _mm256_set1_epi8(0x20);
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+
+    while (end - pointer >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)pointer);
+        __m256i allowed = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, low), _mm256_cmpgt_epi8(high, chunk));
+        __m256i folded = _mm256_or_si256(chunk, fold);
+        __m256i indicator = _mm256_or_si256(_mm256_cmpeq_epi8(folded, colon), _mm256_cmpeq_epi8(folded, comma));
+        unsigned int mask;
+
+        indicator = _mm256_or_si256(indicator, _mm256_cmpeq_epi8(folded, open));
+        indicator = _mm256_or_si256(indicator, _mm256_cmpeq_epi8(folded, close));
+        mask = (unsigned int)_mm256_movemask_epi8(_mm256_andnot_si256(indicator, allowed));
+
+        if (mask != 0xFFFFFFFFu) return (pointer - start) + yaml_count_trailing_zeros(~mask);
+        pointer += 32;
+    }
+
+    return (pointer - start) + yaml_plain_span_sse2(pointer, end);
+}
+
+MYYAML_TARGET_AVX2 static size_t yaml_quoted_span_avx2(const unsigned char *start, const unsigned char *end) {
+    const unsigned char *pointer = start;
+    const __m256i low = _mm256_set1_epi8(0x20);
+    const __m256i high = _mm256_set1_epi8(0x7F);
+    const __m256i single = _mm256_set1_epi8('\'');
+    const __m256i twin = _mm256_set1_epi8('"');
+    const __m256i escape = _mm256_set1_epi8('\\');
+
+    while (end - pointer >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)pointer);
+        __m256i allowed = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, low), _mm256_cmpgt_epi8(high, chunk));
+        __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, single), _mm256_cmpeq_epi8(chunk, twin));
+        unsigned int mask;
+
+        special = _mm256_or_si256(special, _mm256_cmpeq_epi8(chunk, escape));
+        mask = (unsigned int)_mm256_movemask_epi8(_mm256_andnot_si256(special, allowed));
+
+        if (mask != 0xFFFFFFFFu) return (pointer - start) + yaml_count_trailing_zeros(~mask);
+        pointer += 32;
+    }
+
+    return (pointer - start) + yaml_quoted_span_sse2(pointer, end);
+}
+
+#endif  // MYYAML_SIMD_AVX2
+
+static const YamlKernels_t yaml_scalar_kernels = {
+    yaml_utf8_ascii_span_scalar,
+    yaml_utf16_ascii_narrow_scalar,
+    yaml_utf8_ascii_widen_scalar,
+    yaml_space_span_scalar,
+    yaml_text_span_scalar,
+    yaml_plain_span_scalar,
+    yaml_quoted_span_scalar,
+};
+
+#if defined(MYYAML_SIMD_SSE2)
+static const YamlKernels_t yaml_sse2_kernels = {
+    yaml_utf8_ascii_span_sse2,
+    yaml_utf16_ascii_narrow_sse2,
+    yaml_utf8_ascii_widen_sse2,
+    yaml_space_span_sse2,
+    yaml_text_span_sse2,
+    yaml_plain_span_sse2,
+    yaml_quoted_span_sse2,
+};
+#endif
+
+#if defined(MYYAML_SIMD_AVX2)
+static const YamlKernels_t yaml_avx2_kernels = {
+    yaml_utf8_ascii_span_avx2,
+    yaml_utf16_ascii_narrow_avx2,
+    yaml_utf8_ascii_widen_avx2,
+    yaml_space_span_avx2,
+    yaml_text_span_avx2,
+    yaml_plain_span_avx2,
+    yaml_quoted_span_avx2,
+};
+#endif
+
+static const YamlKernels_t *yaml_kernels = NULL;
+
+/*
+ * Check if the CPU and the operating system support AVX2.
+ */
+
+static int yaml_cpu_has_avx2(void) {
+#if defined(MYYAML_SIMD_AVX2) && defined(__AVX2__)
+    return 1;
+#elif defined(MYYAML_SIMD_AVX2) && MYYAML_COMPILER_IS(MSVC)
+    int info[4];
+
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return 0; /* OSXSAVE, AVX */
+    if ((_xgetbv(0) & 0x6) != 0x6) return 0;                                 /* XMM and YMM state */
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(MYYAML_SIMD_AVX2)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return 0;
+#endif
+}
+
+static const YamlKernels_t *yaml_get_kernels(void) {
+    /* Racing first calls store the same table. */
+
+    if (!yaml_kernels) {
+#if defined(MYYAML_SIMD_AVX2)
+        if (yaml_cpu_has_avx2()) {
+            yaml_kernels = &yaml_avx2_kernels;
+            return yaml_kernels;
+        }
+#endif
+#if defined(MYYAML_SIMD_SSE2)
+        yaml_kernels = &yaml_sse2_kernels;
+#else
+        yaml_kernels = &yaml_scalar_kernels;
+#endif
+    }
+
+    return yaml_kernels;
+}
+
+#if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
+
+#pragma region Scanner
+
+/*
+ * Introduction
+ * ************
+ *
+ * The following notes assume that you are familiar with the YAML specification
+ * (http://yaml.org/spec/cvs/current.html).  We mostly follow it, although in
+ * some cases we are less restrictive that it requires.
+ *
+ * The process of transforming a YAML stream into a sequence of events is
+ * divided on two steps: Scanning and Parsing.
+ *
+ * The Scanner transforms the input stream into a sequence of tokens, while the
+ * parser transform the sequence of tokens produced by the Scanner into a
+ * sequence of parsing events.
+ *
+ * The Scanner is rather clever and complicated. The Parser, on the contrary,
+ * is a straightforward implementation of a recursive-descendant parser (or,
+ * LL(1) parser, as it is usually called).
+ *
+ * Actually there are two issues of Scanning that might be called "clever", the
+ * rest is quite straightforward.  The issues are "block collection start" and
+ * "simple keys".  Both issues are explained below in details.
+ *
+ * Here the Scanning step is explained and implemented.  We start with the list
+ * of all the tokens produced by the Scanner together with short descriptions.
+ *
+ * Now, tokens:
+ *
+ *      STREAM-START(encoding)          # The stream start.
+ *      STREAM-END                      # The stream end.
+ *      VERSION-DIRECTIVE(major,minor)  # The '%YAML' directive.
+ *      TAG-DIRECTIVE(handle,prefix)    # The '%TAG' directive.
+ *      DOCUMENT-START                  # '---'
+ *      DOCUMENT-END                    # '...'
+ *      BLOCK-SEQUENCE-START            # Indentation increase denoting a block
+ *      BLOCK-MAPPING-START             # sequence or a block mapping.
+ *      BLOCK-END                       # Indentation decrease.
+ *      FLOW-SEQUENCE-START             # '['
+ *      FLOW-SEQUENCE-END               # ']'
+ *      FLOW-MAPPING-START              # '{'
+ *      FLOW-MAPPING-END                # '}'
+ *      BLOCK-ENTRY                     # '-'
+ *      FLOW-ENTRY                      # ','
+ *      KEY                             # '?' or nothing (simple keys).
+ *      VALUE                           # ':'
+ *      ALIAS(anchor)                   # '*anchor'
+ *      ANCHOR(anchor)                  # '&anchor'
+ *      TAG(handle,suffix)              # '!handle!suffix'
+ *      SCALAR(value,style)             # A scalar.
+ *
+ * The following two tokens are "virtual" tokens denoting the beginning and the
+ * end of the stream:
+ *
+ *      STREAM-START(encoding)
+ *      STREAM-END
+ *
+ * We pass the information about the input stream encoding with the
+ * STREAM-START token.
+ *
+ * The next two tokens are responsible for tags:
+ *
+ *      VERSION-DIRECTIVE(major,minor)
+ *      TAG-DIRECTIVE(handle,prefix)
+ *
+ * Example:
+ *
+ *      %YAML   1.1
+ *      %TAG    !   !foo
+ *      %TAG    !yaml!  tag:yaml.org,2002:
  *      ---
  *
  * The corresponding sequence of tokens:
@@ -1958,22 +3562,21 @@ MYYAML_API int yaml_parser_fetch_more_tokens(YamlParser *parser) {
          */
         need_more_tokens = 0;
 
-        if (parser->tokens.head == parser->tokens.tail) {
+        if (QUEUE_EMPTY(parser, parser->tokens)) {
             /* Queue is empty. */
             need_more_tokens = 1;
         } else {
             YamlSimpleKey *simple_key;
 
             /* Check if any potential simple key may occupy the head position.
+             * The lowest possible key has the lowest token number.
              */
 
             if (!yaml_parser_stale_simple_keys(parser)) return MYYAML_FAILURE;
 
-            for (simple_key = parser->simple_keys.start; simple_key != parser->simple_keys.top; simple_key++) {
-                if (simple_key->possible && simple_key->token_number == parser->tokens_parsed) {
-                    need_more_tokens = 1;
-                    break;
-                }
+            simple_key = parser->simple_keys.start + parser->simple_keys_first;
+            if (simple_key != parser->simple_keys.top && simple_key->token_number == parser->tokens_parsed) {
+                need_more_tokens = 1;
             }
         }
 
@@ -1983,7 +3586,7 @@ MYYAML_API int yaml_parser_fetch_more_tokens(YamlParser *parser) {
 
         /* Fetch the next token. */
 
-        if (!yaml_parser_fetch_next_token(parser)) return MYYAML_FAILURE;
+        if (!yaml_parser_fetch_fed_token(parser)) return MYYAML_FAILURE;
     }
 
     parser->token_available = 1;
@@ -1991,6 +3594,16 @@ MYYAML_API int yaml_parser_fetch_more_tokens(YamlParser *parser) {
     return MYYAML_SUCCESS;
 }
 
+/*
+ * The data of the queued tokens comes from the allocator of the parser; the
+ * tokens learn it on their way out in yaml_parser_scan().
+ */
+
+static void yaml_parser_delete_token(YamlParser *parser, YamlToken *token) {
+    token->allocator = parser->allocator;
+    yaml_token_delete(token);
+}
+
 /*
  * The dispatcher for token fetchers.
  */
@@ -2043,6 +3656,14 @@ static int yaml_parser_fetch_next_token(YamlParser *parser) {
         IS_BLANKZ_AT(parser->buffer, 3))
         return yaml_parser_fetch_document_indicator(parser, YAML_DOCUMENT_END_TOKEN);
 
+    /*
+     * Most tokens are plain scalars starting with a character that is
+     * neither an indicator nor a blank; skip the checks below for them.
+     */
+
+    if (!(CLASS(parser->buffer) & (YAML_CLASS_INDICATOR | YAML_CLASS_SPACE | YAML_CLASS_TAB | YAML_CLASS_BREAK | YAML_CLASS_BREAK_LEAD)))
+        return yaml_parser_fetch_plain_scalar(parser);
+
     /* Is it the flow sequence start indicator? */
 
     if (CHECK(parser->buffer, '[')) return yaml_parser_fetch_flow_collection_start(parser, YAML_FLOW_SEQUENCE_START_TOKEN);
@@ -2122,11 +3743,7 @@ static int yaml_parser_fetch_next_token(YamlParser *parser) {
      * The last rule is more restrictive than the specification requires.
      */
 
-    if (!(IS_BLANKZ(parser->buffer) || CHECK(parser->buffer, '-') || CHECK(parser->buffer, '?') || CHECK(parser->buffer, ':') ||
-          CHECK(parser->buffer, ',') || CHECK(parser->buffer, '[') || CHECK(parser->buffer, ']') || CHECK(parser->buffer, '{') ||
-          CHECK(parser->buffer, '}') || CHECK(parser->buffer, '#') || CHECK(parser->buffer, '&') || CHECK(parser->buffer, '*') ||
-          CHECK(parser->buffer, '!') || CHECK(parser->buffer, '|') || CHECK(parser->buffer, '>') || CHECK(parser->buffer, '\'') ||
-          CHECK(parser->buffer, '"') || CHECK(parser->buffer, '%') || CHECK(parser->buffer, '@') || CHECK(parser->buffer, '`')) ||
+    if (!(IS_BLANKZ(parser->buffer) || IS_INDICATOR(parser->buffer)) ||
         (CHECK(parser->buffer, '-') && !IS_BLANK_AT(parser->buffer, 1)) ||
         (!parser->flow_level && (CHECK(parser->buffer, '?') || CHECK(parser->buffer, ':')) && !IS_BLANKZ_AT(parser->buffer, 1)))
         return yaml_parser_fetch_plain_scalar(parser);
@@ -2139,34 +3756,208 @@ static int yaml_parser_fetch_next_token(YamlParser *parser) {
 }
 
 /*
- * Check the list of potential simple keys and remove the positions that
- * cannot contain simple keys anymore.
+ * Fetch the next token.  With fed input, the scanner state is saved first and
+ * restored if the input runs out before the token is complete, so that the
+ * token is scanned again from its beginning once more input has been fed.
  */
 
-static int yaml_parser_stale_simple_keys(YamlParser *parser) {
-    YamlSimpleKey *simple_key;
+static int yaml_parser_fetch_fed_token(YamlParser *parser) {
+    if (!FEEDING(parser)) return yaml_parser_fetch_next_token(parser);
 
-    /* Check for a potential simple key for each flow level. */
+    if (!yaml_parser_save_checkpoint(parser)) return MYYAML_FAILURE;
 
-    for (simple_key = parser->simple_keys.start; simple_key != parser->simple_keys.top; simple_key++) {
-        /*
-         * The specification requires that a simple key
-         *
-         *  - is limited to a single line,
-         *  - is shorter than 1024 characters.
-         */
+    parser->feed.starved = 0;
 
-        if (simple_key->possible && (simple_key->mark.line < parser->mark.line || simple_key->mark.index + 1024 < parser->mark.index)) {
-            /* Check if the potential simple key to be removed is required. */
+    if (yaml_parser_fetch_next_token(parser)) return MYYAML_SUCCESS;
 
-            if (simple_key->required) {
-                return yaml_parser_set_scanner_error(parser, "while scanning a simple key", simple_key->mark, "could not find expected ':'");
-            }
+    if (parser->feed.starved) yaml_parser_restore_checkpoint(parser);
 
-            simple_key->possible = 0;
-        }
+    return MYYAML_FAILURE;
+}
+
+/*
+ * Ensure that the tokens queue holds every token the Parser may look at while
+ * producing the next event, so that the Parser never runs out of fed input in
+ * the middle of a state transition.
+ *
+ * The Parser consumes the head token, then any run of the indicator, property
+ * and directive tokens below, and peeks at most one token past them.
+ */
+
+static int yaml_parser_fetch_lookahead(YamlParser *parser) {
+    while (1) {
+        YamlSimpleKey *simple_key;
+        YamlToken *token;
+        size_t index;
+        int need_more_tokens = 1;
+
+        /* Find the last token the Parser may look at. */
+
+        for (index = 1; index < QUEUE_LENGTH(parser, parser->tokens); index++) {
+            token = &QUEUE_AT(parser, parser->tokens, index);
+
+            if (token->type != YAML_VERSION_DIRECTIVE_TOKEN && token->type != YAML_TAG_DIRECTIVE_TOKEN &&
+                token->type != YAML_DOCUMENT_END_TOKEN && token->type != YAML_ANCHOR_TOKEN && token->type != YAML_TAG_TOKEN &&
+                token->type != YAML_KEY_TOKEN && token->type != YAML_VALUE_TOKEN && token->type != YAML_BLOCK_ENTRY_TOKEN &&
+                token->type != YAML_FLOW_ENTRY_TOKEN) {
+                need_more_tokens = 0;
+                break;
+            }
+        }
+
+        if (!QUEUE_EMPTY(parser, parser->tokens) && QUEUE_SLOT(parser, parser->tokens, parser->tokens.tail - 1).type == YAML_STREAM_END_TOKEN) {
+            need_more_tokens = 0;
+        }
+
+        /* A potential simple key may still insert tokens before it. */
+
+        if (!need_more_tokens) {
+            size_t number = parser->tokens_parsed + index;
+
+            if (!yaml_parser_stale_simple_keys(parser)) return MYYAML_FAILURE;
+
+            simple_key = parser->simple_keys.start + parser->simple_keys_first;
+            if (simple_key != parser->simple_keys.top && simple_key->token_number <= number) {
+                need_more_tokens = 1;
+            }
+        }
+
+        if (!need_more_tokens) break;
+
+        if (!yaml_parser_fetch_fed_token(parser)) return MYYAML_FAILURE;
+    }
+
+    parser->token_available = 1;
+
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Save the scanner state before fetching a token from fed input.
+ */
+
+static int yaml_parser_save_checkpoint(YamlParser *parser) {
+    if (!parser->checkpoint.indents.start) {
+        if (!STACK_INIT(parser, parser->checkpoint.indents, int *)) return MYYAML_FAILURE;
+        if (!STACK_INIT(parser, parser->checkpoint.simple_keys, YamlSimpleKey *)) return MYYAML_FAILURE;
+    }
+
+    if (!yaml_stack_copy(parser->allocator, (void **)&parser->checkpoint.indents.start, (void **)&parser->checkpoint.indents.top,
+                         (void **)&parser->checkpoint.indents.end, parser->indents.start, parser->indents.top) ||
+        !yaml_stack_copy(parser->allocator, (void **)&parser->checkpoint.simple_keys.start, (void **)&parser->checkpoint.simple_keys.top,
+                         (void **)&parser->checkpoint.simple_keys.end, parser->simple_keys.start, parser->simple_keys.top)) {
+        parser->error = YAML_MEMORY_ERROR;
+        return MYYAML_FAILURE;
+    }
+
+    parser->checkpoint.offset = yaml_parser_input_position(parser);
+    parser->checkpoint.mark = parser->mark;
+    parser->checkpoint.encoding = parser->encoding;
+    parser->checkpoint.tokens = QUEUE_LENGTH(parser, parser->tokens);
+    parser->checkpoint.stream_start_produced = parser->stream_start_produced;
+    parser->checkpoint.stream_end_produced = parser->stream_end_produced;
+    parser->checkpoint.flow_level = parser->flow_level;
+    parser->checkpoint.simple_keys_first = parser->simple_keys_first;
+    parser->checkpoint.simple_key_allowed = parser->simple_key_allowed;
+    parser->checkpoint.indent = parser->indent;
+
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Roll the scanner back to the saved state.  The tokens fetched since are
+ * dropped and the input is read again from the saved position.
+ *
+ * Tokens are only ever inserted into the middle of the queue by
+ * yaml_parser_fetch_value(), which cannot run out of input after doing so;
+ * every other token fetched since the checkpoint is at the tail.
+ */
+
+static void yaml_parser_restore_checkpoint(YamlParser *parser) {
+    while (QUEUE_LENGTH(parser, parser->tokens) > parser->checkpoint.tokens) {
+        yaml_parser_delete_token(parser, &QUEUE_SLOT(parser, parser->tokens, --parser->tokens.tail));
+    }
+
+    memcpy(parser->indents.start, parser->checkpoint.indents.start,
+           (parser->checkpoint.indents.top - parser->checkpoint.indents.start) * sizeof(*parser->indents.start));
+    parser->indents.top = parser->indents.start + (parser->checkpoint.indents.top - parser->checkpoint.indents.start);
+    memcpy(parser->simple_keys.start, parser->checkpoint.simple_keys.start,
+           (parser->checkpoint.simple_keys.top - parser->checkpoint.simple_keys.start) * sizeof(*parser->simple_keys.start));
+    parser->simple_keys.top = parser->simple_keys.start + (parser->checkpoint.simple_keys.top - parser->checkpoint.simple_keys.start);
+    parser->simple_keys_first = parser->checkpoint.simple_keys_first;
+
+    parser->stream_start_produced = parser->checkpoint.stream_start_produced;
+    parser->stream_end_produced = parser->checkpoint.stream_end_produced;
+    parser->flow_level = parser->checkpoint.flow_level;
+    parser->simple_key_allowed = parser->checkpoint.simple_key_allowed;
+    parser->indent = parser->checkpoint.indent;
+    parser->mark = parser->checkpoint.mark;
+
+    /* Forget the decoded input and read it again from the token start. */
+
+    parser->encoding = parser->checkpoint.encoding;
+    parser->offset = parser->checkpoint.offset;
+    parser->feed.pointer = parser->feed.start + (parser->checkpoint.offset - parser->feed.offset);
+    parser->raw_buffer.pointer = parser->raw_buffer.last = parser->raw_buffer.start;
+    parser->buffer.pointer = parser->buffer.last = parser->buffer.start;
+    parser->unread = 0;
+}
+
+/*
+ * Copy the content of a stack into another one, growing it if needed.
+ */
+
+static int yaml_stack_copy(const YamlAllocator *allocator, void **start, void **top, void **end, const void *from_start, const void *from_top) {
+    size_t size = (const char *)from_top - (const char *)from_start;
+
+    while ((size_t)((char *)*end - (char *)*start) < size) {
+        if (!_myyaml_stack_extend(allocator, start, top, end)) return MYYAML_FAILURE;
+    }
+
+    if (size) memcpy(*start, from_start, size);
+    *top = (char *)*start + size;
+
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Check the list of potential simple keys and remove the positions that
+ * cannot contain simple keys anymore.
+ *
+ * A simple key is only ever saved at the top of the stack, when no deeper
+ * flow level exists, so the possible keys are in the order of their marks
+ * and token numbers.  Once a possible key is still valid, so are all the
+ * keys above it: the check starts from the lowest key that may still be
+ * possible and stops there.
+ */
+
+static int yaml_parser_stale_simple_keys(YamlParser *parser) {
+    YamlSimpleKey *simple_key;
+
+    for (simple_key = parser->simple_keys.start + parser->simple_keys_first; simple_key != parser->simple_keys.top; simple_key++) {
+        if (!simple_key->possible) continue;
+
+        /*
+         * The specification requires that a simple key
+         *
+         *  - is limited to a single line,
+         *  - is shorter than 1024 characters.
+         */
+
+        if (simple_key->mark.line >= parser->mark.line && simple_key->mark.index + 1024 >= parser->mark.index) break;
+
+        /* Check if the potential simple key to be removed is required. */
+
+        if (simple_key->required) {
+            return yaml_parser_set_scanner_error(parser, "while scanning a simple key", simple_key->mark, "could not find expected ':'");
+        }
+
+        simple_key->possible = 0;
+        PROFILE_COUNT(parser, simple_keys_removed);
     }
 
+    parser->simple_keys_first = simple_key - parser->simple_keys.start;
+
     return MYYAML_SUCCESS;
 }
 
@@ -2192,12 +3983,16 @@ static int yaml_parser_save_simple_key(YamlParser *parser) {
         YamlSimpleKey simple_key;
         simple_key.possible = 1;
         simple_key.required = required;
-        simple_key.token_number = parser->tokens_parsed + (parser->tokens.tail - parser->tokens.head);
+        simple_key.token_number = parser->tokens_parsed + QUEUE_LENGTH(parser, parser->tokens);
         simple_key.mark = parser->mark;
 
         if (!yaml_parser_remove_simple_key(parser)) return MYYAML_FAILURE;
 
         *(parser->simple_keys.top - 1) = simple_key;
+        if (parser->simple_keys_first >= (size_t)(parser->simple_keys.top - parser->simple_keys.start)) {
+            parser->simple_keys_first = parser->simple_keys.top - parser->simple_keys.start - 1;
+        }
+        PROFILE_COUNT(parser, simple_keys_saved);
     }
 
     return MYYAML_SUCCESS;
@@ -2216,6 +4011,8 @@ static int yaml_parser_remove_simple_key(YamlParser *parser) {
         if (simple_key->required) {
             return yaml_parser_set_scanner_error(parser, "while scanning a simple key", simple_key->mark, "could not find expected ':'");
         }
+
+        PROFILE_COUNT(parser, simple_keys_removed);
     }
 
     /* Remove the key from the stack. */
@@ -2255,7 +4052,10 @@ static int yaml_parser_increase_flow_level(YamlParser *parser) {
 static int yaml_parser_decrease_flow_level(YamlParser *parser) {
     if (parser->flow_level) {
         parser->flow_level--;
-        (void)POP(parser, parser->simple_keys);
+        if (POP(parser, parser->simple_keys).possible) PROFILE_COUNT(parser, simple_keys_removed);
+        if (parser->simple_keys_first > (size_t)(parser->simple_keys.top - parser->simple_keys.start)) {
+            parser->simple_keys_first = parser->simple_keys.top - parser->simple_keys.start;
+        }
     }
 
     return MYYAML_SUCCESS;
@@ -2424,7 +4224,7 @@ static int yaml_parser_fetch_directive(YamlParser *parser) {
     /* Append the token to the queue. */
 
     if (!ENQUEUE(parser, parser->tokens, token)) {
-        yaml_token_delete(&token);
+        yaml_parser_delete_token(parser, &token);
         return MYYAML_FAILURE;
     }
 
@@ -2758,7 +4558,7 @@ static int yaml_parser_fetch_anchor(YamlParser *parser, YamlTokenType type) {
     if (!yaml_parser_scan_anchor(parser, &token, type)) return MYYAML_FAILURE;
 
     if (!ENQUEUE(parser, parser->tokens, token)) {
-        yaml_token_delete(&token);
+        yaml_parser_delete_token(parser, &token);
         return MYYAML_FAILURE;
     }
     return MYYAML_SUCCESS;
@@ -2784,7 +4584,7 @@ static int yaml_parser_fetch_tag(YamlParser *parser) {
     if (!yaml_parser_scan_tag(parser, &token)) return MYYAML_FAILURE;
 
     if (!ENQUEUE(parser, parser->tokens, token)) {
-        yaml_token_delete(&token);
+        yaml_parser_delete_token(parser, &token);
         return MYYAML_FAILURE;
     }
 
@@ -2811,7 +4611,7 @@ static int yaml_parser_fetch_block_scalar(YamlParser *parser, int literal) {
     if (!yaml_parser_scan_block_scalar(parser, &token, literal)) return MYYAML_FAILURE;
 
     if (!ENQUEUE(parser, parser->tokens, token)) {
-        yaml_token_delete(&token);
+        yaml_parser_delete_token(parser, &token);
         return MYYAML_FAILURE;
     }
 
@@ -2838,7 +4638,7 @@ static int yaml_parser_fetch_flow_scalar(YamlParser *parser, int single) {
     if (!yaml_parser_scan_flow_scalar(parser, &token, single)) return MYYAML_FAILURE;
 
     if (!ENQUEUE(parser, parser->tokens, token)) {
-        yaml_token_delete(&token);
+        yaml_parser_delete_token(parser, &token);
         return MYYAML_FAILURE;
     }
 
@@ -2865,7 +4665,7 @@ static int yaml_parser_fetch_plain_scalar(YamlParser *parser) {
     if (!yaml_parser_scan_plain_scalar(parser, &token)) return MYYAML_FAILURE;
 
     if (!ENQUEUE(parser, parser->tokens, token)) {
-        yaml_token_delete(&token);
+        yaml_parser_delete_token(parser, &token);
         return MYYAML_FAILURE;
     }
 
@@ -2877,6 +4677,8 @@ static int yaml_parser_fetch_plain_scalar(YamlParser *parser) {
  */
 
 static int yaml_parser_scan_to_next_token(YamlParser *parser) {
+    size_t length;
+
     /* Until the next token is not found. */
 
     while (1) {
@@ -2899,7 +4701,12 @@ static int yaml_parser_scan_to_next_token(YamlParser *parser) {
         if (!CACHE(parser, 1)) return MYYAML_FAILURE;
 
         while (CHECK(parser->buffer, ' ') || ((parser->flow_level || !parser->simple_key_allowed) && CHECK(parser->buffer, '\t'))) {
-            SKIP(parser);
+            length = yaml_get_kernels()->space_span(parser->buffer.pointer, parser->buffer.last);
+            if (length) {
+                SKIP_RUN(parser, length);
+            } else {
+                SKIP(parser);
+            }
             if (!CACHE(parser, 1)) return MYYAML_FAILURE;
         }
 
@@ -2907,7 +4714,12 @@ static int yaml_parser_scan_to_next_token(YamlParser *parser) {
 
         if (CHECK(parser->buffer, '#')) {
             while (!IS_BREAKZ(parser->buffer)) {
-                SKIP(parser);
+                length = yaml_get_kernels()->text_span(parser->buffer.pointer, parser->buffer.last);
+                if (length) {
+                    SKIP_RUN(parser, length);
+                } else {
+                    SKIP(parser);
+                }
                 if (!CACHE(parser, 1)) return MYYAML_FAILURE;
             }
         }
@@ -3024,14 +4836,14 @@ int yaml_parser_scan_directive(YamlParser *parser, YamlToken *token) {
         SKIP_LINE(parser);
     }
 
-    _myyaml_free(name);
+    _myyaml_free(parser->allocator, name);
 
     return MYYAML_SUCCESS;
 
 error:
-    _myyaml_free(prefix);
-    _myyaml_free(handle);
-    _myyaml_free(name);
+    _myyaml_free(parser->allocator, prefix);
+    _myyaml_free(parser->allocator, handle);
+    _myyaml_free(parser->allocator, name);
     return MYYAML_FAILURE;
 }
 
@@ -3224,8 +5036,8 @@ static int yaml_parser_scan_tag_directive_value(YamlParser *parser, YamlMark sta
     return MYYAML_SUCCESS;
 
 error:
-    _myyaml_free(handle_value);
-    _myyaml_free(prefix_value);
+    _myyaml_free(parser->allocator, handle_value);
+    _myyaml_free(parser->allocator, prefix_value);
     return MYYAML_FAILURE;
 }
 
@@ -3302,7 +5114,7 @@ static int yaml_parser_scan_tag(YamlParser *parser, YamlToken *token) {
     if (CHECK_AT(parser->buffer, '<', 1)) {
         /* Set the handle to '' */
 
-        handle = YAML_MALLOC(1);
+        handle = YAML_MALLOC(parser->allocator, 1);
         if (!handle) goto error;
         handle[0] = '\0';
 
@@ -3343,8 +5155,8 @@ static int yaml_parser_scan_tag(YamlParser *parser, YamlToken *token) {
 
             /* Set the handle to '!'. */
 
-            _myyaml_free(handle);
-            handle = YAML_MALLOC(2);
+            _myyaml_free(parser->allocator, handle);
+            handle = YAML_MALLOC(parser->allocator, 2);
             if (!handle) goto error;
             handle[0] = '!';
             handle[1] = '\0';
@@ -3382,8 +5194,8 @@ static int yaml_parser_scan_tag(YamlParser *parser, YamlToken *token) {
     return MYYAML_SUCCESS;
 
 error:
-    _myyaml_free(handle);
-    _myyaml_free(suffix);
+    _myyaml_free(parser->allocator, handle);
+    _myyaml_free(parser->allocator, suffix);
     return MYYAML_FAILURE;
 }
 
@@ -3458,7 +5270,7 @@ static int yaml_parser_scan_tag_uri(YamlParser *parser, int uri_char, int direct
     /* Resize the string to include the head. */
 
     while ((size_t)(string.end - string.start) <= length) {
-        if (!_myyaml_string_extend(&string.start, &string.pointer, &string.end)) {
+        if (!_myyaml_string_extend(parser->allocator, &string.start, &string.pointer, &string.end)) {
             parser->error = YAML_MEMORY_ERROR;
             goto error;
         }
@@ -3490,12 +5302,7 @@ static int yaml_parser_scan_tag_uri(YamlParser *parser, int uri_char, int direct
      *      ',', '[', ']'
      */
 
-    while (IS_ALPHA(parser->buffer) || CHECK(parser->buffer, ';') || CHECK(parser->buffer, '/') || CHECK(parser->buffer, '?') ||
-           CHECK(parser->buffer, ':') || CHECK(parser->buffer, '@') || CHECK(parser->buffer, '&') || CHECK(parser->buffer, '=') ||
-           CHECK(parser->buffer, '+') || CHECK(parser->buffer, '$') || CHECK(parser->buffer, '.') || CHECK(parser->buffer, '%') ||
-           CHECK(parser->buffer, '!') || CHECK(parser->buffer, '~') || CHECK(parser->buffer, '*') || CHECK(parser->buffer, '\'') ||
-           CHECK(parser->buffer, '(') || CHECK(parser->buffer, ')') ||
-           (uri_char && (CHECK(parser->buffer, ',') || CHECK(parser->buffer, '[') || CHECK(parser->buffer, ']')))) {
+    while (IS_URI(parser->buffer) || (uri_char && (CHECK(parser->buffer, ',') || CHECK(parser->buffer, '[') || CHECK(parser->buffer, ']')))) {
         /* Check if it is a URI-escape sequence. */
 
         if (CHECK(parser->buffer, '%')) {
@@ -3595,15 +5402,16 @@ static int yaml_parser_scan_block_scalar(YamlParser *parser, YamlToken *token, i
     YamlString_t string = MYYAML_STRING_NULL;
     YamlString_t leading_break = MYYAML_STRING_NULL;
     YamlString_t trailing_breaks = MYYAML_STRING_NULL;
+    size_t length;
     int chomping = 0;
     int increment = 0;
     int indent = 0;
     int leading_blank = 0;
     int trailing_blank = 0;
 
-    if (!STRING_INIT(parser, string, MYYAML_INITIAL_STRING_SIZE)) goto error;
-    if (!STRING_INIT(parser, leading_break, MYYAML_INITIAL_STRING_SIZE)) goto error;
-    if (!STRING_INIT(parser, trailing_breaks, MYYAML_INITIAL_STRING_SIZE)) goto error;
+    if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_VALUE, &string)) goto error;
+    if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_LEADING_BREAK, &leading_break)) goto error;
+    if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_TRAILING_BREAKS, &trailing_breaks)) goto error;
 
     /* Eat the indicator '|' or '>'. */
 
@@ -3747,10 +5555,12 @@ static int yaml_parser_scan_block_scalar(YamlParser *parser, YamlToken *token, i
 
         leading_blank = IS_BLANK(parser->buffer);
 
-        /* Consume the current line. */
+        /* Consume the current line, a run of ASCII text at a time. */
 
         while (!IS_BREAKZ(parser->buffer)) {
             if (!READ(parser, string)) goto error;
+            length = yaml_get_kernels()->text_span(parser->buffer.pointer, parser->buffer.last);
+            if (length && !READ_RUN(parser, string, length)) goto error;
             if (!CACHE(parser, 1)) goto error;
         }
 
@@ -3778,9 +5588,10 @@ static int yaml_parser_scan_block_scalar(YamlParser *parser, YamlToken *token, i
 
     SCALAR_TOKEN_INIT(*token, string.start, string.pointer - string.start, literal ? YAML_LITERAL_SCALAR_STYLE : YAML_FOLDED_SCALAR_STYLE, start_mark,
                       end_mark);
+    if (!yaml_parser_borrow_value(parser, token, &string)) goto error;
 
-    STRING_DEL(parser, leading_break);
-    STRING_DEL(parser, trailing_breaks);
+    yaml_parser_keep_scratch(parser, YAML_SCRATCH_LEADING_BREAK, &leading_break);
+    yaml_parser_keep_scratch(parser, YAML_SCRATCH_TRAILING_BREAKS, &trailing_breaks);
 
     return MYYAML_SUCCESS;
 
@@ -3858,10 +5669,10 @@ static int yaml_parser_scan_flow_scalar(YamlParser *parser, YamlToken *token, in
     YamlString_t whitespaces = MYYAML_STRING_NULL;
     int leading_blanks;
 
-    if (!STRING_INIT(parser, string, MYYAML_INITIAL_STRING_SIZE)) goto error;
-    if (!STRING_INIT(parser, leading_break, MYYAML_INITIAL_STRING_SIZE)) goto error;
-    if (!STRING_INIT(parser, trailing_breaks, MYYAML_INITIAL_STRING_SIZE)) goto error;
-    if (!STRING_INIT(parser, whitespaces, MYYAML_INITIAL_STRING_SIZE)) goto error;
+    if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_VALUE, &string)) goto error;
+    if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_LEADING_BREAK, &leading_break)) goto error;
+    if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_TRAILING_BREAKS, &trailing_breaks)) goto error;
+    if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_WHITESPACES, &whitespaces)) goto error;
 
     /* Eat the left quote. */
 
@@ -4082,9 +5893,17 @@ static int yaml_parser_scan_flow_scalar(YamlParser *parser, YamlToken *token, in
             }
 
             else {
-                /* It is a non-escaped non-blank character. */
+                /*
+                 * It is a non-escaped non-blank character.  Copy it with the
+                 * run of characters after it that are neither quotes,
+                 * escapes nor blanks.
+                 */
+
+                size_t length;
 
                 if (!READ(parser, string)) goto error;
+                length = yaml_get_kernels()->quoted_span(parser->buffer.pointer, parser->buffer.last);
+                if (length && !READ_RUN(parser, string, length)) goto error;
             }
 
             if (!CACHE(parser, 2)) goto error;
@@ -4164,10 +5983,11 @@ static int yaml_parser_scan_flow_scalar(YamlParser *parser, YamlToken *token, in
 
     SCALAR_TOKEN_INIT(*token, string.start, string.pointer - string.start, single ? YAML_SINGLE_QUOTED_SCALAR_STYLE : YAML_DOUBLE_QUOTED_SCALAR_STYLE,
                       start_mark, end_mark);
+    if (!yaml_parser_borrow_value(parser, token, &string)) goto error;
 
-    STRING_DEL(parser, leading_break);
-    STRING_DEL(parser, trailing_breaks);
-    STRING_DEL(parser, whitespaces);
+    yaml_parser_keep_scratch(parser, YAML_SCRATCH_LEADING_BREAK, &leading_break);
+    yaml_parser_keep_scratch(parser, YAML_SCRATCH_TRAILING_BREAKS, &trailing_breaks);
+    yaml_parser_keep_scratch(parser, YAML_SCRATCH_WHITESPACES, &whitespaces);
 
     return MYYAML_SUCCESS;
 
@@ -4182,6 +6002,10 @@ error:
 
 /*
  * Scan a plain scalar.
+ *
+ * With zero-copy scanning of a mapped input, the value is borrowed from the
+ * input for as long as it is a single slice of it: nothing is copied and no
+ * string is allocated unless a line break gets folded into the value.
  */
 
 static int yaml_parser_scan_plain_scalar(YamlParser *parser, YamlToken *token) {
@@ -4191,13 +6015,20 @@ static int yaml_parser_scan_plain_scalar(YamlParser *parser, YamlToken *token) {
     YamlString_t leading_break = MYYAML_STRING_NULL;
     YamlString_t trailing_breaks = MYYAML_STRING_NULL;
     YamlString_t whitespaces = MYYAML_STRING_NULL;
+    YamlChar_t *borrow_start = NULL;
+    YamlChar_t *borrow_end = NULL;
+    size_t length;
     int leading_blanks = 0;
     int indent = parser->indent + 1;
 
-    if (!STRING_INIT(parser, string, MYYAML_INITIAL_STRING_SIZE)) goto error;
-    if (!STRING_INIT(parser, leading_break, MYYAML_INITIAL_STRING_SIZE)) goto error;
-    if (!STRING_INIT(parser, trailing_breaks, MYYAML_INITIAL_STRING_SIZE)) goto error;
-    if (!STRING_INIT(parser, whitespaces, MYYAML_INITIAL_STRING_SIZE)) goto error;
+    if (parser->zero_copy && parser->mapping.passthrough) {
+        borrow_start = borrow_end = parser->buffer.pointer;
+    } else {
+        if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_VALUE, &string)) goto error;
+        if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_LEADING_BREAK, &leading_break)) goto error;
+        if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_TRAILING_BREAKS, &trailing_breaks)) goto error;
+        if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_WHITESPACES, &whitespaces)) goto error;
+    }
 
     start_mark = end_mark = parser->mark;
 
@@ -4240,6 +6071,42 @@ static int yaml_parser_scan_plain_scalar(YamlParser *parser, YamlToken *token) {
                                         CHECK(parser->buffer, '{') || CHECK(parser->buffer, '}'))))
                 break;
 
+            /*
+             * A folded line break ends the borrowed slice.  Copy the slice
+             * and read the skipped breaks again, as if they had been read
+             * into the strings in the first place.
+             */
+
+            if (borrow_start && leading_blanks) {
+                YamlChar_t *pointer = parser->buffer.pointer;
+                YamlMark mark = parser->mark;
+                size_t unread = parser->unread;
+
+                if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_VALUE, &string)) goto error;
+                if (!STRING_RESERVE(parser, string, borrow_end - borrow_start)) goto error;
+                if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_LEADING_BREAK, &leading_break)) goto error;
+                if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_TRAILING_BREAKS, &trailing_breaks)) goto error;
+                if (!yaml_parser_take_scratch(parser, YAML_SCRATCH_WHITESPACES, &whitespaces)) goto error;
+
+                memcpy(string.start, borrow_start, borrow_end - borrow_start);
+                string.pointer += borrow_end - borrow_start;
+
+                parser->buffer.pointer = borrow_end;
+                while (parser->buffer.pointer != pointer) {
+                    if (IS_BLANK(parser->buffer)) {
+                        SKIP(parser);
+                    } else if (leading_break.start == leading_break.pointer) {
+                        if (!READ_LINE(parser, leading_break)) goto error;
+                    } else {
+                        if (!READ_LINE(parser, trailing_breaks)) goto error;
+                    }
+                }
+                parser->mark = mark;
+                parser->unread = unread;
+
+                borrow_start = NULL;
+            }
+
             /* Check if we need to join whitespaces and breaks. */
 
             if (leading_blanks || whitespaces.start != whitespaces.pointer) {
@@ -4269,9 +6136,21 @@ static int yaml_parser_scan_plain_scalar(YamlParser *parser, YamlToken *token) {
                 }
             }
 
-            /* Copy the character. */
+            /*
+             * Copy the character and the run of characters after it that
+             * cannot end the scalar.
+             */
 
-            if (!READ(parser, string)) goto error;
+            if (borrow_start) {
+                SKIP(parser);
+                length = yaml_get_kernels()->plain_span(parser->buffer.pointer, parser->buffer.last);
+                SKIP_RUN(parser, length);
+                borrow_end = parser->buffer.pointer;
+            } else {
+                if (!READ(parser, string)) goto error;
+                length = yaml_get_kernels()->plain_span(parser->buffer.pointer, parser->buffer.last);
+                if (length && !READ_RUN(parser, string, length)) goto error;
+            }
 
             end_mark = parser->mark;
 
@@ -4298,7 +6177,7 @@ static int yaml_parser_scan_plain_scalar(YamlParser *parser, YamlToken *token) {
 
                 /* Consume a space or a tab character. */
 
-                if (!leading_blanks) {
+                if (!leading_blanks && !borrow_start) {
                     if (!READ(parser, whitespaces)) goto error;
                 } else {
                     SKIP(parser);
@@ -4308,7 +6187,10 @@ static int yaml_parser_scan_plain_scalar(YamlParser *parser, YamlToken *token) {
 
                 /* Check if it is a first line break. */
 
-                if (!leading_blanks) {
+                if (borrow_start) {
+                    SKIP_LINE(parser);
+                    leading_blanks = 1;
+                } else if (!leading_blanks) {
                     CLEAR(parser, whitespaces);
                     if (!READ_LINE(parser, leading_break)) goto error;
                     leading_blanks = 1;
@@ -4326,7 +6208,13 @@ static int yaml_parser_scan_plain_scalar(YamlParser *parser, YamlToken *token) {
 
     /* Create a token. */
 
-    SCALAR_TOKEN_INIT(*token, string.start, string.pointer - string.start, YAML_PLAIN_SCALAR_STYLE, start_mark, end_mark);
+    if (borrow_start) {
+        SCALAR_TOKEN_INIT(*token, borrow_start, borrow_end - borrow_start, YAML_PLAIN_SCALAR_STYLE, start_mark, end_mark);
+        token->data.scalar.borrowed = 1;
+    } else {
+        SCALAR_TOKEN_INIT(*token, string.start, string.pointer - string.start, YAML_PLAIN_SCALAR_STYLE, start_mark, end_mark);
+        if (!yaml_parser_borrow_value(parser, token, &string)) goto error;
+    }
 
     /* Note that we change the 'simple_key_allowed' flag. */
 
@@ -4334,9 +6222,9 @@ static int yaml_parser_scan_plain_scalar(YamlParser *parser, YamlToken *token) {
         parser->simple_key_allowed = 1;
     }
 
-    STRING_DEL(parser, leading_break);
-    STRING_DEL(parser, trailing_breaks);
-    STRING_DEL(parser, whitespaces);
+    yaml_parser_keep_scratch(parser, YAML_SCRATCH_LEADING_BREAK, &leading_break);
+    yaml_parser_keep_scratch(parser, YAML_SCRATCH_TRAILING_BREAKS, &trailing_breaks);
+    yaml_parser_keep_scratch(parser, YAML_SCRATCH_WHITESPACES, &whitespaces);
 
     return MYYAML_SUCCESS;
 
@@ -4349,6 +6237,76 @@ error:
     return MYYAML_FAILURE;
 }
 
+/*
+ * Take a scratch string of the scalar scanners from the parser, or allocate
+ * it the first time.  The value string is only scratch while the events go
+ * to callbacks; otherwise it becomes the value of the token.
+ */
+
+static int yaml_parser_take_scratch(YamlParser *parser, int slot, YamlString_t *string) {
+    if (!parser->scratch[slot].start || (slot == YAML_SCRATCH_VALUE && !parser->callbacks)) {
+        return STRING_INIT(parser, *string, MYYAML_INITIAL_STRING_SIZE);
+    }
+
+    string->start = string->pointer = parser->scratch[slot].start;
+    string->end = parser->scratch[slot].end;
+    parser->scratch[slot].start = parser->scratch[slot].pointer = parser->scratch[slot].end = NULL;
+
+    /* The scanners tell an empty break or whitespace string by its first octet. */
+
+    if (slot != YAML_SCRATCH_VALUE) {
+        CLEAR(parser, *string);
+    }
+
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Give a scratch string back to the parser for the next scalar.  A break or
+ * whitespace string that has grown long is freed instead, not to be cleared
+ * for every scalar after it.
+ */
+
+static void yaml_parser_keep_scratch(YamlParser *parser, int slot, YamlString_t *string) {
+    if (!string->start) return;
+
+    if (slot != YAML_SCRATCH_VALUE && string->end - string->start > MYYAML_INITIAL_STRING_SIZE * 16) {
+        STRING_DEL(parser, *string);
+        return;
+    }
+
+    _myyaml_free(parser->allocator, parser->scratch[slot].start);
+    parser->scratch[slot].start = parser->scratch[slot].pointer = string->start;
+    parser->scratch[slot].end = string->end;
+    string->start = string->pointer = string->end = NULL;
+}
+
+/*
+ * While the events go to callbacks, copy the value of a scalar token into
+ * the arena of the parser and keep the value string for the next scalar.
+ */
+
+static int yaml_parser_borrow_value(YamlParser *parser, YamlToken *token, YamlString_t *string) {
+    YamlChar_t *value;
+
+    if (!parser->callbacks) return MYYAML_SUCCESS;
+
+    value = (YamlChar_t *)yaml_arena_malloc(parser->values, token->data.scalar.length + 1);
+    if (!value) {
+        parser->error = YAML_MEMORY_ERROR;
+        return MYYAML_FAILURE;
+    }
+
+    memcpy(value, string->start, token->data.scalar.length);
+    value[token->data.scalar.length] = '\0';
+    token->data.scalar.value = value;
+    token->data.scalar.borrowed = 1;
+
+    yaml_parser_keep_scratch(parser, YAML_SCRATCH_VALUE, string);
+
+    return MYYAML_SUCCESS;
+}
+
 #pragma endregion  // Scanner
 
 #pragma region Parser
@@ -4418,6 +6376,19 @@ static int yaml_file_read_handler(void *data, unsigned char *buffer, size_t size
     return !ferror(parser->input.file);
 }
 
+static int yaml_feed_read_handler(void *data, unsigned char *buffer, size_t size, size_t *size_read) {
+    YamlParser *parser = (YamlParser *)data;
+
+    if (size > (size_t)(parser->feed.last - parser->feed.pointer)) {
+        size = parser->feed.last - parser->feed.pointer;
+    }
+
+    if (size) memcpy(buffer, parser->feed.pointer, size);
+    parser->feed.pointer += size;
+    *size_read = size;
+    return MYYAML_SUCCESS;
+}
+
 /*
  * Set parser error.
  */
@@ -4656,13 +6627,13 @@ static int yaml_parser_parse_document_start(YamlParser *parser, YamlEvent *event
     }
 
 error:
-    _myyaml_free(version_directive);
+    _myyaml_free(parser->allocator, version_directive);
     while (tag_directives.start != tag_directives.end) {
-        _myyaml_free(tag_directives.end[-1].handle);
-        _myyaml_free(tag_directives.end[-1].prefix);
+        _myyaml_free(parser->allocator, tag_directives.end[-1].handle);
+        _myyaml_free(parser->allocator, tag_directives.end[-1].prefix);
         tag_directives.end--;
     }
-    _myyaml_free(tag_directives.start);
+    _myyaml_free(parser->allocator, tag_directives.start);
     return MYYAML_FAILURE;
 }
 
@@ -4713,8 +6684,8 @@ static int yaml_parser_parse_document_end(YamlParser *parser, YamlEvent *event)
 
     while (!STACK_EMPTY(parser, parser->tag_directives)) {
         YamlTagDirective tag_directive = POP(parser, parser->tag_directives);
-        _myyaml_free(tag_directive.handle);
-        _myyaml_free(tag_directive.prefix);
+        _myyaml_free(parser->allocator, tag_directive.handle);
+        _myyaml_free(parser->allocator, tag_directive.prefix);
     }
 
     parser->state = YAML_PARSE_DOCUMENT_START_STATE;
@@ -4822,7 +6793,7 @@ static int yaml_parser_parse_node(YamlParser *parser, YamlEvent *event, int bloc
         if (tag_handle) {
             if (!*tag_handle) {
                 tag = tag_suffix;
-                _myyaml_free(tag_handle);
+                _myyaml_free(parser->allocator, tag_handle);
                 tag_handle = tag_suffix = NULL;
             } else {
                 YamlTagDirective *tag_directive;
@@ -4830,7 +6801,7 @@ static int yaml_parser_parse_node(YamlParser *parser, YamlEvent *event, int bloc
                     if (strcmp((char *)tag_directive->handle, (char *)tag_handle) == 0) {
                         size_t prefix_len = strlen((char *)tag_directive->prefix);
                         size_t suffix_len = strlen((char *)tag_suffix);
-                        tag = YAML_MALLOC(prefix_len + suffix_len + 1);
+                        tag = YAML_MALLOC(parser->allocator, prefix_len + suffix_len + 1);
                         if (!tag) {
                             parser->error = YAML_MEMORY_ERROR;
                             goto error;
@@ -4838,8 +6809,8 @@ static int yaml_parser_parse_node(YamlParser *parser, YamlEvent *event, int bloc
                         memcpy(tag, tag_directive->prefix, prefix_len);
                         memcpy(tag + prefix_len, tag_suffix, suffix_len);
                         tag[prefix_len + suffix_len] = '\0';
-                        _myyaml_free(tag_handle);
-                        _myyaml_free(tag_suffix);
+                        _myyaml_free(parser->allocator, tag_handle);
+                        _myyaml_free(parser->allocator, tag_suffix);
                         tag_handle = tag_suffix = NULL;
                         break;
                     }
@@ -4886,6 +6857,7 @@ static int yaml_parser_parse_node(YamlParser *parser, YamlEvent *event, int bloc
                 event->data.scalar.tag = tag;
                 event->data.scalar.value = token->data.scalar.value;
                 event->data.scalar.length = token->data.scalar.length;
+                event->data.scalar.borrowed = token->data.scalar.borrowed;
                 event->data.scalar.plain_implicit = plain_implicit, event->data.scalar.quoted_implicit = quoted_implicit;
                 event->data.scalar.style = token->data.scalar.style;
 
@@ -4964,7 +6936,7 @@ static int yaml_parser_parse_node(YamlParser *parser, YamlEvent *event, int bloc
 
                 return MYYAML_SUCCESS;
             } else if (anchor || tag) {
-                YamlChar_t *value = YAML_MALLOC(1);
+                YamlChar_t *value = YAML_MALLOC(parser->allocator, 1);
                 if (!value) {
                     parser->error = YAML_MEMORY_ERROR;
                     goto error;
@@ -4993,10 +6965,10 @@ static int yaml_parser_parse_node(YamlParser *parser, YamlEvent *event, int bloc
     }
 
 error:
-    _myyaml_free(anchor);
-    _myyaml_free(tag_handle);
-    _myyaml_free(tag_suffix);
-    _myyaml_free(tag);
+    _myyaml_free(parser->allocator, anchor);
+    _myyaml_free(parser->allocator, tag_handle);
+    _myyaml_free(parser->allocator, tag_suffix);
+    _myyaml_free(parser->allocator, tag);
 
     return MYYAML_FAILURE;
 }
@@ -5438,7 +7410,7 @@ static int yaml_parser_parse_flow_mapping_value(YamlParser *parser, YamlEvent *e
 static int yaml_parser_process_empty_scalar(YamlParser *parser, YamlEvent *event, YamlMark mark) {
     YamlChar_t *value;
 
-    value = YAML_MALLOC(1);
+    value = YAML_MALLOC(parser->allocator, 1);
     if (!value) {
         parser->error = YAML_MEMORY_ERROR;
         return MYYAML_FAILURE;
@@ -5492,7 +7464,7 @@ static int yaml_parser_process_directives(YamlParser *parser, YamlVersionDirecti
                 yaml_parser_set_parser_error(parser, "found incompatible YAML document", token->start_mark);
                 goto error;
             }
-            version_directive = YAML_MALLOC_STATIC(YamlVersionDirective);
+            version_directive = YAML_MALLOC_STATIC(parser->allocator, YamlVersionDirective);
             if (!version_directive) {
                 parser->error = YAML_MEMORY_ERROR;
                 goto error;
@@ -5534,15 +7506,15 @@ static int yaml_parser_process_directives(YamlParser *parser, YamlVersionDirecti
         STACK_DEL(parser, tag_directives);
     }
 
-    if (!version_directive_ref) _myyaml_free(version_directive);
+    if (!version_directive_ref) _myyaml_free(parser->allocator, version_directive);
     return MYYAML_SUCCESS;
 
 error:
-    _myyaml_free(version_directive);
+    _myyaml_free(parser->allocator, version_directive);
     while (!STACK_EMPTY(parser, tag_directives)) {
         YamlTagDirective tag_directive = POP(parser, tag_directives);
-        _myyaml_free(tag_directive.handle);
-        _myyaml_free(tag_directive.prefix);
+        _myyaml_free(parser->allocator, tag_directive.handle);
+        _myyaml_free(parser->allocator, tag_directive.prefix);
     }
     STACK_DEL(parser, tag_directives);
     return MYYAML_FAILURE;
@@ -5563,8 +7535,8 @@ static int yaml_parser_append_tag_directive(YamlParser *parser, YamlTagDirective
         }
     }
 
-    copy.handle = _myyaml_strdup(value.handle);
-    copy.prefix = _myyaml_strdup(value.prefix);
+    copy.handle = _myyaml_strdup(parser->allocator, value.handle);
+    copy.prefix = _myyaml_strdup(parser->allocator, value.prefix);
     if (!copy.handle || !copy.prefix) {
         parser->error = YAML_MEMORY_ERROR;
         goto error;
@@ -5575,8 +7547,8 @@ static int yaml_parser_append_tag_directive(YamlParser *parser, YamlTagDirective
     return MYYAML_SUCCESS;
 
 error:
-    _myyaml_free(copy.handle);
-    _myyaml_free(copy.prefix);
+    _myyaml_free(parser->allocator, copy.handle);
+    _myyaml_free(parser->allocator, copy.prefix);
     return MYYAML_FAILURE;
 }
 
@@ -5657,120 +7629,382 @@ static int yaml_parser_update_raw_buffer(YamlParser *parser) {
 
     /* Call the read handler to fill the buffer. */
 
-    if (!parser->read_handler(parser->read_handler_data, parser->raw_buffer.last, parser->raw_buffer.end - parser->raw_buffer.last, &size_read)) {
-        return yaml_parser_set_reader_error(parser, "input error", parser->offset, -1);
+    if (!yaml_parser_read_input(parser, parser->raw_buffer.last, parser->raw_buffer.end - parser->raw_buffer.last, &size_read)) {
+        return MYYAML_FAILURE;
     }
     parser->raw_buffer.last += size_read;
-    if (!size_read) {
-        parser->eof = 1;
-    }
 
     return MYYAML_SUCCESS;
 }
 
-#pragma endregion  // Reader
-
-#pragma region Loader
-
 /*
- * Set composer error.
+ * Call the read handler and set the EOF flag when the input is exhausted.
+ * Fed input that runs out before the last chunk suspends the reader instead:
+ * the function fails without setting an error.
  */
 
-static int yaml_parser_set_composer_error(YamlParser *parser, const char *problem, YamlMark problem_mark) {
-    parser->error = YAML_COMPOSER_ERROR;
-    parser->problem = problem;
-    parser->problem_mark = problem_mark;
+static int yaml_parser_read_input(YamlParser *parser, unsigned char *buffer, size_t size, size_t *size_read) {
+    if (!parser->read_handler(parser->read_handler_data, buffer, size, size_read)) {
+        return yaml_parser_set_reader_error(parser, "input error", parser->offset, -1);
+    }
 
-    return MYYAML_FAILURE;
+    if (!*size_read) {
+        if (FEEDING(parser)) {
+            parser->feed.starved = 1;
+            return MYYAML_FAILURE;
+        }
+        parser->eof = 1;
+    }
+
+    return MYYAML_SUCCESS;
 }
 
 /*
- * Set composer error with context.
+ * Return the stream offset of the current position, i.e. the number of input
+ * octets before the first unread character of the working buffer.
  */
 
-static int yaml_parser_set_composer_error_context(YamlParser *parser, const char *context, YamlMark context_mark, const char *problem,
-                                                  YamlMark problem_mark) {
-    parser->error = YAML_COMPOSER_ERROR;
-    parser->context = context;
-    parser->context_mark = context_mark;
-    parser->problem = problem;
-    parser->problem_mark = problem_mark;
+static size_t yaml_parser_input_position(YamlParser *parser) {
+    const unsigned char *pointer = parser->buffer.pointer;
+    size_t octets;
 
-    return MYYAML_FAILURE;
-}
+    if (parser->encoding != YAML_UTF16LE_ENCODING && parser->encoding != YAML_UTF16BE_ENCODING) {
+        return parser->offset - (parser->buffer.last - pointer);
+    }
 
-/*
- * Delete the stack of aliases.
- */
+    /* Every character takes two octets in UTF-16, or four as a surrogate pair. */
 
-static void yaml_parser_delete_aliases(YamlParser *parser) {
-    while (!STACK_EMPTY(parser, parser->aliases)) {
-        _myyaml_free(POP(parser, parser->aliases).anchor);
+    octets = 2 * parser->unread;
+    for (; pointer != parser->buffer.last; pointer++) {
+        if ((*pointer & 0xF8) == 0xF0) octets += 2;
     }
-    STACK_DEL(parser, parser->aliases);
+
+    return parser->offset - octets;
 }
 
 /*
- * Compose a document object.
+ * Check that a block of UTF-8 input is well-formed and contains only the
+ * characters allowed in a YAML stream. Store the number of octets checked in
+ * `length` and the number of characters in `count`. Unless `eof` is set, an
+ * incomplete sequence at the end of the block is left unchecked for the next
+ * block. Return 1 on success, 0 on failure.
  */
 
-static int yaml_parser_load_document(YamlParser *parser, YamlEvent *event) {
-    struct LoaderCtx_t ctx = {NULL, NULL, NULL};
+static int yaml_parser_check_utf8_block(YamlParser *parser, const unsigned char *start, const unsigned char *end, int eof, size_t *length,
+                                        size_t *count) {
+    const unsigned char *pointer = start;
+    size_t characters = 0;
 
-    MYYAML_ASSERT(event->type == YAML_DOCUMENT_START_EVENT);
-    /* DOCUMENT-START is expected. */
+    while (pointer < end) {
+        unsigned char octet;
+        unsigned int width;
+        unsigned int value;
+        size_t k;
 
-    parser->document->version_directive = event->data.document_start.version_directive;
-    parser->document->tag_directives.start = event->data.document_start.tag_directives.start;
-    parser->document->tag_directives.end = event->data.document_start.tag_directives.end;
-    parser->document->start_implicit = event->data.document_start.implicit;
-    parser->document->start_mark = event->start_mark;
+        /* Skip the printable ASCII run, a block at a time. */
 
-    if (!STACK_INIT(parser, ctx, int *)) return MYYAML_FAILURE;
-    if (!yaml_parser_load_nodes(parser, &ctx)) {
-        STACK_DEL(parser, ctx);
-        return MYYAML_FAILURE;
-    }
-    STACK_DEL(parser, ctx);
+        k = yaml_get_kernels()->utf8_ascii_span(pointer, end);
+        pointer += k;
+        characters += k;
 
-    return MYYAML_SUCCESS;
-}
+        if (pointer == end) break;
 
-/*
- * Compose a node tree.
- */
+        octet = pointer[0];
+        width = (octet & 0x80) == 0x00 ? 1 : (octet & 0xE0) == 0xC0 ? 2 : (octet & 0xF0) == 0xE0 ? 3 : (octet & 0xF8) == 0xF0 ? 4 : 0;
 
-static int yaml_parser_load_nodes(YamlParser *parser, struct LoaderCtx_t *ctx) {
-    YamlEvent event;
+        if (!width) return yaml_parser_set_reader_error(parser, "invalid leading UTF-8 octet", parser->offset + (pointer - start), octet);
+
+        if (width > (size_t)(end - pointer)) {
+            if (!eof) break;
+            return yaml_parser_set_reader_error(parser, "incomplete UTF-8 octet sequence", parser->offset + (pointer - start), -1);
+        }
+
+        value = (octet & 0x80) == 0x00   ? octet & 0x7F
+                : (octet & 0xE0) == 0xC0 ? octet & 0x1F
+                : (octet & 0xF0) == 0xE0 ? octet & 0x0F
+                                         : octet & 0x07;
+
+        for (k = 1; k < width; k++) {
+            octet = pointer[k];
+            if ((octet & 0xC0) != 0x80)
+                return yaml_parser_set_reader_error(parser, "invalid trailing UTF-8 octet", parser->offset + (pointer - start) + k, octet);
+            value = (value << 6) + (octet & 0x3F);
+        }
+
+        if (!((width == 1) || (width == 2 && value >= 0x80) || (width == 3 && value >= 0x800) || (width == 4 && value >= 0x10000)))
+            return yaml_parser_set_reader_error(parser, "invalid length of a UTF-8 sequence", parser->offset + (pointer - start), -1);
+
+        if ((value >= 0xD800 && value <= 0xDFFF) || value > 0x10FFFF)
+            return yaml_parser_set_reader_error(parser, "invalid Unicode character", parser->offset + (pointer - start), value);
+
+        if (!(value == 0x09 || value == 0x0A || value == 0x0D || (value >= 0x20 && value <= 0x7E) || (value == 0x85) ||
+              (value >= 0xA0 && value <= 0xD7FF) || (value >= 0xE000 && value <= 0xFFFD) || (value >= 0x10000 && value <= 0x10FFFF)))
+            return yaml_parser_set_reader_error(parser, "control characters are not allowed", parser->offset + (pointer - start), value);
+
+        pointer += width;
+        characters++;
+    }
+
+    *length = pointer - start;
+    *count = characters;
+
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Read UTF-8 input straight into the working buffer. Valid UTF-8 is already
+ * in the form the scanner consumes, so the block is validated in place instead
+ * of being decoded and re-encoded through the raw buffer. Octets left in the
+ * raw buffer (by the encoding detection or an incomplete sequence at the end
+ * of the previous block) are picked up first.
+ */
+
+static int yaml_parser_read_utf8_buffer(YamlParser *parser) {
+    unsigned char *start = parser->buffer.last;
+    size_t pending = parser->raw_buffer.last - parser->raw_buffer.pointer;
+    size_t size_read = 0;
+    size_t length = 0;
+    size_t count = 0;
+    size_t tail;
+
+    if (pending) {
+        memcpy(start, parser->raw_buffer.pointer, pending);
+    }
+    parser->raw_buffer.pointer = parser->raw_buffer.last = parser->raw_buffer.start;
+
+    /* Keep one octet for the terminating NUL. */
+
+    if (!parser->eof) {
+        if (!yaml_parser_read_input(parser, start + pending, parser->buffer.end - start - pending - 1, &size_read)) return MYYAML_FAILURE;
+    }
+
+    if (!yaml_parser_check_utf8_block(parser, start, start + pending + size_read, parser->eof, &length, &count)) return MYYAML_FAILURE;
+
+    /* Leave an incomplete trailing sequence in the raw buffer. */
+
+    tail = pending + size_read - length;
+    if (tail) {
+        memcpy(parser->raw_buffer.start, start + length, tail);
+        parser->raw_buffer.last = parser->raw_buffer.start + tail;
+    }
+
+    parser->buffer.last = start + length;
+    parser->unread += count;
+    parser->offset += length;
+
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Point the working buffer at a memory-mapped UTF-8 input. The mapping is
+ * validated once and then consumed in place by the scanner. Inputs in other
+ * encodings keep going through the string read handler.
+ */
+
+static int yaml_parser_map_buffer(YamlParser *parser) {
+    unsigned char *start = parser->mapping.start;
+    unsigned char *end = parser->mapping.start + parser->mapping.size;
+    size_t length = 0;
+    size_t count = 0;
+
+    parser->mapping.checked = 1;
+
+    /* Leave UTF-16 input to the decoder. */
+
+    if (!parser->encoding) {
+        if (end - start >= 2 && (!memcmp(start, MYYAML_BOM_UTF16LE, 2) || !memcmp(start, MYYAML_BOM_UTF16BE, 2))) return MYYAML_SUCCESS;
+        parser->encoding = YAML_UTF8_ENCODING;
+        if (end - start >= 3 && !memcmp(start, MYYAML_BOM_UTF8, 3)) {
+            start += 3;
+            parser->offset += 3;
+        }
+    }
+
+    if (parser->encoding != YAML_UTF8_ENCODING) return MYYAML_SUCCESS;
+
+    if (parser->mapping.size >= MYYAML_MAX_FILE_SIZE) return yaml_parser_set_reader_error(parser, "input is too long", parser->offset, -1);
+
+    if (!yaml_parser_check_utf8_block(parser, start, end, 1, &length, &count)) return MYYAML_FAILURE;
+
+    /* The padding after the mapping provides the terminating NUL. */
+
+    BUFFER_DEL(parser, parser->buffer);
+    parser->buffer.start = parser->buffer.pointer = start;
+    parser->buffer.last = end + 1;
+    parser->buffer.end = parser->mapping.start + parser->mapping.length;
+    parser->unread = count + 1;
+    parser->offset += end - start;
+
+    parser->input.string.current = parser->input.string.end;
+    parser->eof = 1;
+    parser->mapping.passthrough = 1;
+
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Release a memory-mapped input.
+ */
+
+static void yaml_parser_unmap_input(YamlParser *parser) {
+#if MYYAML_PLATFORM_IS(WINDOWS)
+    _myyaml_free(parser->allocator, parser->mapping.start);
+#else
+    munmap(parser->mapping.start, parser->mapping.length);
+#endif
+    parser->mapping.start = NULL;
+    parser->mapping.size = parser->mapping.length = 0;
+}
+
+#pragma endregion  // Reader
+
+#pragma region Loader
+
+/*
+ * Set composer error.
+ */
+
+static int yaml_parser_set_composer_error(YamlParser *parser, const char *problem, YamlMark problem_mark) {
+    parser->error = YAML_COMPOSER_ERROR;
+    parser->problem = problem;
+    parser->problem_mark = problem_mark;
+
+    return MYYAML_FAILURE;
+}
+
+/*
+ * Set composer error with context.
+ */
+
+static int yaml_parser_set_composer_error_context(YamlParser *parser, const char *context, YamlMark context_mark, const char *problem,
+                                                  YamlMark problem_mark) {
+    parser->error = YAML_COMPOSER_ERROR;
+    parser->context = context;
+    parser->context_mark = context_mark;
+    parser->problem = problem;
+    parser->problem_mark = problem_mark;
+
+    return MYYAML_FAILURE;
+}
+
+/*
+ * Delete the stack of aliases.
+ */
+
+static void yaml_parser_delete_aliases(YamlParser *parser) {
+    while (!STACK_EMPTY(parser, parser->aliases)) {
+        _myyaml_free(parser->allocator, POP(parser, parser->aliases).anchor);
+    }
+    STACK_DEL(parser, parser->aliases);
+
+    _myyaml_free(parser->allocator, parser->anchors.slots);
+    parser->anchors.slots = NULL;
+    parser->anchors.mask = 0;
+}
+
+/*
+ * Find the alias data of an anchor.
+ */
+
+static YamlAliasData *yaml_parser_find_anchor(YamlParser *parser, const YamlChar_t *anchor, unsigned int hash) {
+    size_t slot;
+
+    if (!parser->anchors.slots) return NULL;
+
+    for (slot = hash & parser->anchors.mask; parser->anchors.slots[slot]; slot = (slot + 1) & parser->anchors.mask) {
+        YamlAliasData *alias_data = parser->aliases.start + parser->anchors.slots[slot] - 1;
+        if (alias_data->hash == hash && strcmp((char *)alias_data->anchor, (char *)anchor) == 0) {
+            return alias_data;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Add the last alias data to the anchor table, doubling the table when it
+ * gets half full.
+ */
+
+static int yaml_parser_index_anchor(YamlParser *parser) {
+    size_t count = parser->aliases.top - parser->aliases.start;
+    size_t slot;
+
+    if (count * 2 > parser->anchors.mask + 1 || !parser->anchors.slots) {
+        size_t size = parser->anchors.slots ? (parser->anchors.mask + 1) * 2 : 64;
+        int *slots = (int *)_myyaml_malloc(parser->allocator, size * sizeof(int));
+        size_t number;
+
+        if (!slots) return MYYAML_FAILURE;
+
+        memset(slots, 0, size * sizeof(int));
+        _myyaml_free(parser->allocator, parser->anchors.slots);
+        parser->anchors.slots = slots;
+        parser->anchors.mask = size - 1;
+
+        for (number = 1; number < count; number++) {
+            for (slot = parser->aliases.start[number - 1].hash & parser->anchors.mask; slots[slot]; slot = (slot + 1) & parser->anchors.mask)
+                ;
+            slots[slot] = (int)number;
+        }
+    }
+
+    for (slot = parser->aliases.start[count - 1].hash & parser->anchors.mask; parser->anchors.slots[slot];
+         slot = (slot + 1) & parser->anchors.mask)
+        ;
+    parser->anchors.slots[slot] = (int)count;
+
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Compose a document object.
+ */
+
+static int yaml_parser_load_document(YamlParser *parser, YamlEvent *event, YamlPathFilter_t *filter) {
+    struct LoaderCtx_t ctx = {NULL, NULL, NULL, {NULL, NULL, NULL}};
+
+    MYYAML_ASSERT(event->type == YAML_DOCUMENT_START_EVENT);
+    /* DOCUMENT-START is expected. */
+
+    parser->document->version_directive = event->data.document_start.version_directive;
+    parser->document->tag_directives.start = event->data.document_start.tag_directives.start;
+    parser->document->tag_directives.end = event->data.document_start.tag_directives.end;
+    parser->document->start_implicit = event->data.document_start.implicit;
+    parser->document->start_mark = event->start_mark;
+
+    if (!STACK_INIT(parser, ctx, int *)) return MYYAML_FAILURE;
+    if ((parser->max_expanded_nodes || parser->max_alias_depth) && !STACK_INIT(parser, ctx.weights, YamlNodeWeight_t *)) {
+        STACK_DEL(parser, ctx);
+        return MYYAML_FAILURE;
+    }
+    if (!(filter ? yaml_parser_load_path_nodes(parser, &ctx, filter) : yaml_parser_load_nodes(parser, &ctx))) {
+        STACK_DEL(parser, ctx.weights);
+        STACK_DEL(parser, ctx);
+        return MYYAML_FAILURE;
+    }
+    STACK_DEL(parser, ctx.weights);
+    STACK_DEL(parser, ctx);
+
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Compose a node tree.
+ */
+
+static int yaml_parser_load_nodes(YamlParser *parser, struct LoaderCtx_t *ctx) {
+    YamlEvent event;
 
     do {
         if (!yaml_parser_parse(parser, &event)) return MYYAML_FAILURE;
 
-        switch (event.type) {
-            case YAML_ALIAS_EVENT:
-                if (!yaml_parser_load_alias(parser, &event, ctx)) return MYYAML_FAILURE;
-                break;
-            case YAML_SCALAR_EVENT:
-                if (!yaml_parser_load_scalar(parser, &event, ctx)) return MYYAML_FAILURE;
-                break;
-            case YAML_SEQUENCE_START_EVENT:
-                if (!yaml_parser_load_sequence(parser, &event, ctx)) return MYYAML_FAILURE;
-                break;
-            case YAML_SEQUENCE_END_EVENT:
-                if (!yaml_parser_load_sequence_end(parser, &event, ctx)) return MYYAML_FAILURE;
-                break;
-            case YAML_MAPPING_START_EVENT:
-                if (!yaml_parser_load_mapping(parser, &event, ctx)) return MYYAML_FAILURE;
-                break;
-            case YAML_MAPPING_END_EVENT:
-                if (!yaml_parser_load_mapping_end(parser, &event, ctx)) return MYYAML_FAILURE;
-                break;
-            default:
-                MYYAML_ASSERT(0); /* Could not happen. */
-                return MYYAML_FAILURE;
-            case YAML_DOCUMENT_END_EVENT:
-                break;
+        if (parser->max_document_length && event.end_mark.index - parser->document->start_mark.index > parser->max_document_length) {
+            yaml_event_delete(&event);
+            return yaml_parser_set_composer_error(parser, "document exceeds the length limit", parser->document->start_mark);
         }
+
+        if (event.type != YAML_DOCUMENT_END_EVENT && !yaml_parser_load_event(parser, &event, ctx)) return MYYAML_FAILURE;
     } while (event.type != YAML_DOCUMENT_END_EVENT);
 
     parser->document->end_implicit = event.data.document_end.implicit;
@@ -5779,11 +8013,35 @@ static int yaml_parser_load_nodes(YamlParser *parser, struct LoaderCtx_t *ctx) {
     return MYYAML_SUCCESS;
 }
 
+/*
+ * Compose the node of an event into the node tree.
+ */
+
+static int yaml_parser_load_event(YamlParser *parser, YamlEvent *event, struct LoaderCtx_t *ctx) {
+    switch (event->type) {
+        case YAML_ALIAS_EVENT:
+            return yaml_parser_load_alias(parser, event, ctx);
+        case YAML_SCALAR_EVENT:
+            return yaml_parser_load_scalar(parser, event, ctx);
+        case YAML_SEQUENCE_START_EVENT:
+            return yaml_parser_load_sequence(parser, event, ctx);
+        case YAML_SEQUENCE_END_EVENT:
+            return yaml_parser_load_sequence_end(parser, event, ctx);
+        case YAML_MAPPING_START_EVENT:
+            return yaml_parser_load_mapping(parser, event, ctx);
+        case YAML_MAPPING_END_EVENT:
+            return yaml_parser_load_mapping_end(parser, event, ctx);
+        default:
+            MYYAML_ASSERT(0); /* Could not happen. */
+            return MYYAML_FAILURE;
+    }
+}
+
 /*
  * Add an anchor.
  */
 
-static int yaml_parser_register_anchor(YamlParser *parser, int index, YamlChar_t *anchor) {
+static int yaml_parser_register_anchor(YamlParser *parser, int index, YamlChar_t *anchor, YamlMark mark) {
     YamlAliasData data;
     YamlAliasData *alias_data;
 
@@ -5791,18 +8049,25 @@ static int yaml_parser_register_anchor(YamlParser *parser, int index, YamlChar_t
 
     data.anchor = anchor;
     data.index = index;
-    data.mark = parser->document->nodes.start[index - 1].start_mark;
+    data.mark = mark;
+    data.hash = yaml_hash_string(anchor, strlen((char *)anchor));
 
-    for (alias_data = parser->aliases.start; alias_data != parser->aliases.top; alias_data++) {
-        if (strcmp((char *)alias_data->anchor, (char *)anchor) == 0) {
-            _myyaml_free(anchor);
-            return yaml_parser_set_composer_error_context(parser, "found duplicate anchor; first occurrence", alias_data->mark, "second occurrence",
-                                                          data.mark);
-        }
+    alias_data = yaml_parser_find_anchor(parser, anchor, data.hash);
+    if (alias_data) {
+        _myyaml_free(parser->allocator, anchor);
+        return yaml_parser_set_composer_error_context(parser, "found duplicate anchor; first occurrence", alias_data->mark, "second occurrence",
+                                                      data.mark);
     }
 
     if (!PUSH(parser, parser->aliases, data)) {
-        _myyaml_free(anchor);
+        _myyaml_free(parser->allocator, anchor);
+        return MYYAML_FAILURE;
+    }
+
+    /* The anchor belongs to the alias data now. */
+
+    if (!yaml_parser_index_anchor(parser)) {
+        parser->error = YAML_MEMORY_ERROR;
         return MYYAML_FAILURE;
     }
 
@@ -5828,7 +8093,7 @@ static int yaml_parser_load_node_add(YamlParser *parser, struct LoaderCtx_t *ctx
     switch (parent->type) {
         case YAML_SEQUENCE_NODE:
             if (!STACK_LIMIT(parser, parent->data.sequence.items, INT_MAX - 1)) return MYYAML_FAILURE;
-            if (!PUSH(parser, parent->data.sequence.items, index)) return MYYAML_FAILURE;
+            if (!DOCUMENT_PUSH(parser, parser->document, parent->data.sequence.items, index)) return MYYAML_FAILURE;
             break;
         case YAML_MAPPING_NODE: {
             YamlNodePair pair;
@@ -5843,7 +8108,7 @@ static int yaml_parser_load_node_add(YamlParser *parser, struct LoaderCtx_t *ctx
             pair.key = index;
             pair.value = 0;
             if (!STACK_LIMIT(parser, parent->data.mapping.pairs, INT_MAX - 1)) return MYYAML_FAILURE;
-            if (!PUSH(parser, parent->data.mapping.pairs, pair)) return MYYAML_FAILURE;
+            if (!DOCUMENT_PUSH(parser, parser->document, parent->data.mapping.pairs, pair)) return MYYAML_FAILURE;
 
             break;
         }
@@ -5854,22 +8119,55 @@ static int yaml_parser_load_node_add(YamlParser *parser, struct LoaderCtx_t *ctx
     return MYYAML_SUCCESS;
 }
 
+/*
+ * Take the tag of a node event, or the default tag of the kind of node
+ * (0 for a scalar, 1 for a sequence and 2 for a mapping) if it has none.
+ * With an arena, the tag is moved into it and the default tags are shared.
+ */
+
+static YamlChar_t *yaml_parser_load_tag(YamlParser *parser, YamlChar_t **event_tag, int kind) {
+    static const char *const default_tags[3] = {YAML_DEFAULT_SCALAR_TAG, YAML_DEFAULT_SEQUENCE_TAG, YAML_DEFAULT_MAPPING_TAG};
+    YamlArena *arena = parser->document->arena;
+    YamlChar_t *tag = *event_tag;
+
+    *event_tag = NULL;
+
+    if (!tag || strcmp((char *)tag, "!") == 0) {
+        _myyaml_free(parser->allocator, tag);
+        if (!arena) {
+            tag = _myyaml_strdup(parser->allocator, (YamlChar_t *)default_tags[kind]);
+        } else {
+            if (!arena->default_tags[kind]) {
+                arena->default_tags[kind] = yaml_document_strdup(parser->document, (YamlChar_t *)default_tags[kind], strlen(default_tags[kind]));
+            }
+            tag = arena->default_tags[kind];
+        }
+    } else if (arena) {
+        YamlChar_t *copy = yaml_document_strdup(parser->document, tag, strlen((char *)tag));
+        _myyaml_free(parser->allocator, tag);
+        tag = copy;
+    }
+
+    if (!tag) parser->error = YAML_MEMORY_ERROR;
+
+    return tag;
+}
+
 /*
  * Compose a node corresponding to an alias.
  */
 
 static int yaml_parser_load_alias(YamlParser *parser, YamlEvent *event, struct LoaderCtx_t *ctx) {
     YamlChar_t *anchor = event->data.alias.anchor;
-    YamlAliasData *alias_data;
+    YamlAliasData *alias_data = yaml_parser_find_anchor(parser, anchor, yaml_hash_string(anchor, strlen((char *)anchor)));
 
-    for (alias_data = parser->aliases.start; alias_data != parser->aliases.top; alias_data++) {
-        if (strcmp((char *)alias_data->anchor, (char *)anchor) == 0) {
-            _myyaml_free(anchor);
-            return yaml_parser_load_node_add(parser, ctx, alias_data->index);
-        }
+    if (alias_data) {
+        _myyaml_free(parser->allocator, anchor);
+        if (!yaml_parser_weigh_child(parser, ctx, alias_data->index, 1, event->start_mark)) return MYYAML_FAILURE;
+        return yaml_parser_load_node_add(parser, ctx, alias_data->index);
     }
 
-    _myyaml_free(anchor);
+    _myyaml_free(parser->allocator, anchor);
     return yaml_parser_set_composer_error(parser, "found undefined alias", event->start_mark);
 }
 
@@ -5880,14 +8178,30 @@ static int yaml_parser_load_alias(YamlParser *parser, YamlEvent *event, struct L
 static int yaml_parser_load_scalar(YamlParser *parser, YamlEvent *event, struct LoaderCtx_t *ctx) {
     YamlNode node;
     int index;
-    YamlChar_t *tag = event->data.scalar.tag;
+    YamlChar_t *tag = NULL;
 
     if (!STACK_LIMIT(parser, parser->document->nodes, INT_MAX - 1)) goto error;
 
-    if (!tag || strcmp((char *)tag, "!") == 0) {
-        _myyaml_free(tag);
-        tag = _myyaml_strdup((YamlChar_t *)YAML_DEFAULT_SCALAR_TAG);
-        if (!tag) goto error;
+    tag = yaml_parser_load_tag(parser, &event->data.scalar.tag, 0);
+    if (!tag) goto error;
+
+    /*
+     * The document outlives the input: give it its own copy of a borrowed
+     * value.  An arena document takes a copy of every value, which then
+     * counts as borrowed for the event.
+     */
+
+    if (event->data.scalar.borrowed || parser->document->arena) {
+        YamlChar_t *value = yaml_document_strdup(parser->document, event->data.scalar.value, event->data.scalar.length);
+        if (!value) {
+            parser->error = YAML_MEMORY_ERROR;
+            goto error;
+        }
+        if (!event->data.scalar.borrowed) {
+            _myyaml_free(parser->allocator, event->data.scalar.value);
+        }
+        event->data.scalar.value = value;
+        event->data.scalar.borrowed = !!parser->document->arena;
     }
 
     SCALAR_NODE_INIT(node, tag, event->data.scalar.value, event->data.scalar.length, event->data.scalar.style, event->start_mark, event->end_mark);
@@ -5896,14 +8210,22 @@ static int yaml_parser_load_scalar(YamlParser *parser, YamlEvent *event, struct
 
     index = parser->document->nodes.top - parser->document->nodes.start;
 
-    if (!yaml_parser_register_anchor(parser, index, event->data.scalar.anchor)) return MYYAML_FAILURE;
+    if (!yaml_parser_register_anchor(parser, index, event->data.scalar.anchor, event->start_mark)) return MYYAML_FAILURE;
+
+    if (!yaml_parser_weigh_node(parser, ctx, 0, event->start_mark)) return MYYAML_FAILURE;
+    if (!yaml_parser_weigh_child(parser, ctx, index, 0, event->start_mark)) return MYYAML_FAILURE;
 
     return yaml_parser_load_node_add(parser, ctx, index);
 
 error:
-    _myyaml_free(tag);
-    _myyaml_free(event->data.scalar.anchor);
-    _myyaml_free(event->data.scalar.value);
+    _myyaml_free(parser->allocator, event->data.scalar.tag);
+    if (!parser->document->arena) {
+        _myyaml_free(parser->allocator, tag);
+    }
+    _myyaml_free(parser->allocator, event->data.scalar.anchor);
+    if (!event->data.scalar.borrowed) {
+        _myyaml_free(parser->allocator, event->data.scalar.value);
+    }
     return MYYAML_FAILURE;
 }
 
@@ -5919,17 +8241,14 @@ static int yaml_parser_load_sequence(YamlParser *parser, YamlEvent *event, struc
         YamlNodeItem *top;
     } items = {NULL, NULL, NULL};
     int index;
-    YamlChar_t *tag = event->data.sequence_start.tag;
+    YamlChar_t *tag = NULL;
 
     if (!STACK_LIMIT(parser, parser->document->nodes, INT_MAX - 1)) goto error;
 
-    if (!tag || strcmp((char *)tag, "!") == 0) {
-        _myyaml_free(tag);
-        tag = _myyaml_strdup((YamlChar_t *)YAML_DEFAULT_SEQUENCE_TAG);
-        if (!tag) goto error;
-    }
+    tag = yaml_parser_load_tag(parser, &event->data.sequence_start.tag, 1);
+    if (!tag) goto error;
 
-    if (!STACK_INIT(parser, items, YamlNodeItem *)) goto error;
+    if (!DOCUMENT_STACK_INIT(parser, parser->document, items, YamlNodeItem *)) goto error;
 
     SEQUENCE_NODE_INIT(node, tag, items.start, items.end, event->data.sequence_start.style, event->start_mark, event->end_mark);
 
@@ -5937,7 +8256,9 @@ static int yaml_parser_load_sequence(YamlParser *parser, YamlEvent *event, struc
 
     index = parser->document->nodes.top - parser->document->nodes.start;
 
-    if (!yaml_parser_register_anchor(parser, index, event->data.sequence_start.anchor)) return MYYAML_FAILURE;
+    if (!yaml_parser_register_anchor(parser, index, event->data.sequence_start.anchor, event->start_mark)) return MYYAML_FAILURE;
+
+    if (!yaml_parser_weigh_node(parser, ctx, 1, event->start_mark)) return MYYAML_FAILURE;
 
     if (!yaml_parser_load_node_add(parser, ctx, index)) return MYYAML_FAILURE;
 
@@ -5947,8 +8268,12 @@ static int yaml_parser_load_sequence(YamlParser *parser, YamlEvent *event, struc
     return MYYAML_SUCCESS;
 
 error:
-    _myyaml_free(tag);
-    _myyaml_free(event->data.sequence_start.anchor);
+    _myyaml_free(parser->allocator, event->data.sequence_start.tag);
+    if (!parser->document->arena) {
+        _myyaml_free(parser->allocator, tag);
+        STACK_DEL(parser, items);
+    }
+    _myyaml_free(parser->allocator, event->data.sequence_start.anchor);
     return MYYAML_FAILURE;
 }
 
@@ -5959,11 +8284,13 @@ static int yaml_parser_load_sequence_end(YamlParser *parser, YamlEvent *event, s
 
     index = *((*ctx).top - 1);
     MYYAML_ASSERT(parser->document->nodes.start[index - 1].type == YAML_SEQUENCE_NODE);
+#if !defined(MYYAML_DISABLE_NODE_MARKS) || !MYYAML_DISABLE_NODE_MARKS
     parser->document->nodes.start[index - 1].end_mark = event->end_mark;
+#endif
 
     (void)POP(parser, *ctx);
 
-    return MYYAML_SUCCESS;
+    return yaml_parser_weigh_child(parser, ctx, index, 0, event->end_mark);
 }
 
 /*
@@ -5978,17 +8305,14 @@ static int yaml_parser_load_mapping(YamlParser *parser, YamlEvent *event, struct
         YamlNodePair *top;
     } pairs = {NULL, NULL, NULL};
     int index;
-    YamlChar_t *tag = event->data.mapping_start.tag;
+    YamlChar_t *tag = NULL;
 
     if (!STACK_LIMIT(parser, parser->document->nodes, INT_MAX - 1)) goto error;
 
-    if (!tag || strcmp((char *)tag, "!") == 0) {
-        _myyaml_free(tag);
-        tag = _myyaml_strdup((YamlChar_t *)YAML_DEFAULT_MAPPING_TAG);
-        if (!tag) goto error;
-    }
+    tag = yaml_parser_load_tag(parser, &event->data.mapping_start.tag, 2);
+    if (!tag) goto error;
 
-    if (!STACK_INIT(parser, pairs, YamlNodePair *)) goto error;
+    if (!DOCUMENT_STACK_INIT(parser, parser->document, pairs, YamlNodePair *)) goto error;
 
     MAPPING_NODE_INIT(node, tag, pairs.start, pairs.end, event->data.mapping_start.style, event->start_mark, event->end_mark);
 
@@ -5996,7 +8320,9 @@ static int yaml_parser_load_mapping(YamlParser *parser, YamlEvent *event, struct
 
     index = parser->document->nodes.top - parser->document->nodes.start;
 
-    if (!yaml_parser_register_anchor(parser, index, event->data.mapping_start.anchor)) return MYYAML_FAILURE;
+    if (!yaml_parser_register_anchor(parser, index, event->data.mapping_start.anchor, event->start_mark)) return MYYAML_FAILURE;
+
+    if (!yaml_parser_weigh_node(parser, ctx, 1, event->start_mark)) return MYYAML_FAILURE;
 
     if (!yaml_parser_load_node_add(parser, ctx, index)) return MYYAML_FAILURE;
 
@@ -6006,8 +8332,12 @@ static int yaml_parser_load_mapping(YamlParser *parser, YamlEvent *event, struct
     return MYYAML_SUCCESS;
 
 error:
-    _myyaml_free(tag);
-    _myyaml_free(event->data.mapping_start.anchor);
+    _myyaml_free(parser->allocator, event->data.mapping_start.tag);
+    if (!parser->document->arena) {
+        _myyaml_free(parser->allocator, tag);
+        STACK_DEL(parser, pairs);
+    }
+    _myyaml_free(parser->allocator, event->data.mapping_start.anchor);
     return MYYAML_FAILURE;
 }
 
@@ -6018,3013 +8348,4510 @@ static int yaml_parser_load_mapping_end(YamlParser *parser, YamlEvent *event, st
 
     index = *((*ctx).top - 1);
     MYYAML_ASSERT(parser->document->nodes.start[index - 1].type == YAML_MAPPING_NODE);
+#if !defined(MYYAML_DISABLE_NODE_MARKS) || !MYYAML_DISABLE_NODE_MARKS
     parser->document->nodes.start[index - 1].end_mark = event->end_mark;
+#endif
+
+    if (parser->index_mappings &&
+        parser->document->nodes.start[index - 1].data.mapping.pairs.top - parser->document->nodes.start[index - 1].data.mapping.pairs.start >=
+            MYYAML_MAPPING_INDEX_THRESHOLD &&
+        !yaml_document_update_mapping_index(parser->document, parser->document->nodes.start + index - 1)) {
+        parser->error = YAML_MEMORY_ERROR;
+        return MYYAML_FAILURE;
+    }
 
     (void)POP(parser, *ctx);
 
-    return MYYAML_SUCCESS;
+    return yaml_parser_weigh_child(parser, ctx, index, 0, event->end_mark);
 }
 
-#pragma endregion  // Loader
+/*
+ * Start the expansion weight of the node just added to the document.
+ */
 
-#endif  // MYYAML_DISABLE_READER
+static int yaml_parser_weigh_node(YamlParser *parser, struct LoaderCtx_t *ctx, int open, YamlMark mark) {
+    YamlNodeWeight_t weight;
 
-#if !defined(MYYAML_DISABLE_WRITER) || !MYYAML_DISABLE_WRITER
+    if (!ctx->weights.start) return MYYAML_SUCCESS;
 
-#pragma region Writer
+    if (parser->max_expanded_nodes && (size_t)(ctx->weights.top - ctx->weights.start) >= parser->max_expanded_nodes) {
+        return yaml_parser_set_composer_error(parser, "document exceeds the node limit", mark);
+    }
+
+    weight.nodes = 1;
+    weight.depth = 0;
+    weight.open = open;
+
+    return PUSH(parser, ctx->weights, weight);
+}
 
 /*
- * Set the writer error and return 0.
+ * Add the expansion weight of a complete node, or of the node an alias
+ * refers to, to the collection on top of the context.  Every node is added
+ * once, so the weights of a document cost O(nodes) however many times its
+ * aliases would expand.
  */
 
-static int yaml_emitter_set_writer_error(YamlEmitter *emitter, const char *problem) {
-    emitter->error = YAML_WRITER_ERROR;
-    emitter->problem = problem;
+static int yaml_parser_weigh_child(YamlParser *parser, struct LoaderCtx_t *ctx, int index, int alias, YamlMark mark) {
+    YamlNodeWeight_t *child;
+    YamlNodeWeight_t *parent;
+    int depth;
 
-    return MYYAML_FAILURE;
-}
+    if (!ctx->weights.start) return MYYAML_SUCCESS;
 
-#pragma endregion  // Writer
+    child = ctx->weights.start + index - 1;
+
+    if (!alias) {
+        child->open = 0;
+    } else if (child->open) {
+        /* An alias to an enclosing collection expands forever. */
+
+        return yaml_parser_set_composer_error(parser, "found recursive alias", mark);
+    }
+
+    depth = child->depth + !!alias;
+
+    if (parser->max_alias_depth && depth > parser->max_alias_depth) {
+        return yaml_parser_set_composer_error(parser, "aliases exceed the depth limit", mark);
+    }
+
+    if (STACK_EMPTY(parser, *ctx)) return MYYAML_SUCCESS;
+
+    parent = ctx->weights.start + *((*ctx).top - 1) - 1;
+    parent->nodes = (child->nodes > SIZE_MAX - parent->nodes) ? SIZE_MAX : parent->nodes + child->nodes;
+    if (parent->depth < depth) parent->depth = depth;
+
+    if (parser->max_expanded_nodes && parent->nodes > parser->max_expanded_nodes) {
+        return yaml_parser_set_composer_error(parser, "aliases expand beyond the node limit", mark);
+    }
+
+    return MYYAML_SUCCESS;
+}
 
-#pragma region Dumper
 /*
- * Clean up the emitter object after a document is dumped.
+ * Compose the nodes of a document the paths of a filter lead to, and skip
+ * the rest.  A collection on the way to them gets only the pairs and items
+ * the paths go through, a node a path ends at is composed whole.
  */
-static void yaml_emitter_delete_document_and_anchors(YamlEmitter *emitter) {
-    int index;
 
-    if (!emitter->anchors) {
-        yaml_document_delete(emitter->document);
-        emitter->document = NULL;
-        return;
-    }
+static int yaml_parser_load_path_nodes(YamlParser *parser, struct LoaderCtx_t *ctx, YamlPathFilter_t *filter) {
+    YamlEvent event;
 
-    for (index = 0; emitter->document->nodes.start + index < emitter->document->nodes.top; index++) {
-        YamlNode node = emitter->document->nodes.start[index];
-        if (!emitter->anchors[index].serialized) {
-            _myyaml_free(node.tag);
-            if (node.type == YAML_SCALAR_NODE) {
-                _myyaml_free(node.data.scalar.value);
+    for (;;) {
+        YamlPathFrame_t *frame = STACK_EMPTY(parser, filter->frames) ? NULL : filter->frames.top - 1;
+        size_t kept = frame ? frame->first + frame->count : 0;
+        int start, how;
+
+        if (!yaml_parser_parse(parser, &event)) return MYYAML_FAILURE;
+
+        if (parser->max_document_length && event.end_mark.index - parser->document->start_mark.index > parser->max_document_length) {
+            yaml_event_delete(&event);
+            return yaml_parser_set_composer_error(parser, "document exceeds the length limit", parser->document->start_mark);
+        }
+
+        if (event.type == YAML_DOCUMENT_END_EVENT) break;
+
+        if (filter->skip) {
+            if (!yaml_parser_skip_path_event(parser, ctx, filter, &event)) return MYYAML_FAILURE;
+            continue;
+        }
+
+        start = (event.type == YAML_SEQUENCE_START_EVENT || event.type == YAML_MAPPING_START_EVENT);
+
+        /* Inside a node composed whole, compose everything. */
+
+        if (filter->full) {
+            if (start) {
+                filter->full++;
+            } else if (event.type == YAML_SEQUENCE_END_EVENT || event.type == YAML_MAPPING_END_EVENT) {
+                filter->full--;
             }
+            if (!yaml_parser_load_event(parser, &event, ctx)) return MYYAML_FAILURE;
+            continue;
         }
-        if (node.type == YAML_SEQUENCE_NODE) {
-            STACK_DEL(emitter, node.data.sequence.items);
+
+        /* The end of a collection composed in part. */
+
+        if (event.type == YAML_SEQUENCE_END_EVENT || event.type == YAML_MAPPING_END_EVENT) {
+            filter->selected.top = filter->selected.start + frame->first;
+            (void)POP(parser, filter->frames);
+            if (!yaml_parser_load_event(parser, &event, ctx)) return MYYAML_FAILURE;
+            continue;
         }
-        if (node.type == YAML_MAPPING_NODE) {
-            STACK_DEL(emitter, node.data.mapping.pairs);
+
+        if (!frame) {
+            /* The root, kept in any case. */
+
+            size_t k;
+
+            how = YAML_PATH_PARTIAL;
+            for (k = 0; k < filter->count; k++) {
+                if (!filter->paths[k]->count) how = YAML_PATH_FULL;
+                if (!PUSH(parser, filter->selected, k)) goto error;
+            }
+        } else if (frame->sequence) {
+            how = yaml_parser_select_path(parser, filter, NULL, 0, frame->item);
+            if (!how) goto error;
+
+            /* The items before a selected one keep their numbers. */
+
+            if (how == YAML_PATH_SKIP && frame->item < frame->last && !yaml_parser_load_placeholder(parser, ctx, filter, event.start_mark)) goto error;
+            frame->item++;
+        } else if (!frame->value) {
+            /* A key: compose it if its value is, or skip both. */
+
+            how = (event.type == YAML_SCALAR_EVENT)
+                      ? yaml_parser_select_path(parser, filter, event.data.scalar.value, event.data.scalar.length, -1)
+                      : YAML_PATH_SKIP;
+            if (!how) goto error;
+
+            frame->value = how;
+            if (how != YAML_PATH_SKIP) {
+                if (!yaml_parser_load_scalar(parser, &event, ctx)) return MYYAML_FAILURE;
+                continue;
+            }
+        } else {
+            how = frame->value;
+            frame->value = 0;
         }
-    }
 
-    STACK_DEL(emitter, emitter->document->nodes);
-    _myyaml_free(emitter->anchors);
+        if (how == YAML_PATH_SKIP) {
+            filter->selected.top = filter->selected.start + kept;
+            if (!yaml_parser_skip_path_event(parser, ctx, filter, &event)) return MYYAML_FAILURE;
+            continue;
+        }
 
-    emitter->anchors = NULL;
-    emitter->last_anchor_id = 0;
-    emitter->document = NULL;
-}
+        if (how == YAML_PATH_FULL || !start) {
+            filter->selected.top = filter->selected.start + kept;
+            filter->full = (how == YAML_PATH_FULL && start);
+            if (!yaml_parser_load_event(parser, &event, ctx)) return MYYAML_FAILURE;
+            continue;
+        }
 
-/*
- * Check the references of a node and assign the anchor id if needed.
- */
-static void yaml_emitter_anchor_node(YamlEmitter *emitter, int index) {
-    YamlNode *node = emitter->document->nodes.start + index - 1;
-    YamlNodeItem *item;
-    YamlNodePair *pair;
+        /* A collection the paths go through. */
 
-    emitter->anchors[index - 1].references++;
+        {
+            YamlPathFrame_t child;
+            size_t k;
 
-    if (emitter->anchors[index - 1].references == 1) {
-        switch (node->type) {
-            case YAML_SEQUENCE_NODE:
-                for (item = node->data.sequence.items.start; item < node->data.sequence.items.top; item++) {
-                    yaml_emitter_anchor_node(emitter, *item);
-                }
-                break;
-            case YAML_MAPPING_NODE:
-                for (pair = node->data.mapping.pairs.start; pair < node->data.mapping.pairs.top; pair++) {
-                    yaml_emitter_anchor_node(emitter, pair->key);
-                    yaml_emitter_anchor_node(emitter, pair->value);
-                }
-                break;
-            default:
-                break;
+            child.first = kept;
+            child.count = (filter->selected.top - filter->selected.start) - kept;
+            child.segment = frame ? frame->segment + 1 : 0;
+            child.sequence = (event.type == YAML_SEQUENCE_START_EVENT);
+            child.item = 0;
+            child.last = -1;
+            child.value = 0;
+
+            for (k = child.first; k < child.first + child.count; k++) {
+                int index = filter->paths[filter->selected.start[k]]->segments[child.segment].index;
+                if (child.last < index) child.last = index;
+            }
+
+            if (!yaml_parser_load_event(parser, &event, ctx)) return MYYAML_FAILURE;
+            if (!PUSH(parser, filter->frames, child)) return MYYAML_FAILURE;
         }
     }
 
-    else if (emitter->anchors[index - 1].references == 2) {
-        emitter->anchors[index - 1].anchor = (++emitter->last_anchor_id);
-    }
+    parser->document->end_implicit = event.data.document_end.implicit;
+    parser->document->end_mark = event.end_mark;
+
+    return MYYAML_SUCCESS;
+
+error:
+    yaml_event_delete(&event);
+
+    return MYYAML_FAILURE;
 }
 
 /*
- * Generate a textual representation for an anchor.
+ * Find how to take a child of the collection on top of the filter, from the
+ * key of a mapping pair or the number of a sequence item, and push the paths
+ * that go on into it.  Returns 0 if there is not enough memory.
  */
 
-#define ANCHOR_TEMPLATE "id%03d"
-#define ANCHOR_TEMPLATE_LENGTH 16
+static int yaml_parser_select_path(YamlParser *parser, YamlPathFilter_t *filter, const YamlChar_t *key, size_t length, int item) {
+    YamlPathFrame_t *frame = filter->frames.top - 1;
+    int how = YAML_PATH_SKIP;
+    size_t k;
 
-static YamlChar_t *yaml_emitter_generate_anchor(SHIM(YamlEmitter *emitter), int anchor_id) {
-    YamlChar_t *anchor = YAML_MALLOC(ANCHOR_TEMPLATE_LENGTH);
+    for (k = frame->first; k < frame->first + frame->count; k++) {
+        size_t number = filter->selected.start[k];
+        const YamlPath *path = filter->paths[number];
+        const YamlPathSegment_t *segment = path->segments + frame->segment;
 
-    if (!anchor) return NULL;
+        if (key ? (segment->length != length || memcmp(segment->key, key, length) != 0) : segment->index != item) continue;
 
-    sprintf((char *)anchor, ANCHOR_TEMPLATE, anchor_id);
+        if (frame->segment + 1 == path->count) {
+            how = YAML_PATH_FULL;
+        } else {
+            if (how == YAML_PATH_SKIP) how = YAML_PATH_PARTIAL;
+            if (!PUSH(parser, filter->selected, number)) return 0;
+        }
+    }
 
-    return anchor;
+    return how;
 }
 
 /*
- * Serialize a node.
+ * Take an event of a skipped node, starting with the node itself.  Like
+ * yaml_parser_skip_node(), the scalar values go into the arena of the
+ * parser.  Anchored nodes are composed all the same, outside of the tree,
+ * for the aliases in the rest of the document.
  */
 
-static int yaml_emitter_dump_node(YamlEmitter *emitter, int index) {
-    YamlNode *node = emitter->document->nodes.start + index - 1;
-    int anchor_id = emitter->anchors[index - 1].anchor;
+static int yaml_parser_skip_path_event(YamlParser *parser, struct LoaderCtx_t *ctx, YamlPathFilter_t *filter, YamlEvent *event) {
+    int start = (event->type == YAML_SEQUENCE_START_EVENT || event->type == YAML_MAPPING_START_EVENT);
+    int end = (event->type == YAML_SEQUENCE_END_EVENT || event->type == YAML_MAPPING_END_EVENT);
     YamlChar_t *anchor = NULL;
 
-    if (anchor_id) {
-        anchor = yaml_emitter_generate_anchor(emitter, anchor_id);
-        if (!anchor) return MYYAML_FAILURE;
-    }
-
-    if (emitter->anchors[index - 1].serialized) {
-        return yaml_emitter_dump_alias(emitter, anchor);
+    if (event->type == YAML_SCALAR_EVENT) {
+        anchor = event->data.scalar.anchor;
+    } else if (event->type == YAML_SEQUENCE_START_EVENT) {
+        anchor = event->data.sequence_start.anchor;
+    } else if (event->type == YAML_MAPPING_START_EVENT) {
+        anchor = event->data.mapping_start.anchor;
     }
 
-    emitter->anchors[index - 1].serialized = 1;
-
-    switch (node->type) {
-        case YAML_SCALAR_NODE:
-            return yaml_emitter_dump_scalar(emitter, node, anchor);
-        case YAML_SEQUENCE_NODE:
-            return yaml_emitter_dump_sequence(emitter, node, anchor);
-        case YAML_MAPPING_NODE:
-            return yaml_emitter_dump_mapping(emitter, node, anchor);
-        default:
-            MYYAML_ASSERT(0); /* Could not happen. */
-            break;
+    if (!filter->skip && start && !yaml_parser_start_values(parser)) {
+        yaml_event_delete(event);
+        return MYYAML_FAILURE;
     }
 
-    return MYYAML_FAILURE; /* Could not happen. */
-}
+    filter->skip += start - end;
 
-/*
- * Serialize an alias.
- */
+    if (filter->orphan || anchor) {
+        int status;
 
-static int yaml_emitter_dump_alias(YamlEmitter *emitter, YamlChar_t *anchor) {
-    YamlEvent event;
-    YamlMark mark = {0, 0, 0};
+        filter->orphan += start - end;
+        filter->orphans.weights = ctx->weights;
+        status = yaml_parser_load_event(parser, event, &filter->orphans);
+        ctx->weights = filter->orphans.weights;
+        if (!status) return MYYAML_FAILURE;
+    } else {
+        yaml_event_delete(event);
+    }
 
-    memset((&event), 0, sizeof(YamlEvent));
-    event.type = YAML_ALIAS_EVENT;
-    event.start_mark = mark;
-    event.end_mark = mark;
-    event.data.alias.anchor = anchor;
+    if (filter->skip) {
+        yaml_parser_recycle_values(parser);
+        return MYYAML_SUCCESS;
+    }
 
-    return yaml_emitter_emit(emitter, &event);
+    return parser->callbacks ? yaml_parser_stop_values(parser) : MYYAML_SUCCESS;
 }
 
 /*
- * Serialize a scalar.
+ * Add the node that stands for a skipped sequence item: an empty scalar
+ * tagged as null, composed once per document.
  */
 
-static int yaml_emitter_dump_scalar(YamlEmitter *emitter, YamlNode *node, YamlChar_t *anchor) {
+static int yaml_parser_load_placeholder(YamlParser *parser, struct LoaderCtx_t *ctx, YamlPathFilter_t *filter, YamlMark mark) {
     YamlEvent event;
-    YamlMark mark = {0, 0, 0};
 
-    int plain_implicit = (strcmp((char *)node->tag, YAML_DEFAULT_SCALAR_TAG) == 0);
-    int quoted_implicit = (strcmp((char *)node->tag, YAML_DEFAULT_SCALAR_TAG) == 0);
+    if (filter->placeholder) return yaml_parser_load_node_add(parser, ctx, filter->placeholder);
 
-    memset((&event), 0, sizeof(YamlEvent));
+    memset(&event, 0, sizeof(YamlEvent));
     event.type = YAML_SCALAR_EVENT;
-    event.start_mark = mark;
-    event.end_mark = mark;
-    event.data.scalar.anchor = anchor;
-    event.data.scalar.tag = node->tag;
-    event.data.scalar.value = node->data.scalar.value;
-    event.data.scalar.length = node->data.scalar.length;
-    event.data.scalar.plain_implicit = plain_implicit;
-    event.data.scalar.quoted_implicit = quoted_implicit;
+    event.start_mark = event.end_mark = mark;
+    event.data.scalar.tag = _myyaml_strdup(parser->allocator, (YamlChar_t *)YAML_NULL_TAG);
+    if (!event.data.scalar.tag) {
+        parser->error = YAML_MEMORY_ERROR;
+        return MYYAML_FAILURE;
+    }
+    event.data.scalar.value = (YamlChar_t *)"";
+    event.data.scalar.borrowed = 1;
+    event.data.scalar.plain_implicit = 1;
     event.data.scalar.style = YAML_PLAIN_SCALAR_STYLE;
 
-    return yaml_emitter_emit(emitter, &event);
+    if (!yaml_parser_load_scalar(parser, &event, ctx)) return MYYAML_FAILURE;
+
+    filter->placeholder = parser->document->nodes.top - parser->document->nodes.start;
+
+    return MYYAML_SUCCESS;
 }
 
 /*
- * Serialize a sequence.
+ * Compose the nodes of a document into a tape.
  */
 
-static int yaml_emitter_dump_sequence(YamlEmitter *emitter, YamlNode *node, YamlChar_t *anchor) {
+static int yaml_parser_load_tape_nodes(YamlParser *parser, YamlTape *tape, struct LoaderCtx_t *ctx, YamlMark start_mark) {
     YamlEvent event;
-    YamlMark mark = {0, 0, 0};
+    uint32_t last_tag = 0;
+    int loaded;
 
-    int implicit = (strcmp((char *)node->tag, YAML_DEFAULT_SEQUENCE_TAG) == 0);
+    for (;;) {
+        if (!yaml_parser_parse(parser, &event)) return MYYAML_FAILURE;
 
-    YamlNodeItem *item;
+        if (parser->max_document_length && event.end_mark.index - start_mark.index > parser->max_document_length) {
+            yaml_event_delete(&event);
+            return yaml_parser_set_composer_error(parser, "document exceeds the length limit", start_mark);
+        }
 
-    memset((&event), 0, sizeof(YamlEvent));
-    event.type = YAML_SEQUENCE_START_EVENT;
-    event.start_mark = mark;
-    event.end_mark = mark;
-    event.data.sequence_start.anchor = anchor;
-    event.data.sequence_start.tag = node->tag;
-    event.data.sequence_start.implicit = implicit;
-    event.data.sequence_start.style = node->data.sequence.style;
+        switch (event.type) {
+            case YAML_ALIAS_EVENT:
+            case YAML_SCALAR_EVENT:
+            case YAML_SEQUENCE_START_EVENT:
+            case YAML_MAPPING_START_EVENT:
+                loaded = yaml_parser_load_tape_node(parser, tape, &event, ctx, &last_tag);
+                break;
+            case YAML_SEQUENCE_END_EVENT:
+            case YAML_MAPPING_END_EVENT:
+                loaded = yaml_parser_load_tape_end(parser, tape, &event, ctx);
+                break;
+            case YAML_DOCUMENT_END_EVENT:
+                return MYYAML_SUCCESS;
+            default:
+                MYYAML_ASSERT(0); /* Could not happen. */
+                return MYYAML_FAILURE;
+        }
 
-    if (!yaml_emitter_emit(emitter, &event)) return MYYAML_FAILURE;
+        /* The tape holds copies of the strings of the event. */
 
-    for (item = node->data.sequence.items.start; item < node->data.sequence.items.top; item++) {
-        if (!yaml_emitter_dump_node(emitter, *item)) return MYYAML_FAILURE;
+        yaml_event_delete(&event);
+        if (!loaded) return MYYAML_FAILURE;
     }
-
-    memset((&event), 0, sizeof(YamlEvent));
-    event.type = YAML_SEQUENCE_END_EVENT;
-    event.start_mark = mark;
-    event.end_mark = mark;
-
-    if (!yaml_emitter_emit(emitter, &event)) return MYYAML_FAILURE;
-
-    return MYYAML_SUCCESS;
 }
 
 /*
- * Serialize a mapping.
+ * Append a node or an alias to a tape.
  */
 
-static int yaml_emitter_dump_mapping(YamlEmitter *emitter, YamlNode *node, YamlChar_t *anchor) {
-    YamlEvent event;
-    YamlMark mark = {0, 0, 0};
+static int yaml_parser_load_tape_node(YamlParser *parser, YamlTape *tape, YamlEvent *event, struct LoaderCtx_t *ctx, uint32_t *last_tag) {
+    YamlTapeEntry entry = {0, 0, 0, 0, 0, 0};
+    YamlChar_t **anchor = NULL;
+    YamlChar_t *tag = NULL;
+    int index;
 
-    int implicit = (strcmp((char *)node->tag, YAML_DEFAULT_MAPPING_TAG) == 0);
+    switch (event->type) {
+        case YAML_ALIAS_EVENT: {
+            YamlChar_t *name = event->data.alias.anchor;
+            YamlAliasData *alias_data = yaml_parser_find_anchor(parser, name, yaml_hash_string(name, strlen((char *)name)));
 
-    YamlNodePair *pair;
+            if (!alias_data) return yaml_parser_set_composer_error(parser, "found undefined alias", event->start_mark);
+            if (!yaml_parser_weigh_child(parser, ctx, alias_data->index, 1, event->start_mark)) return MYYAML_FAILURE;
 
-    memset((&event), 0, sizeof(YamlEvent));
-    event.type = YAML_MAPPING_START_EVENT;
-    event.start_mark = mark;
-    event.end_mark = mark;
-    event.data.mapping_start.anchor = anchor;
-    event.data.mapping_start.tag = node->tag;
-    event.data.mapping_start.implicit = implicit;
-    event.data.mapping_start.style = node->data.mapping.style;
+            entry.type = tape->entries.start[alias_data->index - 1].type;
+            entry.alias = 1;
+            entry.data = (uint32_t)alias_data->index;
+            break;
+        }
+        case YAML_SCALAR_EVENT:
+            entry.type = YAML_SCALAR_NODE;
+            entry.style = (unsigned char)event->data.scalar.style;
+            entry.data = yaml_parser_tape_string(parser, tape, event->data.scalar.value, event->data.scalar.length);
+            if (!entry.data) return MYYAML_FAILURE;
+            entry.length = (uint32_t)event->data.scalar.length;
+            tag = event->data.scalar.tag;
+            anchor = &event->data.scalar.anchor;
+            break;
+        case YAML_SEQUENCE_START_EVENT:
+            entry.type = YAML_SEQUENCE_NODE;
+            entry.style = (unsigned char)event->data.sequence_start.style;
+            tag = event->data.sequence_start.tag;
+            anchor = &event->data.sequence_start.anchor;
+            break;
+        case YAML_MAPPING_START_EVENT:
+            entry.type = YAML_MAPPING_NODE;
+            entry.style = (unsigned char)event->data.mapping_start.style;
+            tag = event->data.mapping_start.tag;
+            anchor = &event->data.mapping_start.anchor;
+            break;
+        default:
+            MYYAML_ASSERT(0); /* Could not happen. */
+            return MYYAML_FAILURE;
+    }
 
-    if (!yaml_emitter_emit(emitter, &event)) return MYYAML_FAILURE;
+    /* Runs of nodes with the same explicit tag share one copy of it. */
 
-    for (pair = node->data.mapping.pairs.start; pair < node->data.mapping.pairs.top; pair++) {
-        if (!yaml_emitter_dump_node(emitter, pair->key)) return MYYAML_FAILURE;
-        if (!yaml_emitter_dump_node(emitter, pair->value)) return MYYAML_FAILURE;
+    if (tag && strcmp((char *)tag, "!") != 0) {
+        if (!*last_tag || strcmp((char *)tape->strings.start + *last_tag, (char *)tag) != 0) {
+            *last_tag = yaml_parser_tape_string(parser, tape, tag, strlen((char *)tag));
+            if (!*last_tag) return MYYAML_FAILURE;
+        }
+        entry.tag = *last_tag;
     }
 
-    memset((&event), 0, sizeof(YamlEvent));
-    event.type = YAML_MAPPING_END_EVENT;
-    event.start_mark = mark;
-    event.end_mark = mark;
+    if (!STACK_LIMIT(parser, tape->entries, INT_MAX - 1)) return MYYAML_FAILURE;
+    if (!PUSH(parser, tape->entries, entry)) return MYYAML_FAILURE;
 
-    if (!yaml_emitter_emit(emitter, &event)) return MYYAML_FAILURE;
+    index = tape->entries.top - tape->entries.start;
 
-    return MYYAML_SUCCESS;
-}
+    if (!STACK_EMPTY(parser, *ctx)) {
+        tape->entries.start[*((*ctx).top - 1) - 1].length++;
+    }
 
-#pragma endregion  // Dumper
+    if (anchor) {
+        YamlChar_t *name = *anchor;
 
-#pragma region Emitter
+        /* The anchor belongs to the alias data now. */
 
-static int yaml_string_write_handler(void *data, unsigned char *buffer, size_t size) {
-    YamlEmitter *emitter = (YamlEmitter *)data;
-
-    if (emitter->output.string.size - *emitter->output.string.size_written < size) {
-        memcpy(emitter->output.string.buffer + *emitter->output.string.size_written, buffer,
-               emitter->output.string.size - *emitter->output.string.size_written);
-        *emitter->output.string.size_written = emitter->output.string.size;
-        return MYYAML_FAILURE;
+        *anchor = NULL;
+        if (!yaml_parser_register_anchor(parser, index, name, event->start_mark)) return MYYAML_FAILURE;
     }
 
-    memcpy(emitter->output.string.buffer + *emitter->output.string.size_written, buffer, size);
-    *emitter->output.string.size_written += size;
-    return MYYAML_SUCCESS;
-}
+    /* An alias entry has a weight of its own to keep the weights in step with the entries. */
 
-static int yaml_file_write_handler(void *data, unsigned char *buffer, size_t size) {
-    YamlEmitter *emitter = (YamlEmitter *)data;
+    if (!yaml_parser_weigh_node(parser, ctx, entry.type != YAML_SCALAR_NODE && !entry.alias, event->start_mark)) return MYYAML_FAILURE;
 
-    return (fwrite(buffer, 1, size, emitter->output.file) == size);
-}
+    if (entry.alias) return MYYAML_SUCCESS;
+    if (entry.type == YAML_SCALAR_NODE) return yaml_parser_weigh_child(parser, ctx, index, 0, event->start_mark);
 
-/*
- * Set an emitter error and return 0.
- */
-static int yaml_emitter_set_emitter_error(YamlEmitter *emitter, const char *problem) {
-    emitter->error = YAML_EMITTER_ERROR;
-    emitter->problem = problem;
+    if (!STACK_LIMIT(parser, *ctx, INT_MAX - 1)) return MYYAML_FAILURE;
 
-    return MYYAML_FAILURE;
+    return PUSH(parser, *ctx, index);
 }
 
 /*
- * Check if we need to accumulate more events before emitting.
- *
- * We accumulate extra
- *  - 1 event for DOCUMENT-START
- *  - 2 events for SEQUENCE-START
- *  - 3 events for MAPPING-START
+ * Close the collection on top of the context.
  */
 
-static int yaml_emitter_need_more_events(YamlEmitter *emitter) {
-    int level = 0;
-    int accumulate = 0;
-    YamlEvent *event;
-
-    if (QUEUE_EMPTY(emitter, emitter->events)) return MYYAML_SUCCESS;
-
-    switch (emitter->events.head->type) {
-        case YAML_DOCUMENT_START_EVENT:
-            accumulate = 1;
-            break;
-        case YAML_SEQUENCE_START_EVENT:
-            accumulate = 2;
-            break;
-        case YAML_MAPPING_START_EVENT:
-            accumulate = 3;
-            break;
-        default:
-            return MYYAML_FAILURE;
-    }
+static int yaml_parser_load_tape_end(YamlParser *parser, YamlTape *tape, YamlEvent *event, struct LoaderCtx_t *ctx) {
+    YamlTapeEntry *entry;
+    int index;
 
-    if (emitter->events.tail - emitter->events.head > accumulate) return MYYAML_FAILURE;
+    MYYAML_ASSERT(((*ctx).top - (*ctx).start) > 0);
 
-    for (event = emitter->events.head; event != emitter->events.tail; event++) {
-        switch (event->type) {
-            case YAML_STREAM_START_EVENT:
-            case YAML_DOCUMENT_START_EVENT:
-            case YAML_SEQUENCE_START_EVENT:
-            case YAML_MAPPING_START_EVENT:
-                level += 1;
-                break;
-            case YAML_STREAM_END_EVENT:
-            case YAML_DOCUMENT_END_EVENT:
-            case YAML_SEQUENCE_END_EVENT:
-            case YAML_MAPPING_END_EVENT:
-                level -= 1;
-                break;
-            default:
-                break;
-        }
-        if (!level) return MYYAML_FAILURE;
+    index = POP(parser, *ctx);
+    entry = tape->entries.start + index - 1;
+    entry->data = (uint32_t)(tape->entries.top - tape->entries.start) + 1;
+    if (entry->type == YAML_MAPPING_NODE) {
+        entry->length /= 2;
     }
 
-    return MYYAML_SUCCESS;
+    return yaml_parser_weigh_child(parser, ctx, index, 0, event->end_mark);
 }
 
 /*
- * Append a directive to the directives stack.
+ * Copy a string into the string pool of a tape and return its offset, or
+ * 0 on error: the pool starts with an empty string no other one uses.
  */
 
-static int yaml_emitter_append_tag_directive(YamlEmitter *emitter, YamlTagDirective value, int allow_duplicates) {
-    YamlTagDirective *tag_directive;
-    YamlTagDirective copy = {NULL, NULL};
+static uint32_t yaml_parser_tape_string(YamlParser *parser, YamlTape *tape, const YamlChar_t *string, size_t length) {
+    size_t offset = tape->strings.pointer - tape->strings.start;
 
-    for (tag_directive = emitter->tag_directives.start; tag_directive != emitter->tag_directives.top; tag_directive++) {
-        if (strcmp((char *)value.handle, (char *)tag_directive->handle) == 0) {
-            if (allow_duplicates) return MYYAML_SUCCESS;
-            return yaml_emitter_set_emitter_error(emitter, "duplicate %TAG directive");
-        }
+    if (length >= UINT32_MAX - offset ||
+        !_myyaml_string_reserve(parser->allocator, &tape->strings.start, &tape->strings.pointer, &tape->strings.end, length)) {
+        parser->error = YAML_MEMORY_ERROR;
+        return 0;
     }
 
-    copy.handle = _myyaml_strdup(value.handle);
-    copy.prefix = _myyaml_strdup(value.prefix);
-    if (!copy.handle || !copy.prefix) {
-        emitter->error = YAML_MEMORY_ERROR;
-        goto error;
-    }
+    memcpy(tape->strings.pointer, string, length);
+    tape->strings.pointer[length] = '\0';
+    tape->strings.pointer += length + 1;
 
-    if (!PUSH(emitter, emitter->tag_directives, copy)) goto error;
+    return (uint32_t)offset;
+}
 
-    return MYYAML_SUCCESS;
+#pragma endregion  // Loader
 
-error:
-    _myyaml_free(copy.handle);
-    _myyaml_free(copy.prefix);
-    return MYYAML_FAILURE;
-}
+#endif  // MYYAML_DISABLE_READER
+
+#if !defined(MYYAML_DISABLE_WRITER) || !MYYAML_DISABLE_WRITER
+
+#pragma region Writer
 
 /*
- * Increase the indentation level.
+ * Set the writer error and return 0.
  */
 
-static int yaml_emitter_increase_indent(YamlEmitter *emitter, int flow, int indentless) {
-    if (!PUSH(emitter, emitter->indents, emitter->indent)) return MYYAML_FAILURE;
-
-    if (emitter->indent < 0) {
-        emitter->indent = flow ? emitter->best_indent : 0;
-    } else if (!indentless) {
-        emitter->indent += emitter->best_indent;
-    }
+static int yaml_emitter_set_writer_error(YamlEmitter *emitter, const char *problem) {
+    emitter->error = YAML_WRITER_ERROR;
+    emitter->problem = problem;
 
-    return MYYAML_SUCCESS;
+    return MYYAML_FAILURE;
 }
 
+#pragma endregion  // Writer
+
+#pragma region Dumper
 /*
- * State dispatcher.
+ * Clean up the emitter object after a document is dumped.
  */
+static void yaml_emitter_delete_document_and_anchors(YamlEmitter *emitter) {
+    int index;
 
-static int yaml_emitter_state_machine(YamlEmitter *emitter, YamlEvent *event) {
-    switch (emitter->state) {
-        case YAML_EMIT_STREAM_START_STATE:
-            return yaml_emitter_emit_stream_start(emitter, event);
-
-        case YAML_EMIT_FIRST_DOCUMENT_START_STATE:
-            return yaml_emitter_emit_document_start(emitter, event, 1);
-
-        case YAML_EMIT_DOCUMENT_START_STATE:
-            return yaml_emitter_emit_document_start(emitter, event, 0);
+    if (!emitter->anchors) {
+        yaml_document_delete(emitter->document);
+        emitter->document = NULL;
+        return;
+    }
 
-        case YAML_EMIT_DOCUMENT_CONTENT_STATE:
-            return yaml_emitter_emit_document_content(emitter, event);
+    /*
+     * The events only got copies of the tags of an arena document, and its
+     * values were borrowed: the rest goes with the arena.  The directives
+     * went to the DOCUMENT-START event either way.
+     */
 
-        case YAML_EMIT_DOCUMENT_END_STATE:
-            return yaml_emitter_emit_document_end(emitter, event);
+    if (emitter->document->arena) {
+        emitter->document->nodes.top = emitter->document->nodes.start;
+    }
 
-        case YAML_EMIT_FLOW_SEQUENCE_FIRST_ITEM_STATE:
-            return yaml_emitter_emit_flow_sequence_item(emitter, event, 1);
+    for (index = 0; emitter->document->nodes.start + index < emitter->document->nodes.top; index++) {
+        YamlNode node = emitter->document->nodes.start[index];
+        if (!emitter->anchors[index].serialized) {
+            _myyaml_free(emitter->document->allocator, node.tag);
+            if (node.type == YAML_SCALAR_NODE) {
+                _myyaml_free(emitter->document->allocator, node.data.scalar.value);
+            }
+        }
+        if (node.type == YAML_SEQUENCE_NODE) {
+            STACK_DEL(emitter->document, node.data.sequence.items);
+        }
+        if (node.type == YAML_MAPPING_NODE) {
+            STACK_DEL(emitter->document, node.data.mapping.pairs);
+            _myyaml_free(emitter->document->allocator, node.data.mapping.index);
+        }
+    }
 
-        case YAML_EMIT_FLOW_SEQUENCE_ITEM_STATE:
-            return yaml_emitter_emit_flow_sequence_item(emitter, event, 0);
+    STACK_DEL(emitter->document, emitter->document->nodes);
+    yaml_arena_destroy(emitter->document->arena);
+    emitter->document->arena = NULL;
+    _myyaml_free(emitter->allocator, emitter->anchors);
+    _myyaml_free(emitter->allocator, emitter->anchor_names);
 
-        case YAML_EMIT_FLOW_MAPPING_FIRST_KEY_STATE:
-            return yaml_emitter_emit_flow_mapping_key(emitter, event, 1);
+    emitter->anchors = NULL;
+    emitter->anchor_names = NULL;
+    emitter->last_anchor_id = 0;
+    emitter->document = NULL;
+}
 
-        case YAML_EMIT_FLOW_MAPPING_KEY_STATE:
-            return yaml_emitter_emit_flow_mapping_key(emitter, event, 0);
+/*
+ * Count the references to the nodes reachable from the root and assign an
+ * anchor id to each node referenced more than once.  The nodes are visited
+ * depth first with an explicit stack, in the order a recursive walk would
+ * take, so the anchor ids follow the order of the second references.
+ */
+static int yaml_emitter_anchor_nodes(YamlEmitter *emitter) {
+    struct {
+        int *start;
+        int *end;
+        int *top;
+    } stack = {NULL, NULL, NULL};
 
-        case YAML_EMIT_FLOW_MAPPING_SIMPLE_VALUE_STATE:
-            return yaml_emitter_emit_flow_mapping_value(emitter, event, 1);
+    if (!STACK_INIT(emitter, stack, int *)) return MYYAML_FAILURE;
+    if (!PUSH(emitter, stack, 1)) goto error;
 
-        case YAML_EMIT_FLOW_MAPPING_VALUE_STATE:
-            return yaml_emitter_emit_flow_mapping_value(emitter, event, 0);
+    while (!STACK_EMPTY(emitter, stack)) {
+        int index = POP(emitter, stack);
+        YamlNode *node = emitter->document->nodes.start + index - 1;
+        YamlNodeItem *item;
+        YamlNodePair *pair;
 
-        case YAML_EMIT_BLOCK_SEQUENCE_FIRST_ITEM_STATE:
-            return yaml_emitter_emit_block_sequence_item(emitter, event, 1);
+        emitter->anchors[index - 1].references++;
 
-        case YAML_EMIT_BLOCK_SEQUENCE_ITEM_STATE:
-            return yaml_emitter_emit_block_sequence_item(emitter, event, 0);
+        if (emitter->anchors[index - 1].references == 2) {
+            emitter->anchors[index - 1].anchor = (++emitter->last_anchor_id);
+        }
 
-        case YAML_EMIT_BLOCK_MAPPING_FIRST_KEY_STATE:
-            return yaml_emitter_emit_block_mapping_key(emitter, event, 1);
+        if (emitter->anchors[index - 1].references != 1) continue;
 
-        case YAML_EMIT_BLOCK_MAPPING_KEY_STATE:
-            return yaml_emitter_emit_block_mapping_key(emitter, event, 0);
+        /* Push the children last to first, so that the first is visited first. */
 
-        case YAML_EMIT_BLOCK_MAPPING_SIMPLE_VALUE_STATE:
-            return yaml_emitter_emit_block_mapping_value(emitter, event, 1);
+        switch (node->type) {
+            case YAML_SEQUENCE_NODE:
+                for (item = node->data.sequence.items.top; item != node->data.sequence.items.start; item--) {
+                    if (!PUSH(emitter, stack, item[-1])) goto error;
+                }
+                break;
+            case YAML_MAPPING_NODE:
+                for (pair = node->data.mapping.pairs.top; pair != node->data.mapping.pairs.start; pair--) {
+                    if (!PUSH(emitter, stack, pair[-1].value)) goto error;
+                    if (!PUSH(emitter, stack, pair[-1].key)) goto error;
+                }
+                break;
+            default:
+                break;
+        }
+    }
 
-        case YAML_EMIT_BLOCK_MAPPING_VALUE_STATE:
-            return yaml_emitter_emit_block_mapping_value(emitter, event, 0);
+    STACK_DEL(emitter, stack);
 
-        case YAML_EMIT_END_STATE:
-            return yaml_emitter_set_emitter_error(emitter, "expected nothing after STREAM-END");
+    return yaml_emitter_generate_anchors(emitter);
 
-        default:
-            MYYAML_ASSERT(1); /* Invalid state. */
-    }
+error:
+    STACK_DEL(emitter, stack);
 
     return MYYAML_FAILURE;
 }
 
 /*
- * Expect STREAM-START.
+ * Generate the textual representations of the anchors, all in one table.
+ * The events of the document borrow them from there.
  */
 
-static int yaml_emitter_emit_stream_start(YamlEmitter *emitter, YamlEvent *event) {
-    emitter->open_ended = 0;
-    if (event->type == YAML_STREAM_START_EVENT) {
-        if (!emitter->encoding) {
-            emitter->encoding = event->data.stream_start.encoding;
-        }
-
-        if (!emitter->encoding) {
-            emitter->encoding = YAML_UTF8_ENCODING;
-        }
-
-        if (emitter->best_indent < 2 || emitter->best_indent > 9) {
-            emitter->best_indent = 2;
-        }
-
-        if (emitter->best_width >= 0 && emitter->best_width <= emitter->best_indent * 2) {
-            emitter->best_width = 80;
-        }
-
-        if (emitter->best_width < 0) {
-            emitter->best_width = INT_MAX;
-        }
-
-        if (!emitter->line_break) {
-            emitter->line_break = YAML_LN_BREAK;
-        }
+#define ANCHOR_TEMPLATE "id%03d"
+#define ANCHOR_TEMPLATE_LENGTH 16
 
-        emitter->indent = -1;
+#define ANCHOR_NAME(emitter, anchor_id) ((emitter)->anchor_names + ((anchor_id) - 1) * ANCHOR_TEMPLATE_LENGTH)
 
-        emitter->line = 0;
-        emitter->column = 0;
-        emitter->whitespace = 1;
-        emitter->indention = 1;
+static int yaml_emitter_generate_anchors(YamlEmitter *emitter) {
+    int anchor_id;
 
-        if (emitter->encoding != YAML_UTF8_ENCODING) {
-            if (!yaml_emitter_write_bom(emitter)) return MYYAML_FAILURE;
-        }
+    if (!emitter->last_anchor_id) return MYYAML_SUCCESS;
 
-        emitter->state = YAML_EMIT_FIRST_DOCUMENT_START_STATE;
+    emitter->anchor_names = YAML_MALLOC(emitter->allocator, (size_t)emitter->last_anchor_id * ANCHOR_TEMPLATE_LENGTH);
+    if (!emitter->anchor_names) {
+        emitter->error = YAML_MEMORY_ERROR;
+        return MYYAML_FAILURE;
+    }
 
-        return MYYAML_SUCCESS;
+    for (anchor_id = 1; anchor_id <= emitter->last_anchor_id; anchor_id++) {
+        sprintf((char *)ANCHOR_NAME(emitter, anchor_id), ANCHOR_TEMPLATE, anchor_id);
     }
 
-    return yaml_emitter_set_emitter_error(emitter, "expected STREAM-START");
+    return MYYAML_SUCCESS;
 }
 
 /*
- * Expect DOCUMENT-START or STREAM-END.
+ * Serialize a node.
  */
 
-static int yaml_emitter_emit_document_start(YamlEmitter *emitter, YamlEvent *event, int first) {
-    if (event->type == YAML_DOCUMENT_START_EVENT) {
-        YamlTagDirective default_tag_directives[] = {
-            {(YamlChar_t *)"!", (YamlChar_t *)"!"}, {(YamlChar_t *)"!!", (YamlChar_t *)"tag:yaml.org,2002:"}, {NULL, NULL}};
-        YamlTagDirective *tag_directive;
-        int implicit;
-
-        if (event->data.document_start.version_directive) {
-            if (!yaml_emitter_analyze_version_directive(emitter, *event->data.document_start.version_directive)) return MYYAML_FAILURE;
-        }
+static int yaml_emitter_dump_node(YamlEmitter *emitter, int index) {
+    YamlNode *node = emitter->document->nodes.start + index - 1;
+    int anchor_id = emitter->anchors[index - 1].anchor;
+    YamlChar_t *anchor = anchor_id ? ANCHOR_NAME(emitter, anchor_id) : NULL;
 
-        for (tag_directive = event->data.document_start.tag_directives.start; tag_directive != event->data.document_start.tag_directives.end;
-             tag_directive++) {
-            if (!yaml_emitter_analyze_tag_directive(emitter, *tag_directive)) return MYYAML_FAILURE;
-            if (!yaml_emitter_append_tag_directive(emitter, *tag_directive, 0)) return MYYAML_FAILURE;
-        }
-
-        for (tag_directive = default_tag_directives; tag_directive->handle; tag_directive++) {
-            if (!yaml_emitter_append_tag_directive(emitter, *tag_directive, 1)) return MYYAML_FAILURE;
-        }
-
-        implicit = event->data.document_start.implicit;
-        if (!first || emitter->canonical) {
-            implicit = 0;
-        }
-
-        if ((event->data.document_start.version_directive ||
-             (event->data.document_start.tag_directives.start != event->data.document_start.tag_directives.end)) &&
-            emitter->open_ended) {
-            if (!yaml_emitter_write_indicator(emitter, "...", 1, 0, 0)) return MYYAML_FAILURE;
-            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-        }
-        emitter->open_ended = 0;
-
-        if (event->data.document_start.version_directive) {
-            implicit = 0;
-            if (!yaml_emitter_write_indicator(emitter, "%YAML", 1, 0, 0)) return MYYAML_FAILURE;
-            if (event->data.document_start.version_directive->minor == 1) {
-                if (!yaml_emitter_write_indicator(emitter, "1.1", 1, 0, 0)) return MYYAML_FAILURE;
-            } else {
-                if (!yaml_emitter_write_indicator(emitter, "1.2", 1, 0, 0)) return MYYAML_FAILURE;
-            }
-            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-        }
-
-        if (event->data.document_start.tag_directives.start != event->data.document_start.tag_directives.end) {
-            implicit = 0;
-            for (tag_directive = event->data.document_start.tag_directives.start; tag_directive != event->data.document_start.tag_directives.end;
-                 tag_directive++) {
-                if (!yaml_emitter_write_indicator(emitter, "%TAG", 1, 0, 0)) return MYYAML_FAILURE;
-                if (!yaml_emitter_write_tag_handle(emitter, tag_directive->handle, strlen((char *)tag_directive->handle))) return MYYAML_FAILURE;
-                if (!yaml_emitter_write_tag_content(emitter, tag_directive->prefix, strlen((char *)tag_directive->prefix), 1)) return MYYAML_FAILURE;
-                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-            }
-        }
-
-        if (yaml_emitter_check_empty_document(emitter)) {
-            implicit = 0;
-        }
-
-        if (!implicit) {
-            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-            if (!yaml_emitter_write_indicator(emitter, "---", 1, 0, 0)) return MYYAML_FAILURE;
-            if (emitter->canonical) {
-                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-            }
-        }
-
-        emitter->state = YAML_EMIT_DOCUMENT_CONTENT_STATE;
-
-        emitter->open_ended = 0;
-        return MYYAML_SUCCESS;
+    if (emitter->anchors[index - 1].serialized) {
+        return yaml_emitter_dump_alias(emitter, anchor);
     }
 
-    else if (event->type == YAML_STREAM_END_EVENT) {
-        /**
-         * This can happen if a block scalar with trailing empty lines
-         * is at the end of the stream
-         */
-        if (emitter->open_ended == 2) {
-            if (!yaml_emitter_write_indicator(emitter, "...", 1, 0, 0)) return MYYAML_FAILURE;
-            emitter->open_ended = 0;
-            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-        }
-        if (!yaml_emitter_flush(emitter)) return MYYAML_FAILURE;
-
-        emitter->state = YAML_EMIT_END_STATE;
+    emitter->anchors[index - 1].serialized = 1;
 
-        return MYYAML_SUCCESS;
+    switch (node->type) {
+        case YAML_SCALAR_NODE:
+            return yaml_emitter_dump_scalar(emitter, node, anchor);
+        case YAML_SEQUENCE_NODE:
+            return yaml_emitter_dump_sequence(emitter, node, anchor);
+        case YAML_MAPPING_NODE:
+            return yaml_emitter_dump_mapping(emitter, node, anchor);
+        default:
+            MYYAML_ASSERT(0); /* Could not happen. */
+            break;
     }
 
-    return yaml_emitter_set_emitter_error(emitter, "expected DOCUMENT-START or STREAM-END");
+    return MYYAML_FAILURE; /* Could not happen. */
 }
 
 /*
- * Expect the root node.
+ * Serialize an alias.
  */
 
-static int yaml_emitter_emit_document_content(YamlEmitter *emitter, YamlEvent *event) {
-    if (!PUSH(emitter, emitter->states, YAML_EMIT_DOCUMENT_END_STATE)) return MYYAML_FAILURE;
+static int yaml_emitter_dump_alias(YamlEmitter *emitter, YamlChar_t *anchor) {
+    YamlEvent event;
+    YamlMark mark = {0, 0, 0};
 
-    return yaml_emitter_emit_node(emitter, event, 1, 0, 0, 0);
+    memset((&event), 0, sizeof(YamlEvent));
+    event.type = YAML_ALIAS_EVENT;
+    event.start_mark = mark;
+    event.end_mark = mark;
+    event.allocator = emitter->document->allocator;
+    event.borrowed_anchor = 1;
+    event.data.alias.anchor = anchor;
+
+    return yaml_emitter_emit(emitter, &event);
 }
 
 /*
- * Expect DOCUMENT-END.
+ * Get the tag of a node for its event.  Events take over the tags of the
+ * nodes, except for an arena document, whose tags stay in the arena: those
+ * events get copies.
  */
 
-static int yaml_emitter_emit_document_end(YamlEmitter *emitter, YamlEvent *event) {
-    if (event->type == YAML_DOCUMENT_END_EVENT) {
-        if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-        if (!event->data.document_end.implicit) {
-            if (!yaml_emitter_write_indicator(emitter, "...", 1, 0, 0)) return MYYAML_FAILURE;
-            emitter->open_ended = 0;
-            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-        } else if (!emitter->open_ended)
-            emitter->open_ended = 1;
-        if (!yaml_emitter_flush(emitter)) return MYYAML_FAILURE;
-
-        emitter->state = YAML_EMIT_DOCUMENT_START_STATE;
+static YamlChar_t *yaml_emitter_dump_tag(YamlEmitter *emitter, YamlNode *node) {
+    YamlChar_t *tag = node->tag;
 
-        while (!STACK_EMPTY(emitter, emitter->tag_directives)) {
-            YamlTagDirective tag_directive = POP(emitter, emitter->tag_directives);
-            _myyaml_free(tag_directive.handle);
-            _myyaml_free(tag_directive.prefix);
+    if (emitter->document->arena) {
+        tag = _myyaml_strdup(emitter->document->allocator, node->tag);
+        if (!tag) {
+            emitter->error = YAML_MEMORY_ERROR;
         }
-
-        return MYYAML_SUCCESS;
     }
 
-    return yaml_emitter_set_emitter_error(emitter, "expected DOCUMENT-END");
+    return tag;
 }
 
 /*
- *
- * Expect a flow item node.
+ * Serialize a scalar.
  */
 
-static int yaml_emitter_emit_flow_sequence_item(YamlEmitter *emitter, YamlEvent *event, int first) {
-    if (first) {
-        if (!yaml_emitter_write_indicator(emitter, "[", 1, 1, 0)) return MYYAML_FAILURE;
-        if (!yaml_emitter_increase_indent(emitter, 1, 0)) return MYYAML_FAILURE;
-        emitter->flow_level++;
-    }
-
-    if (event->type == YAML_SEQUENCE_END_EVENT) {
-        emitter->flow_level--;
-        emitter->indent = POP(emitter, emitter->indents);
-        if (emitter->canonical && !first) {
-            if (!yaml_emitter_write_indicator(emitter, ",", 0, 0, 0)) return MYYAML_FAILURE;
-            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-        }
-        if (!yaml_emitter_write_indicator(emitter, "]", 0, 0, 0)) return MYYAML_FAILURE;
-        emitter->state = POP(emitter, emitter->states);
+static int yaml_emitter_dump_scalar(YamlEmitter *emitter, YamlNode *node, YamlChar_t *anchor) {
+    YamlEvent event;
+    YamlMark mark = {0, 0, 0};
+    YamlChar_t *tag;
 
-        return MYYAML_SUCCESS;
-    }
+    int plain_implicit = (strcmp((char *)node->tag, YAML_DEFAULT_SCALAR_TAG) == 0);
+    int quoted_implicit = (strcmp((char *)node->tag, YAML_DEFAULT_SCALAR_TAG) == 0);
 
-    if (!first) {
-        if (!yaml_emitter_write_indicator(emitter, ",", 0, 0, 0)) return MYYAML_FAILURE;
-    }
+    if (!(tag = yaml_emitter_dump_tag(emitter, node))) return MYYAML_FAILURE;
 
-    if (emitter->canonical || emitter->column > emitter->best_width) {
-        if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-    }
-    if (!PUSH(emitter, emitter->states, YAML_EMIT_FLOW_SEQUENCE_ITEM_STATE)) return MYYAML_FAILURE;
+    memset((&event), 0, sizeof(YamlEvent));
+    event.type = YAML_SCALAR_EVENT;
+    event.start_mark = mark;
+    event.end_mark = mark;
+    event.allocator = emitter->document->allocator;
+    event.borrowed_anchor = 1;
+    event.data.scalar.anchor = anchor;
+    event.data.scalar.tag = tag;
+    event.data.scalar.value = node->data.scalar.value;
+    event.data.scalar.length = node->data.scalar.length;
+    event.data.scalar.borrowed = !!emitter->document->arena;
+    event.data.scalar.plain_implicit = plain_implicit;
+    event.data.scalar.quoted_implicit = quoted_implicit;
+    event.data.scalar.style = YAML_PLAIN_SCALAR_STYLE;
 
-    return yaml_emitter_emit_node(emitter, event, 0, 1, 0, 0);
+    return yaml_emitter_emit(emitter, &event);
 }
 
 /*
- * Expect a flow key node.
+ * Serialize a sequence.
  */
 
-static int yaml_emitter_emit_flow_mapping_key(YamlEmitter *emitter, YamlEvent *event, int first) {
-    if (first) {
-        if (!yaml_emitter_write_indicator(emitter, "{", 1, 1, 0)) return MYYAML_FAILURE;
-        if (!yaml_emitter_increase_indent(emitter, 1, 0)) return MYYAML_FAILURE;
-        emitter->flow_level++;
-    }
+static int yaml_emitter_dump_sequence(YamlEmitter *emitter, YamlNode *node, YamlChar_t *anchor) {
+    YamlEvent event;
+    YamlMark mark = {0, 0, 0};
 
-    if (event->type == YAML_MAPPING_END_EVENT) {
-        emitter->flow_level--;
-        emitter->indent = POP(emitter, emitter->indents);
-        if (emitter->canonical && !first) {
-            if (!yaml_emitter_write_indicator(emitter, ",", 0, 0, 0)) return MYYAML_FAILURE;
-            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-        }
-        if (!yaml_emitter_write_indicator(emitter, "}", 0, 0, 0)) return MYYAML_FAILURE;
-        emitter->state = POP(emitter, emitter->states);
+    YamlChar_t *tag;
 
-        return MYYAML_SUCCESS;
-    }
+    int implicit = (strcmp((char *)node->tag, YAML_DEFAULT_SEQUENCE_TAG) == 0);
 
-    if (!first) {
-        if (!yaml_emitter_write_indicator(emitter, ",", 0, 0, 0)) return MYYAML_FAILURE;
-    }
-    if (emitter->canonical || emitter->column > emitter->best_width) {
-        if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-    }
+    YamlNodeItem *item;
 
-    if (!emitter->canonical && yaml_emitter_check_simple_key(emitter)) {
-        if (!PUSH(emitter, emitter->states, YAML_EMIT_FLOW_MAPPING_SIMPLE_VALUE_STATE)) return MYYAML_FAILURE;
+    if (!(tag = yaml_emitter_dump_tag(emitter, node))) return MYYAML_FAILURE;
 
-        return yaml_emitter_emit_node(emitter, event, 0, 0, 1, 1);
-    } else {
-        if (!yaml_emitter_write_indicator(emitter, "?", 1, 0, 0)) return MYYAML_FAILURE;
-        if (!PUSH(emitter, emitter->states, YAML_EMIT_FLOW_MAPPING_VALUE_STATE)) return MYYAML_FAILURE;
+    memset((&event), 0, sizeof(YamlEvent));
+    event.type = YAML_SEQUENCE_START_EVENT;
+    event.start_mark = mark;
+    event.end_mark = mark;
+    event.allocator = emitter->document->allocator;
+    event.borrowed_anchor = 1;
+    event.data.sequence_start.anchor = anchor;
+    event.data.sequence_start.tag = tag;
+    event.data.sequence_start.implicit = implicit;
+    event.data.sequence_start.style = node->data.sequence.style;
 
-        return yaml_emitter_emit_node(emitter, event, 0, 0, 1, 0);
+    if (!yaml_emitter_emit(emitter, &event)) return MYYAML_FAILURE;
+
+    for (item = node->data.sequence.items.start; item < node->data.sequence.items.top; item++) {
+        if (!yaml_emitter_dump_node(emitter, *item)) return MYYAML_FAILURE;
     }
-}
 
-/*
- * Expect a flow value node.
- */
+    memset((&event), 0, sizeof(YamlEvent));
+    event.type = YAML_SEQUENCE_END_EVENT;
+    event.start_mark = mark;
+    event.end_mark = mark;
 
-static int yaml_emitter_emit_flow_mapping_value(YamlEmitter *emitter, YamlEvent *event, int simple) {
-    if (simple) {
-        if (!yaml_emitter_write_indicator(emitter, ":", 0, 0, 0)) return MYYAML_FAILURE;
-    } else {
-        if (emitter->canonical || emitter->column > emitter->best_width) {
-            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-        }
-        if (!yaml_emitter_write_indicator(emitter, ":", 1, 0, 0)) return MYYAML_FAILURE;
-    }
-    if (!PUSH(emitter, emitter->states, YAML_EMIT_FLOW_MAPPING_KEY_STATE)) return MYYAML_FAILURE;
-    return yaml_emitter_emit_node(emitter, event, 0, 0, 1, 0);
+    if (!yaml_emitter_emit(emitter, &event)) return MYYAML_FAILURE;
+
+    return MYYAML_SUCCESS;
 }
 
 /*
- * Expect a block item node.
+ * Serialize a mapping.
  */
 
-static int yaml_emitter_emit_block_sequence_item(YamlEmitter *emitter, YamlEvent *event, int first) {
-    if (first) {
-        if (!yaml_emitter_increase_indent(emitter, 0, (emitter->mapping_context && !emitter->indention))) return MYYAML_FAILURE;
-    }
+static int yaml_emitter_dump_mapping(YamlEmitter *emitter, YamlNode *node, YamlChar_t *anchor) {
+    YamlEvent event;
+    YamlMark mark = {0, 0, 0};
 
-    if (event->type == YAML_SEQUENCE_END_EVENT) {
-        emitter->indent = POP(emitter, emitter->indents);
-        emitter->state = POP(emitter, emitter->states);
+    YamlChar_t *tag;
 
-        return MYYAML_SUCCESS;
-    }
+    int implicit = (strcmp((char *)node->tag, YAML_DEFAULT_MAPPING_TAG) == 0);
 
-    if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-    if (!yaml_emitter_write_indicator(emitter, "-", 1, 0, 1)) return MYYAML_FAILURE;
-    if (!PUSH(emitter, emitter->states, YAML_EMIT_BLOCK_SEQUENCE_ITEM_STATE)) return MYYAML_FAILURE;
+    YamlNodePair *pair;
 
-    return yaml_emitter_emit_node(emitter, event, 0, 1, 0, 0);
-}
+    if (!(tag = yaml_emitter_dump_tag(emitter, node))) return MYYAML_FAILURE;
 
-/*
- * Expect a block key node.
- */
+    memset((&event), 0, sizeof(YamlEvent));
+    event.type = YAML_MAPPING_START_EVENT;
+    event.start_mark = mark;
+    event.end_mark = mark;
+    event.allocator = emitter->document->allocator;
+    event.borrowed_anchor = 1;
+    event.data.mapping_start.anchor = anchor;
+    event.data.mapping_start.tag = tag;
+    event.data.mapping_start.implicit = implicit;
+    event.data.mapping_start.style = node->data.mapping.style;
 
-static int yaml_emitter_emit_block_mapping_key(YamlEmitter *emitter, YamlEvent *event, int first) {
-    if (first) {
-        if (!yaml_emitter_increase_indent(emitter, 0, 0)) return MYYAML_FAILURE;
+    if (!yaml_emitter_emit(emitter, &event)) return MYYAML_FAILURE;
+
+    for (pair = node->data.mapping.pairs.start; pair < node->data.mapping.pairs.top; pair++) {
+        if (!yaml_emitter_dump_node(emitter, pair->key)) return MYYAML_FAILURE;
+        if (!yaml_emitter_dump_node(emitter, pair->value)) return MYYAML_FAILURE;
     }
 
-    if (event->type == YAML_MAPPING_END_EVENT) {
-        emitter->indent = POP(emitter, emitter->indents);
-        emitter->state = POP(emitter, emitter->states);
+    memset((&event), 0, sizeof(YamlEvent));
+    event.type = YAML_MAPPING_END_EVENT;
+    event.start_mark = mark;
+    event.end_mark = mark;
 
-        return MYYAML_SUCCESS;
-    }
+    if (!yaml_emitter_emit(emitter, &event)) return MYYAML_FAILURE;
 
-    if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+    return MYYAML_SUCCESS;
+}
 
-    if (yaml_emitter_check_simple_key(emitter)) {
-        if (!PUSH(emitter, emitter->states, YAML_EMIT_BLOCK_MAPPING_SIMPLE_VALUE_STATE)) return MYYAML_FAILURE;
+#pragma endregion  // Dumper
 
-        return yaml_emitter_emit_node(emitter, event, 0, 0, 1, 1);
-    } else {
-        if (!yaml_emitter_write_indicator(emitter, "?", 1, 0, 1)) return MYYAML_FAILURE;
-        if (!PUSH(emitter, emitter->states, YAML_EMIT_BLOCK_MAPPING_VALUE_STATE)) return MYYAML_FAILURE;
+#pragma region Emitter
 
-        return yaml_emitter_emit_node(emitter, event, 0, 0, 1, 0);
+static int yaml_string_write_handler(void *data, unsigned char *buffer, size_t size) {
+    YamlEmitter *emitter = (YamlEmitter *)data;
+
+    if (emitter->output.string.size - *emitter->output.string.size_written < size) {
+        memcpy(emitter->output.string.buffer + *emitter->output.string.size_written, buffer,
+               emitter->output.string.size - *emitter->output.string.size_written);
+        *emitter->output.string.size_written = emitter->output.string.size;
+        return MYYAML_FAILURE;
     }
+
+    memcpy(emitter->output.string.buffer + *emitter->output.string.size_written, buffer, size);
+    *emitter->output.string.size_written += size;
+    return MYYAML_SUCCESS;
+}
+
+static int yaml_file_write_handler(void *data, unsigned char *buffer, size_t size) {
+    YamlEmitter *emitter = (YamlEmitter *)data;
+
+    return (fwrite(buffer, 1, size, emitter->output.file) == size);
 }
 
 /*
- * Expect a block value node.
+ * Set an emitter error and return 0.
  */
+static int yaml_emitter_set_emitter_error(YamlEmitter *emitter, const char *problem) {
+    emitter->error = YAML_EMITTER_ERROR;
+    emitter->problem = problem;
 
-static int yaml_emitter_emit_block_mapping_value(YamlEmitter *emitter, YamlEvent *event, int simple) {
-    if (simple) {
-        if (!yaml_emitter_write_indicator(emitter, ":", 0, 0, 0)) return MYYAML_FAILURE;
-    } else {
-        if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-        if (!yaml_emitter_write_indicator(emitter, ":", 1, 0, 1)) return MYYAML_FAILURE;
-    }
-    if (!PUSH(emitter, emitter->states, YAML_EMIT_BLOCK_MAPPING_KEY_STATE)) return MYYAML_FAILURE;
-
-    return yaml_emitter_emit_node(emitter, event, 0, 0, 1, 0);
+    return MYYAML_FAILURE;
 }
 
 /*
- * Expect a node.
+ * Check if we need to accumulate more events before emitting.
+ *
+ * We accumulate extra
+ *  - 1 event for DOCUMENT-START
+ *  - 2 events for SEQUENCE-START
+ *  - 3 events for MAPPING-START
  */
 
-static int yaml_emitter_emit_node(YamlEmitter *emitter, YamlEvent *event, int root, int sequence, int mapping, int simple_key) {
-    emitter->root_context = root;
-    emitter->sequence_context = sequence;
-    emitter->mapping_context = mapping;
-    emitter->simple_key_context = simple_key;
-
-    switch (event->type) {
-        case YAML_ALIAS_EVENT:
-            return yaml_emitter_emit_alias(emitter, event);
+static int yaml_emitter_need_more_events(YamlEmitter *emitter) {
+    int level = 0;
+    int accumulate = 0;
+    size_t index;
 
-        case YAML_SCALAR_EVENT:
-            return yaml_emitter_emit_scalar(emitter, event);
+    if (QUEUE_EMPTY(emitter, emitter->events)) return MYYAML_SUCCESS;
 
+    switch (QUEUE_AT(emitter, emitter->events, 0).type) {
+        case YAML_DOCUMENT_START_EVENT:
+            accumulate = 1;
+            break;
         case YAML_SEQUENCE_START_EVENT:
-            return yaml_emitter_emit_sequence_start(emitter, event);
-
+            accumulate = 2;
+            break;
         case YAML_MAPPING_START_EVENT:
-            return yaml_emitter_emit_mapping_start(emitter, event);
-
+            accumulate = 3;
+            break;
         default:
-            return yaml_emitter_set_emitter_error(emitter, "expected SCALAR, SEQUENCE-START, MAPPING-START, or ALIAS");
+            return MYYAML_FAILURE;
     }
 
-    return MYYAML_FAILURE;
-}
-
-/*
- * Expect ALIAS.
- */
+    if (QUEUE_LENGTH(emitter, emitter->events) > (size_t)accumulate) return MYYAML_FAILURE;
 
-static int yaml_emitter_emit_alias(YamlEmitter *emitter, SHIM(YamlEvent *event)) {
-    if (!yaml_emitter_process_anchor(emitter)) return MYYAML_FAILURE;
-    if (emitter->simple_key_context)
-        if (!PUT(emitter, ' ')) return MYYAML_FAILURE;
-    emitter->state = POP(emitter, emitter->states);
+    for (index = 0; index < QUEUE_LENGTH(emitter, emitter->events); index++) {
+        switch (QUEUE_AT(emitter, emitter->events, index).type) {
+            case YAML_STREAM_START_EVENT:
+            case YAML_DOCUMENT_START_EVENT:
+            case YAML_SEQUENCE_START_EVENT:
+            case YAML_MAPPING_START_EVENT:
+                level += 1;
+                break;
+            case YAML_STREAM_END_EVENT:
+            case YAML_DOCUMENT_END_EVENT:
+            case YAML_SEQUENCE_END_EVENT:
+            case YAML_MAPPING_END_EVENT:
+                level -= 1;
+                break;
+            default:
+                break;
+        }
+        if (!level) return MYYAML_FAILURE;
+    }
 
     return MYYAML_SUCCESS;
 }
 
 /*
- * Expect SCALAR.
+ * Append a directive to the directives stack.
  */
 
-static int yaml_emitter_emit_scalar(YamlEmitter *emitter, YamlEvent *event) {
-    if (!yaml_emitter_select_scalar_style(emitter, event)) return MYYAML_FAILURE;
-    if (!yaml_emitter_process_anchor(emitter)) return MYYAML_FAILURE;
-    if (!yaml_emitter_process_tag(emitter)) return MYYAML_FAILURE;
-    if (!yaml_emitter_increase_indent(emitter, 1, 0)) return MYYAML_FAILURE;
-    if (!yaml_emitter_process_scalar(emitter)) return MYYAML_FAILURE;
-    emitter->indent = POP(emitter, emitter->indents);
-    emitter->state = POP(emitter, emitter->states);
-
-    return MYYAML_SUCCESS;
-}
-
-/*
- * Expect SEQUENCE-START.
- */
+static int yaml_emitter_append_tag_directive(YamlEmitter *emitter, YamlTagDirective value, int allow_duplicates) {
+    YamlTagDirective *tag_directive;
+    YamlTagDirective copy = {NULL, NULL};
 
-static int yaml_emitter_emit_sequence_start(YamlEmitter *emitter, YamlEvent *event) {
-    if (!yaml_emitter_process_anchor(emitter)) return MYYAML_FAILURE;
-    if (!yaml_emitter_process_tag(emitter)) return MYYAML_FAILURE;
+    for (tag_directive = emitter->tag_directives.start; tag_directive != emitter->tag_directives.top; tag_directive++) {
+        if (strcmp((char *)value.handle, (char *)tag_directive->handle) == 0) {
+            if (allow_duplicates) return MYYAML_SUCCESS;
+            return yaml_emitter_set_emitter_error(emitter, "duplicate %TAG directive");
+        }
+    }
 
-    if (emitter->flow_level || emitter->canonical || event->data.sequence_start.style == YAML_FLOW_SEQUENCE_STYLE ||
-        yaml_emitter_check_empty_sequence(emitter)) {
-        emitter->state = YAML_EMIT_FLOW_SEQUENCE_FIRST_ITEM_STATE;
-    } else {
-        emitter->state = YAML_EMIT_BLOCK_SEQUENCE_FIRST_ITEM_STATE;
+    copy.handle = _myyaml_strdup(emitter->allocator, value.handle);
+    copy.prefix = _myyaml_strdup(emitter->allocator, value.prefix);
+    if (!copy.handle || !copy.prefix) {
+        emitter->error = YAML_MEMORY_ERROR;
+        goto error;
     }
 
+    if (!PUSH(emitter, emitter->tag_directives, copy)) goto error;
+
     return MYYAML_SUCCESS;
+
+error:
+    _myyaml_free(emitter->allocator, copy.handle);
+    _myyaml_free(emitter->allocator, copy.prefix);
+    return MYYAML_FAILURE;
 }
 
 /*
- * Expect MAPPING-START.
+ * Increase the indentation level.
  */
 
-static int yaml_emitter_emit_mapping_start(YamlEmitter *emitter, YamlEvent *event) {
-    if (!yaml_emitter_process_anchor(emitter)) return MYYAML_FAILURE;
-    if (!yaml_emitter_process_tag(emitter)) return MYYAML_FAILURE;
+static int yaml_emitter_increase_indent(YamlEmitter *emitter, int flow, int indentless) {
+    if (!PUSH(emitter, emitter->indents, emitter->indent)) return MYYAML_FAILURE;
 
-    if (emitter->flow_level || emitter->canonical || event->data.mapping_start.style == YAML_FLOW_MAPPING_STYLE ||
-        yaml_emitter_check_empty_mapping(emitter)) {
-        emitter->state = YAML_EMIT_FLOW_MAPPING_FIRST_KEY_STATE;
-    } else {
-        emitter->state = YAML_EMIT_BLOCK_MAPPING_FIRST_KEY_STATE;
+    if (emitter->indent < 0) {
+        emitter->indent = flow ? emitter->best_indent : 0;
+    } else if (!indentless) {
+        emitter->indent += emitter->best_indent;
     }
 
     return MYYAML_SUCCESS;
 }
 
 /*
- * Check if the document content is an empty scalar.
+ * State dispatcher.
  */
 
-static int yaml_emitter_check_empty_document(SHIM(YamlEmitter *emitter)) { return MYYAML_FAILURE; }
+static int yaml_emitter_state_machine(YamlEmitter *emitter, YamlEvent *event) {
+    switch (emitter->state) {
+        case YAML_EMIT_STREAM_START_STATE:
+            return yaml_emitter_emit_stream_start(emitter, event);
 
-/*
- * Check if the next events represent an empty sequence.
- */
+        case YAML_EMIT_FIRST_DOCUMENT_START_STATE:
+            return yaml_emitter_emit_document_start(emitter, event, 1);
 
-static int yaml_emitter_check_empty_sequence(YamlEmitter *emitter) {
-    if (emitter->events.tail - emitter->events.head < 2) return MYYAML_FAILURE;
+        case YAML_EMIT_DOCUMENT_START_STATE:
+            return yaml_emitter_emit_document_start(emitter, event, 0);
 
-    return (emitter->events.head[0].type == YAML_SEQUENCE_START_EVENT && emitter->events.head[1].type == YAML_SEQUENCE_END_EVENT);
-}
+        case YAML_EMIT_DOCUMENT_CONTENT_STATE:
+            return yaml_emitter_emit_document_content(emitter, event);
 
-/*
- * Check if the next events represent an empty mapping.
- */
+        case YAML_EMIT_DOCUMENT_END_STATE:
+            return yaml_emitter_emit_document_end(emitter, event);
 
-static int yaml_emitter_check_empty_mapping(YamlEmitter *emitter) {
-    if (emitter->events.tail - emitter->events.head < 2) return MYYAML_FAILURE;
+        case YAML_EMIT_FLOW_SEQUENCE_FIRST_ITEM_STATE:
+            return yaml_emitter_emit_flow_sequence_item(emitter, event, 1);
 
-    return (emitter->events.head[0].type == YAML_MAPPING_START_EVENT && emitter->events.head[1].type == YAML_MAPPING_END_EVENT);
-}
+        case YAML_EMIT_FLOW_SEQUENCE_ITEM_STATE:
+            return yaml_emitter_emit_flow_sequence_item(emitter, event, 0);
 
-/*
- * Check if the next node can be expressed as a simple key.
- */
+        case YAML_EMIT_FLOW_MAPPING_FIRST_KEY_STATE:
+            return yaml_emitter_emit_flow_mapping_key(emitter, event, 1);
 
-static int yaml_emitter_check_simple_key(YamlEmitter *emitter) {
-    YamlEvent *event = emitter->events.head;
-    size_t length = 0;
+        case YAML_EMIT_FLOW_MAPPING_KEY_STATE:
+            return yaml_emitter_emit_flow_mapping_key(emitter, event, 0);
 
-    switch (event->type) {
-        case YAML_ALIAS_EVENT:
-            length += emitter->anchor_data.anchor_length;
-            break;
+        case YAML_EMIT_FLOW_MAPPING_SIMPLE_VALUE_STATE:
+            return yaml_emitter_emit_flow_mapping_value(emitter, event, 1);
 
-        case YAML_SCALAR_EVENT:
-            if (emitter->scalar_data.multiline) return MYYAML_FAILURE;
-            length +=
-                emitter->anchor_data.anchor_length + emitter->tag_data.handle_length + emitter->tag_data.suffix_length + emitter->scalar_data.length;
-            break;
+        case YAML_EMIT_FLOW_MAPPING_VALUE_STATE:
+            return yaml_emitter_emit_flow_mapping_value(emitter, event, 0);
 
-        case YAML_SEQUENCE_START_EVENT:
-            if (!yaml_emitter_check_empty_sequence(emitter)) return MYYAML_FAILURE;
-            length += emitter->anchor_data.anchor_length + emitter->tag_data.handle_length + emitter->tag_data.suffix_length;
-            break;
+        case YAML_EMIT_BLOCK_SEQUENCE_FIRST_ITEM_STATE:
+            return yaml_emitter_emit_block_sequence_item(emitter, event, 1);
 
-        case YAML_MAPPING_START_EVENT:
-            if (!yaml_emitter_check_empty_mapping(emitter)) return MYYAML_FAILURE;
-            length += emitter->anchor_data.anchor_length + emitter->tag_data.handle_length + emitter->tag_data.suffix_length;
-            break;
+        case YAML_EMIT_BLOCK_SEQUENCE_ITEM_STATE:
+            return yaml_emitter_emit_block_sequence_item(emitter, event, 0);
+
+        case YAML_EMIT_BLOCK_MAPPING_FIRST_KEY_STATE:
+            return yaml_emitter_emit_block_mapping_key(emitter, event, 1);
+
+        case YAML_EMIT_BLOCK_MAPPING_KEY_STATE:
+            return yaml_emitter_emit_block_mapping_key(emitter, event, 0);
+
+        case YAML_EMIT_BLOCK_MAPPING_SIMPLE_VALUE_STATE:
+            return yaml_emitter_emit_block_mapping_value(emitter, event, 1);
+
+        case YAML_EMIT_BLOCK_MAPPING_VALUE_STATE:
+            return yaml_emitter_emit_block_mapping_value(emitter, event, 0);
+
+        case YAML_EMIT_END_STATE:
+            return yaml_emitter_set_emitter_error(emitter, "expected nothing after STREAM-END");
 
         default:
-            return MYYAML_FAILURE;
+            MYYAML_ASSERT(1); /* Invalid state. */
     }
 
-    if (length > 128) return MYYAML_FAILURE;
-
-    return MYYAML_SUCCESS;
+    return MYYAML_FAILURE;
 }
 
 /*
- * Determine an acceptable scalar style.
+ * Expect STREAM-START.
  */
 
-static int yaml_emitter_select_scalar_style(YamlEmitter *emitter, YamlEvent *event) {
-    YamlScalarStyle style = event->data.scalar.style;
-    int no_tag = (!emitter->tag_data.handle && !emitter->tag_data.suffix);
+static int yaml_emitter_emit_stream_start(YamlEmitter *emitter, YamlEvent *event) {
+    emitter->open_ended = 0;
+    if (event->type == YAML_STREAM_START_EVENT) {
+        if (!emitter->encoding) {
+            emitter->encoding = event->data.stream_start.encoding;
+        }
 
-    if (no_tag && !event->data.scalar.plain_implicit && !event->data.scalar.quoted_implicit) {
-        return yaml_emitter_set_emitter_error(emitter, "neither tag nor implicit flags are specified");
-    }
+        if (!emitter->encoding) {
+            emitter->encoding = YAML_UTF8_ENCODING;
+        }
 
-    if (style == YAML_ANY_SCALAR_STYLE) style = YAML_PLAIN_SCALAR_STYLE;
+        if (emitter->best_indent < 2 || emitter->best_indent > 9) {
+            emitter->best_indent = 2;
+        }
 
-    if (emitter->canonical) style = YAML_DOUBLE_QUOTED_SCALAR_STYLE;
+        if (emitter->best_width >= 0 && emitter->best_width <= emitter->best_indent * 2) {
+            emitter->best_width = 80;
+        }
 
-    if (emitter->simple_key_context && emitter->scalar_data.multiline) style = YAML_DOUBLE_QUOTED_SCALAR_STYLE;
+        if (emitter->best_width < 0) {
+            emitter->best_width = INT_MAX;
+        }
 
-    if (style == YAML_PLAIN_SCALAR_STYLE) {
-        if ((emitter->flow_level && !emitter->scalar_data.flow_plain_allowed) || (!emitter->flow_level && !emitter->scalar_data.block_plain_allowed))
-            style = YAML_SINGLE_QUOTED_SCALAR_STYLE;
-        if (!emitter->scalar_data.length && (emitter->flow_level || emitter->simple_key_context)) style = YAML_SINGLE_QUOTED_SCALAR_STYLE;
-        if (no_tag && !event->data.scalar.plain_implicit) style = YAML_SINGLE_QUOTED_SCALAR_STYLE;
-    }
+        if (!emitter->line_break) {
+            emitter->line_break = YAML_LN_BREAK;
+        }
 
-    if (style == YAML_SINGLE_QUOTED_SCALAR_STYLE) {
-        if (!emitter->scalar_data.single_quoted_allowed) style = YAML_DOUBLE_QUOTED_SCALAR_STYLE;
-    }
+        emitter->indent = -1;
 
-    if (style == YAML_LITERAL_SCALAR_STYLE || style == YAML_FOLDED_SCALAR_STYLE) {
-        if (!emitter->scalar_data.block_allowed || emitter->flow_level || emitter->simple_key_context) style = YAML_DOUBLE_QUOTED_SCALAR_STYLE;
-    }
+        emitter->line = 0;
+        emitter->column = 0;
+        emitter->whitespace = 1;
+        emitter->indention = 1;
 
-    if (no_tag && !event->data.scalar.quoted_implicit && style != YAML_PLAIN_SCALAR_STYLE) {
-        emitter->tag_data.handle = (YamlChar_t *)"!";
-        emitter->tag_data.handle_length = 1;
-    }
+        if (emitter->encoding != YAML_UTF8_ENCODING) {
+            if (!yaml_emitter_write_bom(emitter)) return MYYAML_FAILURE;
+        }
 
-    emitter->scalar_data.style = style;
+        emitter->state = YAML_EMIT_FIRST_DOCUMENT_START_STATE;
 
-    return MYYAML_SUCCESS;
+        return MYYAML_SUCCESS;
+    }
+
+    return yaml_emitter_set_emitter_error(emitter, "expected STREAM-START");
 }
 
 /*
- * Write an anchor.
+ * Expect DOCUMENT-START or STREAM-END.
  */
 
-static int yaml_emitter_process_anchor(YamlEmitter *emitter) {
-    if (!emitter->anchor_data.anchor) return MYYAML_SUCCESS;
+static int yaml_emitter_emit_document_start(YamlEmitter *emitter, YamlEvent *event, int first) {
+    if (event->type == YAML_DOCUMENT_START_EVENT) {
+        YamlTagDirective default_tag_directives[] = {
+            {(YamlChar_t *)"!", (YamlChar_t *)"!"}, {(YamlChar_t *)"!!", (YamlChar_t *)"tag:yaml.org,2002:"}, {NULL, NULL}};
+        YamlTagDirective *tag_directive;
+        int implicit;
 
-    if (!yaml_emitter_write_indicator(emitter, (emitter->anchor_data.alias ? "*" : "&"), 1, 0, 0)) return MYYAML_FAILURE;
+        if (event->data.document_start.version_directive) {
+            if (!yaml_emitter_analyze_version_directive(emitter, *event->data.document_start.version_directive)) return MYYAML_FAILURE;
+        }
 
-    return yaml_emitter_write_anchor(emitter, emitter->anchor_data.anchor, emitter->anchor_data.anchor_length);
-}
+        for (tag_directive = event->data.document_start.tag_directives.start; tag_directive != event->data.document_start.tag_directives.end;
+             tag_directive++) {
+            if (!yaml_emitter_analyze_tag_directive(emitter, *tag_directive)) return MYYAML_FAILURE;
+            if (!yaml_emitter_append_tag_directive(emitter, *tag_directive, 0)) return MYYAML_FAILURE;
+        }
 
-/*
- * Write a tag.
- */
+        for (tag_directive = default_tag_directives; tag_directive->handle; tag_directive++) {
+            if (!yaml_emitter_append_tag_directive(emitter, *tag_directive, 1)) return MYYAML_FAILURE;
+        }
 
-static int yaml_emitter_process_tag(YamlEmitter *emitter) {
-    if (!emitter->tag_data.handle && !emitter->tag_data.suffix) return MYYAML_SUCCESS;
+        implicit = event->data.document_start.implicit;
+        if (!first || emitter->canonical) {
+            implicit = 0;
+        }
 
-    if (emitter->tag_data.handle) {
-        if (!yaml_emitter_write_tag_handle(emitter, emitter->tag_data.handle, emitter->tag_data.handle_length)) return MYYAML_FAILURE;
-        if (emitter->tag_data.suffix) {
-            if (!yaml_emitter_write_tag_content(emitter, emitter->tag_data.suffix, emitter->tag_data.suffix_length, 0)) return MYYAML_FAILURE;
+        if ((event->data.document_start.version_directive ||
+             (event->data.document_start.tag_directives.start != event->data.document_start.tag_directives.end)) &&
+            emitter->open_ended) {
+            if (!yaml_emitter_write_indicator(emitter, "...", 1, 0, 0)) return MYYAML_FAILURE;
+            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
         }
-    } else {
-        if (!yaml_emitter_write_indicator(emitter, "!<", 1, 0, 0)) return MYYAML_FAILURE;
-        if (!yaml_emitter_write_tag_content(emitter, emitter->tag_data.suffix, emitter->tag_data.suffix_length, 0)) return MYYAML_FAILURE;
-        if (!yaml_emitter_write_indicator(emitter, ">", 0, 0, 0)) return MYYAML_FAILURE;
-    }
+        emitter->open_ended = 0;
 
-    return MYYAML_SUCCESS;
-}
+        if (event->data.document_start.version_directive) {
+            implicit = 0;
+            if (!yaml_emitter_write_indicator(emitter, "%YAML", 1, 0, 0)) return MYYAML_FAILURE;
+            if (event->data.document_start.version_directive->minor == 1) {
+                if (!yaml_emitter_write_indicator(emitter, "1.1", 1, 0, 0)) return MYYAML_FAILURE;
+            } else {
+                if (!yaml_emitter_write_indicator(emitter, "1.2", 1, 0, 0)) return MYYAML_FAILURE;
+            }
+            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+        }
 
-/*
- * Write a scalar.
- */
+        if (event->data.document_start.tag_directives.start != event->data.document_start.tag_directives.end) {
+            implicit = 0;
+            for (tag_directive = event->data.document_start.tag_directives.start; tag_directive != event->data.document_start.tag_directives.end;
+                 tag_directive++) {
+                if (!yaml_emitter_write_indicator(emitter, "%TAG", 1, 0, 0)) return MYYAML_FAILURE;
+                if (!yaml_emitter_write_tag_handle(emitter, tag_directive->handle, strlen((char *)tag_directive->handle))) return MYYAML_FAILURE;
+                if (!yaml_emitter_write_tag_content(emitter, tag_directive->prefix, strlen((char *)tag_directive->prefix), 1)) return MYYAML_FAILURE;
+                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+            }
+        }
 
-static int yaml_emitter_process_scalar(YamlEmitter *emitter) {
-    switch (emitter->scalar_data.style) {
-        case YAML_PLAIN_SCALAR_STYLE:
-            return yaml_emitter_write_plain_scalar(emitter, emitter->scalar_data.value, emitter->scalar_data.length, !emitter->simple_key_context);
+        if (yaml_emitter_check_empty_document(emitter)) {
+            implicit = 0;
+        }
 
-        case YAML_SINGLE_QUOTED_SCALAR_STYLE:
-            return yaml_emitter_write_single_quoted_scalar(emitter, emitter->scalar_data.value, emitter->scalar_data.length,
-                                                           !emitter->simple_key_context);
+        if (!implicit) {
+            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+            if (!yaml_emitter_write_indicator(emitter, "---", 1, 0, 0)) return MYYAML_FAILURE;
+            if (emitter->canonical) {
+                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+            }
+        }
 
-        case YAML_DOUBLE_QUOTED_SCALAR_STYLE:
-            return yaml_emitter_write_double_quoted_scalar(emitter, emitter->scalar_data.value, emitter->scalar_data.length,
-                                                           !emitter->simple_key_context);
+        emitter->state = YAML_EMIT_DOCUMENT_CONTENT_STATE;
 
-        case YAML_LITERAL_SCALAR_STYLE:
-            return yaml_emitter_write_literal_scalar(emitter, emitter->scalar_data.value, emitter->scalar_data.length);
+        emitter->open_ended = 0;
+        return MYYAML_SUCCESS;
+    }
 
-        case YAML_FOLDED_SCALAR_STYLE:
-            return yaml_emitter_write_folded_scalar(emitter, emitter->scalar_data.value, emitter->scalar_data.length);
+    else if (event->type == YAML_STREAM_END_EVENT) {
+        /**
+         * This can happen if a block scalar with trailing empty lines
+         * is at the end of the stream
+         */
+        if (emitter->open_ended == 2) {
+            if (!yaml_emitter_write_indicator(emitter, "...", 1, 0, 0)) return MYYAML_FAILURE;
+            emitter->open_ended = 0;
+            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+        }
+        if (!yaml_emitter_flush(emitter)) return MYYAML_FAILURE;
 
-        default:
-            MYYAML_ASSERT(1); /* Impossible. */
+        emitter->state = YAML_EMIT_END_STATE;
+
+        return MYYAML_SUCCESS;
     }
 
-    return MYYAML_FAILURE;
+    return yaml_emitter_set_emitter_error(emitter, "expected DOCUMENT-START or STREAM-END");
 }
 
 /*
- * Check if a %YAML directive is valid.
+ * Expect the root node.
  */
 
-static int yaml_emitter_analyze_version_directive(YamlEmitter *emitter, YamlVersionDirective version_directive) {
-    if (version_directive.major != 1 || (version_directive.minor != 1 && version_directive.minor != 2)) {
-        return yaml_emitter_set_emitter_error(emitter, "incompatible %YAML directive");
-    }
+static int yaml_emitter_emit_document_content(YamlEmitter *emitter, YamlEvent *event) {
+    if (!PUSH(emitter, emitter->states, YAML_EMIT_DOCUMENT_END_STATE)) return MYYAML_FAILURE;
 
-    return MYYAML_SUCCESS;
+    return yaml_emitter_emit_node(emitter, event, 1, 0, 0, 0);
 }
 
 /*
- * Check if a %TAG directive is valid.
+ * Expect DOCUMENT-END.
  */
 
-static int yaml_emitter_analyze_tag_directive(YamlEmitter *emitter, YamlTagDirective tag_directive) {
-    YamlString_t handle;
-    YamlString_t prefix;
-    size_t handle_length;
-    size_t prefix_length;
-
-    handle_length = strlen((char *)tag_directive.handle);
-    prefix_length = strlen((char *)tag_directive.prefix);
-    STRING_ASSIGN(handle, tag_directive.handle, handle_length);
-    STRING_ASSIGN(prefix, tag_directive.prefix, prefix_length);
+static int yaml_emitter_emit_document_end(YamlEmitter *emitter, YamlEvent *event) {
+    if (event->type == YAML_DOCUMENT_END_EVENT) {
+        if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+        if (!event->data.document_end.implicit) {
+            if (!yaml_emitter_write_indicator(emitter, "...", 1, 0, 0)) return MYYAML_FAILURE;
+            emitter->open_ended = 0;
+            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+        } else if (!emitter->open_ended)
+            emitter->open_ended = 1;
+        if (!yaml_emitter_flush(emitter)) return MYYAML_FAILURE;
 
-    if (handle.start == handle.end) {
-        return yaml_emitter_set_emitter_error(emitter, "tag handle must not be empty");
-    }
+        emitter->state = YAML_EMIT_DOCUMENT_START_STATE;
 
-    if (handle.start[0] != '!') {
-        return yaml_emitter_set_emitter_error(emitter, "tag handle must start with '!'");
-    }
+        while (!STACK_EMPTY(emitter, emitter->tag_directives)) {
+            YamlTagDirective tag_directive = POP(emitter, emitter->tag_directives);
+            _myyaml_free(emitter->allocator, tag_directive.handle);
+            _myyaml_free(emitter->allocator, tag_directive.prefix);
+        }
 
-    if (handle.end[-1] != '!') {
-        return yaml_emitter_set_emitter_error(emitter, "tag handle must end with '!'");
+        return MYYAML_SUCCESS;
     }
 
-    handle.pointer++;
+    return yaml_emitter_set_emitter_error(emitter, "expected DOCUMENT-END");
+}
 
-    while (handle.pointer < handle.end - 1) {
-        if (!IS_ALPHA(handle)) {
-            return yaml_emitter_set_emitter_error(emitter, "tag handle must contain alphanumerical characters only");
+/*
+ *
+ * Expect a flow item node.
+ */
+
+static int yaml_emitter_emit_flow_sequence_item(YamlEmitter *emitter, YamlEvent *event, int first) {
+    if (first) {
+        if (!yaml_emitter_write_indicator(emitter, "[", 1, 1, 0)) return MYYAML_FAILURE;
+        if (!yaml_emitter_increase_indent(emitter, 1, 0)) return MYYAML_FAILURE;
+        emitter->flow_level++;
+    }
+
+    if (event->type == YAML_SEQUENCE_END_EVENT) {
+        emitter->flow_level--;
+        emitter->indent = POP(emitter, emitter->indents);
+        if (emitter->canonical && !first) {
+            if (!yaml_emitter_write_indicator(emitter, ",", 0, 0, 0)) return MYYAML_FAILURE;
+            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
         }
-        MOVE(handle);
+        if (!yaml_emitter_write_indicator(emitter, "]", 0, 0, 0)) return MYYAML_FAILURE;
+        emitter->state = POP(emitter, emitter->states);
+
+        return MYYAML_SUCCESS;
     }
 
-    if (prefix.start == prefix.end) {
-        return yaml_emitter_set_emitter_error(emitter, "tag prefix must not be empty");
+    if (!first) {
+        if (!yaml_emitter_write_indicator(emitter, ",", 0, 0, 0)) return MYYAML_FAILURE;
     }
 
-    return MYYAML_SUCCESS;
+    if (emitter->canonical || emitter->column > emitter->best_width) {
+        if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+    }
+    if (!PUSH(emitter, emitter->states, YAML_EMIT_FLOW_SEQUENCE_ITEM_STATE)) return MYYAML_FAILURE;
+
+    return yaml_emitter_emit_node(emitter, event, 0, 1, 0, 0);
 }
 
 /*
- * Check if an anchor is valid.
+ * Expect a flow key node.
  */
 
-static int yaml_emitter_analyze_anchor(YamlEmitter *emitter, YamlChar_t *anchor, int alias) {
-    size_t anchor_length;
-    YamlString_t string;
+static int yaml_emitter_emit_flow_mapping_key(YamlEmitter *emitter, YamlEvent *event, int first) {
+    if (first) {
+        if (!yaml_emitter_write_indicator(emitter, "{", 1, 1, 0)) return MYYAML_FAILURE;
+        if (!yaml_emitter_increase_indent(emitter, 1, 0)) return MYYAML_FAILURE;
+        emitter->flow_level++;
+    }
 
-    anchor_length = strlen((char *)anchor);
-    STRING_ASSIGN(string, anchor, anchor_length);
+    if (event->type == YAML_MAPPING_END_EVENT) {
+        emitter->flow_level--;
+        emitter->indent = POP(emitter, emitter->indents);
+        if (emitter->canonical && !first) {
+            if (!yaml_emitter_write_indicator(emitter, ",", 0, 0, 0)) return MYYAML_FAILURE;
+            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+        }
+        if (!yaml_emitter_write_indicator(emitter, "}", 0, 0, 0)) return MYYAML_FAILURE;
+        emitter->state = POP(emitter, emitter->states);
 
-    if (string.start == string.end) {
-        return yaml_emitter_set_emitter_error(emitter, alias ? "alias value must not be empty" : "anchor value must not be empty");
+        return MYYAML_SUCCESS;
     }
 
-    while (string.pointer != string.end) {
-        if (!IS_ALPHA(string)) {
-            return yaml_emitter_set_emitter_error(emitter, alias ? "alias value must contain alphanumerical characters only"
-                                                                 : "anchor value must contain alphanumerical characters "
-                                                                   "only");
-        }
-        MOVE(string);
+    if (!first) {
+        if (!yaml_emitter_write_indicator(emitter, ",", 0, 0, 0)) return MYYAML_FAILURE;
+    }
+    if (emitter->canonical || emitter->column > emitter->best_width) {
+        if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
     }
 
-    emitter->anchor_data.anchor = string.start;
-    emitter->anchor_data.anchor_length = string.end - string.start;
-    emitter->anchor_data.alias = alias;
+    if (!emitter->canonical && yaml_emitter_check_simple_key(emitter)) {
+        if (!PUSH(emitter, emitter->states, YAML_EMIT_FLOW_MAPPING_SIMPLE_VALUE_STATE)) return MYYAML_FAILURE;
 
-    return MYYAML_SUCCESS;
+        return yaml_emitter_emit_node(emitter, event, 0, 0, 1, 1);
+    } else {
+        if (!yaml_emitter_write_indicator(emitter, "?", 1, 0, 0)) return MYYAML_FAILURE;
+        if (!PUSH(emitter, emitter->states, YAML_EMIT_FLOW_MAPPING_VALUE_STATE)) return MYYAML_FAILURE;
+
+        return yaml_emitter_emit_node(emitter, event, 0, 0, 1, 0);
+    }
 }
 
 /*
- * Check if a tag is valid.
+ * Expect a flow value node.
  */
 
-static int yaml_emitter_analyze_tag(YamlEmitter *emitter, YamlChar_t *tag) {
-    size_t tag_length;
-    YamlString_t string;
-    YamlTagDirective *tag_directive;
+static int yaml_emitter_emit_flow_mapping_value(YamlEmitter *emitter, YamlEvent *event, int simple) {
+    if (simple) {
+        if (!yaml_emitter_write_indicator(emitter, ":", 0, 0, 0)) return MYYAML_FAILURE;
+    } else {
+        if (emitter->canonical || emitter->column > emitter->best_width) {
+            if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+        }
+        if (!yaml_emitter_write_indicator(emitter, ":", 1, 0, 0)) return MYYAML_FAILURE;
+    }
+    if (!PUSH(emitter, emitter->states, YAML_EMIT_FLOW_MAPPING_KEY_STATE)) return MYYAML_FAILURE;
+    return yaml_emitter_emit_node(emitter, event, 0, 0, 1, 0);
+}
 
-    tag_length = strlen((char *)tag);
-    STRING_ASSIGN(string, tag, tag_length);
+/*
+ * Expect a block item node.
+ */
 
-    if (string.start == string.end) {
-        return yaml_emitter_set_emitter_error(emitter, "tag value must not be empty");
+static int yaml_emitter_emit_block_sequence_item(YamlEmitter *emitter, YamlEvent *event, int first) {
+    if (first) {
+        if (!yaml_emitter_increase_indent(emitter, 0, (emitter->mapping_context && !emitter->indention))) return MYYAML_FAILURE;
     }
 
-    for (tag_directive = emitter->tag_directives.start; tag_directive != emitter->tag_directives.top; tag_directive++) {
-        size_t prefix_length = strlen((char *)tag_directive->prefix);
-        if (prefix_length < (size_t)(string.end - string.start) && strncmp((char *)tag_directive->prefix, (char *)string.start, prefix_length) == 0) {
-            emitter->tag_data.handle = tag_directive->handle;
-            emitter->tag_data.handle_length = strlen((char *)tag_directive->handle);
-            emitter->tag_data.suffix = string.start + prefix_length;
-            emitter->tag_data.suffix_length = (string.end - string.start) - prefix_length;
-            return MYYAML_SUCCESS;
-        }
+    if (event->type == YAML_SEQUENCE_END_EVENT) {
+        emitter->indent = POP(emitter, emitter->indents);
+        emitter->state = POP(emitter, emitter->states);
+
+        return MYYAML_SUCCESS;
     }
 
-    emitter->tag_data.suffix = string.start;
-    emitter->tag_data.suffix_length = string.end - string.start;
+    if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+    if (!yaml_emitter_write_indicator(emitter, "-", 1, 0, 1)) return MYYAML_FAILURE;
+    if (!PUSH(emitter, emitter->states, YAML_EMIT_BLOCK_SEQUENCE_ITEM_STATE)) return MYYAML_FAILURE;
 
-    return MYYAML_SUCCESS;
+    return yaml_emitter_emit_node(emitter, event, 0, 1, 0, 0);
 }
 
 /*
- * Check if a scalar is valid.
+ * Expect a block key node.
  */
 
-static int yaml_emitter_analyze_scalar(YamlEmitter *emitter, YamlChar_t *value, size_t length) {
-    YamlString_t string;
-
-    int block_indicators = 0;
-    int flow_indicators = 0;
-    int line_breaks = 0;
-    int special_characters = 0;
+static int yaml_emitter_emit_block_mapping_key(YamlEmitter *emitter, YamlEvent *event, int first) {
+    if (first) {
+        if (!yaml_emitter_increase_indent(emitter, 0, 0)) return MYYAML_FAILURE;
+    }
 
-    int leading_space = 0;
-    int leading_break = 0;
-    int trailing_space = 0;
-    int trailing_break = 0;
-    int break_space = 0;
-    int space_break = 0;
+    if (event->type == YAML_MAPPING_END_EVENT) {
+        emitter->indent = POP(emitter, emitter->indents);
+        emitter->state = POP(emitter, emitter->states);
 
-    int preceded_by_whitespace = 0;
-    int followed_by_whitespace = 0;
-    int previous_space = 0;
-    int previous_break = 0;
+        return MYYAML_SUCCESS;
+    }
 
-    STRING_ASSIGN(string, value, length);
+    if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
 
-    emitter->scalar_data.value = value;
-    emitter->scalar_data.length = length;
+    if (yaml_emitter_check_simple_key(emitter)) {
+        if (!PUSH(emitter, emitter->states, YAML_EMIT_BLOCK_MAPPING_SIMPLE_VALUE_STATE)) return MYYAML_FAILURE;
 
-    if (string.start == string.end) {
-        emitter->scalar_data.multiline = 0;
-        emitter->scalar_data.flow_plain_allowed = 0;
-        emitter->scalar_data.block_plain_allowed = 1;
-        emitter->scalar_data.single_quoted_allowed = 1;
-        emitter->scalar_data.block_allowed = 0;
+        return yaml_emitter_emit_node(emitter, event, 0, 0, 1, 1);
+    } else {
+        if (!yaml_emitter_write_indicator(emitter, "?", 1, 0, 1)) return MYYAML_FAILURE;
+        if (!PUSH(emitter, emitter->states, YAML_EMIT_BLOCK_MAPPING_VALUE_STATE)) return MYYAML_FAILURE;
 
-        return MYYAML_SUCCESS;
+        return yaml_emitter_emit_node(emitter, event, 0, 0, 1, 0);
     }
+}
 
-    if ((CHECK_AT(string, '-', 0) && CHECK_AT(string, '-', 1) && CHECK_AT(string, '-', 2)) ||
-        (CHECK_AT(string, '.', 0) && CHECK_AT(string, '.', 1) && CHECK_AT(string, '.', 2))) {
-        block_indicators = 1;
-        flow_indicators = 1;
+/*
+ * Expect a block value node.
+ */
+
+static int yaml_emitter_emit_block_mapping_value(YamlEmitter *emitter, YamlEvent *event, int simple) {
+    if (simple) {
+        if (!yaml_emitter_write_indicator(emitter, ":", 0, 0, 0)) return MYYAML_FAILURE;
+    } else {
+        if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+        if (!yaml_emitter_write_indicator(emitter, ":", 1, 0, 1)) return MYYAML_FAILURE;
     }
+    if (!PUSH(emitter, emitter->states, YAML_EMIT_BLOCK_MAPPING_KEY_STATE)) return MYYAML_FAILURE;
 
-    preceded_by_whitespace = 1;
-    followed_by_whitespace = IS_BLANKZ_AT(string, WIDTH(string));
+    return yaml_emitter_emit_node(emitter, event, 0, 0, 1, 0);
+}
 
-    while (string.pointer != string.end) {
-        if (string.start == string.pointer) {
-            if (CHECK(string, '#') || CHECK(string, ',') || CHECK(string, '[') || CHECK(string, ']') || CHECK(string, '{') || CHECK(string, '}') ||
-                CHECK(string, '&') || CHECK(string, '*') || CHECK(string, '!') || CHECK(string, '|') || CHECK(string, '>') || CHECK(string, '\'') ||
-                CHECK(string, '"') || CHECK(string, '%') || CHECK(string, '@') || CHECK(string, '`')) {
-                flow_indicators = 1;
-                block_indicators = 1;
-            }
+/*
+ * Expect a node.
+ */
 
-            if (CHECK(string, '?') || CHECK(string, ':')) {
-                flow_indicators = 1;
-                if (followed_by_whitespace) {
-                    block_indicators = 1;
-                }
-            }
+static int yaml_emitter_emit_node(YamlEmitter *emitter, YamlEvent *event, int root, int sequence, int mapping, int simple_key) {
+    emitter->root_context = root;
+    emitter->sequence_context = sequence;
+    emitter->mapping_context = mapping;
+    emitter->simple_key_context = simple_key;
 
-            if (CHECK(string, '-') && followed_by_whitespace) {
-                flow_indicators = 1;
-                block_indicators = 1;
-            }
-        } else {
-            if (CHECK(string, ',') || CHECK(string, '?') || CHECK(string, '[') || CHECK(string, ']') || CHECK(string, '{') || CHECK(string, '}')) {
-                flow_indicators = 1;
-            }
+    switch (event->type) {
+        case YAML_ALIAS_EVENT:
+            return yaml_emitter_emit_alias(emitter, event);
 
-            if (CHECK(string, ':')) {
-                flow_indicators = 1;
-                if (followed_by_whitespace) {
-                    block_indicators = 1;
-                }
-            }
+        case YAML_SCALAR_EVENT:
+            return yaml_emitter_emit_scalar(emitter, event);
 
-            if (CHECK(string, '#') && preceded_by_whitespace) {
-                flow_indicators = 1;
-                block_indicators = 1;
-            }
-        }
+        case YAML_SEQUENCE_START_EVENT:
+            return yaml_emitter_emit_sequence_start(emitter, event);
 
-        if (!IS_PRINTABLE(string) || (!IS_ASCII(string) && !emitter->unicode)) {
-            special_characters = 1;
-        }
+        case YAML_MAPPING_START_EVENT:
+            return yaml_emitter_emit_mapping_start(emitter, event);
 
-        if (IS_BREAK(string)) {
-            line_breaks = 1;
-        }
+        default:
+            return yaml_emitter_set_emitter_error(emitter, "expected SCALAR, SEQUENCE-START, MAPPING-START, or ALIAS");
+    }
 
-        if (IS_SPACE(string)) {
-            if (string.start == string.pointer) {
-                leading_space = 1;
-            }
-            if (string.pointer + WIDTH(string) == string.end) {
-                trailing_space = 1;
-            }
-            if (previous_break) {
-                break_space = 1;
-            }
-            previous_space = 1;
-            previous_break = 0;
-        } else if (IS_BREAK(string)) {
-            if (string.start == string.pointer) {
-                leading_break = 1;
-            }
-            if (string.pointer + WIDTH(string) == string.end) {
-                trailing_break = 1;
-            }
-            if (previous_space) {
-                space_break = 1;
-            }
-            previous_space = 0;
-            previous_break = 1;
-        } else {
-            previous_space = 0;
-            previous_break = 0;
-        }
+    return MYYAML_FAILURE;
+}
 
-        preceded_by_whitespace = IS_BLANKZ(string);
-        MOVE(string);
-        if (string.pointer != string.end) {
-            followed_by_whitespace = IS_BLANKZ_AT(string, WIDTH(string));
-        }
-    }
+/*
+ * Expect ALIAS.
+ */
 
-    emitter->scalar_data.multiline = line_breaks;
+static int yaml_emitter_emit_alias(YamlEmitter *emitter, SHIM(YamlEvent *event)) {
+    if (!yaml_emitter_process_anchor(emitter)) return MYYAML_FAILURE;
+    if (emitter->simple_key_context)
+        if (!PUT(emitter, ' ')) return MYYAML_FAILURE;
+    emitter->state = POP(emitter, emitter->states);
 
-    emitter->scalar_data.flow_plain_allowed = 1;
-    emitter->scalar_data.block_plain_allowed = 1;
-    emitter->scalar_data.single_quoted_allowed = 1;
-    emitter->scalar_data.block_allowed = 1;
+    return MYYAML_SUCCESS;
+}
 
-    if (leading_space || leading_break || trailing_space || trailing_break) {
-        emitter->scalar_data.flow_plain_allowed = 0;
-        emitter->scalar_data.block_plain_allowed = 0;
-    }
+/*
+ * Expect SCALAR.
+ */
 
-    if (trailing_space) {
-        emitter->scalar_data.block_allowed = 0;
-    }
+static int yaml_emitter_emit_scalar(YamlEmitter *emitter, YamlEvent *event) {
+    if (!yaml_emitter_select_scalar_style(emitter, event)) return MYYAML_FAILURE;
+    if (!yaml_emitter_process_anchor(emitter)) return MYYAML_FAILURE;
+    if (!yaml_emitter_process_tag(emitter)) return MYYAML_FAILURE;
+    if (!yaml_emitter_increase_indent(emitter, 1, 0)) return MYYAML_FAILURE;
+    if (!yaml_emitter_process_scalar(emitter)) return MYYAML_FAILURE;
+    emitter->indent = POP(emitter, emitter->indents);
+    emitter->state = POP(emitter, emitter->states);
 
-    if (break_space) {
-        emitter->scalar_data.flow_plain_allowed = 0;
-        emitter->scalar_data.block_plain_allowed = 0;
-        emitter->scalar_data.single_quoted_allowed = 0;
-    }
+    return MYYAML_SUCCESS;
+}
 
-    if (space_break || special_characters) {
-        emitter->scalar_data.flow_plain_allowed = 0;
-        emitter->scalar_data.block_plain_allowed = 0;
-        emitter->scalar_data.single_quoted_allowed = 0;
-        emitter->scalar_data.block_allowed = 0;
-    }
+/*
+ * Expect SEQUENCE-START.
+ */
 
-    if (line_breaks) {
-        emitter->scalar_data.flow_plain_allowed = 0;
-        emitter->scalar_data.block_plain_allowed = 0;
-    }
+static int yaml_emitter_emit_sequence_start(YamlEmitter *emitter, YamlEvent *event) {
+    if (!yaml_emitter_process_anchor(emitter)) return MYYAML_FAILURE;
+    if (!yaml_emitter_process_tag(emitter)) return MYYAML_FAILURE;
 
-    if (flow_indicators) {
-        emitter->scalar_data.flow_plain_allowed = 0;
+    if (emitter->flow_level || emitter->canonical || event->data.sequence_start.style == YAML_FLOW_SEQUENCE_STYLE ||
+        yaml_emitter_check_empty_sequence(emitter)) {
+        emitter->state = YAML_EMIT_FLOW_SEQUENCE_FIRST_ITEM_STATE;
+    } else {
+        emitter->state = YAML_EMIT_BLOCK_SEQUENCE_FIRST_ITEM_STATE;
     }
 
-    if (block_indicators) {
-        emitter->scalar_data.block_plain_allowed = 0;
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Expect MAPPING-START.
+ */
+
+static int yaml_emitter_emit_mapping_start(YamlEmitter *emitter, YamlEvent *event) {
+    if (!yaml_emitter_process_anchor(emitter)) return MYYAML_FAILURE;
+    if (!yaml_emitter_process_tag(emitter)) return MYYAML_FAILURE;
+
+    if (emitter->flow_level || emitter->canonical || event->data.mapping_start.style == YAML_FLOW_MAPPING_STYLE ||
+        yaml_emitter_check_empty_mapping(emitter)) {
+        emitter->state = YAML_EMIT_FLOW_MAPPING_FIRST_KEY_STATE;
+    } else {
+        emitter->state = YAML_EMIT_BLOCK_MAPPING_FIRST_KEY_STATE;
     }
 
     return MYYAML_SUCCESS;
 }
 
 /*
- * Check if the event data is valid.
+ * Check if the document content is an empty scalar.
  */
 
-static int yaml_emitter_analyze_event(YamlEmitter *emitter, YamlEvent *event) {
-    emitter->anchor_data.anchor = NULL;
-    emitter->anchor_data.anchor_length = 0;
-    emitter->tag_data.handle = NULL;
-    emitter->tag_data.handle_length = 0;
-    emitter->tag_data.suffix = NULL;
-    emitter->tag_data.suffix_length = 0;
-    emitter->scalar_data.value = NULL;
-    emitter->scalar_data.length = 0;
+static int yaml_emitter_check_empty_document(SHIM(YamlEmitter *emitter)) { return MYYAML_FAILURE; }
+
+/*
+ * Check if the next events represent an empty sequence.
+ */
+
+static int yaml_emitter_check_empty_sequence(YamlEmitter *emitter) {
+    if (QUEUE_LENGTH(emitter, emitter->events) < 2) return MYYAML_FAILURE;
+
+    return (QUEUE_AT(emitter, emitter->events, 0).type == YAML_SEQUENCE_START_EVENT &&
+            QUEUE_AT(emitter, emitter->events, 1).type == YAML_SEQUENCE_END_EVENT);
+}
+
+/*
+ * Check if the next events represent an empty mapping.
+ */
+
+static int yaml_emitter_check_empty_mapping(YamlEmitter *emitter) {
+    if (QUEUE_LENGTH(emitter, emitter->events) < 2) return MYYAML_FAILURE;
+
+    return (QUEUE_AT(emitter, emitter->events, 0).type == YAML_MAPPING_START_EVENT &&
+            QUEUE_AT(emitter, emitter->events, 1).type == YAML_MAPPING_END_EVENT);
+}
+
+/*
+ * Check if the next node can be expressed as a simple key.
+ */
+
+static int yaml_emitter_check_simple_key(YamlEmitter *emitter) {
+    YamlEvent *event = &QUEUE_AT(emitter, emitter->events, 0);
+    size_t length = 0;
 
     switch (event->type) {
         case YAML_ALIAS_EVENT:
-            if (!yaml_emitter_analyze_anchor(emitter, event->data.alias.anchor, 1)) return MYYAML_FAILURE;
-            return MYYAML_SUCCESS;
+            length += emitter->anchor_data.anchor_length;
+            break;
 
         case YAML_SCALAR_EVENT:
-            if (event->data.scalar.anchor) {
-                if (!yaml_emitter_analyze_anchor(emitter, event->data.scalar.anchor, 0)) return MYYAML_FAILURE;
-            }
-            if (event->data.scalar.tag && (emitter->canonical || (!event->data.scalar.plain_implicit && !event->data.scalar.quoted_implicit))) {
-                if (!yaml_emitter_analyze_tag(emitter, event->data.scalar.tag)) return MYYAML_FAILURE;
-            }
-            if (!yaml_emitter_analyze_scalar(emitter, event->data.scalar.value, event->data.scalar.length)) return MYYAML_FAILURE;
-            return MYYAML_SUCCESS;
+            if (emitter->scalar_data.multiline) return MYYAML_FAILURE;
+            length +=
+                emitter->anchor_data.anchor_length + emitter->tag_data.handle_length + emitter->tag_data.suffix_length + emitter->scalar_data.length;
+            break;
 
         case YAML_SEQUENCE_START_EVENT:
-            if (event->data.sequence_start.anchor) {
-                if (!yaml_emitter_analyze_anchor(emitter, event->data.sequence_start.anchor, 0)) return MYYAML_FAILURE;
-            }
-            if (event->data.sequence_start.tag && (emitter->canonical || !event->data.sequence_start.implicit)) {
-                if (!yaml_emitter_analyze_tag(emitter, event->data.sequence_start.tag)) return MYYAML_FAILURE;
-            }
-            return MYYAML_SUCCESS;
+            if (!yaml_emitter_check_empty_sequence(emitter)) return MYYAML_FAILURE;
+            length += emitter->anchor_data.anchor_length + emitter->tag_data.handle_length + emitter->tag_data.suffix_length;
+            break;
 
         case YAML_MAPPING_START_EVENT:
-            if (event->data.mapping_start.anchor) {
-                if (!yaml_emitter_analyze_anchor(emitter, event->data.mapping_start.anchor, 0)) return MYYAML_FAILURE;
-            }
-            if (event->data.mapping_start.tag && (emitter->canonical || !event->data.mapping_start.implicit)) {
-                if (!yaml_emitter_analyze_tag(emitter, event->data.mapping_start.tag)) return MYYAML_FAILURE;
-            }
-            return MYYAML_SUCCESS;
+            if (!yaml_emitter_check_empty_mapping(emitter)) return MYYAML_FAILURE;
+            length += emitter->anchor_data.anchor_length + emitter->tag_data.handle_length + emitter->tag_data.suffix_length;
+            break;
 
         default:
-            return MYYAML_SUCCESS;
+            return MYYAML_FAILURE;
     }
-}
-
-/*
- * Write the BOM character.
- */
 
-static int yaml_emitter_write_bom(YamlEmitter *emitter) {
-    if (!FLUSH(emitter)) return MYYAML_FAILURE;
-
-    *(emitter->buffer.pointer++) = (YamlChar_t)'\xEF';
-    *(emitter->buffer.pointer++) = (YamlChar_t)'\xBB';
-    *(emitter->buffer.pointer++) = (YamlChar_t)'\xBF';
+    if (length > 128) return MYYAML_FAILURE;
 
     return MYYAML_SUCCESS;
 }
 
-static int yaml_emitter_write_indent(YamlEmitter *emitter) {
-    int indent = (emitter->indent >= 0) ? emitter->indent : 0;
+/*
+ * Determine an acceptable scalar style.
+ */
 
-    if (!emitter->indention || emitter->column > indent || (emitter->column == indent && !emitter->whitespace)) {
-        if (!PUT_BREAK(emitter)) return MYYAML_FAILURE;
-    }
+static int yaml_emitter_select_scalar_style(YamlEmitter *emitter, YamlEvent *event) {
+    YamlScalarStyle style = event->data.scalar.style;
+    int no_tag = (!emitter->tag_data.handle && !emitter->tag_data.suffix);
 
-    while (emitter->column < indent) {
-        if (!PUT(emitter, ' ')) return MYYAML_FAILURE;
+    if (no_tag && !event->data.scalar.plain_implicit && !event->data.scalar.quoted_implicit) {
+        return yaml_emitter_set_emitter_error(emitter, "neither tag nor implicit flags are specified");
     }
 
-    emitter->whitespace = 1;
-    emitter->indention = 1;
+    if (style == YAML_ANY_SCALAR_STYLE) style = YAML_PLAIN_SCALAR_STYLE;
 
-    return MYYAML_SUCCESS;
-}
+    if (emitter->canonical) style = YAML_DOUBLE_QUOTED_SCALAR_STYLE;
 
-static int yaml_emitter_write_indicator(YamlEmitter *emitter, const char *indicator, int need_whitespace, int is_whitespace, int is_indention) {
-    size_t indicator_length;
-    YamlString_t string;
+    if (emitter->simple_key_context && emitter->scalar_data.multiline) style = YAML_DOUBLE_QUOTED_SCALAR_STYLE;
 
-    indicator_length = strlen(indicator);
-    STRING_ASSIGN(string, (YamlChar_t *)indicator, indicator_length);
+    if (style == YAML_PLAIN_SCALAR_STYLE) {
+        if ((emitter->flow_level && !emitter->scalar_data.flow_plain_allowed) || (!emitter->flow_level && !emitter->scalar_data.block_plain_allowed))
+            style = YAML_SINGLE_QUOTED_SCALAR_STYLE;
+        if (!emitter->scalar_data.length && (emitter->flow_level || emitter->simple_key_context)) style = YAML_SINGLE_QUOTED_SCALAR_STYLE;
+        if (no_tag && !event->data.scalar.plain_implicit) style = YAML_SINGLE_QUOTED_SCALAR_STYLE;
+    }
 
-    if (need_whitespace && !emitter->whitespace) {
-        if (!PUT(emitter, ' ')) return MYYAML_FAILURE;
+    if (style == YAML_SINGLE_QUOTED_SCALAR_STYLE) {
+        if (!emitter->scalar_data.single_quoted_allowed) style = YAML_DOUBLE_QUOTED_SCALAR_STYLE;
     }
 
-    while (string.pointer != string.end) {
-        if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+    if (style == YAML_LITERAL_SCALAR_STYLE || style == YAML_FOLDED_SCALAR_STYLE) {
+        if (!emitter->scalar_data.block_allowed || emitter->flow_level || emitter->simple_key_context) style = YAML_DOUBLE_QUOTED_SCALAR_STYLE;
     }
 
-    emitter->whitespace = is_whitespace;
-    emitter->indention = (emitter->indention && is_indention);
+    if (no_tag && !event->data.scalar.quoted_implicit && style != YAML_PLAIN_SCALAR_STYLE) {
+        emitter->tag_data.handle = (YamlChar_t *)"!";
+        emitter->tag_data.handle_length = 1;
+    }
+
+    emitter->scalar_data.style = style;
 
     return MYYAML_SUCCESS;
 }
 
-static int yaml_emitter_write_anchor(YamlEmitter *emitter, YamlChar_t *value, size_t length) {
-    YamlString_t string;
-    STRING_ASSIGN(string, value, length);
+/*
+ * Write an anchor.
+ */
 
-    while (string.pointer != string.end) {
-        if (!WRITE(emitter, string)) return MYYAML_FAILURE;
-    }
+static int yaml_emitter_process_anchor(YamlEmitter *emitter) {
+    if (!emitter->anchor_data.anchor) return MYYAML_SUCCESS;
 
-    emitter->whitespace = 0;
-    emitter->indention = 0;
+    if (!yaml_emitter_write_indicator(emitter, (emitter->anchor_data.alias ? "*" : "&"), 1, 0, 0)) return MYYAML_FAILURE;
 
-    return MYYAML_SUCCESS;
+    return yaml_emitter_write_anchor(emitter, emitter->anchor_data.anchor, emitter->anchor_data.anchor_length);
 }
 
-static int yaml_emitter_write_tag_handle(YamlEmitter *emitter, YamlChar_t *value, size_t length) {
-    YamlString_t string;
-    STRING_ASSIGN(string, value, length);
+/*
+ * Write a tag.
+ */
 
-    if (!emitter->whitespace) {
-        if (!PUT(emitter, ' ')) return MYYAML_FAILURE;
+static int yaml_emitter_process_tag(YamlEmitter *emitter) {
+    if (!emitter->tag_data.handle && !emitter->tag_data.suffix) return MYYAML_SUCCESS;
+
+    if (emitter->tag_data.handle) {
+        if (!yaml_emitter_write_tag_handle(emitter, emitter->tag_data.handle, emitter->tag_data.handle_length)) return MYYAML_FAILURE;
+        if (emitter->tag_data.suffix) {
+            if (!yaml_emitter_write_tag_content(emitter, emitter->tag_data.suffix, emitter->tag_data.suffix_length, 0)) return MYYAML_FAILURE;
+        }
+    } else {
+        if (!yaml_emitter_write_indicator(emitter, "!<", 1, 0, 0)) return MYYAML_FAILURE;
+        if (!yaml_emitter_write_tag_content(emitter, emitter->tag_data.suffix, emitter->tag_data.suffix_length, 0)) return MYYAML_FAILURE;
+        if (!yaml_emitter_write_indicator(emitter, ">", 0, 0, 0)) return MYYAML_FAILURE;
     }
 
-    while (string.pointer != string.end) {
-        if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Write a scalar.
+ */
+
+static int yaml_emitter_process_scalar(YamlEmitter *emitter) {
+    switch (emitter->scalar_data.style) {
+        case YAML_PLAIN_SCALAR_STYLE:
+            return yaml_emitter_write_plain_scalar(emitter, emitter->scalar_data.value, emitter->scalar_data.length, !emitter->simple_key_context);
+
+        case YAML_SINGLE_QUOTED_SCALAR_STYLE:
+            return yaml_emitter_write_single_quoted_scalar(emitter, emitter->scalar_data.value, emitter->scalar_data.length,
+                                                           !emitter->simple_key_context);
+
+        case YAML_DOUBLE_QUOTED_SCALAR_STYLE:
+            return yaml_emitter_write_double_quoted_scalar(emitter, emitter->scalar_data.value, emitter->scalar_data.length,
+                                                           !emitter->simple_key_context);
+
+        case YAML_LITERAL_SCALAR_STYLE:
+            return yaml_emitter_write_literal_scalar(emitter, emitter->scalar_data.value, emitter->scalar_data.length);
+
+        case YAML_FOLDED_SCALAR_STYLE:
+            return yaml_emitter_write_folded_scalar(emitter, emitter->scalar_data.value, emitter->scalar_data.length);
+
+        default:
+            MYYAML_ASSERT(1); /* Impossible. */
     }
 
-    emitter->whitespace = 0;
-    emitter->indention = 0;
+    return MYYAML_FAILURE;
+}
+
+/*
+ * Check if a %YAML directive is valid.
+ */
+
+static int yaml_emitter_analyze_version_directive(YamlEmitter *emitter, YamlVersionDirective version_directive) {
+    if (version_directive.major != 1 || (version_directive.minor != 1 && version_directive.minor != 2)) {
+        return yaml_emitter_set_emitter_error(emitter, "incompatible %YAML directive");
+    }
 
     return MYYAML_SUCCESS;
 }
 
-static int yaml_emitter_write_tag_content(YamlEmitter *emitter, YamlChar_t *value, size_t length, int need_whitespace) {
-    YamlString_t string;
-    STRING_ASSIGN(string, value, length);
+/*
+ * Check if a %TAG directive is valid.
+ */
 
-    if (need_whitespace && !emitter->whitespace) {
-        if (!PUT(emitter, ' ')) return MYYAML_FAILURE;
+static int yaml_emitter_analyze_tag_directive(YamlEmitter *emitter, YamlTagDirective tag_directive) {
+    YamlString_t handle;
+    YamlString_t prefix;
+    size_t handle_length;
+    size_t prefix_length;
+
+    handle_length = strlen((char *)tag_directive.handle);
+    prefix_length = strlen((char *)tag_directive.prefix);
+    STRING_ASSIGN(handle, tag_directive.handle, handle_length);
+    STRING_ASSIGN(prefix, tag_directive.prefix, prefix_length);
+
+    if (handle.start == handle.end) {
+        return yaml_emitter_set_emitter_error(emitter, "tag handle must not be empty");
     }
 
-    while (string.pointer != string.end) {
-        if (IS_ALPHA(string) || CHECK(string, ';') || CHECK(string, '/') || CHECK(string, '?') || CHECK(string, ':') || CHECK(string, '@') ||
-            CHECK(string, '&') || CHECK(string, '=') || CHECK(string, '+') || CHECK(string, '$') || CHECK(string, ',') || CHECK(string, '_') ||
-            CHECK(string, '.') || CHECK(string, '~') || CHECK(string, '*') || CHECK(string, '\'') || CHECK(string, '(') || CHECK(string, ')') ||
-            CHECK(string, '[') || CHECK(string, ']')) {
-            if (!WRITE(emitter, string)) return MYYAML_FAILURE;
-        } else {
-            int width = WIDTH(string);
-            unsigned int value;
-            while (width--) {
-                value = *(string.pointer++);
-                if (!PUT(emitter, '%')) return MYYAML_FAILURE;
-                if (!PUT(emitter, (value >> 4) + ((value >> 4) < 10 ? '0' : 'A' - 10))) return MYYAML_FAILURE;
-                if (!PUT(emitter, (value & 0x0F) + ((value & 0x0F) < 10 ? '0' : 'A' - 10))) return MYYAML_FAILURE;
-            }
+    if (handle.start[0] != '!') {
+        return yaml_emitter_set_emitter_error(emitter, "tag handle must start with '!'");
+    }
+
+    if (handle.end[-1] != '!') {
+        return yaml_emitter_set_emitter_error(emitter, "tag handle must end with '!'");
+    }
+
+    handle.pointer++;
+
+    while (handle.pointer < handle.end - 1) {
+        if (!IS_ALPHA(handle)) {
+            return yaml_emitter_set_emitter_error(emitter, "tag handle must contain alphanumerical characters only");
         }
+        MOVE(handle);
     }
 
-    emitter->whitespace = 0;
-    emitter->indention = 0;
+    if (prefix.start == prefix.end) {
+        return yaml_emitter_set_emitter_error(emitter, "tag prefix must not be empty");
+    }
 
     return MYYAML_SUCCESS;
 }
 
-static int yaml_emitter_write_plain_scalar(YamlEmitter *emitter, YamlChar_t *value, size_t length, int allow_breaks) {
+/*
+ * Check if an anchor is valid.
+ */
+
+static int yaml_emitter_analyze_anchor(YamlEmitter *emitter, YamlChar_t *anchor, int alias) {
+    size_t anchor_length;
     YamlString_t string;
-    int spaces = 0;
-    int breaks = 0;
 
-    STRING_ASSIGN(string, value, length);
+    anchor_length = strlen((char *)anchor);
+    STRING_ASSIGN(string, anchor, anchor_length);
 
-    /**
-     * Avoid trailing spaces for empty values in block mode.
-     * In flow mode, we still want the space to prevent ambiguous things
-     * like {a:}.
-     * Currently, the emitter forbids any plain empty scalar in flow mode
-     * (e.g. it outputs {a: ''} instead), so emitter->flow_level will
-     * never be true here.
-     * But if the emitter is ever changed to allow emitting empty values,
-     * the check for flow_level is already here.
-     */
-    if (!emitter->whitespace && (length || emitter->flow_level)) {
-        if (!PUT(emitter, ' ')) return MYYAML_FAILURE;
+    if (string.start == string.end) {
+        return yaml_emitter_set_emitter_error(emitter, alias ? "alias value must not be empty" : "anchor value must not be empty");
     }
 
     while (string.pointer != string.end) {
-        if (IS_SPACE(string)) {
-            if (allow_breaks && !spaces && emitter->column > emitter->best_width && !IS_SPACE_AT(string, 1)) {
-                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-                MOVE(string);
-            } else {
-                if (!WRITE(emitter, string)) return MYYAML_FAILURE;
-            }
-            spaces = 1;
-        } else if (IS_BREAK(string)) {
-            if (!breaks && CHECK(string, '\n')) {
-                if (!PUT_BREAK(emitter)) return MYYAML_FAILURE;
-            }
-            if (!WRITE_BREAK(emitter, string)) return MYYAML_FAILURE;
-            emitter->indention = 1;
-            breaks = 1;
-        } else {
-            if (breaks) {
-                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-            }
-            if (!WRITE(emitter, string)) return MYYAML_FAILURE;
-            emitter->indention = 0;
-            spaces = 0;
-            breaks = 0;
+        if (!IS_ALPHA(string)) {
+            return yaml_emitter_set_emitter_error(emitter, alias ? "alias value must contain alphanumerical characters only"
+                                                                 : "anchor value must contain alphanumerical characters "
+                                                                   "only");
         }
+        MOVE(string);
     }
 
-    emitter->whitespace = 0;
-    emitter->indention = 0;
+    emitter->anchor_data.anchor = string.start;
+    emitter->anchor_data.anchor_length = string.end - string.start;
+    emitter->anchor_data.alias = alias;
 
     return MYYAML_SUCCESS;
 }
 
-static int yaml_emitter_write_single_quoted_scalar(YamlEmitter *emitter, YamlChar_t *value, size_t length, int allow_breaks) {
+/*
+ * Check if a tag is valid.
+ */
+
+static int yaml_emitter_analyze_tag(YamlEmitter *emitter, YamlChar_t *tag) {
+    size_t tag_length;
     YamlString_t string;
-    int spaces = 0;
-    int breaks = 0;
+    YamlTagDirective *tag_directive;
 
-    STRING_ASSIGN(string, value, length);
+    tag_length = strlen((char *)tag);
+    STRING_ASSIGN(string, tag, tag_length);
 
-    if (!yaml_emitter_write_indicator(emitter, "'", 1, 0, 0)) return MYYAML_FAILURE;
+    if (string.start == string.end) {
+        return yaml_emitter_set_emitter_error(emitter, "tag value must not be empty");
+    }
 
-    while (string.pointer != string.end) {
-        if (IS_SPACE(string)) {
-            if (allow_breaks && !spaces && emitter->column > emitter->best_width && string.pointer != string.start &&
-                string.pointer != string.end - 1 && !IS_SPACE_AT(string, 1)) {
-                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-                MOVE(string);
-            } else {
-                if (!WRITE(emitter, string)) return MYYAML_FAILURE;
-            }
-            spaces = 1;
-        } else if (IS_BREAK(string)) {
-            if (!breaks && CHECK(string, '\n')) {
-                if (!PUT_BREAK(emitter)) return MYYAML_FAILURE;
-            }
-            if (!WRITE_BREAK(emitter, string)) return MYYAML_FAILURE;
-            emitter->indention = 1;
-            breaks = 1;
-        } else {
-            if (breaks) {
-                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-            }
-            if (CHECK(string, '\'')) {
-                if (!PUT(emitter, '\'')) return MYYAML_FAILURE;
-            }
-            if (!WRITE(emitter, string)) return MYYAML_FAILURE;
-            emitter->indention = 0;
-            spaces = 0;
-            breaks = 0;
+    for (tag_directive = emitter->tag_directives.start; tag_directive != emitter->tag_directives.top; tag_directive++) {
+        size_t prefix_length = strlen((char *)tag_directive->prefix);
+        if (prefix_length < (size_t)(string.end - string.start) && strncmp((char *)tag_directive->prefix, (char *)string.start, prefix_length) == 0) {
+            emitter->tag_data.handle = tag_directive->handle;
+            emitter->tag_data.handle_length = strlen((char *)tag_directive->handle);
+            emitter->tag_data.suffix = string.start + prefix_length;
+            emitter->tag_data.suffix_length = (string.end - string.start) - prefix_length;
+            return MYYAML_SUCCESS;
         }
     }
 
-    if (breaks)
-        if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-
-    if (!yaml_emitter_write_indicator(emitter, "'", 0, 0, 0)) return MYYAML_FAILURE;
-
-    emitter->whitespace = 0;
-    emitter->indention = 0;
+    emitter->tag_data.suffix = string.start;
+    emitter->tag_data.suffix_length = string.end - string.start;
 
     return MYYAML_SUCCESS;
 }
 
-static int yaml_emitter_write_double_quoted_scalar(YamlEmitter *emitter, YamlChar_t *value, size_t length, int allow_breaks) {
+/*
+ * Check if a scalar is valid.
+ */
+
+static int yaml_emitter_analyze_scalar(YamlEmitter *emitter, YamlChar_t *value, size_t length) {
     YamlString_t string;
-    int spaces = 0;
+
+    int block_indicators = 0;
+    int flow_indicators = 0;
+    int line_breaks = 0;
+    int special_characters = 0;
+
+    int leading_space = 0;
+    int leading_break = 0;
+    int trailing_space = 0;
+    int trailing_break = 0;
+    int break_space = 0;
+    int space_break = 0;
+
+    int preceded_by_whitespace = 0;
+    int followed_by_whitespace = 0;
+    int previous_space = 0;
+    int previous_break = 0;
 
     STRING_ASSIGN(string, value, length);
 
-    if (!yaml_emitter_write_indicator(emitter, "\"", 1, 0, 0)) return MYYAML_FAILURE;
+    emitter->scalar_data.value = value;
+    emitter->scalar_data.length = length;
+
+    if (string.start == string.end) {
+        emitter->scalar_data.multiline = 0;
+        emitter->scalar_data.flow_plain_allowed = 0;
+        emitter->scalar_data.block_plain_allowed = 1;
+        emitter->scalar_data.single_quoted_allowed = 1;
+        emitter->scalar_data.block_allowed = 0;
+
+        return MYYAML_SUCCESS;
+    }
+
+    if ((CHECK_AT(string, '-', 0) && CHECK_AT(string, '-', 1) && CHECK_AT(string, '-', 2)) ||
+        (CHECK_AT(string, '.', 0) && CHECK_AT(string, '.', 1) && CHECK_AT(string, '.', 2))) {
+        block_indicators = 1;
+        flow_indicators = 1;
+    }
+
+    preceded_by_whitespace = 1;
+    followed_by_whitespace = IS_BLANKZ_AT(string, WIDTH(string));
 
     while (string.pointer != string.end) {
-        if (!IS_PRINTABLE(string) || (!emitter->unicode && !IS_ASCII(string)) || IS_BOM(string) || IS_BREAK(string) || CHECK(string, '"') ||
-            CHECK(string, '\\')) {
-            unsigned char octet;
-            unsigned int width;
-            unsigned int value;
-            int k;
+        if (string.start == string.pointer) {
+            if (CHECK(string, '#') || CHECK(string, ',') || CHECK(string, '[') || CHECK(string, ']') || CHECK(string, '{') || CHECK(string, '}') ||
+                CHECK(string, '&') || CHECK(string, '*') || CHECK(string, '!') || CHECK(string, '|') || CHECK(string, '>') || CHECK(string, '\'') ||
+                CHECK(string, '"') || CHECK(string, '%') || CHECK(string, '@') || CHECK(string, '`')) {
+                flow_indicators = 1;
+                block_indicators = 1;
+            }
 
-            octet = string.pointer[0];
-            width = (octet & 0x80) == 0x00 ? 1 : (octet & 0xE0) == 0xC0 ? 2 : (octet & 0xF0) == 0xE0 ? 3 : (octet & 0xF8) == 0xF0 ? 4 : 0;
-            value = (octet & 0x80) == 0x00   ? octet & 0x7F
-                    : (octet & 0xE0) == 0xC0 ? octet & 0x1F
-                    : (octet & 0xF0) == 0xE0 ? octet & 0x0F
-                    : (octet & 0xF8) == 0xF0 ? octet & 0x07
-                                             : 0;
-            for (k = 1; k < (int)width; k++) {
-                octet = string.pointer[k];
-                value = (value << 6) + (octet & 0x3F);
+            if (CHECK(string, '?') || CHECK(string, ':')) {
+                flow_indicators = 1;
+                if (followed_by_whitespace) {
+                    block_indicators = 1;
+                }
             }
-            string.pointer += width;
 
-            if (!PUT(emitter, '\\')) return MYYAML_FAILURE;
+            if (CHECK(string, '-') && followed_by_whitespace) {
+                flow_indicators = 1;
+                block_indicators = 1;
+            }
+        } else {
+            if (CHECK(string, ',') || CHECK(string, '?') || CHECK(string, '[') || CHECK(string, ']') || CHECK(string, '{') || CHECK(string, '}')) {
+                flow_indicators = 1;
+            }
 
-            switch (value) {
-                case 0x00:
-                    if (!PUT(emitter, '0')) return MYYAML_FAILURE;
-                    break;
+            if (CHECK(string, ':')) {
+                flow_indicators = 1;
+                if (followed_by_whitespace) {
+                    block_indicators = 1;
+                }
+            }
 
-                case 0x07:
-                    if (!PUT(emitter, 'a')) return MYYAML_FAILURE;
-                    break;
+            if (CHECK(string, '#') && preceded_by_whitespace) {
+                flow_indicators = 1;
+                block_indicators = 1;
+            }
+        }
 
-                case 0x08:
-                    if (!PUT(emitter, 'b')) return MYYAML_FAILURE;
-                    break;
+        if (!IS_PRINTABLE(string) || (!IS_ASCII(string) && !emitter->unicode)) {
+            special_characters = 1;
+        }
+
+        if (IS_BREAK(string)) {
+            line_breaks = 1;
+        }
+
+        if (IS_SPACE(string)) {
+            if (string.start == string.pointer) {
+                leading_space = 1;
+            }
+            if (string.pointer + WIDTH(string) == string.end) {
+                trailing_space = 1;
+            }
+            if (previous_break) {
+                break_space = 1;
+            }
+            previous_space = 1;
+            previous_break = 0;
+        } else if (IS_BREAK(string)) {
+            if (string.start == string.pointer) {
+                leading_break = 1;
+            }
+            if (string.pointer + WIDTH(string) == string.end) {
+                trailing_break = 1;
+            }
+            if (previous_space) {
+                space_break = 1;
+            }
+            previous_space = 0;
+            previous_break = 1;
+        } else {
+            previous_space = 0;
+            previous_break = 0;
+        }
+
+        preceded_by_whitespace = IS_BLANKZ(string);
+        MOVE(string);
+        if (string.pointer != string.end) {
+            followed_by_whitespace = IS_BLANKZ_AT(string, WIDTH(string));
+        }
+    }
+
+    emitter->scalar_data.multiline = line_breaks;
+
+    emitter->scalar_data.flow_plain_allowed = 1;
+    emitter->scalar_data.block_plain_allowed = 1;
+    emitter->scalar_data.single_quoted_allowed = 1;
+    emitter->scalar_data.block_allowed = 1;
+
+    if (leading_space || leading_break || trailing_space || trailing_break) {
+        emitter->scalar_data.flow_plain_allowed = 0;
+        emitter->scalar_data.block_plain_allowed = 0;
+    }
+
+    if (trailing_space) {
+        emitter->scalar_data.block_allowed = 0;
+    }
+
+    if (break_space) {
+        emitter->scalar_data.flow_plain_allowed = 0;
+        emitter->scalar_data.block_plain_allowed = 0;
+        emitter->scalar_data.single_quoted_allowed = 0;
+    }
+
+    if (space_break || special_characters) {
+        emitter->scalar_data.flow_plain_allowed = 0;
+        emitter->scalar_data.block_plain_allowed = 0;
+        emitter->scalar_data.single_quoted_allowed = 0;
+        emitter->scalar_data.block_allowed = 0;
+    }
+
+    if (line_breaks) {
+        emitter->scalar_data.flow_plain_allowed = 0;
+        emitter->scalar_data.block_plain_allowed = 0;
+    }
+
+    if (flow_indicators) {
+        emitter->scalar_data.flow_plain_allowed = 0;
+    }
+
+    if (block_indicators) {
+        emitter->scalar_data.block_plain_allowed = 0;
+    }
+
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Check if the event data is valid.
+ */
+
+static int yaml_emitter_analyze_event(YamlEmitter *emitter, YamlEvent *event) {
+    emitter->anchor_data.anchor = NULL;
+    emitter->anchor_data.anchor_length = 0;
+    emitter->tag_data.handle = NULL;
+    emitter->tag_data.handle_length = 0;
+    emitter->tag_data.suffix = NULL;
+    emitter->tag_data.suffix_length = 0;
+    emitter->scalar_data.value = NULL;
+    emitter->scalar_data.length = 0;
+
+    switch (event->type) {
+        case YAML_ALIAS_EVENT:
+            if (!yaml_emitter_analyze_anchor(emitter, event->data.alias.anchor, 1)) return MYYAML_FAILURE;
+            return MYYAML_SUCCESS;
+
+        case YAML_SCALAR_EVENT:
+            if (event->data.scalar.anchor) {
+                if (!yaml_emitter_analyze_anchor(emitter, event->data.scalar.anchor, 0)) return MYYAML_FAILURE;
+            }
+            if (event->data.scalar.tag && (emitter->canonical || (!event->data.scalar.plain_implicit && !event->data.scalar.quoted_implicit))) {
+                if (!yaml_emitter_analyze_tag(emitter, event->data.scalar.tag)) return MYYAML_FAILURE;
+            }
+            if (!yaml_emitter_analyze_scalar(emitter, event->data.scalar.value, event->data.scalar.length)) return MYYAML_FAILURE;
+            return MYYAML_SUCCESS;
+
+        case YAML_SEQUENCE_START_EVENT:
+            if (event->data.sequence_start.anchor) {
+                if (!yaml_emitter_analyze_anchor(emitter, event->data.sequence_start.anchor, 0)) return MYYAML_FAILURE;
+            }
+            if (event->data.sequence_start.tag && (emitter->canonical || !event->data.sequence_start.implicit)) {
+                if (!yaml_emitter_analyze_tag(emitter, event->data.sequence_start.tag)) return MYYAML_FAILURE;
+            }
+            return MYYAML_SUCCESS;
+
+        case YAML_MAPPING_START_EVENT:
+            if (event->data.mapping_start.anchor) {
+                if (!yaml_emitter_analyze_anchor(emitter, event->data.mapping_start.anchor, 0)) return MYYAML_FAILURE;
+            }
+            if (event->data.mapping_start.tag && (emitter->canonical || !event->data.mapping_start.implicit)) {
+                if (!yaml_emitter_analyze_tag(emitter, event->data.mapping_start.tag)) return MYYAML_FAILURE;
+            }
+            return MYYAML_SUCCESS;
+
+        default:
+            return MYYAML_SUCCESS;
+    }
+}
+
+/*
+ * Write the BOM character.
+ */
+
+static int yaml_emitter_write_bom(YamlEmitter *emitter) {
+    if (!FLUSH(emitter)) return MYYAML_FAILURE;
+
+    *(emitter->buffer.pointer++) = (YamlChar_t)'\xEF';
+    *(emitter->buffer.pointer++) = (YamlChar_t)'\xBB';
+    *(emitter->buffer.pointer++) = (YamlChar_t)'\xBF';
+
+    return MYYAML_SUCCESS;
+}
+
+static int yaml_emitter_write_indent(YamlEmitter *emitter) {
+    int indent = (emitter->indent >= 0) ? emitter->indent : 0;
+
+    if (!emitter->indention || emitter->column > indent || (emitter->column == indent && !emitter->whitespace)) {
+        if (!PUT_BREAK(emitter)) return MYYAML_FAILURE;
+    }
+
+    while (emitter->column < indent) {
+        if (!PUT(emitter, ' ')) return MYYAML_FAILURE;
+    }
+
+    emitter->whitespace = 1;
+    emitter->indention = 1;
+
+    return MYYAML_SUCCESS;
+}
+
+static int yaml_emitter_write_indicator(YamlEmitter *emitter, const char *indicator, int need_whitespace, int is_whitespace, int is_indention) {
+    size_t indicator_length;
+    YamlString_t string;
+
+    indicator_length = strlen(indicator);
+    STRING_ASSIGN(string, (YamlChar_t *)indicator, indicator_length);
+
+    if (need_whitespace && !emitter->whitespace) {
+        if (!PUT(emitter, ' ')) return MYYAML_FAILURE;
+    }
+
+    while (string.pointer != string.end) {
+        if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+    }
+
+    emitter->whitespace = is_whitespace;
+    emitter->indention = (emitter->indention && is_indention);
+
+    return MYYAML_SUCCESS;
+}
+
+static int yaml_emitter_write_anchor(YamlEmitter *emitter, YamlChar_t *value, size_t length) {
+    YamlString_t string;
+    STRING_ASSIGN(string, value, length);
+
+    while (string.pointer != string.end) {
+        if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+    }
+
+    emitter->whitespace = 0;
+    emitter->indention = 0;
+
+    return MYYAML_SUCCESS;
+}
+
+static int yaml_emitter_write_tag_handle(YamlEmitter *emitter, YamlChar_t *value, size_t length) {
+    YamlString_t string;
+    STRING_ASSIGN(string, value, length);
+
+    if (!emitter->whitespace) {
+        if (!PUT(emitter, ' ')) return MYYAML_FAILURE;
+    }
+
+    while (string.pointer != string.end) {
+        if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+    }
+
+    emitter->whitespace = 0;
+    emitter->indention = 0;
+
+    return MYYAML_SUCCESS;
+}
+
+static int yaml_emitter_write_tag_content(YamlEmitter *emitter, YamlChar_t *value, size_t length, int need_whitespace) {
+    YamlString_t string;
+    STRING_ASSIGN(string, value, length);
+
+    if (need_whitespace && !emitter->whitespace) {
+        if (!PUT(emitter, ' ')) return MYYAML_FAILURE;
+    }
+
+    while (string.pointer != string.end) {
+        if (IS_ALPHA(string) || CHECK(string, ';') || CHECK(string, '/') || CHECK(string, '?') || CHECK(string, ':') || CHECK(string, '@') ||
+            CHECK(string, '&') || CHECK(string, '=') || CHECK(string, '+') || CHECK(string, '$') || CHECK(string, ',') || CHECK(string, '_') ||
+            CHECK(string, '.') || CHECK(string, '~') || CHECK(string, '*') || CHECK(string, '\'') || CHECK(string, '(') || CHECK(string, ')') ||
+            CHECK(string, '[') || CHECK(string, ']')) {
+            if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+        } else {
+            int width = WIDTH(string);
+            unsigned int value;
+            while (width--) {
+                value = *(string.pointer++);
+                if (!PUT(emitter, '%')) return MYYAML_FAILURE;
+                if (!PUT(emitter, (value >> 4) + ((value >> 4) < 10 ? '0' : 'A' - 10))) return MYYAML_FAILURE;
+                if (!PUT(emitter, (value & 0x0F) + ((value & 0x0F) < 10 ? '0' : 'A' - 10))) return MYYAML_FAILURE;
+            }
+        }
+    }
+
+    emitter->whitespace = 0;
+    emitter->indention = 0;
+
+    return MYYAML_SUCCESS;
+}
+
+static int yaml_emitter_write_plain_scalar(YamlEmitter *emitter, YamlChar_t *value, size_t length, int allow_breaks) {
+    YamlString_t string;
+    int spaces = 0;
+    int breaks = 0;
+
+    STRING_ASSIGN(string, value, length);
+
+    /**
+     * Avoid trailing spaces for empty values in block mode.
+     * In flow mode, we still want the space to prevent ambiguous things
+     * like {a:}.
+     * Currently, the emitter forbids any plain empty scalar in flow mode
+     * (e.g. it outputs {a: ''} instead), so emitter->flow_level will
+     * never be true here.
+     * But if the emitter is ever changed to allow emitting empty values,
+     * the check for flow_level is already here.
+     */
+    if (!emitter->whitespace && (length || emitter->flow_level)) {
+        if (!PUT(emitter, ' ')) return MYYAML_FAILURE;
+    }
+
+    while (string.pointer != string.end) {
+        if (IS_SPACE(string)) {
+            if (allow_breaks && !spaces && emitter->column > emitter->best_width && !IS_SPACE_AT(string, 1)) {
+                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+                MOVE(string);
+            } else {
+                if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+            }
+            spaces = 1;
+        } else if (IS_BREAK(string)) {
+            if (!breaks && CHECK(string, '\n')) {
+                if (!PUT_BREAK(emitter)) return MYYAML_FAILURE;
+            }
+            if (!WRITE_BREAK(emitter, string)) return MYYAML_FAILURE;
+            emitter->indention = 1;
+            breaks = 1;
+        } else {
+            if (breaks) {
+                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+            }
+            if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+            emitter->indention = 0;
+            spaces = 0;
+            breaks = 0;
+        }
+    }
+
+    emitter->whitespace = 0;
+    emitter->indention = 0;
+
+    return MYYAML_SUCCESS;
+}
+
+static int yaml_emitter_write_single_quoted_scalar(YamlEmitter *emitter, YamlChar_t *value, size_t length, int allow_breaks) {
+    YamlString_t string;
+    int spaces = 0;
+    int breaks = 0;
+
+    STRING_ASSIGN(string, value, length);
+
+    if (!yaml_emitter_write_indicator(emitter, "'", 1, 0, 0)) return MYYAML_FAILURE;
+
+    while (string.pointer != string.end) {
+        if (IS_SPACE(string)) {
+            if (allow_breaks && !spaces && emitter->column > emitter->best_width && string.pointer != string.start &&
+                string.pointer != string.end - 1 && !IS_SPACE_AT(string, 1)) {
+                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+                MOVE(string);
+            } else {
+                if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+            }
+            spaces = 1;
+        } else if (IS_BREAK(string)) {
+            if (!breaks && CHECK(string, '\n')) {
+                if (!PUT_BREAK(emitter)) return MYYAML_FAILURE;
+            }
+            if (!WRITE_BREAK(emitter, string)) return MYYAML_FAILURE;
+            emitter->indention = 1;
+            breaks = 1;
+        } else {
+            if (breaks) {
+                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+            }
+            if (CHECK(string, '\'')) {
+                if (!PUT(emitter, '\'')) return MYYAML_FAILURE;
+            }
+            if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+            emitter->indention = 0;
+            spaces = 0;
+            breaks = 0;
+        }
+    }
+
+    if (breaks)
+        if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+
+    if (!yaml_emitter_write_indicator(emitter, "'", 0, 0, 0)) return MYYAML_FAILURE;
+
+    emitter->whitespace = 0;
+    emitter->indention = 0;
+
+    return MYYAML_SUCCESS;
+}
+
+static int yaml_emitter_write_double_quoted_scalar(YamlEmitter *emitter, YamlChar_t *value, size_t length, int allow_breaks) {
+    YamlString_t string;
+    int spaces = 0;
+
+    STRING_ASSIGN(string, value, length);
+
+    if (!yaml_emitter_write_indicator(emitter, "\"", 1, 0, 0)) return MYYAML_FAILURE;
+
+    while (string.pointer != string.end) {
+        if (!IS_PRINTABLE(string) || (!emitter->unicode && !IS_ASCII(string)) || IS_BOM(string) || IS_BREAK(string) || CHECK(string, '"') ||
+            CHECK(string, '\\')) {
+            unsigned char octet;
+            unsigned int width;
+            unsigned int value;
+            int k;
+
+            octet = string.pointer[0];
+            width = (octet & 0x80) == 0x00 ? 1 : (octet & 0xE0) == 0xC0 ? 2 : (octet & 0xF0) == 0xE0 ? 3 : (octet & 0xF8) == 0xF0 ? 4 : 0;
+            value = (octet & 0x80) == 0x00   ? octet & 0x7F
+                    : (octet & 0xE0) == 0xC0 ? octet & 0x1F
+                    : (octet & 0xF0) == 0xE0 ? octet & 0x0F
+                    : (octet & 0xF8) == 0xF0 ? octet & 0x07
+                                             : 0;
+            for (k = 1; k < (int)width; k++) {
+                octet = string.pointer[k];
+                value = (value << 6) + (octet & 0x3F);
+            }
+            string.pointer += width;
+
+            if (!PUT(emitter, '\\')) return MYYAML_FAILURE;
+
+            switch (value) {
+                case 0x00:
+                    if (!PUT(emitter, '0')) return MYYAML_FAILURE;
+                    break;
+
+                case 0x07:
+                    if (!PUT(emitter, 'a')) return MYYAML_FAILURE;
+                    break;
+
+                case 0x08:
+                    if (!PUT(emitter, 'b')) return MYYAML_FAILURE;
+                    break;
+
+                case 0x09:
+                    if (!PUT(emitter, 't')) return MYYAML_FAILURE;
+                    break;
+
+                case 0x0A:
+                    if (!PUT(emitter, 'n')) return MYYAML_FAILURE;
+                    break;
+
+                case 0x0B:
+                    if (!PUT(emitter, 'v')) return MYYAML_FAILURE;
+                    break;
+
+                case 0x0C:
+                    if (!PUT(emitter, 'f')) return MYYAML_FAILURE;
+                    break;
+
+                case 0x0D:
+                    if (!PUT(emitter, 'r')) return MYYAML_FAILURE;
+                    break;
+
+                case 0x1B:
+                    if (!PUT(emitter, 'e')) return MYYAML_FAILURE;
+                    break;
+
+                case 0x22:
+                    if (!PUT(emitter, '\"')) return MYYAML_FAILURE;
+                    break;
+
+                case 0x5C:
+                    if (!PUT(emitter, '\\')) return MYYAML_FAILURE;
+                    break;
+
+                case 0x85:
+                    if (!PUT(emitter, 'N')) return MYYAML_FAILURE;
+                    break;
+
+                case 0xA0:
+                    if (!PUT(emitter, '_')) return MYYAML_FAILURE;
+                    break;
+
+                case 0x2028:
+                    if (!PUT(emitter, 'L')) return MYYAML_FAILURE;
+                    break;
+
+                case 0x2029:
+                    if (!PUT(emitter, 'P')) return MYYAML_FAILURE;
+                    break;
+
+                default:
+                    if (value <= 0xFF) {
+                        if (!PUT(emitter, 'x')) return MYYAML_FAILURE;
+                        width = 2;
+                    } else if (value <= 0xFFFF) {
+                        if (!PUT(emitter, 'u')) return MYYAML_FAILURE;
+                        width = 4;
+                    } else {
+                        if (!PUT(emitter, 'U')) return MYYAML_FAILURE;
+                        width = 8;
+                    }
+                    for (k = (width - 1) * 4; k >= 0; k -= 4) {
+                        int digit = (value >> k) & 0x0F;
+                        if (!PUT(emitter, digit + (digit < 10 ? '0' : 'A' - 10))) return MYYAML_FAILURE;
+                    }
+            }
+            spaces = 0;
+        } else if (IS_SPACE(string)) {
+            if (allow_breaks && !spaces && emitter->column > emitter->best_width && string.pointer != string.start &&
+                string.pointer != string.end - 1) {
+                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+                if (IS_SPACE_AT(string, 1)) {
+                    if (!PUT(emitter, '\\')) return MYYAML_FAILURE;
+                }
+                MOVE(string);
+            } else {
+                if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+            }
+            spaces = 1;
+        } else {
+            if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+            spaces = 0;
+        }
+    }
+
+    if (!yaml_emitter_write_indicator(emitter, "\"", 0, 0, 0)) return MYYAML_FAILURE;
+
+    emitter->whitespace = 0;
+    emitter->indention = 0;
+
+    return MYYAML_SUCCESS;
+}
+
+static int yaml_emitter_write_block_scalar_hints(YamlEmitter *emitter, YamlString_t string) {
+    char indent_hint[2];
+    const char *chomp_hint = NULL;
+
+    if (IS_SPACE(string) || IS_BREAK(string)) {
+        indent_hint[0] = '0' + (char)emitter->best_indent;
+        indent_hint[1] = '\0';
+        if (!yaml_emitter_write_indicator(emitter, indent_hint, 0, 0, 0)) return MYYAML_FAILURE;
+    }
+
+    emitter->open_ended = 0;
+
+    string.pointer = string.end;
+    if (string.start == string.pointer) {
+        chomp_hint = "-";
+    } else {
+        do {
+            string.pointer--;
+        } while ((*string.pointer & 0xC0) == 0x80);
+        if (!IS_BREAK(string)) {
+            chomp_hint = "-";
+        } else if (string.start == string.pointer) {
+            chomp_hint = "+";
+            emitter->open_ended = 2;
+        } else {
+            do {
+                string.pointer--;
+            } while ((*string.pointer & 0xC0) == 0x80);
+            if (IS_BREAK(string)) {
+                chomp_hint = "+";
+                emitter->open_ended = 2;
+            }
+        }
+    }
+
+    if (chomp_hint) {
+        if (!yaml_emitter_write_indicator(emitter, chomp_hint, 0, 0, 0)) return MYYAML_FAILURE;
+    }
+
+    return MYYAML_SUCCESS;
+}
+
+static int yaml_emitter_write_literal_scalar(YamlEmitter *emitter, YamlChar_t *value, size_t length) {
+    YamlString_t string;
+    int breaks = 1;
+
+    STRING_ASSIGN(string, value, length);
+
+    if (!yaml_emitter_write_indicator(emitter, "|", 1, 0, 0)) return MYYAML_FAILURE;
+    if (!yaml_emitter_write_block_scalar_hints(emitter, string)) return MYYAML_FAILURE;
+    if (!PUT_BREAK(emitter)) return MYYAML_FAILURE;
+    emitter->indention = 1;
+    emitter->whitespace = 1;
+
+    while (string.pointer != string.end) {
+        if (IS_BREAK(string)) {
+            if (!WRITE_BREAK(emitter, string)) return MYYAML_FAILURE;
+            emitter->indention = 1;
+            breaks = 1;
+        } else {
+            if (breaks) {
+                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+            }
+            if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+            emitter->indention = 0;
+            breaks = 0;
+        }
+    }
+
+    return MYYAML_SUCCESS;
+}
+
+static int yaml_emitter_write_folded_scalar(YamlEmitter *emitter, YamlChar_t *value, size_t length) {
+    YamlString_t string;
+    int breaks = 1;
+    int leading_spaces = 1;
+
+    STRING_ASSIGN(string, value, length);
+
+    if (!yaml_emitter_write_indicator(emitter, ">", 1, 0, 0)) return MYYAML_FAILURE;
+    if (!yaml_emitter_write_block_scalar_hints(emitter, string)) return MYYAML_FAILURE;
+    if (!PUT_BREAK(emitter)) return MYYAML_FAILURE;
+    emitter->indention = 1;
+    emitter->whitespace = 1;
+
+    while (string.pointer != string.end) {
+        if (IS_BREAK(string)) {
+            if (!breaks && !leading_spaces && CHECK(string, '\n')) {
+                int k = 0;
+                while (IS_BREAK_AT(string, k)) {
+                    k += WIDTH_AT(string, k);
+                }
+                if (!IS_BLANKZ_AT(string, k)) {
+                    if (!PUT_BREAK(emitter)) return MYYAML_FAILURE;
+                }
+            }
+            if (!WRITE_BREAK(emitter, string)) return MYYAML_FAILURE;
+            emitter->indention = 1;
+            breaks = 1;
+        } else {
+            if (breaks) {
+                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+                leading_spaces = IS_BLANK(string);
+            }
+            if (!breaks && IS_SPACE(string) && !IS_SPACE_AT(string, 1) && emitter->column > emitter->best_width) {
+                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
+                MOVE(string);
+            } else {
+                if (!WRITE(emitter, string)) return MYYAML_FAILURE;
+            }
+            emitter->indention = 0;
+            breaks = 0;
+        }
+    }
+
+    return MYYAML_SUCCESS;
+}
+
+#pragma endregion  // Emitter
+
+#endif  // MYYAML_DISABLE_WRITER
+
+#pragma endregion  // C Definations
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+
+//-----------------------------------------------------------------------------
+// [SECTION] C++ Only Classes
+//-----------------------------------------------------------------------------
+
+#ifdef __cplusplus
+
+namespace myyaml {
+inline namespace internal {
+//-----------------------------------------------------------------------------
+// [SECTION] Declarations
+//-----------------------------------------------------------------------------
+
+#pragma region Cpp Dec
+
+#if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
+
+#endif  // MYYAML_DISABLE_READER
+
+#if !defined(MYYAML_DISABLE_WRITER) || !MYYAML_DISABLE_WRITER
+
+#endif  // MYYAML_DISABLE_WRITER
+
+#pragma endregion  // C++ Declarations
+
+//-----------------------------------------------------------------------------
+// [SECTION] Definations
+//-----------------------------------------------------------------------------
+
+#pragma region Cpp Def
+
+#if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
+#endif  // MYYAML_DISABLE_READER
+
+#if !defined(MYYAML_DISABLE_WRITER) || !MYYAML_DISABLE_WRITER
+#endif  // MYYAML_DISABLE_WRITER
+
+#pragma endregion  // Definations
+
+};  // namespace internal
+};  // namespace myyaml
+
+#endif  //__cplusplus
+
+#pragma endregion  // Internal
+
+#pragma region Myyaml
+
+//-----------------------------------------------------------------------------
+// [SECTION] C Only Functions
+//-----------------------------------------------------------------------------
+
+#pragma region C
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+MYYAML_API void yaml_set_max_nest_level(int max) { MAX_NESTING_LEVEL = max; }
+
+MYYAML_API void yaml_set_simd(int enabled) { yaml_kernels = enabled ? NULL : &yaml_scalar_kernels; }
+
+MYYAML_API void yaml_token_delete(YamlToken *token) {
+    MYYAML_ASSERT(token); /* Non-NULL token object expected. */
+
+    switch (token->type) {
+        case YAML_TAG_DIRECTIVE_TOKEN:
+            _myyaml_free(token->allocator, token->data.tag_directive.handle);
+            _myyaml_free(token->allocator, token->data.tag_directive.prefix);
+            break;
+
+        case YAML_ALIAS_TOKEN:
+            _myyaml_free(token->allocator, token->data.alias.value);
+            break;
+
+        case YAML_ANCHOR_TOKEN:
+            _myyaml_free(token->allocator, token->data.anchor.value);
+            break;
+
+        case YAML_TAG_TOKEN:
+            _myyaml_free(token->allocator, token->data.tag.handle);
+            _myyaml_free(token->allocator, token->data.tag.suffix);
+            break;
+
+        case YAML_SCALAR_TOKEN:
+            if (!token->data.scalar.borrowed) {
+                _myyaml_free(token->allocator, token->data.scalar.value);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    memset(token, 0, sizeof(YamlToken));
+}
+
+#pragma region Encoding
+
+static int rune_is_valid(uint32_t rune) { return rune < 0xD800 || rune > 0xDFFF; }
+
+static int secondary_byte(unsigned char b) { return b >= 0x80 && b <= 0xBF; }
+
+size_t utf8_decode(const char *data, size_t size, uint32_t *rune) {
+    if (size == 0) return 0;
+
+    size_t rd = 0;
+    unsigned char c = (unsigned char)data[rd++];
+
+    // 1 byte ASCII.
+    if (c <= 0x7F) {
+        if (rune != NULL) *rune = (uint32_t)c;
+
+        return 1;
+    }
+
+    // 2 byte.
+    if (c >= 0xC0 && c <= 0xDF) {
+        if (rd == size) return 0;
+
+        unsigned char more = (unsigned char)data[rd];
+        if (!secondary_byte(more)) return 0;
+
+        uint32_t rn = (((uint32_t)c & 0x1F) << 6) | ((uint32_t)more & 0x3F);
+        if (!rune_is_valid(rn)) return 0;
+
+        if (rune != NULL) *rune = rn;
+
+        return 2;
+    }
+
+    // 3 byte.
+    if (c >= 0xE0 && c <= 0xEF) {
+        if (rd + 2 > size) return 0;
+
+        unsigned char more[2];
+        for (size_t i = 0; i < sizeof(more); i++) {
+            if (!secondary_byte(more[i] = data[rd++])) return 0;
+        }
+
+        uint32_t rn = (((uint32_t)c & 0x0F) << 12) | (((uint32_t)more[0] & 0x3F) << 6) | ((uint32_t)more[1] & 0x3F);
+        if (!rune_is_valid(rn)) return 0;
+
+        if (rune != NULL) *rune = rn;
+
+        return 3;
+    }
+
+    // 4 byte.
+    if (c >= 0xF0 && c <= 0xF7) {
+        if (rd + 3 > size) return 0;
+
+        unsigned char more[3];
+        for (size_t i = 0; i < sizeof(more); i++) {
+            if (!secondary_byte(more[i] = data[rd++])) return 0;
+        }
+
+        uint32_t rn =
+            (((uint32_t)c & 0x0F) << 18) | (((uint32_t)more[0] & 0x3F) << 12) | (((uint32_t)more[1] & 0x3F) << 6) | ((uint32_t)more[2] & 0x3F);
+        if (!rune_is_valid(rn)) return 0;
+
+        if (rune != NULL) *rune = rn;
+
+        return 4;
+    }
+
+    return 0;
+}
+
+size_t utf8_encode(char *buffer, uint32_t rune) {
+    // 1 byte ASCII.
+    if (rune <= 0x7F) {
+        if (buffer != NULL) *buffer = (char)rune;
+
+        return 1;
+    }
+
+    // 2 byte.
+    if (rune >= 0x80 && rune <= 0x7FF) {
+        if (buffer != NULL) {
+            buffer[0] = (char)(0xC0 | ((rune >> 6) & 0x1F));
+            buffer[1] = (char)(0x80 | (rune & 0x3F));
+        }
+
+        return 2;
+    }
+
+    // 3 byte.
+    if (rune >= 0x800 && rune <= 0xFFFF) {
+        if (buffer != NULL) {
+            buffer[0] = (char)(0xE0 | ((rune >> 12) & 0x0F));
+            buffer[1] = (char)(0x80 | ((rune >> 6) & 0x3F));
+            buffer[2] = (char)(0x80 | (rune & 0x3F));
+        }
+
+        return 3;
+    }
+
+    // 4 byte.
+    if (rune >= 0x10000 && rune <= 0x10FFFF) {
+        if (buffer != NULL) {
+            buffer[0] = (char)(0xF0 | ((rune >> 18) & 0x07));
+            buffer[1] = (char)(0x80 | ((rune >> 12) & 0x3F));
+            buffer[2] = (char)(0x80 | ((rune >> 6) & 0x3F));
+            buffer[3] = (char)(0x80 | (rune & 0x3F));
+        }
+
+        return 4;
+    }
+
+    return 0;
+}
+
+int utf8_is_valid(const char *data, size_t size) {
+    for (size_t i = 0; i < size;) {
+        size_t s = utf8_decode(&data[i], size - i, NULL);
+        if (s == 0) return 0;
+
+        i += s;
+    }
+
+    return 1;
+}
+MYYAML_API int yaml_check_utf8(const YamlChar_t *start, size_t length) {
+    const YamlChar_t *end = start + length;
+    const YamlChar_t *pointer = start;
+
+    while (pointer < end) {
+        unsigned char octet;
+        unsigned int width;
+        unsigned int value;
+        size_t k;
+
+        octet = pointer[0];
+        width = (octet & 0x80) == 0x00 ? 1 : (octet & 0xE0) == 0xC0 ? 2 : (octet & 0xF0) == 0xE0 ? 3 : (octet & 0xF8) == 0xF0 ? 4 : 0;
+        value = (octet & 0x80) == 0x00   ? octet & 0x7F
+                : (octet & 0xE0) == 0xC0 ? octet & 0x1F
+                : (octet & 0xF0) == 0xE0 ? octet & 0x0F
+                : (octet & 0xF8) == 0xF0 ? octet & 0x07
+                                         : 0;
+        if (!width) return MYYAML_FAILURE;
+        if (pointer + width > end) return MYYAML_FAILURE;
+        for (k = 1; k < width; k++) {
+            octet = pointer[k];
+            if ((octet & 0xC0) != 0x80) return MYYAML_FAILURE;
+            value = (value << 6) + (octet & 0x3F);
+        }
+        if (!((width == 1) || (width == 2 && value >= 0x80) || (width == 3 && value >= 0x800) || (width == 4 && value >= 0x10000)))
+            return MYYAML_FAILURE;
+
+        pointer += width;
+    }
+
+    return MYYAML_SUCCESS;
+}
+
+#pragma endregion  // Encoding
+
+#pragma region Event
+
+MYYAML_API int yaml_event_initialize_stream_start(YamlEvent *event, YamlEncoding encoding) {
+    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
+
+    YamlMark mark = {0, 0, 0};
+
+    memset((event), 0, sizeof(YamlEvent));
+    event->type = YAML_STREAM_START_EVENT;
+    event->start_mark = mark;
+    event->end_mark = mark;
+    event->data.stream_start.encoding = encoding;
+
+    return MYYAML_SUCCESS;
+}
+
+MYYAML_API int yaml_event_initialize_stream_end(YamlEvent *event) {
+    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
+
+    YamlMark mark = {0, 0, 0};
+
+    memset((event), 0, sizeof(YamlEvent));
+    event->type = YAML_STREAM_END_EVENT;
+    event->start_mark = mark;
+    event->end_mark = mark;
+
+    return MYYAML_SUCCESS;
+}
+
+MYYAML_API int yaml_event_initialize_document_start(YamlEvent *event, YamlVersionDirective *version_directive, YamlTagDirective *tag_directives_start,
+                                                    YamlTagDirective *tag_directives_end, int implicit) {
+    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
+    MYYAML_ASSERT((tag_directives_start && tag_directives_end) || (tag_directives_start == tag_directives_end));
+
+    struct {
+        YamlErrorType error;
+        const YamlAllocator *allocator;
+    } context = {YAML_NO_ERROR, NULL};
+
+    YamlVersionDirective *version_directive_copy = NULL;
+    YamlTagDirective value = {NULL, NULL};
+    YamlMark mark = {0, 0, 0};
+    struct {
+        YamlTagDirective *start;
+        YamlTagDirective *end;
+        YamlTagDirective *top;
+    } tag_directives_copy = {NULL, NULL, NULL};
+
+    /* Valid tag directives are expected. */
+    if (version_directive) {
+        version_directive_copy = YAML_MALLOC_STATIC(context.allocator, YamlVersionDirective);
+        if (!version_directive_copy) goto error;
+        version_directive_copy->major = version_directive->major;
+        version_directive_copy->minor = version_directive->minor;
+    }
+
+    if (tag_directives_start != tag_directives_end) {
+        YamlTagDirective *tag_directive;
+        if (!STACK_INIT(&context, tag_directives_copy, YamlTagDirective *)) goto error;
+        for (tag_directive = tag_directives_start; tag_directive != tag_directives_end; tag_directive++) {
+            MYYAML_ASSERT(tag_directive->handle);
+            MYYAML_ASSERT(tag_directive->prefix);
+            if (!yaml_check_utf8(tag_directive->handle, strlen((char *)tag_directive->handle))) goto error;
+            if (!yaml_check_utf8(tag_directive->prefix, strlen((char *)tag_directive->prefix))) goto error;
+            value.handle = _myyaml_strdup(context.allocator, tag_directive->handle);
+            value.prefix = _myyaml_strdup(context.allocator, tag_directive->prefix);
+            if (!value.handle || !value.prefix) goto error;
+            if (!PUSH(&context, tag_directives_copy, value)) goto error;
+            value.handle = NULL;
+            value.prefix = NULL;
+        }
+    }
+
+    memset((event), 0, sizeof(YamlEvent));
+    event->type = YAML_DOCUMENT_START_EVENT;
+    event->start_mark = mark;
+    event->end_mark = mark;
+    event->data.document_start.version_directive = version_directive_copy;
+    event->data.document_start.tag_directives.start = tag_directives_copy.start;
+    event->data.document_start.tag_directives.end = tag_directives_copy.top;
+    event->data.document_start.implicit = implicit;
+
+    return MYYAML_SUCCESS;
+
+error:
+    _myyaml_free(context.allocator, version_directive_copy);
+    while (!STACK_EMPTY(&context, tag_directives_copy)) {
+        YamlTagDirective value = POP(&context, tag_directives_copy);
+        _myyaml_free(context.allocator, value.handle);
+        _myyaml_free(context.allocator, value.prefix);
+    }
+    STACK_DEL(&context, tag_directives_copy);
+    _myyaml_free(context.allocator, value.handle);
+    _myyaml_free(context.allocator, value.prefix);
+
+    return MYYAML_FAILURE;
+}
+
+MYYAML_API int yaml_event_initialize_document_end(YamlEvent *event, int implicit) {
+    MYYAML_ASSERT(event); /**< Non-NULL emitter object is expected. */
+
+    YamlMark mark = {0, 0, 0};
+
+    memset((event), 0, sizeof(YamlEvent));
+    event->type = YAML_DOCUMENT_END_EVENT;
+    event->start_mark = mark;
+    event->end_mark = mark;
+    event->data.document_end.implicit = implicit;
+
+    return MYYAML_SUCCESS;
+}
+
+MYYAML_API int yaml_event_initialize_alias(YamlEvent *event, const YamlChar_t *anchor) {
+    MYYAML_ASSERT(event);  /**< Non-NULL event object is expected. */
+    MYYAML_ASSERT(anchor); /**< Non-NULL anchor is expected. */
+
+    YamlChar_t *anchor_copy = NULL;
+    YamlMark mark = {0, 0, 0};
+
+    if (!yaml_check_utf8(anchor, strlen((char *)anchor))) return MYYAML_FAILURE;
+
+    anchor_copy = _myyaml_strdup(NULL, anchor);
+
+    if (!anchor_copy) return MYYAML_FAILURE;
+
+    memset((event), 0, sizeof(YamlEvent));
+    event->type = YAML_ALIAS_EVENT;
+    event->start_mark = mark;
+    event->end_mark = mark;
+    event->data.alias.anchor = anchor_copy;
+
+    return MYYAML_SUCCESS;
+}
+
+MYYAML_API int yaml_event_initialize_scalar(YamlEvent *event, const YamlChar_t *anchor, const YamlChar_t *tag, const YamlChar_t *value, int length,
+                                            int plain_implicit, int quoted_implicit, YamlScalarStyle style) {
+    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
+    MYYAML_ASSERT(value); /**< Non-NULL anchor is expected. */
+
+    YamlChar_t *anchor_copy = NULL;
+    YamlChar_t *value_copy = NULL;
+    YamlChar_t *tag_copy = NULL;
+    YamlMark mark = {0, 0, 0};
+
+    if (anchor) {
+        if (!yaml_check_utf8(anchor, strlen((char *)anchor))) goto error;
+        anchor_copy = _myyaml_strdup(NULL, anchor);
+        if (!anchor_copy) goto error;
+    }
+
+    if (tag) {
+        if (!yaml_check_utf8(tag, strlen((char *)tag))) goto error;
+        tag_copy = _myyaml_strdup(NULL, tag);
+        if (!tag_copy) goto error;
+    }
+
+    if (length < 0) {
+        length = strlen((char *)value);
+    }
+
+    if (!yaml_check_utf8(value, length)) goto error;
+    value_copy = YAML_MALLOC(NULL, length + 1);
+    if (!value_copy) goto error;
+    memcpy(value_copy, value, length);
+    value_copy[length] = '\0';
+
+    memset((event), 0, sizeof(YamlEvent));
+    event->type = YAML_SCALAR_EVENT;
+    event->start_mark = mark;
+    event->end_mark = mark;
+    event->data.scalar.anchor = anchor_copy;
+    event->data.scalar.tag = tag_copy;
+    event->data.scalar.value = value_copy;
+    event->data.scalar.length = length;
+    event->data.scalar.plain_implicit = plain_implicit, event->data.scalar.quoted_implicit = quoted_implicit;
+    event->data.scalar.style = style;
+
+    return MYYAML_SUCCESS;
+
+error:
+    _myyaml_free(NULL, anchor_copy);
+    _myyaml_free(NULL, tag_copy);
+    _myyaml_free(NULL, value_copy);
+
+    return MYYAML_FAILURE;
+}
+
+MYYAML_API int yaml_event_initialize_sequence_start(YamlEvent *event, const YamlChar_t *anchor, const YamlChar_t *tag, int implicit,
+                                                    YamlSequenceStyle style) {
+    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
+
+    YamlChar_t *anchor_copy = NULL;
+    YamlChar_t *tag_copy = NULL;
+    YamlMark mark = {0, 0, 0};
+
+    if (anchor) {
+        if (!yaml_check_utf8(anchor, strlen((char *)anchor))) goto error;
+        anchor_copy = _myyaml_strdup(NULL, anchor);
+        if (!anchor_copy) goto error;
+    }
+
+    if (tag) {
+        if (!yaml_check_utf8(tag, strlen((char *)tag))) goto error;
+        tag_copy = _myyaml_strdup(NULL, tag);
+        if (!tag_copy) goto error;
+    }
+
+    memset((event), 0, sizeof(YamlEvent));
+    event->type = YAML_SEQUENCE_START_EVENT;
+    event->start_mark = mark;
+    event->end_mark = mark;
+    event->data.sequence_start.anchor = anchor_copy;
+    event->data.sequence_start.tag = tag_copy;
+    event->data.sequence_start.implicit = implicit;
+    event->data.sequence_start.style = style;
+
+    return MYYAML_SUCCESS;
+
+error:
+    _myyaml_free(NULL, anchor_copy);
+    _myyaml_free(NULL, tag_copy);
+
+    return MYYAML_FAILURE;
+}
+
+MYYAML_API int yaml_event_initialize_sequence_end(YamlEvent *event) {
+    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
+
+    YamlMark mark = {0, 0, 0};
+
+    memset((event), 0, sizeof(YamlEvent));
+    event->type = YAML_SEQUENCE_END_EVENT;
+    event->start_mark = mark;
+    event->end_mark = mark;
+
+    return MYYAML_SUCCESS;
+}
+
+MYYAML_API int yaml_event_initialize_mapping_start(YamlEvent *event, const YamlChar_t *anchor, const YamlChar_t *tag, int implicit,
+                                                   YamlMappingStyle style) {
+    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
+
+    YamlChar_t *anchor_copy = NULL;
+    YamlChar_t *tag_copy = NULL;
+    YamlMark mark = {0, 0, 0};
+
+    if (anchor) {
+        if (!yaml_check_utf8(anchor, strlen((char *)anchor))) goto error;
+        anchor_copy = _myyaml_strdup(NULL, anchor);
+        if (!anchor_copy) goto error;
+    }
+
+    if (tag) {
+        if (!yaml_check_utf8(tag, strlen((char *)tag))) goto error;
+        tag_copy = _myyaml_strdup(NULL, tag);
+        if (!tag_copy) goto error;
+    }
+
+    memset((event), 0, sizeof(YamlEvent));
+    event->type = YAML_MAPPING_START_EVENT;
+    event->start_mark = mark;
+    event->end_mark = mark;
+    event->data.mapping_start.anchor = anchor_copy;
+    event->data.mapping_start.tag = tag_copy;
+    event->data.mapping_start.implicit = implicit;
+    event->data.mapping_start.style = style;
+
+    return MYYAML_SUCCESS;
+
+error:
+    _myyaml_free(NULL, anchor_copy);
+    _myyaml_free(NULL, tag_copy);
+
+    return MYYAML_FAILURE;
+}
+
+MYYAML_API int yaml_event_initialize_mapping_end(YamlEvent *event) {
+    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
+
+    YamlMark mark = {0, 0, 0};
+
+    memset((event), 0, sizeof(YamlEvent));
+    event->type = YAML_MAPPING_END_EVENT;
+    event->start_mark = mark;
+    event->end_mark = mark;
+
+    return MYYAML_SUCCESS;
+}
+
+MYYAML_API void yaml_event_delete(YamlEvent *event) {
+    MYYAML_ASSERT(event); /**< Non-NULL event object expected. */
+
+    YamlTagDirective *tag_directive;
+
+    switch (event->type) {
+        case YAML_DOCUMENT_START_EVENT:
+            _myyaml_free(event->allocator, event->data.document_start.version_directive);
+            for (tag_directive = event->data.document_start.tag_directives.start; tag_directive != event->data.document_start.tag_directives.end;
+                 tag_directive++) {
+                _myyaml_free(event->allocator, tag_directive->handle);
+                _myyaml_free(event->allocator, tag_directive->prefix);
+            }
+            _myyaml_free(event->allocator, event->data.document_start.tag_directives.start);
+            break;
+
+        case YAML_ALIAS_EVENT:
+            if (!event->borrowed_anchor) {
+                _myyaml_free(event->allocator, event->data.alias.anchor);
+            }
+            break;
+
+        case YAML_SCALAR_EVENT:
+            if (!event->borrowed_anchor) {
+                _myyaml_free(event->allocator, event->data.scalar.anchor);
+            }
+            _myyaml_free(event->allocator, event->data.scalar.tag);
+            if (!event->data.scalar.borrowed) {
+                _myyaml_free(event->allocator, event->data.scalar.value);
+            }
+            break;
+
+        case YAML_SEQUENCE_START_EVENT:
+            if (!event->borrowed_anchor) {
+                _myyaml_free(event->allocator, event->data.sequence_start.anchor);
+            }
+            _myyaml_free(event->allocator, event->data.sequence_start.tag);
+            break;
+
+        case YAML_MAPPING_START_EVENT:
+            if (!event->borrowed_anchor) {
+                _myyaml_free(event->allocator, event->data.mapping_start.anchor);
+            }
+            _myyaml_free(event->allocator, event->data.mapping_start.tag);
+            break;
+
+        default:
+            break;
+    }
+
+    memset(event, 0, sizeof(YamlEvent));
+}
+
+#pragma endregion  // Event
+
+#pragma region Document
+
+static int yaml_document_initialize_allocator(YamlDocument *document, const YamlAllocator *allocator, YamlVersionDirective *version_directive,
+                                              YamlTagDirective *tag_directives_start, YamlTagDirective *tag_directives_end, int start_implicit,
+                                              int end_implicit) {
+    struct {
+        YamlErrorType error;
+        const YamlAllocator *allocator;
+    } context = {YAML_NO_ERROR, allocator};
+    struct {
+        YamlNode *start;
+        YamlNode *end;
+        YamlNode *top;
+    } nodes = {NULL, NULL, NULL};
+    YamlVersionDirective *version_directive_copy = NULL;
+    struct {
+        YamlTagDirective *start;
+        YamlTagDirective *end;
+        YamlTagDirective *top;
+    } tag_directives_copy = {NULL, NULL, NULL};
+    YamlTagDirective value = {NULL, NULL};
+    YamlMark mark = {0, 0, 0};
+
+    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
+    MYYAML_ASSERT((tag_directives_start && tag_directives_end) || (tag_directives_start == tag_directives_end));
+    /* Valid tag directives are expected. */
+
+    if (!STACK_INIT(&context, nodes, YamlNode *)) goto error;
+
+    if (version_directive) {
+        version_directive_copy = YAML_MALLOC_STATIC(allocator, YamlVersionDirective);
+        if (!version_directive_copy) goto error;
+        version_directive_copy->major = version_directive->major;
+        version_directive_copy->minor = version_directive->minor;
+    }
+
+    if (tag_directives_start != tag_directives_end) {
+        YamlTagDirective *tag_directive;
+        if (!STACK_INIT(&context, tag_directives_copy, YamlTagDirective *)) goto error;
+        for (tag_directive = tag_directives_start; tag_directive != tag_directives_end; tag_directive++) {
+            MYYAML_ASSERT(tag_directive->handle);
+            MYYAML_ASSERT(tag_directive->prefix);
+            if (!yaml_check_utf8(tag_directive->handle, strlen((char *)tag_directive->handle))) goto error;
+            if (!yaml_check_utf8(tag_directive->prefix, strlen((char *)tag_directive->prefix))) goto error;
+            value.handle = _myyaml_strdup(allocator, tag_directive->handle);
+            value.prefix = _myyaml_strdup(allocator, tag_directive->prefix);
+            if (!value.handle || !value.prefix) goto error;
+            if (!PUSH(&context, tag_directives_copy, value)) goto error;
+            value.handle = NULL;
+            value.prefix = NULL;
+        }
+    }
+
+    memset((document), 0, sizeof(YamlDocument));
+    document->nodes.start = nodes.start;
+    document->nodes.top = nodes.start;
+    document->nodes.end = nodes.end;
+    document->start_mark = mark;
+    document->end_mark = mark;
+    document->version_directive = version_directive_copy;
+    document->tag_directives.start = tag_directives_copy.start;
+    document->tag_directives.end = tag_directives_copy.top;
+    document->start_implicit = start_implicit;
+    document->end_implicit = end_implicit;
+    document->allocator = allocator;
 
-                case 0x09:
-                    if (!PUT(emitter, 't')) return MYYAML_FAILURE;
-                    break;
+    return MYYAML_SUCCESS;
 
-                case 0x0A:
-                    if (!PUT(emitter, 'n')) return MYYAML_FAILURE;
-                    break;
+error:
+    STACK_DEL(&context, nodes);
+    _myyaml_free(allocator, version_directive_copy);
+    while (!STACK_EMPTY(&context, tag_directives_copy)) {
+        YamlTagDirective value = POP(&context, tag_directives_copy);
+        _myyaml_free(allocator, value.handle);
+        _myyaml_free(allocator, value.prefix);
+    }
+    STACK_DEL(&context, tag_directives_copy);
+    _myyaml_free(allocator, value.handle);
+    _myyaml_free(allocator, value.prefix);
 
-                case 0x0B:
-                    if (!PUT(emitter, 'v')) return MYYAML_FAILURE;
-                    break;
+    return MYYAML_FAILURE;
+}
 
-                case 0x0C:
-                    if (!PUT(emitter, 'f')) return MYYAML_FAILURE;
-                    break;
+MYYAML_API int yaml_document_initialize(YamlDocument *document, YamlVersionDirective *version_directive, YamlTagDirective *tag_directives_start,
+                                        YamlTagDirective *tag_directives_end, int start_implicit, int end_implicit) {
+    return yaml_document_initialize_allocator(document, NULL, version_directive, tag_directives_start, tag_directives_end, start_implicit,
+                                              end_implicit);
+}
 
-                case 0x0D:
-                    if (!PUT(emitter, 'r')) return MYYAML_FAILURE;
-                    break;
+MYYAML_API int yaml_document_set_allocator(YamlDocument *document, const YamlAllocator *allocator) {
+    YamlDocument old;
 
-                case 0x1B:
-                    if (!PUT(emitter, 'e')) return MYYAML_FAILURE;
-                    break;
+    MYYAML_ASSERT(document);                                     /* Non-NULL document object is expected. */
+    MYYAML_ASSERT(document->nodes.start == document->nodes.top); /* An empty document is expected. */
 
-                case 0x22:
-                    if (!PUT(emitter, '\"')) return MYYAML_FAILURE;
-                    break;
+    /* Copy the directives with the new allocator, then drop the old document. */
 
-                case 0x5C:
-                    if (!PUT(emitter, '\\')) return MYYAML_FAILURE;
-                    break;
+    old = *document;
+    if (!yaml_document_initialize_allocator(document, allocator, old.version_directive, old.tag_directives.start, old.tag_directives.end,
+                                            old.start_implicit, old.end_implicit)) {
+        *document = old;
+        return MYYAML_FAILURE;
+    }
+    document->start_mark = old.start_mark;
+    document->end_mark = old.end_mark;
+    yaml_document_delete(&old);
 
-                case 0x85:
-                    if (!PUT(emitter, 'N')) return MYYAML_FAILURE;
-                    break;
+    return MYYAML_SUCCESS;
+}
 
-                case 0xA0:
-                    if (!PUT(emitter, '_')) return MYYAML_FAILURE;
-                    break;
+MYYAML_API void yaml_document_delete(YamlDocument *document) {
+    YamlTagDirective *tag_directive;
 
-                case 0x2028:
-                    if (!PUT(emitter, 'L')) return MYYAML_FAILURE;
-                    break;
+    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
 
-                case 0x2029:
-                    if (!PUT(emitter, 'P')) return MYYAML_FAILURE;
-                    break;
+    /* The tags, values and child stacks of an arena document go with the arena. */
 
-                default:
-                    if (value <= 0xFF) {
-                        if (!PUT(emitter, 'x')) return MYYAML_FAILURE;
-                        width = 2;
-                    } else if (value <= 0xFFFF) {
-                        if (!PUT(emitter, 'u')) return MYYAML_FAILURE;
-                        width = 4;
-                    } else {
-                        if (!PUT(emitter, 'U')) return MYYAML_FAILURE;
-                        width = 8;
-                    }
-                    for (k = (width - 1) * 4; k >= 0; k -= 4) {
-                        int digit = (value >> k) & 0x0F;
-                        if (!PUT(emitter, digit + (digit < 10 ? '0' : 'A' - 10))) return MYYAML_FAILURE;
-                    }
-            }
-            spaces = 0;
-        } else if (IS_SPACE(string)) {
-            if (allow_breaks && !spaces && emitter->column > emitter->best_width && string.pointer != string.start &&
-                string.pointer != string.end - 1) {
-                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-                if (IS_SPACE_AT(string, 1)) {
-                    if (!PUT(emitter, '\\')) return MYYAML_FAILURE;
-                }
-                MOVE(string);
-            } else {
-                if (!WRITE(emitter, string)) return MYYAML_FAILURE;
-            }
-            spaces = 1;
-        } else {
-            if (!WRITE(emitter, string)) return MYYAML_FAILURE;
-            spaces = 0;
+    if (document->arena) {
+        document->nodes.top = document->nodes.start;
+    }
+
+    while (!STACK_EMPTY(document, document->nodes)) {
+        YamlNode node = POP(document, document->nodes);
+        _myyaml_free(document->allocator, node.tag);
+        switch (node.type) {
+            case YAML_SCALAR_NODE:
+                _myyaml_free(document->allocator, node.data.scalar.value);
+                break;
+            case YAML_SEQUENCE_NODE:
+                STACK_DEL(document, node.data.sequence.items);
+                break;
+            case YAML_MAPPING_NODE:
+                STACK_DEL(document, node.data.mapping.pairs);
+                _myyaml_free(document->allocator, node.data.mapping.index);
+                break;
+            default:
+                MYYAML_ASSERT(0); /* Should not happen. */
         }
     }
+    STACK_DEL(document, document->nodes);
 
-    if (!yaml_emitter_write_indicator(emitter, "\"", 0, 0, 0)) return MYYAML_FAILURE;
+    _myyaml_free(document->allocator, document->version_directive);
+    for (tag_directive = document->tag_directives.start; tag_directive != document->tag_directives.end; tag_directive++) {
+        _myyaml_free(document->allocator, tag_directive->handle);
+        _myyaml_free(document->allocator, tag_directive->prefix);
+    }
+    _myyaml_free(document->allocator, document->tag_directives.start);
 
-    emitter->whitespace = 0;
-    emitter->indention = 0;
+    yaml_arena_destroy(document->arena);
 
-    return MYYAML_SUCCESS;
+    memset(document, 0, sizeof(YamlDocument));
 }
 
-static int yaml_emitter_write_block_scalar_hints(YamlEmitter *emitter, YamlString_t string) {
-    char indent_hint[2];
-    const char *chomp_hint = NULL;
+MYYAML_API void yaml_documents_delete(YamlDocument *documents, size_t count) {
+    const YamlAllocator *allocator;
+    size_t k;
 
-    if (IS_SPACE(string) || IS_BREAK(string)) {
-        indent_hint[0] = '0' + (char)emitter->best_indent;
-        indent_hint[1] = '\0';
-        if (!yaml_emitter_write_indicator(emitter, indent_hint, 0, 0, 0)) return MYYAML_FAILURE;
+    if (!documents) return;
+
+    allocator = documents->allocator;
+    for (k = 0; k < count; k++) {
+        yaml_document_delete(documents + k);
     }
 
-    emitter->open_ended = 0;
+    _myyaml_free(allocator, documents);
+}
 
-    string.pointer = string.end;
-    if (string.start == string.pointer) {
-        chomp_hint = "-";
-    } else {
-        do {
-            string.pointer--;
-        } while ((*string.pointer & 0xC0) == 0x80);
-        if (!IS_BREAK(string)) {
-            chomp_hint = "-";
-        } else if (string.start == string.pointer) {
-            chomp_hint = "+";
-            emitter->open_ended = 2;
-        } else {
-            do {
-                string.pointer--;
-            } while ((*string.pointer & 0xC0) == 0x80);
-            if (IS_BREAK(string)) {
-                chomp_hint = "+";
-                emitter->open_ended = 2;
-            }
-        }
-    }
+MYYAML_API YamlNode *yaml_document_get_node(YamlDocument *document, int index) {
+    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
 
-    if (chomp_hint) {
-        if (!yaml_emitter_write_indicator(emitter, chomp_hint, 0, 0, 0)) return MYYAML_FAILURE;
+    if (index > 0 && document->nodes.start + index <= document->nodes.top) {
+        return document->nodes.start + index - 1;
     }
+    return NULL;
+}
 
-    return MYYAML_SUCCESS;
+MYYAML_API YamlNode *yaml_document_get_root_node(YamlDocument *document) {
+    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
+
+    if (document->nodes.top != document->nodes.start) {
+        return document->nodes.start;
+    }
+    return NULL;
 }
 
-static int yaml_emitter_write_literal_scalar(YamlEmitter *emitter, YamlChar_t *value, size_t length) {
-    YamlString_t string;
-    int breaks = 1;
+MYYAML_API int yaml_document_add_scalar(YamlDocument *document, const YamlChar_t *tag, const YamlChar_t *value, int length, YamlScalarStyle style) {
+    struct {
+        YamlErrorType error;
+        const YamlAllocator *allocator;
+    } context = {YAML_NO_ERROR, NULL};
+    YamlMark mark = {0, 0, 0};
+    YamlChar_t *tag_copy = NULL;
+    YamlChar_t *value_copy = NULL;
+    YamlNode node;
 
-    STRING_ASSIGN(string, value, length);
+    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
+    MYYAML_ASSERT(value);    /* Non-NULL value is expected. */
 
-    if (!yaml_emitter_write_indicator(emitter, "|", 1, 0, 0)) return MYYAML_FAILURE;
-    if (!yaml_emitter_write_block_scalar_hints(emitter, string)) return MYYAML_FAILURE;
-    if (!PUT_BREAK(emitter)) return MYYAML_FAILURE;
-    emitter->indention = 1;
-    emitter->whitespace = 1;
+    context.allocator = document->allocator;
 
-    while (string.pointer != string.end) {
-        if (IS_BREAK(string)) {
-            if (!WRITE_BREAK(emitter, string)) return MYYAML_FAILURE;
-            emitter->indention = 1;
-            breaks = 1;
-        } else {
-            if (breaks) {
-                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-            }
-            if (!WRITE(emitter, string)) return MYYAML_FAILURE;
-            emitter->indention = 0;
-            breaks = 0;
-        }
+    if (!tag) {
+        tag = (YamlChar_t *)YAML_DEFAULT_SCALAR_TAG;
     }
 
-    return MYYAML_SUCCESS;
-}
+    if (!yaml_check_utf8(tag, strlen((char *)tag))) goto error;
+    tag_copy = yaml_document_strdup(document, tag, strlen((char *)tag));
+    if (!tag_copy) goto error;
 
-static int yaml_emitter_write_folded_scalar(YamlEmitter *emitter, YamlChar_t *value, size_t length) {
-    YamlString_t string;
-    int breaks = 1;
-    int leading_spaces = 1;
+    if (length < 0) {
+        length = strlen((char *)value);
+    }
 
-    STRING_ASSIGN(string, value, length);
+    if (!yaml_check_utf8(value, length)) goto error;
+    value_copy = yaml_document_strdup(document, value, length);
+    if (!value_copy) goto error;
 
-    if (!yaml_emitter_write_indicator(emitter, ">", 1, 0, 0)) return MYYAML_FAILURE;
-    if (!yaml_emitter_write_block_scalar_hints(emitter, string)) return MYYAML_FAILURE;
-    if (!PUT_BREAK(emitter)) return MYYAML_FAILURE;
-    emitter->indention = 1;
-    emitter->whitespace = 1;
+    SCALAR_NODE_INIT(node, tag_copy, value_copy, length, style, mark, mark);
+    if (!PUSH(&context, document->nodes, node)) goto error;
 
-    while (string.pointer != string.end) {
-        if (IS_BREAK(string)) {
-            if (!breaks && !leading_spaces && CHECK(string, '\n')) {
-                int k = 0;
-                while (IS_BREAK_AT(string, k)) {
-                    k += WIDTH_AT(string, k);
-                }
-                if (!IS_BLANKZ_AT(string, k)) {
-                    if (!PUT_BREAK(emitter)) return MYYAML_FAILURE;
-                }
-            }
-            if (!WRITE_BREAK(emitter, string)) return MYYAML_FAILURE;
-            emitter->indention = 1;
-            breaks = 1;
-        } else {
-            if (breaks) {
-                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-                leading_spaces = IS_BLANK(string);
-            }
-            if (!breaks && IS_SPACE(string) && !IS_SPACE_AT(string, 1) && emitter->column > emitter->best_width) {
-                if (!yaml_emitter_write_indent(emitter)) return MYYAML_FAILURE;
-                MOVE(string);
-            } else {
-                if (!WRITE(emitter, string)) return MYYAML_FAILURE;
-            }
-            emitter->indention = 0;
-            breaks = 0;
-        }
+    return document->nodes.top - document->nodes.start;
+
+error:
+    if (!document->arena) {
+        _myyaml_free(document->allocator, tag_copy);
+        _myyaml_free(document->allocator, value_copy);
     }
 
-    return MYYAML_SUCCESS;
+    return MYYAML_FAILURE;
 }
 
-#pragma endregion  // Emitter
-
-#endif  // MYYAML_DISABLE_WRITER
+MYYAML_API int yaml_document_add_sequence(YamlDocument *document, const YamlChar_t *tag, YamlSequenceStyle style) {
+    struct {
+        YamlErrorType error;
+        const YamlAllocator *allocator;
+    } context = {YAML_NO_ERROR, NULL};
+    YamlMark mark = {0, 0, 0};
+    YamlChar_t *tag_copy = NULL;
+    struct {
+        YamlNodeItem *start;
+        YamlNodeItem *end;
+        YamlNodeItem *top;
+    } items = {NULL, NULL, NULL};
+    YamlNode node;
 
-#pragma endregion  // C Definations
+    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
 
-#ifdef __cplusplus
-}
-#endif  // __cplusplus
+    context.allocator = document->allocator;
 
-//-----------------------------------------------------------------------------
-// [SECTION] C++ Only Classes
-//-----------------------------------------------------------------------------
+    if (!tag) {
+        tag = (YamlChar_t *)YAML_DEFAULT_SEQUENCE_TAG;
+    }
 
-#ifdef __cplusplus
+    if (!yaml_check_utf8(tag, strlen((char *)tag))) goto error;
+    tag_copy = yaml_document_strdup(document, tag, strlen((char *)tag));
+    if (!tag_copy) goto error;
 
-namespace myyaml {
-inline namespace internal {
-//-----------------------------------------------------------------------------
-// [SECTION] Declarations
-//-----------------------------------------------------------------------------
+    if (!DOCUMENT_STACK_INIT(&context, document, items, YamlNodeItem *)) goto error;
 
-#pragma region Cpp Dec
+    SEQUENCE_NODE_INIT(node, tag_copy, items.start, items.end, style, mark, mark);
+    if (!PUSH(&context, document->nodes, node)) goto error;
 
-#if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
+    return document->nodes.top - document->nodes.start;
 
-#endif  // MYYAML_DISABLE_READER
+error:
+    if (!document->arena) {
+        STACK_DEL(&context, items);
+        _myyaml_free(document->allocator, tag_copy);
+    }
 
-#if !defined(MYYAML_DISABLE_WRITER) || !MYYAML_DISABLE_WRITER
+    return MYYAML_FAILURE;
+}
 
-#endif  // MYYAML_DISABLE_WRITER
+MYYAML_API int yaml_document_add_mapping(YamlDocument *document, const YamlChar_t *tag, YamlMappingStyle style) {
+    struct {
+        YamlErrorType error;
+        const YamlAllocator *allocator;
+    } context = {YAML_NO_ERROR, NULL};
+    YamlMark mark = {0, 0, 0};
+    YamlChar_t *tag_copy = NULL;
+    struct {
+        YamlNodePair *start;
+        YamlNodePair *end;
+        YamlNodePair *top;
+    } pairs = {NULL, NULL, NULL};
+    YamlNode node;
 
-#pragma endregion  // C++ Declarations
+    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
 
-//-----------------------------------------------------------------------------
-// [SECTION] Definations
-//-----------------------------------------------------------------------------
+    context.allocator = document->allocator;
 
-#pragma region Cpp Def
+    if (!tag) {
+        tag = (YamlChar_t *)YAML_DEFAULT_MAPPING_TAG;
+    }
 
-#if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
-#endif  // MYYAML_DISABLE_READER
+    if (!yaml_check_utf8(tag, strlen((char *)tag))) goto error;
+    tag_copy = yaml_document_strdup(document, tag, strlen((char *)tag));
+    if (!tag_copy) goto error;
 
-#if !defined(MYYAML_DISABLE_WRITER) || !MYYAML_DISABLE_WRITER
-#endif  // MYYAML_DISABLE_WRITER
+    if (!DOCUMENT_STACK_INIT(&context, document, pairs, YamlNodePair *)) goto error;
 
-#pragma endregion  // Definations
+    MAPPING_NODE_INIT(node, tag_copy, pairs.start, pairs.end, style, mark, mark);
+    if (!PUSH(&context, document->nodes, node)) goto error;
 
-};  // namespace internal
-};  // namespace myyaml
+    return document->nodes.top - document->nodes.start;
 
-#endif  //__cplusplus
+error:
+    if (!document->arena) {
+        STACK_DEL(&context, pairs);
+        _myyaml_free(document->allocator, tag_copy);
+    }
 
-#pragma endregion  // Internal
+    return MYYAML_FAILURE;
+}
 
-#pragma region Myyaml
+MYYAML_API int yaml_document_append_sequence_item(YamlDocument *document, int sequence, int item) {
+    struct {
+        YamlErrorType error;
+    } context;
 
-//-----------------------------------------------------------------------------
-// [SECTION] C Only Functions
-//-----------------------------------------------------------------------------
+    MYYAML_ASSERT(document); /* Non-NULL document is required. */
+    MYYAML_ASSERT(sequence > 0 && document->nodes.start + sequence <= document->nodes.top);
+    /* Valid sequence id is required. */
+    MYYAML_ASSERT(document->nodes.start[sequence - 1].type == YAML_SEQUENCE_NODE);
+    /* A sequence node is required. */
+    MYYAML_ASSERT(item > 0 && document->nodes.start + item <= document->nodes.top);
+    /* Valid item id is required. */
 
-#pragma region C
+    if (!DOCUMENT_PUSH(&context, document, document->nodes.start[sequence - 1].data.sequence.items, item)) return MYYAML_FAILURE;
 
-#ifdef __cplusplus
-extern "C" {
-#endif  // __cplusplus
+    return MYYAML_SUCCESS;
+}
 
-MYYAML_API void yaml_set_max_nest_level(int max) { MAX_NESTING_LEVEL = max; }
+MYYAML_API int yaml_document_append_mapping_pair(YamlDocument *document, int mapping, int key, int value) {
+    struct {
+        YamlErrorType error;
+    } context;
 
-MYYAML_API void yaml_token_delete(YamlToken *token) {
-    MYYAML_ASSERT(token); /* Non-NULL token object expected. */
+    YamlNodePair pair;
 
-    switch (token->type) {
-        case YAML_TAG_DIRECTIVE_TOKEN:
-            _myyaml_free(token->data.tag_directive.handle);
-            _myyaml_free(token->data.tag_directive.prefix);
-            break;
+    MYYAML_ASSERT(document);                                                              /* Non-NULL document is required. */
+    MYYAML_ASSERT(mapping > 0 && document->nodes.start + mapping <= document->nodes.top); /* Valid mapping id is required. */
 
-        case YAML_ALIAS_TOKEN:
-            _myyaml_free(token->data.alias.value);
-            break;
+    MYYAML_ASSERT(document->nodes.start[mapping - 1].type == YAML_MAPPING_NODE);
+    /* A mapping node is required. */
+    MYYAML_ASSERT(key > 0 && document->nodes.start + key <= document->nodes.top);
+    /* Valid key id is required. */
+    MYYAML_ASSERT(value > 0 && document->nodes.start + value <= document->nodes.top);
+    /* Valid value id is required. */
 
-        case YAML_ANCHOR_TOKEN:
-            _myyaml_free(token->data.anchor.value);
-            break;
+    pair.key = key;
+    pair.value = value;
 
-        case YAML_TAG_TOKEN:
-            _myyaml_free(token->data.tag.handle);
-            _myyaml_free(token->data.tag.suffix);
-            break;
+    if (!DOCUMENT_PUSH(&context, document, document->nodes.start[mapping - 1].data.mapping.pairs, pair)) return MYYAML_FAILURE;
 
-        case YAML_SCALAR_TOKEN:
-            _myyaml_free(token->data.scalar.value);
-            break;
+    /* Keep an existing key index in step; lookups rebuild it if this fails. */
 
-        default:
-            break;
+    if (document->nodes.start[mapping - 1].data.mapping.index &&
+        !yaml_document_update_mapping_index(document, document->nodes.start + mapping - 1)) {
+        yaml_document_delete_mapping_index(document, document->nodes.start + mapping - 1);
     }
 
-    memset(token, 0, sizeof(YamlToken));
+    return MYYAML_SUCCESS;
 }
 
-#pragma region Encoding
-
-static int rune_is_valid(uint32_t rune) { return rune < 0xD800 || rune > 0xDFFF; }
+#pragma endregion  // Document
 
-static int secondary_byte(unsigned char b) { return b >= 0x80 && b <= 0xBF; }
+/* Convenience accessors */
 
-size_t utf8_decode(const char *data, size_t size, uint32_t *rune) {
-    if (size == 0) return 0;
+MYYAML_API const YamlChar_t *yaml_document_get_scalar_value(YamlDocument *document, int node_id) {
+    YamlNode *node;
 
-    size_t rd = 0;
-    unsigned char c = (unsigned char)data[rd++];
+    MYYAML_ASSERT(document);
 
-    // 1 byte ASCII.
-    if (c <= 0x7F) {
-        if (rune != NULL) *rune = (uint32_t)c;
+    node = yaml_document_get_node(document, node_id);
+    if (!node) return NULL;
+    if (node->type != YAML_SCALAR_NODE) return NULL;
 
-        return 1;
-    }
+    return node->data.scalar.value;
+}
 
-    // 2 byte.
-    if (c >= 0xC0 && c <= 0xDF) {
-        if (rd == size) return 0;
+MYYAML_API int yaml_document_get_scalar_length(YamlDocument *document, int node_id) {
+    YamlNode *node;
 
-        unsigned char more = (unsigned char)data[rd];
-        if (!secondary_byte(more)) return 0;
+    MYYAML_ASSERT(document);
 
-        uint32_t rn = (((uint32_t)c & 0x1F) << 6) | ((uint32_t)more & 0x3F);
-        if (!rune_is_valid(rn)) return 0;
+    node = yaml_document_get_node(document, node_id);
+    if (!node) return -1;
+    if (node->type != YAML_SCALAR_NODE) return -1;
 
-        if (rune != NULL) *rune = rn;
+    return node->data.scalar.length;
+}
 
-        return 2;
-    }
+MYYAML_API int yaml_document_sequence_get_item(YamlDocument *document, int sequence_node_id, int index) {
+    YamlNode *node;
 
-    // 3 byte.
-    if (c >= 0xE0 && c <= 0xEF) {
-        if (rd + 2 > size) return 0;
+    MYYAML_ASSERT(document);
 
-        unsigned char more[2];
-        for (size_t i = 0; i < sizeof(more); i++) {
-            if (!secondary_byte(more[i] = data[rd++])) return 0;
-        }
+    node = yaml_document_get_node(document, sequence_node_id);
+    if (!node) return MYYAML_FAILURE;
+    if (node->type != YAML_SEQUENCE_NODE) return MYYAML_FAILURE;
 
-        uint32_t rn = (((uint32_t)c & 0x0F) << 12) | (((uint32_t)more[0] & 0x3F) << 6) | ((uint32_t)more[1] & 0x3F);
-        if (!rune_is_valid(rn)) return 0;
+    if (index < 0 || node->data.sequence.items.start + index >= node->data.sequence.items.top) return MYYAML_FAILURE;
 
-        if (rune != NULL) *rune = rn;
+    return node->data.sequence.items.start[index];
+}
 
-        return 3;
-    }
+MYYAML_API int yaml_document_mapping_get_value(YamlDocument *document, int mapping_node_id, const YamlChar_t *key, int key_length) {
+    YamlNode *node;
 
-    // 4 byte.
-    if (c >= 0xF0 && c <= 0xF7) {
-        if (rd + 3 > size) return 0;
+    MYYAML_ASSERT(document);
+    MYYAML_ASSERT(key);
 
-        unsigned char more[3];
-        for (size_t i = 0; i < sizeof(more); i++) {
-            if (!secondary_byte(more[i] = data[rd++])) return 0;
-        }
+    node = yaml_document_get_node(document, mapping_node_id);
+    if (!node) return MYYAML_FAILURE;
+    if (node->type != YAML_MAPPING_NODE) return MYYAML_FAILURE;
 
-        uint32_t rn =
-            (((uint32_t)c & 0x0F) << 18) | (((uint32_t)more[0] & 0x3F) << 12) | (((uint32_t)more[1] & 0x3F) << 6) | ((uint32_t)more[2] & 0x3F);
-        if (!rune_is_valid(rn)) return 0;
+    if (key_length < 0) key_length = (int)strlen((char *)key);
 
-        if (rune != NULL) *rune = rn;
+    /* Build the key index of a large mapping on first use; without it the pairs are searched linearly. */
 
-        return 4;
+    if (node->data.mapping.index || node->data.mapping.pairs.top - node->data.mapping.pairs.start >= MYYAML_MAPPING_INDEX_THRESHOLD) {
+        (void)yaml_document_update_mapping_index(document, node);
     }
 
-    return 0;
+    return yaml_document_mapping_find(document, node, key, key_length, node->data.mapping.index ? yaml_hash_string(key, key_length) : 0);
 }
 
-size_t utf8_encode(char *buffer, uint32_t rune) {
-    // 1 byte ASCII.
-    if (rune <= 0x7F) {
-        if (buffer != NULL) *buffer = (char)rune;
+/* Find node by path of keys. */
+static int is_decimal_string_n(const YamlChar_t *s, size_t length) {
+    if (!length) return MYYAML_FAILURE;
+    while (length--) {
+        if (*s < '0' || *s > '9') return MYYAML_FAILURE;
+        s++;
+    }
+    return MYYAML_SUCCESS;
+}
 
-        return 1;
+static int is_decimal_string(const YamlChar_t *s) {
+    if (!s || !*s) return MYYAML_FAILURE;
+    while (*s) {
+        if (*s < '0' || *s > '9') return MYYAML_FAILURE;
+        s++;
     }
+    return MYYAML_SUCCESS;
+}
 
-    // 2 byte.
-    if (rune >= 0x80 && rune <= 0x7FF) {
-        if (buffer != NULL) {
-            buffer[0] = (char)(0xC0 | ((rune >> 6) & 0x1F));
-            buffer[1] = (char)(0x80 | (rune & 0x3F));
-        }
+MYYAML_API int yaml_document_get_node_by_path(YamlDocument *document, const YamlChar_t **keys, int key_count) {
+    int current_id;
+    int i;
 
-        return 2;
-    }
+    MYYAML_ASSERT(document);
+    if (!keys || key_count <= 0) return MYYAML_FAILURE;
 
-    // 3 byte.
-    if (rune >= 0x800 && rune <= 0xFFFF) {
-        if (buffer != NULL) {
-            buffer[0] = (char)(0xE0 | ((rune >> 12) & 0x0F));
-            buffer[1] = (char)(0x80 | ((rune >> 6) & 0x3F));
-            buffer[2] = (char)(0x80 | (rune & 0x3F));
+    /* Start from root */
+    current_id = 0;
+    current_id = (yaml_document_get_root_node(document) ? (int)(yaml_document_get_root_node(document) - document->nodes.start + 1) : 0);
+    if (!current_id) return MYYAML_FAILURE;
+
+    for (i = 0; i < key_count; i++) {
+        YamlNode *node = yaml_document_get_node(document, current_id);
+        if (!node) return MYYAML_FAILURE;
+
+        if (node->type == YAML_MAPPING_NODE) {
+            /* lookup mapping by scalar key */
+            int found_id = yaml_document_mapping_get_value(document, current_id, keys[i], -1);
+            if (!found_id) return MYYAML_FAILURE;
+            current_id = found_id;
+            continue;
         }
 
-        return 3;
-    }
-
-    // 4 byte.
-    if (rune >= 0x10000 && rune <= 0x10FFFF) {
-        if (buffer != NULL) {
-            buffer[0] = (char)(0xF0 | ((rune >> 18) & 0x07));
-            buffer[1] = (char)(0x80 | ((rune >> 12) & 0x3F));
-            buffer[2] = (char)(0x80 | ((rune >> 6) & 0x3F));
-            buffer[3] = (char)(0x80 | (rune & 0x3F));
+        if (node->type == YAML_SEQUENCE_NODE) {
+            /* sequence: key must be decimal index */
+            if (!is_decimal_string(keys[i])) return MYYAML_FAILURE;
+            int idx = atoi((const char *)keys[i]);
+            int item_id = yaml_document_sequence_get_item(document, current_id, idx);
+            if (!item_id) return MYYAML_FAILURE;
+            current_id = item_id;
+            continue;
         }
 
-        return 4;
+        /* scalar or other: cannot traverse further */
+        return MYYAML_FAILURE;
     }
 
-    return 0;
+    return current_id;
 }
 
-int utf8_is_valid(const char *data, size_t size) {
-    for (size_t i = 0; i < size;) {
-        size_t s = utf8_decode(&data[i], size - i, NULL);
-        if (s == 0) return 0;
-
-        i += s;
-    }
-
-    return 1;
+MYYAML_API const YamlChar_t *yaml_document_get_value_by_path(YamlDocument *document, const YamlChar_t **keys, int key_count) {
+    int id = yaml_document_get_node_by_path(document, keys, key_count);
+    if (!id) return NULL;
+    return yaml_document_get_scalar_value(document, id);
 }
-MYYAML_API int yaml_check_utf8(const YamlChar_t *start, size_t length) {
-    const YamlChar_t *end = start + length;
-    const YamlChar_t *pointer = start;
 
-    while (pointer < end) {
-        unsigned char octet;
-        unsigned int width;
-        unsigned int value;
-        size_t k;
-
-        octet = pointer[0];
-        width = (octet & 0x80) == 0x00 ? 1 : (octet & 0xE0) == 0xC0 ? 2 : (octet & 0xF0) == 0xE0 ? 3 : (octet & 0xF8) == 0xF0 ? 4 : 0;
-        value = (octet & 0x80) == 0x00   ? octet & 0x7F
-                : (octet & 0xE0) == 0xC0 ? octet & 0x1F
-                : (octet & 0xF0) == 0xE0 ? octet & 0x0F
-                : (octet & 0xF8) == 0xF0 ? octet & 0x07
-                                         : 0;
-        if (!width) return MYYAML_FAILURE;
-        if (pointer + width > end) return MYYAML_FAILURE;
-        for (k = 1; k < width; k++) {
-            octet = pointer[k];
-            if ((octet & 0xC0) != 0x80) return MYYAML_FAILURE;
-            value = (value << 6) + (octet & 0x3F);
-        }
-        if (!((width == 1) || (width == 2 && value >= 0x80) || (width == 3 && value >= 0x800) || (width == 4 && value >= 0x10000)))
-            return MYYAML_FAILURE;
+MYYAML_API int yaml_document_get_value_length_by_path(YamlDocument *document, const YamlChar_t **keys, int key_count) {
+    int id = yaml_document_get_node_by_path(document, keys, key_count);
+    if (!id) return -1;
+    return yaml_document_get_scalar_length(document, id);
+}
 
-        pointer += width;
-    }
+/* Compiled paths */
 
-    return MYYAML_SUCCESS;
+MYYAML_API YamlPath *yaml_path_compile(const char *expression) {
+    return yaml_path_compile_allocator(expression, NULL);
 }
 
-#pragma endregion  // Encoding
+MYYAML_API YamlPath *yaml_path_compile_allocator(const char *expression, const YamlAllocator *allocator) {
+    size_t length;
+    size_t capacity;
+    const char *pointer;
+    YamlChar_t *keys;
+    YamlPath *path;
 
-#pragma region Event
+    MYYAML_ASSERT(expression); /* Non-NULL expression is expected. */
 
-MYYAML_API int yaml_event_initialize_stream_start(YamlEvent *event, YamlEncoding encoding) {
-    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
+    /*
+     * Every segment takes at least one character of the expression, and no
+     * key is longer than its text: size the allocation from the length.
+     */
 
-    YamlMark mark = {0, 0, 0};
+    length = strlen(expression);
+    capacity = length + 1;
 
-    memset((event), 0, sizeof(YamlEvent));
-    event->type = YAML_STREAM_START_EVENT;
-    event->start_mark = mark;
-    event->end_mark = mark;
-    event->data.stream_start.encoding = encoding;
+    path = (YamlPath *)_myyaml_malloc(allocator, sizeof(YamlPath) + capacity * sizeof(YamlPathSegment_t) + capacity);
+    if (!path) return NULL;
 
-    return MYYAML_SUCCESS;
-}
+    path->allocator = allocator;
+    path->count = 0;
+    keys = (YamlChar_t *)(path->segments + capacity);
 
-MYYAML_API int yaml_event_initialize_stream_end(YamlEvent *event) {
-    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
+    for (pointer = expression; *pointer;) {
+        YamlPathSegment_t *segment = path->segments + path->count;
+        YamlChar_t *key = keys;
 
-    YamlMark mark = {0, 0, 0};
+        if (*pointer == '[' && (pointer[1] == '"' || pointer[1] == '\'')) {
+            /* A quoted key; a backslash escapes the next character. */
 
-    memset((event), 0, sizeof(YamlEvent));
-    event->type = YAML_STREAM_END_EVENT;
-    event->start_mark = mark;
-    event->end_mark = mark;
+            char quote = pointer[1];
 
-    return MYYAML_SUCCESS;
-}
+            pointer += 2;
+            while (*pointer && *pointer != quote) {
+                if (*pointer == '\\' && pointer[1]) pointer++;
+                *keys++ = (YamlChar_t)*pointer++;
+            }
+            if (pointer[0] != quote || pointer[1] != ']') goto error;
+            pointer += 2;
+        } else {
+            int bracket = (*pointer == '[');
 
-MYYAML_API int yaml_event_initialize_document_start(YamlEvent *event, YamlVersionDirective *version_directive, YamlTagDirective *tag_directives_start,
-                                                    YamlTagDirective *tag_directives_end, int implicit) {
-    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
-    MYYAML_ASSERT((tag_directives_start && tag_directives_end) || (tag_directives_start == tag_directives_end));
+            if (bracket) {
+                pointer++;
+                while (*pointer >= '0' && *pointer <= '9') *keys++ = (YamlChar_t)*pointer++;
+                if (*pointer != ']') goto error;
+                pointer++;
+            } else {
+                while (*pointer && *pointer != '.' && *pointer != '[') *keys++ = (YamlChar_t)*pointer++;
+            }
+            if (keys == key) goto error;
+        }
 
-    struct {
-        YamlErrorType error;
-    } context;
+        segment->key = key;
+        segment->length = keys - key;
+        segment->hash = yaml_hash_string(key, segment->length);
+        segment->index = -1;
 
-    YamlVersionDirective *version_directive_copy = NULL;
-    YamlTagDirective value = {NULL, NULL};
-    YamlMark mark = {0, 0, 0};
-    struct {
-        YamlTagDirective *start;
-        YamlTagDirective *end;
-        YamlTagDirective *top;
-    } tag_directives_copy = {NULL, NULL, NULL};
+        /* A decimal key also selects an item of a sequence. */
 
-    /* Valid tag directives are expected. */
-    if (version_directive) {
-        version_directive_copy = YAML_MALLOC_STATIC(YamlVersionDirective);
-        if (!version_directive_copy) goto error;
-        version_directive_copy->major = version_directive->major;
-        version_directive_copy->minor = version_directive->minor;
-    }
+        if (is_decimal_string_n(key, segment->length)) {
+            size_t k;
+            long long value = 0;
 
-    if (tag_directives_start != tag_directives_end) {
-        YamlTagDirective *tag_directive;
-        if (!STACK_INIT(&context, tag_directives_copy, YamlTagDirective *)) goto error;
-        for (tag_directive = tag_directives_start; tag_directive != tag_directives_end; tag_directive++) {
-            MYYAML_ASSERT(tag_directive->handle);
-            MYYAML_ASSERT(tag_directive->prefix);
-            if (!yaml_check_utf8(tag_directive->handle, strlen((char *)tag_directive->handle))) goto error;
-            if (!yaml_check_utf8(tag_directive->prefix, strlen((char *)tag_directive->prefix))) goto error;
-            value.handle = _myyaml_strdup(tag_directive->handle);
-            value.prefix = _myyaml_strdup(tag_directive->prefix);
-            if (!value.handle || !value.prefix) goto error;
-            if (!PUSH(&context, tag_directives_copy, value)) goto error;
-            value.handle = NULL;
-            value.prefix = NULL;
+            for (k = 0; k < segment->length && value <= INT_MAX; k++) value = value * 10 + (key[k] - '0');
+            if (value <= INT_MAX) segment->index = (int)value;
         }
-    }
 
-    memset((event), 0, sizeof(YamlEvent));
-    event->type = YAML_DOCUMENT_START_EVENT;
-    event->start_mark = mark;
-    event->end_mark = mark;
-    event->data.document_start.version_directive = version_directive_copy;
-    event->data.document_start.tag_directives.start = tag_directives_copy.start;
-    event->data.document_start.tag_directives.end = tag_directives_copy.top;
-    event->data.document_start.implicit = implicit;
+        path->count++;
 
-    return MYYAML_SUCCESS;
+        /* Segments are separated by dots, or start with a bracket. */
 
-error:
-    _myyaml_free(version_directive_copy);
-    while (!STACK_EMPTY(context, tag_directives_copy)) {
-        YamlTagDirective value = POP(context, tag_directives_copy);
-        _myyaml_free(value.handle);
-        _myyaml_free(value.prefix);
+        if (*pointer == '.') {
+            pointer++;
+            if (!*pointer) goto error;
+        } else if (*pointer && *pointer != '[') {
+            goto error;
+        }
     }
-    STACK_DEL(context, tag_directives_copy);
-    _myyaml_free(value.handle);
-    _myyaml_free(value.prefix);
-
-    return MYYAML_FAILURE;
-}
 
-MYYAML_API int yaml_event_initialize_document_end(YamlEvent *event, int implicit) {
-    MYYAML_ASSERT(event); /**< Non-NULL emitter object is expected. */
-
-    YamlMark mark = {0, 0, 0};
+    return path;
 
-    memset((event), 0, sizeof(YamlEvent));
-    event->type = YAML_DOCUMENT_END_EVENT;
-    event->start_mark = mark;
-    event->end_mark = mark;
-    event->data.document_end.implicit = implicit;
+error:
+    _myyaml_free(allocator, path);
 
-    return MYYAML_SUCCESS;
+    return NULL;
 }
 
-MYYAML_API int yaml_event_initialize_alias(YamlEvent *event, const YamlChar_t *anchor) {
-    MYYAML_ASSERT(event);  /**< Non-NULL event object is expected. */
-    MYYAML_ASSERT(anchor); /**< Non-NULL anchor is expected. */
-
-    YamlChar_t *anchor_copy = NULL;
-    YamlMark mark = {0, 0, 0};
+MYYAML_API void yaml_path_delete(YamlPath *path) {
+    if (!path) return;
 
-    if (!yaml_check_utf8(anchor, strlen((char *)anchor))) return MYYAML_FAILURE;
+    _myyaml_free(path->allocator, path);
+}
 
-    anchor_copy = _myyaml_strdup(anchor);
+MYYAML_API int yaml_path_eval(YamlDocument *document, const YamlPath *path) {
+    YamlNode *root;
 
-    if (!anchor_copy) return MYYAML_FAILURE;
+    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
 
-    memset((event), 0, sizeof(YamlEvent));
-    event->type = YAML_ALIAS_EVENT;
-    event->start_mark = mark;
-    event->end_mark = mark;
-    event->data.alias.anchor = anchor_copy;
+    root = yaml_document_get_root_node(document);
+    if (!root) return MYYAML_FAILURE;
 
-    return MYYAML_SUCCESS;
+    return yaml_path_eval_from(document, (int)(root - document->nodes.start) + 1, path);
 }
 
-MYYAML_API int yaml_event_initialize_scalar(YamlEvent *event, const YamlChar_t *anchor, const YamlChar_t *tag, const YamlChar_t *value, int length,
-                                            int plain_implicit, int quoted_implicit, YamlScalarStyle style) {
-    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
-    MYYAML_ASSERT(value); /**< Non-NULL anchor is expected. */
+MYYAML_API int yaml_path_eval_from(YamlDocument *document, int node_id, const YamlPath *path) {
+    size_t k;
 
-    YamlChar_t *anchor_copy = NULL;
-    YamlChar_t *value_copy = NULL;
-    YamlChar_t *tag_copy = NULL;
-    YamlMark mark = {0, 0, 0};
+    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
+    MYYAML_ASSERT(path);     /* Non-NULL path object is expected. */
 
-    if (anchor) {
-        if (!yaml_check_utf8(anchor, strlen((char *)anchor))) goto error;
-        anchor_copy = _myyaml_strdup(anchor);
-        if (!anchor_copy) goto error;
-    }
+    for (k = 0; k < path->count; k++) {
+        const YamlPathSegment_t *segment = path->segments + k;
+        YamlNode *node = yaml_document_get_node(document, node_id);
 
-    if (tag) {
-        if (!yaml_check_utf8(tag, strlen((char *)tag))) goto error;
-        tag_copy = _myyaml_strdup(tag);
-        if (!tag_copy) goto error;
-    }
+        if (!node) return MYYAML_FAILURE;
 
-    if (length < 0) {
-        length = strlen((char *)value);
+        switch (node->type) {
+            case YAML_MAPPING_NODE:
+                node_id = yaml_document_mapping_find(document, node, segment->key, segment->length, segment->hash);
+                break;
+            case YAML_SEQUENCE_NODE:
+                if (segment->index < 0 || segment->index >= node->data.sequence.items.top - node->data.sequence.items.start) {
+                    return MYYAML_FAILURE;
+                }
+                node_id = node->data.sequence.items.start[segment->index];
+                break;
+            default:
+                return MYYAML_FAILURE;
+        }
     }
 
-    if (!yaml_check_utf8(value, length)) goto error;
-    value_copy = YAML_MALLOC(length + 1);
-    if (!value_copy) goto error;
-    memcpy(value_copy, value, length);
-    value_copy[length] = '\0';
+    return node_id;
+}
 
-    memset((event), 0, sizeof(YamlEvent));
-    event->type = YAML_SCALAR_EVENT;
-    event->start_mark = mark;
-    event->end_mark = mark;
-    event->data.scalar.anchor = anchor_copy;
-    event->data.scalar.tag = tag_copy;
-    event->data.scalar.value = value_copy;
-    event->data.scalar.length = length;
-    event->data.scalar.plain_implicit = plain_implicit, event->data.scalar.quoted_implicit = quoted_implicit;
-    event->data.scalar.style = style;
+/* Tapes */
 
-    return MYYAML_SUCCESS;
+MYYAML_API void yaml_tape_delete(YamlTape *tape) {
+    MYYAML_ASSERT(tape); /* Non-NULL tape object is expected. */
 
-error:
-    _myyaml_free(anchor_copy);
-    _myyaml_free(tag_copy);
-    _myyaml_free(value_copy);
+    STACK_DEL(tape, tape->entries);
+    STRING_DEL(tape, tape->strings);
 
-    return MYYAML_FAILURE;
+    memset(tape, 0, sizeof(YamlTape));
 }
 
-MYYAML_API int yaml_event_initialize_sequence_start(YamlEvent *event, const YamlChar_t *anchor, const YamlChar_t *tag, int implicit,
-                                                    YamlSequenceStyle style) {
-    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
-
-    YamlChar_t *anchor_copy = NULL;
-    YamlChar_t *tag_copy = NULL;
-    YamlMark mark = {0, 0, 0};
-
-    if (anchor) {
-        if (!yaml_check_utf8(anchor, strlen((char *)anchor))) goto error;
-        anchor_copy = _myyaml_strdup(anchor);
-        if (!anchor_copy) goto error;
-    }
+MYYAML_API YamlTapeEntry *yaml_tape_get_entry(YamlTape *tape, int id) {
+    MYYAML_ASSERT(tape); /* Non-NULL tape object is expected. */
 
-    if (tag) {
-        if (!yaml_check_utf8(tag, strlen((char *)tag))) goto error;
-        tag_copy = _myyaml_strdup(tag);
-        if (!tag_copy) goto error;
+    if (id > 0 && tape->entries.start + id <= tape->entries.top) {
+        return tape->entries.start + id - 1;
     }
+    return NULL;
+}
 
-    memset((event), 0, sizeof(YamlEvent));
-    event->type = YAML_SEQUENCE_START_EVENT;
-    event->start_mark = mark;
-    event->end_mark = mark;
-    event->data.sequence_start.anchor = anchor_copy;
-    event->data.sequence_start.tag = tag_copy;
-    event->data.sequence_start.implicit = implicit;
-    event->data.sequence_start.style = style;
-
-    return MYYAML_SUCCESS;
+static YamlTapeEntry *yaml_tape_resolve(YamlTape *tape, int *id) {
+    YamlTapeEntry *entry = yaml_tape_get_entry(tape, *id);
 
-error:
-    _myyaml_free(anchor_copy);
-    _myyaml_free(tag_copy);
+    if (entry && entry->alias) {
+        *id = (int)entry->data;
+        entry = tape->entries.start + *id - 1;
+    }
 
-    return MYYAML_FAILURE;
+    return entry;
 }
 
-MYYAML_API int yaml_event_initialize_sequence_end(YamlEvent *event) {
-    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
-
-    YamlMark mark = {0, 0, 0};
+MYYAML_API int yaml_tape_next(YamlTape *tape, int id) {
+    YamlTapeEntry *entry = yaml_tape_get_entry(tape, id);
 
-    memset((event), 0, sizeof(YamlEvent));
-    event->type = YAML_SEQUENCE_END_EVENT;
-    event->start_mark = mark;
-    event->end_mark = mark;
+    if (!entry) return MYYAML_FAILURE;
 
-    return MYYAML_SUCCESS;
+    return (entry->type == YAML_SCALAR_NODE || entry->alias) ? id + 1 : (int)entry->data;
 }
 
-MYYAML_API int yaml_event_initialize_mapping_start(YamlEvent *event, const YamlChar_t *anchor, const YamlChar_t *tag, int implicit,
-                                                   YamlMappingStyle style) {
-    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
-
-    YamlChar_t *anchor_copy = NULL;
-    YamlChar_t *tag_copy = NULL;
-    YamlMark mark = {0, 0, 0};
+MYYAML_API const YamlChar_t *yaml_tape_get_tag(YamlTape *tape, int id) {
+    static const char *const default_tags[4] = {NULL, YAML_DEFAULT_SCALAR_TAG, YAML_DEFAULT_SEQUENCE_TAG, YAML_DEFAULT_MAPPING_TAG};
+    YamlTapeEntry *entry = yaml_tape_resolve(tape, &id);
 
-    if (anchor) {
-        if (!yaml_check_utf8(anchor, strlen((char *)anchor))) goto error;
-        anchor_copy = _myyaml_strdup(anchor);
-        if (!anchor_copy) goto error;
-    }
+    if (!entry) return NULL;
 
-    if (tag) {
-        if (!yaml_check_utf8(tag, strlen((char *)tag))) goto error;
-        tag_copy = _myyaml_strdup(tag);
-        if (!tag_copy) goto error;
-    }
+    return entry->tag ? tape->strings.start + entry->tag : (const YamlChar_t *)default_tags[entry->type];
+}
 
-    memset((event), 0, sizeof(YamlEvent));
-    event->type = YAML_MAPPING_START_EVENT;
-    event->start_mark = mark;
-    event->end_mark = mark;
-    event->data.mapping_start.anchor = anchor_copy;
-    event->data.mapping_start.tag = tag_copy;
-    event->data.mapping_start.implicit = implicit;
-    event->data.mapping_start.style = style;
+MYYAML_API const YamlChar_t *yaml_tape_get_scalar_value(YamlTape *tape, int id, size_t *length) {
+    YamlTapeEntry *entry = yaml_tape_resolve(tape, &id);
 
-    return MYYAML_SUCCESS;
+    if (!entry || entry->type != YAML_SCALAR_NODE) return NULL;
 
-error:
-    _myyaml_free(anchor_copy);
-    _myyaml_free(tag_copy);
+    if (length) *length = entry->length;
 
-    return MYYAML_FAILURE;
+    return tape->strings.start + entry->data;
 }
 
-MYYAML_API int yaml_event_initialize_mapping_end(YamlEvent *event) {
-    MYYAML_ASSERT(event); /**< Non-NULL event object is expected. */
+MYYAML_API int yaml_tape_sequence_get_item(YamlTape *tape, int id, int index) {
+    YamlTapeEntry *entry = yaml_tape_resolve(tape, &id);
+    int item;
 
-    YamlMark mark = {0, 0, 0};
+    if (!entry || entry->type != YAML_SEQUENCE_NODE) return MYYAML_FAILURE;
+    if (index < 0 || (uint32_t)index >= entry->length) return MYYAML_FAILURE;
 
-    memset((event), 0, sizeof(YamlEvent));
-    event->type = YAML_MAPPING_END_EVENT;
-    event->start_mark = mark;
-    event->end_mark = mark;
+    for (item = id + 1; index--;) {
+        item = yaml_tape_next(tape, item);
+    }
 
-    return MYYAML_SUCCESS;
+    (void)yaml_tape_resolve(tape, &item);
+
+    return item;
 }
 
-MYYAML_API void yaml_event_delete(YamlEvent *event) {
-    MYYAML_ASSERT(event); /**< Non-NULL event object expected. */
+MYYAML_API int yaml_tape_mapping_get_value(YamlTape *tape, int id, const YamlChar_t *key, int key_length) {
+    YamlTapeEntry *entry = yaml_tape_resolve(tape, &id);
+    int child;
 
-    YamlTagDirective *tag_directive;
+    MYYAML_ASSERT(key);
 
-    switch (event->type) {
-        case YAML_DOCUMENT_START_EVENT:
-            _myyaml_free(event->data.document_start.version_directive);
-            for (tag_directive = event->data.document_start.tag_directives.start; tag_directive != event->data.document_start.tag_directives.end;
-                 tag_directive++) {
-                _myyaml_free(tag_directive->handle);
-                _myyaml_free(tag_directive->prefix);
-            }
-            _myyaml_free(event->data.document_start.tag_directives.start);
-            break;
+    if (!entry || entry->type != YAML_MAPPING_NODE) return MYYAML_FAILURE;
 
-        case YAML_ALIAS_EVENT:
-            _myyaml_free(event->data.alias.anchor);
-            break;
+    if (key_length < 0) key_length = (int)strlen((char *)key);
 
-        case YAML_SCALAR_EVENT:
-            _myyaml_free(event->data.scalar.anchor);
-            _myyaml_free(event->data.scalar.tag);
-            _myyaml_free(event->data.scalar.value);
-            break;
+    /* The pairs are searched linearly, skipping over the values. */
 
-        case YAML_SEQUENCE_START_EVENT:
-            _myyaml_free(event->data.sequence_start.anchor);
-            _myyaml_free(event->data.sequence_start.tag);
-            break;
+    for (child = id + 1; child < (int)entry->data;) {
+        int key_id = child;
+        int value = yaml_tape_next(tape, child);
+        YamlTapeEntry *candidate = yaml_tape_resolve(tape, &key_id);
 
-        case YAML_MAPPING_START_EVENT:
-            _myyaml_free(event->data.mapping_start.anchor);
-            _myyaml_free(event->data.mapping_start.tag);
-            break;
+        if (candidate->type == YAML_SCALAR_NODE && candidate->length == (uint32_t)key_length &&
+            memcmp(tape->strings.start + candidate->data, key, key_length) == 0) {
+            (void)yaml_tape_resolve(tape, &value);
+            return value;
+        }
 
-        default:
-            break;
+        child = yaml_tape_next(tape, value);
     }
 
-    memset(event, 0, sizeof(YamlEvent));
+    return MYYAML_FAILURE;
 }
 
-#pragma endregion  // Event
+#if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
 
-#pragma region Document
+#pragma region Parser
 
-MYYAML_API int yaml_document_initialize(YamlDocument *document, YamlVersionDirective *version_directive, YamlTagDirective *tag_directives_start,
-                                        YamlTagDirective *tag_directives_end, int start_implicit, int end_implicit) {
-    struct {
-        YamlErrorType error;
-    } context;
-    struct {
-        YamlNode *start;
-        YamlNode *end;
-        YamlNode *top;
-    } nodes = {NULL, NULL, NULL};
-    YamlVersionDirective *version_directive_copy = NULL;
-    struct {
-        YamlTagDirective *start;
-        YamlTagDirective *end;
-        YamlTagDirective *top;
-    } tag_directives_copy = {NULL, NULL, NULL};
-    YamlTagDirective value = {NULL, NULL};
-    YamlMark mark = {0, 0, 0};
+MYYAML_API int yaml_parser_initialize(YamlParser *parser) {
+    MYYAML_ASSERT(parser); /* Non-NULL parser object expected. */
 
-    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
-    MYYAML_ASSERT((tag_directives_start && tag_directives_end) || (tag_directives_start == tag_directives_end));
-    /* Valid tag directives are expected. */
+    memset(parser, 0, sizeof(YamlParser));
 
-    if (!STACK_INIT(&context, nodes, YamlNode *)) goto error;
+    return yaml_parser_allocate(parser);
+}
 
-    if (version_directive) {
-        version_directive_copy = YAML_MALLOC_STATIC(YamlVersionDirective);
-        if (!version_directive_copy) goto error;
-        version_directive_copy->major = version_directive->major;
-        version_directive_copy->minor = version_directive->minor;
-    }
+MYYAML_API int yaml_parser_set_allocator(YamlParser *parser, const YamlAllocator *allocator) {
+    MYYAML_ASSERT(parser);                /* Non-NULL parser object expected. */
+    MYYAML_ASSERT(!parser->read_handler); /* The allocator must be set before the input. */
 
-    if (tag_directives_start != tag_directives_end) {
-        YamlTagDirective *tag_directive;
-        if (!STACK_INIT(&context, tag_directives_copy, YamlTagDirective *)) goto error;
-        for (tag_directive = tag_directives_start; tag_directive != tag_directives_end; tag_directive++) {
-            MYYAML_ASSERT(tag_directive->handle);
-            MYYAML_ASSERT(tag_directive->prefix);
-            if (!yaml_check_utf8(tag_directive->handle, strlen((char *)tag_directive->handle))) goto error;
-            if (!yaml_check_utf8(tag_directive->prefix, strlen((char *)tag_directive->prefix))) goto error;
-            value.handle = _myyaml_strdup(tag_directive->handle);
-            value.prefix = _myyaml_strdup(tag_directive->prefix);
-            if (!value.handle || !value.prefix) goto error;
-            if (!PUSH(&context, tag_directives_copy, value)) goto error;
-            value.handle = NULL;
-            value.prefix = NULL;
-        }
-    }
+    yaml_parser_delete(parser);
+    parser->allocator = allocator;
 
-    memset((document), 0, sizeof(YamlDocument));
-    document->nodes.start = nodes.start;
-    document->nodes.top = nodes.start;
-    document->nodes.end = nodes.end;
-    document->start_mark = mark;
-    document->end_mark = mark;
-    document->version_directive = version_directive_copy;
-    document->tag_directives.start = tag_directives_copy.start;
-    document->tag_directives.end = tag_directives_copy.top;
-    document->start_implicit = start_implicit;
-    document->end_implicit = end_implicit;
+    return yaml_parser_allocate(parser);
+}
+
+static int yaml_parser_allocate(YamlParser *parser) {
+    if (!MYYAML_BUFFER_INIT(parser, parser->raw_buffer, MYYAML_INPUT_RAW_BUFFER_SIZE)) goto error;
+    if (!MYYAML_BUFFER_INIT(parser, parser->buffer, MYYAML_INPUT_BUFFER_SIZE)) goto error;
+    if (!QUEUE_INIT(parser, parser->tokens, MYYAML_INITIAL_QUEUE_SIZE, YamlToken *)) goto error;
+    if (!STACK_INIT(parser, parser->indents, int *)) goto error;
+    if (!STACK_INIT(parser, parser->simple_keys, YamlSimpleKey *)) goto error;
+    if (!STACK_INIT(parser, parser->states, YamlParserState *)) goto error;
+    if (!STACK_INIT(parser, parser->marks, YamlMark *)) goto error;
+    if (!STACK_INIT(parser, parser->tag_directives, YamlTagDirective *)) goto error;
 
     return MYYAML_SUCCESS;
 
 error:
-    STACK_DEL(&context, nodes);
-    _myyaml_free(version_directive_copy);
-    while (!STACK_EMPTY(&context, tag_directives_copy)) {
-        YamlTagDirective value = POP(&context, tag_directives_copy);
-        _myyaml_free(value.handle);
-        _myyaml_free(value.prefix);
-    }
-    STACK_DEL(&context, tag_directives_copy);
-    _myyaml_free(value.handle);
-    _myyaml_free(value.prefix);
+
+    BUFFER_DEL(parser, parser->raw_buffer);
+    BUFFER_DEL(parser, parser->buffer);
+    QUEUE_DEL(parser, parser->tokens);
+    STACK_DEL(parser, parser->indents);
+    STACK_DEL(parser, parser->simple_keys);
+    STACK_DEL(parser, parser->states);
+    STACK_DEL(parser, parser->marks);
+    STACK_DEL(parser, parser->tag_directives);
 
     return MYYAML_FAILURE;
 }
 
-MYYAML_API void yaml_document_delete(YamlDocument *document) {
-    YamlTagDirective *tag_directive;
-
+MYYAML_API int yaml_parser_load(YamlParser *parser, YamlDocument *document) {
+    MYYAML_ASSERT(parser);   /* Non-NULL parser object is expected. */
     MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
 
-    while (!STACK_EMPTY(&context, document->nodes)) {
-        YamlNode node = POP(&context, document->nodes);
-        _myyaml_free(node.tag);
-        switch (node.type) {
-            case YAML_SCALAR_NODE:
-                _myyaml_free(node.data.scalar.value);
-                break;
-            case YAML_SEQUENCE_NODE:
-                STACK_DEL(&context, node.data.sequence.items);
-                break;
-            case YAML_MAPPING_NODE:
-                STACK_DEL(&context, node.data.mapping.pairs);
-                break;
-            default:
-                MYYAML_ASSERT(0); /* Should not happen. */
-        }
-    }
-    STACK_DEL(&context, document->nodes);
-
-    _myyaml_free(document->version_directive);
-    for (tag_directive = document->tag_directives.start; tag_directive != document->tag_directives.end; tag_directive++) {
-        _myyaml_free(tag_directive->handle);
-        _myyaml_free(tag_directive->prefix);
-    }
-    _myyaml_free(document->tag_directives.start);
-
-    memset(document, 0, sizeof(YamlDocument));
+    return yaml_parser_compose(parser, document, NULL);
 }
 
-MYYAML_API YamlNode *yaml_document_get_node(YamlDocument *document, int index) {
-    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
+MYYAML_API int yaml_parser_load_paths(YamlParser *parser, YamlDocument *document, const YamlPath *const *paths, size_t count) {
+    YamlPathFilter_t filter;
+    int status;
 
-    if (index > 0 && document->nodes.start + index <= document->nodes.top) {
-        return document->nodes.start + index - 1;
-    }
-    return NULL;
-}
+    MYYAML_ASSERT(parser);            /* Non-NULL parser object is expected. */
+    MYYAML_ASSERT(document);          /* Non-NULL document object is expected. */
+    MYYAML_ASSERT(paths || !count);   /* Non-NULL paths are expected. */
 
-MYYAML_API YamlNode *yaml_document_get_root_node(YamlDocument *document) {
-    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
+    memset(&filter, 0, sizeof(YamlPathFilter_t));
+    filter.paths = paths;
+    filter.count = count;
 
-    if (document->nodes.top != document->nodes.start) {
-        return document->nodes.start;
+    if (!STACK_INIT(parser, filter.frames, YamlPathFrame_t *) || !STACK_INIT(parser, filter.selected, size_t *) ||
+        !STACK_INIT(parser, filter.orphans, int *)) {
+        STACK_DEL(parser, filter.selected);
+        STACK_DEL(parser, filter.frames);
+        memset(document, 0, sizeof(YamlDocument));
+        return MYYAML_FAILURE;
     }
-    return NULL;
-}
 
-MYYAML_API int yaml_document_add_scalar(YamlDocument *document, const YamlChar_t *tag, const YamlChar_t *value, int length, YamlScalarStyle style) {
-    struct {
-        YamlErrorType error;
-    } context;
-    YamlMark mark = {0, 0, 0};
-    YamlChar_t *tag_copy = NULL;
-    YamlChar_t *value_copy = NULL;
-    YamlNode node;
+    status = yaml_parser_compose(parser, document, &filter);
 
-    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
-    MYYAML_ASSERT(value);    /* Non-NULL value is expected. */
+    /* An error may have stopped a skip. */
 
-    if (!tag) {
-        tag = (YamlChar_t *)YAML_DEFAULT_SCALAR_TAG;
+    if (parser->callbacks) {
+        (void)yaml_parser_stop_values(parser);
     }
 
-    if (!yaml_check_utf8(tag, strlen((char *)tag))) goto error;
-    tag_copy = _myyaml_strdup(tag);
-    if (!tag_copy) goto error;
+    STACK_DEL(parser, filter.orphans);
+    STACK_DEL(parser, filter.selected);
+    STACK_DEL(parser, filter.frames);
 
-    if (length < 0) {
-        length = strlen((char *)value);
-    }
+    return status;
+}
 
-    if (!yaml_check_utf8(value, length)) goto error;
-    value_copy = YAML_MALLOC(length + 1);
-    if (!value_copy) goto error;
-    memcpy(value_copy, value, length);
-    value_copy[length] = '\0';
+/*
+ * Compose the next document of the stream, whole or filtered by paths.
+ */
 
-    SCALAR_NODE_INIT(node, tag_copy, value_copy, length, style, mark, mark);
-    if (!PUSH(&context, document->nodes, node)) goto error;
+static int yaml_parser_compose(YamlParser *parser, YamlDocument *document, YamlPathFilter_t *filter) {
+    YamlEvent event;
 
-    return document->nodes.top - document->nodes.start;
+    memset(document, 0, sizeof(YamlDocument));
+    document->allocator = parser->allocator;
+    if (!STACK_INIT(parser, document->nodes, YamlNode *)) goto error;
 
-error:
-    _myyaml_free(tag_copy);
-    _myyaml_free(value_copy);
+    if (!parser->stream_start_produced) {
+        if (!yaml_parser_parse(parser, &event)) goto error;
+        MYYAML_ASSERT(event.type == YAML_STREAM_START_EVENT);
+        /* STREAM-START is expected. */
+    }
 
-    return MYYAML_FAILURE;
-}
+    if (parser->stream_end_produced) {
+        return MYYAML_SUCCESS;
+    }
 
-MYYAML_API int yaml_document_add_sequence(YamlDocument *document, const YamlChar_t *tag, YamlSequenceStyle style) {
-    struct {
-        YamlErrorType error;
-    } context;
-    YamlMark mark = {0, 0, 0};
-    YamlChar_t *tag_copy = NULL;
-    struct {
-        YamlNodeItem *start;
-        YamlNodeItem *end;
-        YamlNodeItem *top;
-    } items = {NULL, NULL, NULL};
-    YamlNode node;
+    if (!yaml_parser_parse(parser, &event)) goto error;
+    if (event.type == YAML_STREAM_END_EVENT) {
+        return MYYAML_SUCCESS;
+    }
 
-    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
+    if (!STACK_INIT(parser, parser->aliases, YamlAliasData *)) goto error;
 
-    if (!tag) {
-        tag = (YamlChar_t *)YAML_DEFAULT_SEQUENCE_TAG;
+    if (parser->arena && !(document->arena = yaml_arena_create(document->allocator))) {
+        parser->error = YAML_MEMORY_ERROR;
+        goto error;
     }
 
-    if (!yaml_check_utf8(tag, strlen((char *)tag))) goto error;
-    tag_copy = _myyaml_strdup(tag);
-    if (!tag_copy) goto error;
+    parser->document = document;
 
-    if (!STACK_INIT(&context, items, YamlNodeItem *)) goto error;
+    if (!PROFILE_STAGE(parser, YAML_COMPOSER_STAGE, yaml_parser_load_document(parser, &event, filter))) goto error;
 
-    SEQUENCE_NODE_INIT(node, tag_copy, items.start, items.end, style, mark, mark);
-    if (!PUSH(&context, document->nodes, node)) goto error;
+    yaml_parser_delete_aliases(parser);
+    parser->document = NULL;
 
-    return document->nodes.top - document->nodes.start;
+    return MYYAML_SUCCESS;
 
 error:
-    STACK_DEL(&context, items);
-    _myyaml_free(tag_copy);
+
+    yaml_parser_delete_aliases(parser);
+    yaml_document_delete(document);
+    parser->document = NULL;
 
     return MYYAML_FAILURE;
 }
 
-MYYAML_API int yaml_document_add_mapping(YamlDocument *document, const YamlChar_t *tag, YamlMappingStyle style) {
-    struct {
-        YamlErrorType error;
-    } context;
-    YamlMark mark = {0, 0, 0};
-    YamlChar_t *tag_copy = NULL;
-    struct {
-        YamlNodePair *start;
-        YamlNodePair *end;
-        YamlNodePair *top;
-    } pairs = {NULL, NULL, NULL};
-    YamlNode node;
+MYYAML_API int yaml_parser_load_tape(YamlParser *parser, YamlTape *tape) {
+    struct LoaderCtx_t ctx = {NULL, NULL, NULL, {NULL, NULL, NULL}};
+    YamlEvent event;
+    YamlMark start_mark;
 
-    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
+    MYYAML_ASSERT(parser); /* Non-NULL parser object is expected. */
+    MYYAML_ASSERT(tape);   /* Non-NULL tape object is expected. */
 
-    if (!tag) {
-        tag = (YamlChar_t *)YAML_DEFAULT_MAPPING_TAG;
+    memset(tape, 0, sizeof(YamlTape));
+    tape->allocator = parser->allocator;
+    if (!STACK_INIT(parser, tape->entries, YamlTapeEntry *)) goto error;
+    if (!STRING_INIT(parser, tape->strings, MYYAML_INITIAL_STRING_SIZE)) goto error;
+
+    /* The offset 0 of the pool stands for no string. */
+
+    tape->strings.pointer++;
+
+    if (!parser->stream_start_produced) {
+        if (!yaml_parser_parse(parser, &event)) goto error;
+        MYYAML_ASSERT(event.type == YAML_STREAM_START_EVENT);
+        /* STREAM-START is expected. */
     }
 
-    if (!yaml_check_utf8(tag, strlen((char *)tag))) goto error;
-    tag_copy = _myyaml_strdup(tag);
-    if (!tag_copy) goto error;
+    if (parser->stream_end_produced) {
+        return MYYAML_SUCCESS;
+    }
+
+    if (!yaml_parser_parse(parser, &event)) goto error;
+    if (event.type == YAML_STREAM_END_EVENT) {
+        return MYYAML_SUCCESS;
+    }
 
-    if (!STACK_INIT(&context, pairs, YamlNodePair *)) goto error;
+    /* A tape keeps no directives. */
 
-    MAPPING_NODE_INIT(node, tag_copy, pairs.start, pairs.end, style, mark, mark);
-    if (!PUSH(&context, document->nodes, node)) goto error;
+    start_mark = event.start_mark;
+    yaml_event_delete(&event);
 
-    return document->nodes.top - document->nodes.start;
+    if (!STACK_INIT(parser, parser->aliases, YamlAliasData *)) goto error;
+    if (!STACK_INIT(parser, ctx, int *)) goto error;
+    if ((parser->max_expanded_nodes || parser->max_alias_depth) && !STACK_INIT(parser, ctx.weights, YamlNodeWeight_t *)) goto error;
+
+    if (!PROFILE_STAGE(parser, YAML_COMPOSER_STAGE, yaml_parser_load_tape_nodes(parser, tape, &ctx, start_mark))) goto error;
+
+    STACK_DEL(parser, ctx.weights);
+    STACK_DEL(parser, ctx);
+    yaml_parser_delete_aliases(parser);
+
+    return MYYAML_SUCCESS;
 
 error:
-    STACK_DEL(&context, pairs);
-    _myyaml_free(tag_copy);
+
+    STACK_DEL(parser, ctx.weights);
+    STACK_DEL(parser, ctx);
+    yaml_parser_delete_aliases(parser);
+    yaml_tape_delete(tape);
 
     return MYYAML_FAILURE;
 }
 
-MYYAML_API int yaml_document_append_sequence_item(YamlDocument *document, int sequence, int item) {
-    struct {
-        YamlErrorType error;
-    } context;
+MYYAML_API int yaml_parser_load_all(YamlParser *parser, int threads, YamlDocument **documents, size_t *count) {
+    YamlStreamLoad_t load = {parser, NULL, 0, 0};
+    YamlStreamBatch_t *batch;
+    size_t total = 0;
+    int spawned = 0;
+    long k;
 
-    MYYAML_ASSERT(document); /* Non-NULL document is required. */
-    MYYAML_ASSERT(sequence > 0 && document->nodes.start + sequence <= document->nodes.top);
-    /* Valid sequence id is required. */
-    MYYAML_ASSERT(document->nodes.start[sequence - 1].type == YAML_SEQUENCE_NODE);
-    /* A sequence node is required. */
-    MYYAML_ASSERT(item > 0 && document->nodes.start + item <= document->nodes.top);
-    /* Valid item id is required. */
+    MYYAML_ASSERT(parser);       /* Non-NULL parser object is expected. */
+    MYYAML_ASSERT(documents);    /* Non-NULL documents pointer is expected. */
+    MYYAML_ASSERT(count);        /* Non-NULL count pointer is expected. */
+    MYYAML_ASSERT(threads >= 0); /* Non-negative thread count is expected. */
 
-    if (!PUSH(&context, document->nodes.start[sequence - 1].data.sequence.items, item)) return MYYAML_FAILURE;
+    *documents = NULL;
+    *count = 0;
 
-    return MYYAML_SUCCESS;
-}
+#if MYYAML_THREADS
+    if (!threads) threads = yaml_stream_processors();
+#else
+    threads = 1;
+#endif
 
-MYYAML_API int yaml_document_append_mapping_pair(YamlDocument *document, int mapping, int key, int value) {
-    struct {
-        YamlErrorType error;
-    } context;
+    /*
+     * Only a stream in memory that has not been read from yet, and is not
+     * in UTF-16, can be split; any other input is loaded here as one run.
+     */
 
-    YamlNodePair pair;
+    if (threads > 1 && parser->read_handler == yaml_string_read_handler && !parser->stream_start_produced && !parser->error &&
+        parser->input.string.current == parser->input.string.start && parser->encoding != YAML_UTF16LE_ENCODING &&
+        parser->encoding != YAML_UTF16BE_ENCODING) {
+        size_t size = parser->input.string.end - parser->input.string.start;
+        size_t target = size / ((size_t)threads * 4);
 
-    MYYAML_ASSERT(document);                                                              /* Non-NULL document is required. */
-    MYYAML_ASSERT(mapping > 0 && document->nodes.start + mapping <= document->nodes.top); /* Valid mapping id is required. */
+        if (size >= 2 && (!memcmp(parser->input.string.start, MYYAML_BOM_UTF16LE, 2) || !memcmp(parser->input.string.start, MYYAML_BOM_UTF16BE, 2))) {
+            target = size;
+        }
+        if (target < MYYAML_LOAD_BATCH_SIZE) target = MYYAML_LOAD_BATCH_SIZE;
+        if (target < size && !yaml_parser_split_stream(parser, target, &load)) return MYYAML_FAILURE;
+    }
 
-    MYYAML_ASSERT(document->nodes.start[mapping - 1].type == YAML_MAPPING_NODE);
-    /* A mapping node is required. */
-    MYYAML_ASSERT(key > 0 && document->nodes.start + key <= document->nodes.top);
-    /* Valid key id is required. */
-    MYYAML_ASSERT(value > 0 && document->nodes.start + value <= document->nodes.top);
-    /* Valid value id is required. */
+    if (load.count <= 1) {
+        YamlStreamBatch_t whole;
 
-    pair.key = key;
-    pair.value = value;
+        memset(&whole, 0, sizeof(YamlStreamBatch_t));
+        _myyaml_free(parser->allocator, load.batches);
 
-    if (!PUSH(&context, document->nodes.start[mapping - 1].data.mapping.pairs, pair)) return MYYAML_FAILURE;
+        if (!yaml_parser_load_stream(parser, &whole)) return MYYAML_FAILURE;
 
-    return MYYAML_SUCCESS;
-}
+        *documents = whole.documents.start;
+        *count = whole.documents.top - whole.documents.start;
+        if (!*count) {
+            _myyaml_free(parser->allocator, whole.documents.start);
+            *documents = NULL;
+        }
 
-#pragma endregion  // Document
+        return MYYAML_SUCCESS;
+    }
 
-/* Convenience accessors */
+    /* Load the runs on the threads and this one. */
 
-MYYAML_API const YamlChar_t *yaml_document_get_scalar_value(YamlDocument *document, int node_id) {
-    YamlNode *node;
+    if (threads > load.count) threads = (int)load.count;
 
-    MYYAML_ASSERT(document);
+#if MYYAML_THREADS
+    {
+#if MYYAML_PLATFORM_IS(WINDOWS)
+        HANDLE *workers = (HANDLE *)_myyaml_malloc(parser->allocator, threads * sizeof(HANDLE));
+#else
+        pthread_t *workers = (pthread_t *)_myyaml_malloc(parser->allocator, threads * sizeof(pthread_t));
+#endif
 
-    node = yaml_document_get_node(document, node_id);
-    if (!node) return NULL;
-    if (node->type != YAML_SCALAR_NODE) return NULL;
+        /* Without the threads, this one loads all the runs. */
 
-    return node->data.scalar.value;
-}
+        while (workers && spawned < threads - 1) {
+#if MYYAML_PLATFORM_IS(WINDOWS)
+            workers[spawned] = (HANDLE)_beginthreadex(NULL, 0, yaml_stream_load_thread, &load, 0, NULL);
+            if (!workers[spawned]) break;
+#else
+            if (pthread_create(&workers[spawned], NULL, yaml_stream_load_thread, &load)) break;
+#endif
+            spawned++;
+        }
 
-MYYAML_API int yaml_document_get_scalar_length(YamlDocument *document, int node_id) {
-    YamlNode *node;
+        yaml_stream_load_batches(&load);
 
-    MYYAML_ASSERT(document);
+        while (spawned--) {
+#if MYYAML_PLATFORM_IS(WINDOWS)
+            WaitForSingleObject(workers[spawned], INFINITE);
+            CloseHandle(workers[spawned]);
+#else
+            pthread_join(workers[spawned], NULL);
+#endif
+        }
 
-    node = yaml_document_get_node(document, node_id);
-    if (!node) return -1;
-    if (node->type != YAML_SCALAR_NODE) return -1;
+        _myyaml_free(parser->allocator, workers);
+    }
+#else
+    (void)spawned;
+    yaml_stream_load_batches(&load);
+#endif
 
-    return node->data.scalar.length;
-}
+    /*
+     * A run may have been cut inside a quoted scalar.  Load the stream from
+     * the first run that failed to the end in one piece for the error the
+     * stream really has.
+     */
 
-MYYAML_API int yaml_document_sequence_get_item(YamlDocument *document, int sequence_node_id, int index) {
-    YamlNode *node;
+    for (k = 0; k < load.count && !load.batches[k].error; k++) {
+    }
 
-    MYYAML_ASSERT(document);
+    if (k < load.count) {
+        long last;
 
-    node = yaml_document_get_node(document, sequence_node_id);
-    if (!node) return MYYAML_FAILURE;
-    if (node->type != YAML_SEQUENCE_NODE) return MYYAML_FAILURE;
+        for (last = k + 1; last < load.count; last++) {
+            batch = load.batches + last;
+            while (!STACK_EMPTY(parser, batch->documents)) {
+                yaml_document_delete(--batch->documents.top);
+            }
+            STACK_DEL(parser, batch->documents);
+        }
 
-    if (index < 0 || node->data.sequence.items.start + index >= node->data.sequence.items.top) return MYYAML_FAILURE;
+        batch = load.batches + k;
+        batch->error = YAML_NO_ERROR;
+        batch->size = parser->input.string.end - batch->start;
+        load.count = k + 1;
 
-    return node->data.sequence.items.start[index];
-}
+        yaml_stream_load_batch(parser, batch);
+    }
 
-MYYAML_API int yaml_document_mapping_get_value(YamlDocument *document, int mapping_node_id, const YamlChar_t *key, int key_length) {
-    YamlNode *node;
-    YamlNodePair *pairs;
-    int i, count;
+    /* Report the first error of the stream, or gather the documents. */
 
-    MYYAML_ASSERT(document);
-    MYYAML_ASSERT(key);
+    for (k = 0; k < load.count && !parser->error; k++) {
+        batch = load.batches + k;
+        if (batch->error) {
+            parser->error = batch->error;
+            parser->problem = batch->problem;
+            parser->context = batch->context;
+            parser->problem_offset = batch->problem_offset;
+            parser->problem_value = batch->problem_value;
+            parser->problem_mark = batch->problem_mark;
+            parser->context_mark = batch->context_mark;
+        }
+        total += batch->documents.top - batch->documents.start;
+    }
 
-    node = yaml_document_get_node(document, mapping_node_id);
-    if (!node) return MYYAML_FAILURE;
-    if (node->type != YAML_MAPPING_NODE) return MYYAML_FAILURE;
+    if (!parser->error && total) {
+        *documents = (YamlDocument *)_myyaml_malloc(parser->allocator, total * sizeof(YamlDocument));
+        if (!*documents) parser->error = YAML_MEMORY_ERROR;
+    }
 
-    pairs = node->data.mapping.pairs.start;
-    count = node->data.mapping.pairs.top - node->data.mapping.pairs.start;
+    for (k = 0; k < load.count; k++) {
+        size_t number;
 
-    if (key_length < 0) key_length = (int)strlen((char *)key);
+        batch = load.batches + k;
+        number = batch->documents.top - batch->documents.start;
 
-    for (i = 0; i < count; i++) {
-        YamlNode *k = yaml_document_get_node(document, pairs[i].key);
-        if (!k || k->type != YAML_SCALAR_NODE) continue;
-        if (k->data.scalar.length == key_length && memcmp(k->data.scalar.value, key, key_length) == 0) {
-            return pairs[i].value;
+        if (parser->error) {
+            while (!STACK_EMPTY(parser, batch->documents)) {
+                yaml_document_delete(--batch->documents.top);
+            }
+        } else if (number) {
+            memcpy(*documents + *count, batch->documents.start, number * sizeof(YamlDocument));
+            *count += number;
         }
+
+        STACK_DEL(parser, batch->documents);
     }
 
-    return MYYAML_FAILURE;
-}
+    _myyaml_free(parser->allocator, load.batches);
 
-/* Find node by path of keys. */
-static int is_decimal_string(const YamlChar_t *s) {
-    if (!s || !*s) return MYYAML_FAILURE;
-    while (*s) {
-        if (*s < '0' || *s > '9') return MYYAML_FAILURE;
-        s++;
+    if (parser->error) {
+        *documents = NULL;
+        *count = 0;
+        return MYYAML_FAILURE;
     }
+
+    /* The stream has been read to the end. */
+
+    parser->input.string.current = parser->input.string.end;
+    parser->stream_start_produced = 1;
+    parser->stream_end_produced = 1;
+
     return MYYAML_SUCCESS;
 }
 
-MYYAML_API int yaml_document_get_node_by_path(YamlDocument *document, const YamlChar_t **keys, int key_count) {
-    int current_id;
-    int i;
+/*
+ * Load the rest of the documents of a parser into a run.
+ */
 
-    MYYAML_ASSERT(document);
-    if (!keys || key_count <= 0) return MYYAML_FAILURE;
+static int yaml_parser_load_stream(YamlParser *parser, YamlStreamBatch_t *batch) {
+    YamlDocument document;
 
-    /* Start from root */
-    current_id = 0;
-    current_id = (yaml_document_get_root_node(document) ? (int)(yaml_document_get_root_node(document) - document->nodes.start + 1) : 0);
-    if (!current_id) return MYYAML_FAILURE;
+    if (!STACK_INIT(parser, batch->documents, YamlDocument *)) return MYYAML_FAILURE;
 
-    for (i = 0; i < key_count; i++) {
-        YamlNode *node = yaml_document_get_node(document, current_id);
-        if (!node) return MYYAML_FAILURE;
+    while (1) {
+        if (!yaml_parser_load(parser, &document)) goto error;
 
-        if (node->type == YAML_MAPPING_NODE) {
-            /* lookup mapping by scalar key */
-            int found_id = yaml_document_mapping_get_value(document, current_id, keys[i], -1);
-            if (!found_id) return MYYAML_FAILURE;
-            current_id = found_id;
-            continue;
+        if (!yaml_document_get_root_node(&document)) {
+            yaml_document_delete(&document);
+            return MYYAML_SUCCESS;
         }
 
-        if (node->type == YAML_SEQUENCE_NODE) {
-            /* sequence: key must be decimal index */
-            if (!is_decimal_string(keys[i])) return MYYAML_FAILURE;
-            int idx = atoi((const char *)keys[i]);
-            int item_id = yaml_document_sequence_get_item(document, current_id, idx);
-            if (!item_id) return MYYAML_FAILURE;
-            current_id = item_id;
-            continue;
+        if (!PUSH(parser, batch->documents, document)) {
+            yaml_document_delete(&document);
+            goto error;
         }
+    }
 
-        /* scalar or other: cannot traverse further */
-        return MYYAML_FAILURE;
+error:
+
+    while (!STACK_EMPTY(parser, batch->documents)) {
+        yaml_document_delete(--batch->documents.top);
     }
+    STACK_DEL(parser, batch->documents);
 
-    return current_id;
+    return MYYAML_FAILURE;
 }
 
-MYYAML_API const YamlChar_t *yaml_document_get_value_by_path(YamlDocument *document, const YamlChar_t **keys, int key_count) {
-    int id = yaml_document_get_node_by_path(document, keys, key_count);
-    if (!id) return NULL;
-    return yaml_document_get_scalar_value(document, id);
-}
+/*
+ * Split a stream in memory into runs of whole documents of about `target`
+ * octets.
+ *
+ * The scanner takes @c --- and @c ... at the beginning of a line as document
+ * markers and @c % as a directive wherever they occur, so a run may start at
+ * any document start marker, or at the directives before it if they follow
+ * an explicit document end.  A marker inside a quoted scalar is an error
+ * either way.
+ */
+
+static int yaml_parser_split_stream(YamlParser *parser, size_t target, YamlStreamLoad_t *load) {
+    const unsigned char *start = parser->input.string.start;
+    const unsigned char *end = parser->input.string.end;
+    const unsigned char *pointer = start;
+    const unsigned char *run = start;
+    const unsigned char *directives = NULL;
+    YamlMark mark = {0, 0, 0};
+    YamlMark run_mark = {0, 0, 0};
+    YamlMark directives_mark = {0, 0, 0};
+    int ended = 1; /* May directives start here? */
+    int split = 1; /* May the next document start a run? */
+    struct {
+        YamlStreamBatch_t *start;
+        YamlStreamBatch_t *end;
+        YamlStreamBatch_t *top;
+    } batches = {NULL, NULL, NULL};
+    YamlStreamBatch_t batch;
 
-MYYAML_API int yaml_document_get_value_length_by_path(YamlDocument *document, const YamlChar_t **keys, int key_count) {
-    int id = yaml_document_get_node_by_path(document, keys, key_count);
-    if (!id) return -1;
-    return yaml_document_get_scalar_length(document, id);
-}
+    memset(&batch, 0, sizeof(YamlStreamBatch_t));
 
-#if !defined(MYYAML_DISABLE_READER) || !MYYAML_DISABLE_READER
+    if (!STACK_INIT(parser, batches, YamlStreamBatch_t *)) return MYYAML_FAILURE;
 
-#pragma region Parser
+    /* The reader skips the BOM without counting it. */
 
-MYYAML_API int yaml_parser_initialize(YamlParser *parser) {
-    MYYAML_ASSERT(parser); /* Non-NULL parser object expected. */
+    if (end - pointer >= 3 && !memcmp(pointer, MYYAML_BOM_UTF8, 3)) pointer += 3;
 
-    memset(parser, 0, sizeof(YamlParser));
-    if (!MYYAML_BUFFER_INIT(parser, parser->raw_buffer, MYYAML_INPUT_RAW_BUFFER_SIZE)) goto error;
-    if (!MYYAML_BUFFER_INIT(parser, parser->buffer, MYYAML_INPUT_BUFFER_SIZE)) goto error;
-    if (!QUEUE_INIT(parser, parser->tokens, MYYAML_INITIAL_QUEUE_SIZE, YamlToken *)) goto error;
-    if (!STACK_INIT(parser, parser->indents, int *)) goto error;
-    if (!STACK_INIT(parser, parser->simple_keys, YamlSimpleKey *)) goto error;
-    if (!STACK_INIT(parser, parser->states, YamlParserState *)) goto error;
-    if (!STACK_INIT(parser, parser->marks, YamlMark *)) goto error;
-    if (!STACK_INIT(parser, parser->tag_directives, YamlTagDirective *)) goto error;
+    while (pointer < end) {
+        const unsigned char *line = pointer;
 
-    return MYYAML_SUCCESS;
+        /* Look at the beginning of the line. */
 
-error:
+        if (*pointer == '%') {
+            if (!ended) {
+                split = 0;
+            } else if (!directives) {
+                directives = line;
+                directives_mark = mark;
+            }
+        } else if (yaml_stream_marker_at(pointer, end, '-')) {
+            const unsigned char *boundary = directives ? directives : line;
+
+            if (split && (size_t)(boundary - run) >= target) {
+                batch.start = run;
+                batch.size = boundary - run;
+                batch.offset = run - start;
+                batch.mark = run_mark;
+                if (!PUSH(parser, batches, batch)) goto error;
+
+                run = boundary;
+                run_mark = directives ? directives_mark : mark;
+            }
 
-    BUFFER_DEL(parser, parser->raw_buffer);
-    BUFFER_DEL(parser, parser->buffer);
-    QUEUE_DEL(parser, parser->tokens);
-    STACK_DEL(parser, parser->indents);
-    STACK_DEL(parser, parser->simple_keys);
-    STACK_DEL(parser, parser->states);
-    STACK_DEL(parser, parser->marks);
-    STACK_DEL(parser, parser->tag_directives);
+            directives = NULL;
+            ended = 0;
+            split = 1;
+        } else if (yaml_stream_marker_at(pointer, end, '.')) {
+            ended = 1;
+        } else {
+            const unsigned char *text = pointer;
+
+            while (text < end && (*text == ' ' || *text == '\t')) text++;
+            if (text < end && *text != '#' && *text != '\r' && *text != '\n') {
+                ended = 0;
+                if (directives) {
+                    directives = NULL;
+                    split = 0;
+                }
+            }
+        }
+
+        /* Go to the next line, counting the characters and breaks. */
+
+        while (pointer < end) {
+            unsigned char octet = *pointer++;
+
+            if ((octet & 0xC0) != 0x80) mark.index++;
+
+            if (octet == '\n') {
+                mark.line++;
+                break;
+            }
+            if (octet == '\r') {
+                if (pointer < end && *pointer == '\n') {
+                    mark.index++;
+                    pointer++;
+                }
+                mark.line++;
+                break;
+            }
+            if (octet == 0xC2 && pointer < end && *pointer == 0x85) {
+                pointer++;
+                mark.line++;
+                break;
+            }
+            if (octet == 0xE2 && end - pointer >= 2 && pointer[0] == 0x80 && (pointer[1] == 0xA8 || pointer[1] == 0xA9)) {
+                pointer += 2;
+                mark.line++;
+                break;
+            }
+        }
+    }
+
+    batch.start = run;
+    batch.size = end - run;
+    batch.offset = run - start;
+    batch.mark = run_mark;
+    if (!PUSH(parser, batches, batch)) goto error;
+
+    load->batches = batches.start;
+    load->count = (long)(batches.top - batches.start);
+
+    return MYYAML_SUCCESS;
+
+error:
+
+    STACK_DEL(parser, batches);
 
     return MYYAML_FAILURE;
 }
 
-MYYAML_API int yaml_parser_load(YamlParser *parser, YamlDocument *document) {
-    YamlEvent event;
+/*
+ * Check for a three-octet document marker followed by a blank, a break or
+ * the end of the input.
+ */
 
-    MYYAML_ASSERT(parser);   /* Non-NULL parser object is expected. */
-    MYYAML_ASSERT(document); /* Non-NULL document object is expected. */
+static int yaml_stream_marker_at(const unsigned char *pointer, const unsigned char *end, unsigned char octet) {
+    if (end - pointer < 3 || pointer[0] != octet || pointer[1] != octet || pointer[2] != octet) return 0;
+    if (end - pointer == 3) return 1;
 
-    memset(document, 0, sizeof(YamlDocument));
-    if (!STACK_INIT(parser, document->nodes, YamlNode *)) goto error;
+    switch (pointer[3]) {
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+        case '\0':
+            return 1;
+        case 0xC2:
+            return end - pointer > 4 && pointer[4] == 0x85;
+        case 0xE2:
+            return end - pointer > 5 && pointer[4] == 0x80 && (pointer[5] == 0xA8 || pointer[5] == 0xA9);
+        default:
+            return 0;
+    }
+}
 
-    if (!parser->stream_start_produced) {
-        if (!yaml_parser_parse(parser, &event)) goto error;
-        MYYAML_ASSERT(event.type == YAML_STREAM_START_EVENT);
-        /* STREAM-START is expected. */
+/*
+ * Load a run with a parser of its own, set up like the given one and placed
+ * at the start of the run, so that the marks are in the stream.
+ */
+
+static void yaml_stream_load_batch(YamlParser *settings, YamlStreamBatch_t *batch) {
+    YamlParser parser;
+
+    if (!yaml_parser_initialize(&parser) || (settings->allocator && !yaml_parser_set_allocator(&parser, settings->allocator))) {
+        batch->error = YAML_MEMORY_ERROR;
+        yaml_parser_delete(&parser);
+        return;
     }
 
-    if (parser->stream_end_produced) {
-        return MYYAML_SUCCESS;
+    yaml_parser_set_input_string(&parser, batch->start, batch->size);
+    parser.encoding = settings->encoding;
+    parser.offset = batch->offset;
+    parser.mark = batch->mark;
+    parser.arena = settings->arena;
+    parser.index_mappings = settings->index_mappings;
+    parser.max_expanded_nodes = settings->max_expanded_nodes;
+    parser.max_alias_depth = settings->max_alias_depth;
+    parser.max_document_length = settings->max_document_length;
+
+    if (!yaml_parser_load_stream(&parser, batch)) {
+        batch->error = parser.error;
+        batch->problem = parser.problem;
+        batch->context = parser.context;
+        batch->problem_offset = parser.problem_offset;
+        batch->problem_value = parser.problem_value;
+        batch->problem_mark = parser.problem_mark;
+        batch->context_mark = parser.context_mark;
     }
 
-    if (!yaml_parser_parse(parser, &event)) goto error;
-    if (event.type == YAML_STREAM_END_EVENT) {
-        return MYYAML_SUCCESS;
+    yaml_parser_delete(&parser);
+}
+
+/*
+ * Load runs until none are left.
+ */
+
+static void yaml_stream_load_batches(YamlStreamLoad_t *load) {
+    while (1) {
+#if MYYAML_THREADS && MYYAML_PLATFORM_IS(WINDOWS)
+        long k = InterlockedIncrement(&load->next) - 1;
+#elif MYYAML_THREADS
+        long k = __atomic_fetch_add(&load->next, 1, __ATOMIC_RELAXED);
+#else
+        long k = load->next++;
+#endif
+
+        if (k >= load->count) break;
+
+        yaml_stream_load_batch(load->parser, load->batches + k);
     }
+}
 
-    if (!STACK_INIT(parser, parser->aliases, YamlAliasData *)) goto error;
+#if MYYAML_THREADS
 
-    parser->document = document;
+/*
+ * Count the processors online.
+ */
 
-    if (!yaml_parser_load_document(parser, &event)) goto error;
+static int yaml_stream_processors(void) {
+#if MYYAML_PLATFORM_IS(WINDOWS)
+    SYSTEM_INFO info;
 
-    yaml_parser_delete_aliases(parser);
-    parser->document = NULL;
+    GetSystemInfo(&info);
 
-    return MYYAML_SUCCESS;
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
 
-error:
+    return processors > 0 ? (int)processors : 1;
+#endif
+}
 
-    yaml_parser_delete_aliases(parser);
-    yaml_document_delete(document);
-    parser->document = NULL;
+#if MYYAML_PLATFORM_IS(WINDOWS)
+static unsigned __stdcall yaml_stream_load_thread(void *data) {
+    yaml_stream_load_batches((YamlStreamLoad_t *)data);
 
-    return MYYAML_FAILURE;
+    return 0;
+}
+#else
+static void *yaml_stream_load_thread(void *data) {
+    yaml_stream_load_batches((YamlStreamLoad_t *)data);
+
+    return NULL;
 }
+#endif
+
+#endif // MYYAML_THREADS
 
 /*
  * Ensure that the buffer contains at least `length` characters.
@@ -9046,6 +12873,13 @@ MYYAML_API int yaml_parser_update_buffer(YamlParser *parser, size_t length) {
 
     if (parser->unread >= length) return MYYAML_SUCCESS;
 
+    /* A mapped UTF-8 input is consumed in place; nothing is ever copied. */
+
+    if (parser->mapping.start && !parser->mapping.checked) {
+        if (!yaml_parser_map_buffer(parser)) return MYYAML_FAILURE;
+        if (parser->mapping.passthrough) return MYYAML_SUCCESS;
+    }
+
     /* Determine the input encoding if it is not known yet. */
 
     if (!parser->encoding) {
@@ -9067,6 +12901,20 @@ MYYAML_API int yaml_parser_update_buffer(YamlParser *parser, size_t length) {
     /* Fill the buffer until it has enough characters. */
 
     while (parser->unread < length) {
+        /* UTF-8 input bypasses the raw buffer and the decoder. */
+
+        if (parser->encoding == YAML_UTF8_ENCODING) {
+            if (!yaml_parser_read_utf8_buffer(parser)) return MYYAML_FAILURE;
+
+            if (parser->eof) {
+                *(parser->buffer.last++) = '\0';
+                parser->unread++;
+                return MYYAML_SUCCESS;
+            }
+
+            continue;
+        }
+
         /* Fill the raw buffer if necessary. */
 
         if (!first || parser->raw_buffer.pointer == parser->raw_buffer.last) {
@@ -9085,6 +12933,20 @@ MYYAML_API int yaml_parser_update_buffer(YamlParser *parser, size_t length) {
             size_t k;
             size_t raw_unread = parser->raw_buffer.last - parser->raw_buffer.pointer;
 
+            /* Narrow a run of ASCII code units in one go. */
+
+            if (parser->encoding == YAML_UTF16LE_ENCODING || parser->encoding == YAML_UTF16BE_ENCODING) {
+                k = yaml_get_kernels()->utf16_ascii_narrow(parser->raw_buffer.pointer, raw_unread / 2,
+                                                           parser->encoding == YAML_UTF16BE_ENCODING, parser->buffer.last);
+                if (k) {
+                    parser->raw_buffer.pointer += 2 * k;
+                    parser->offset += 2 * k;
+                    parser->buffer.last += k;
+                    parser->unread += k;
+                    continue;
+                }
+            }
+
             /* Decode the next character. */
 
             switch (parser->encoding) {
@@ -9250,117 +13112,419 @@ MYYAML_API int yaml_parser_update_buffer(YamlParser *parser, size_t length) {
                         width = 2;
                     }
 
-                    break;
+                    break;
+
+                default:
+                    MYYAML_ASSERT(1); /* Impossible. */
+            }
+
+            /* Check if the raw buffer contains enough bytes to form a
+             * character. */
+
+            if (incomplete) break;
+
+            /*
+             * Check if the character is in the allowed range:
+             *      #x9 | #xA | #xD | [#x20-#x7E]               (8 bit)
+             *      | #x85 | [#xA0-#xD7FF] | [#xE000-#xFFFD]    (16 bit)
+             *      | [#x10000-#x10FFFF]                        (32 bit)
+             */
+
+            if (!(value == 0x09 || value == 0x0A || value == 0x0D || (value >= 0x20 && value <= 0x7E) || (value == 0x85) ||
+                  (value >= 0xA0 && value <= 0xD7FF) || (value >= 0xE000 && value <= 0xFFFD) || (value >= 0x10000 && value <= 0x10FFFF)))
+                return yaml_parser_set_reader_error(parser, "control characters are not allowed", parser->offset, value);
+
+            /* Move the raw pointers. */
+
+            parser->raw_buffer.pointer += width;
+            parser->offset += width;
+
+            /* Finally put the character into the buffer. */
+
+            /* 0000 0000-0000 007F -> 0xxxxxxx */
+            if (value <= 0x7F) {
+                *(parser->buffer.last++) = value;
+            }
+            /* 0000 0080-0000 07FF -> 110xxxxx 10xxxxxx */
+            else if (value <= 0x7FF) {
+                *(parser->buffer.last++) = 0xC0 + (value >> 6);
+                *(parser->buffer.last++) = 0x80 + (value & 0x3F);
+            }
+            /* 0000 0800-0000 FFFF -> 1110xxxx 10xxxxxx 10xxxxxx */
+            else if (value <= 0xFFFF) {
+                *(parser->buffer.last++) = 0xE0 + (value >> 12);
+                *(parser->buffer.last++) = 0x80 + ((value >> 6) & 0x3F);
+                *(parser->buffer.last++) = 0x80 + (value & 0x3F);
+            }
+            /* 0001 0000-0010 FFFF -> 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx */
+            else {
+                *(parser->buffer.last++) = 0xF0 + (value >> 18);
+                *(parser->buffer.last++) = 0x80 + ((value >> 12) & 0x3F);
+                *(parser->buffer.last++) = 0x80 + ((value >> 6) & 0x3F);
+                *(parser->buffer.last++) = 0x80 + (value & 0x3F);
+            }
+
+            parser->unread++;
+        }
+
+        /* On EOF, put NUL into the buffer and return. */
+
+        if (parser->eof) {
+            *(parser->buffer.last++) = '\0';
+            parser->unread++;
+            return MYYAML_SUCCESS;
+        }
+    }
+
+    if (parser->offset >= MYYAML_MAX_FILE_SIZE) {
+        return yaml_parser_set_reader_error(parser, "input is too long", parser->offset, -1);
+    }
+
+    return MYYAML_SUCCESS;
+}
+
+MYYAML_API void yaml_parser_set_input_string(YamlParser *parser, const unsigned char *input, size_t size) {
+    MYYAML_ASSERT(parser);                /* Non-NULL parser object expected. */
+    MYYAML_ASSERT(!parser->read_handler); /* You can set the source only once. */
+    MYYAML_ASSERT(input);                 /* Non-NULL input string expected. */
+
+    parser->read_handler = yaml_string_read_handler;
+    parser->read_handler_data = parser;
+
+    parser->input.string.start = input;
+    parser->input.string.current = input;
+    parser->input.string.end = input + size;
+}
+
+MYYAML_API void yaml_parser_set_input_file(YamlParser *parser, FILE *file) {
+    MYYAML_ASSERT(parser);                /* Non-NULL parser object expected. */
+    MYYAML_ASSERT(!parser->read_handler); /* You can set the source only once. */
+    MYYAML_ASSERT(file);                  /* Non-NULL file object expected. */
+
+    parser->read_handler = yaml_file_read_handler;
+    parser->read_handler_data = parser;
+
+    parser->input.file = file;
+}
+
+MYYAML_API int yaml_parser_set_input_mmap(YamlParser *parser, const char *path) {
+    int fd;
+    int result;
+
+    MYYAML_ASSERT(parser);                /* Non-NULL parser object expected. */
+    MYYAML_ASSERT(!parser->read_handler); /* You can set the source only once. */
+    MYYAML_ASSERT(path);                  /* Non-NULL path expected. */
+
+#if MYYAML_PLATFORM_IS(WINDOWS)
+    fd = _open(path, _O_RDONLY | _O_BINARY);
+#else
+    fd = open(path, O_RDONLY);
+#endif
+    if (fd < 0) return yaml_parser_set_reader_error(parser, "cannot open the input file", 0, -1);
+
+    result = yaml_parser_set_input_mmap_fd(parser, fd);
+
+#if MYYAML_PLATFORM_IS(WINDOWS)
+    _close(fd);
+#else
+    close(fd);
+#endif
+
+    return result;
+}
+
+MYYAML_API int yaml_parser_set_input_mmap_fd(YamlParser *parser, int fd) {
+    unsigned char *start;
+    size_t size;
+    size_t length;
+
+    MYYAML_ASSERT(parser);                /* Non-NULL parser object expected. */
+    MYYAML_ASSERT(!parser->read_handler); /* You can set the source only once. */
+    MYYAML_ASSERT(fd >= 0);               /* Valid file descriptor expected. */
+
+#if MYYAML_PLATFORM_IS(WINDOWS)
+    {
+        /* No padded mappings here: read the file once into padded memory. */
+
+        __int64 file_size = _filelengthi64(fd);
+        size_t done = 0;
+
+        if (file_size < 0) return yaml_parser_set_reader_error(parser, "cannot map the input file", 0, -1);
+        if (file_size >= MYYAML_MAX_FILE_SIZE) return yaml_parser_set_reader_error(parser, "input is too long", 0, -1);
+
+        size = (size_t)file_size;
+        length = size + MYYAML_INPUT_MAP_PADDING;
+        start = (unsigned char *)_myyaml_malloc(parser->allocator, length);
+        if (!start) {
+            parser->error = YAML_MEMORY_ERROR;
+            return MYYAML_FAILURE;
+        }
+
+        while (done < size) {
+            int chunk = _read(fd, start + done, (unsigned int)((size - done) < INT_MAX ? (size - done) : INT_MAX));
+            if (chunk <= 0) {
+                _myyaml_free(parser->allocator, start);
+                return yaml_parser_set_reader_error(parser, "input error", done, -1);
+            }
+            done += chunk;
+        }
+        memset(start + size, 0, MYYAML_INPUT_MAP_PADDING);
+    }
+#else
+    {
+        /*
+         * Reserve zeroed anonymous pages and map the file over their
+         * beginning, so that at least MYYAML_INPUT_MAP_PADDING zero octets
+         * follow the content.
+         */
+
+        struct stat st;
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        void *reserve;
+
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return yaml_parser_set_reader_error(parser, "cannot map the input file", 0, -1);
+        if (st.st_size >= MYYAML_MAX_FILE_SIZE) return yaml_parser_set_reader_error(parser, "input is too long", 0, -1);
+
+        size = (size_t)st.st_size;
+        length = (size + MYYAML_INPUT_MAP_PADDING + page - 1) / page * page;
+
+        reserve = mmap(NULL, length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (reserve == MAP_FAILED) return yaml_parser_set_reader_error(parser, "cannot map the input file", 0, -1);
+
+        if (size && mmap(reserve, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            munmap(reserve, length);
+            return yaml_parser_set_reader_error(parser, "cannot map the input file", 0, -1);
+        }
+
+#ifdef MADV_SEQUENTIAL
+        madvise(reserve, length, MADV_SEQUENTIAL);
+#endif
+
+        start = (unsigned char *)reserve;
+    }
+#endif
+
+    parser->mapping.start = start;
+    parser->mapping.size = size;
+    parser->mapping.length = length;
+    parser->mapping.checked = 0;
+    parser->mapping.passthrough = 0;
+
+    /* Until the mapping is checked, it reads like a string input. */
+
+    parser->read_handler = yaml_string_read_handler;
+    parser->read_handler_data = parser;
+
+    parser->input.string.start = start;
+    parser->input.string.current = start;
+    parser->input.string.end = start + size;
+
+    return MYYAML_SUCCESS;
+}
+
+MYYAML_API void yaml_parser_set_input(YamlParser *parser, YamlReadHandler *handler, void *data) {
+    MYYAML_ASSERT(parser);                /* Non-NULL parser object expected. */
+    MYYAML_ASSERT(!parser->read_handler); /* You can set the source only once. */
+    MYYAML_ASSERT(handler);               /* Non-NULL read handler expected. */
+
+    parser->read_handler = handler;
+    parser->read_handler_data = data;
+}
+
+MYYAML_API int yaml_parser_feed(YamlParser *parser, const unsigned char *data, size_t size, int is_last) {
+    MYYAML_ASSERT(parser);              /* Non-NULL parser object expected. */
+    MYYAML_ASSERT(data || !size);       /* Non-NULL data expected. */
+    MYYAML_ASSERT(!parser->feed.final); /* No input after the last chunk. */
+    MYYAML_ASSERT(!parser->read_handler || parser->feed.start); /* You can set the source only once. */
+
+    if (!parser->feed.start) {
+        parser->feed.start = (unsigned char *)_myyaml_malloc(parser->allocator, MYYAML_INPUT_RAW_BUFFER_SIZE);
+        if (!parser->feed.start) {
+            parser->error = YAML_MEMORY_ERROR;
+            return MYYAML_FAILURE;
+        }
+        parser->feed.pointer = parser->feed.last = parser->feed.start;
+        parser->feed.end = parser->feed.start + MYYAML_INPUT_RAW_BUFFER_SIZE;
+
+        parser->read_handler = yaml_feed_read_handler;
+        parser->read_handler_data = parser;
+    }
+
+    if ((size_t)(parser->feed.end - parser->feed.last) < size) {
+        /* Drop the octets before the current position; they are never read again. */
+
+        size_t consumed = yaml_parser_input_position(parser) - parser->feed.offset;
+        size_t length = parser->feed.last - parser->feed.start - consumed;
+        size_t capacity = parser->feed.end - parser->feed.start;
+
+        if (consumed) {
+            memmove(parser->feed.start, parser->feed.start + consumed, length);
+            parser->feed.pointer -= consumed;
+            parser->feed.last -= consumed;
+            parser->feed.offset += consumed;
+        }
+
+        if (capacity - length < size) {
+            unsigned char *start;
+
+            while (capacity - length < size) {
+                if (capacity >= MYYAML_MAX_FILE_SIZE) {
+                    return yaml_parser_set_reader_error(parser, "input is too long", parser->feed.offset + length, -1);
+                }
+                capacity *= 2;
+            }
+
+            start = (unsigned char *)_myyaml_realloc(parser->allocator, parser->feed.start, capacity);
+            if (!start) {
+                parser->error = YAML_MEMORY_ERROR;
+                return MYYAML_FAILURE;
+            }
+            parser->feed.pointer = start + (parser->feed.pointer - parser->feed.start);
+            parser->feed.last = start + length;
+            parser->feed.end = start + capacity;
+            parser->feed.start = start;
+        }
+    }
+
+    if (size) {
+        memcpy(parser->feed.last, data, size);
+        parser->feed.last += size;
+    }
+    parser->feed.final = is_last;
+    parser->feed.starved = 0;
+
+    return MYYAML_SUCCESS;
+}
+
+MYYAML_API void yaml_parser_set_encoding(YamlParser *parser, YamlEncoding encoding) {
+    MYYAML_ASSERT(parser);            /* Non-NULL parser object expected. */
+    MYYAML_ASSERT(!parser->encoding); /* Encoding is already set or detected. */
+
+    parser->encoding = encoding;
+}
+
+MYYAML_API void yaml_parser_set_zero_copy(YamlParser *parser, int enabled) {
+    MYYAML_ASSERT(parser); /* Non-NULL parser object expected. */
+
+    parser->zero_copy = enabled;
+}
+
+MYYAML_API void yaml_parser_set_arena(YamlParser *parser, int enabled) {
+    MYYAML_ASSERT(parser); /* Non-NULL parser object expected. */
+
+    parser->arena = enabled;
+}
 
-                default:
-                    MYYAML_ASSERT(1); /* Impossible. */
-            }
+MYYAML_API void yaml_parser_set_index_mappings(YamlParser *parser, int enabled) {
+    MYYAML_ASSERT(parser); /* Non-NULL parser object expected. */
 
-            /* Check if the raw buffer contains enough bytes to form a
-             * character. */
+    parser->index_mappings = enabled;
+}
 
-            if (incomplete) break;
+MYYAML_API void yaml_parser_set_max_expanded_nodes(YamlParser *parser, size_t limit) {
+    MYYAML_ASSERT(parser); /* Non-NULL parser object expected. */
 
-            /*
-             * Check if the character is in the allowed range:
-             *      #x9 | #xA | #xD | [#x20-#x7E]               (8 bit)
-             *      | #x85 | [#xA0-#xD7FF] | [#xE000-#xFFFD]    (16 bit)
-             *      | [#x10000-#x10FFFF]                        (32 bit)
-             */
+    parser->max_expanded_nodes = limit;
+}
 
-            if (!(value == 0x09 || value == 0x0A || value == 0x0D || (value >= 0x20 && value <= 0x7E) || (value == 0x85) ||
-                  (value >= 0xA0 && value <= 0xD7FF) || (value >= 0xE000 && value <= 0xFFFD) || (value >= 0x10000 && value <= 0x10FFFF)))
-                return yaml_parser_set_reader_error(parser, "control characters are not allowed", parser->offset, value);
+MYYAML_API void yaml_parser_set_max_alias_depth(YamlParser *parser, int limit) {
+    MYYAML_ASSERT(parser);     /* Non-NULL parser object expected. */
+    MYYAML_ASSERT(limit >= 0); /* Non-negative limit expected. */
 
-            /* Move the raw pointers. */
+    parser->max_alias_depth = limit;
+}
 
-            parser->raw_buffer.pointer += width;
-            parser->offset += width;
+MYYAML_API void yaml_parser_set_max_document_length(YamlParser *parser, size_t limit) {
+    MYYAML_ASSERT(parser); /* Non-NULL parser object expected. */
 
-            /* Finally put the character into the buffer. */
+    parser->max_document_length = limit;
+}
 
-            /* 0000 0000-0000 007F -> 0xxxxxxx */
-            if (value <= 0x7F) {
-                *(parser->buffer.last++) = value;
-            }
-            /* 0000 0080-0000 07FF -> 110xxxxx 10xxxxxx */
-            else if (value <= 0x7FF) {
-                *(parser->buffer.last++) = 0xC0 + (value >> 6);
-                *(parser->buffer.last++) = 0x80 + (value & 0x3F);
-            }
-            /* 0000 0800-0000 FFFF -> 1110xxxx 10xxxxxx 10xxxxxx */
-            else if (value <= 0xFFFF) {
-                *(parser->buffer.last++) = 0xE0 + (value >> 12);
-                *(parser->buffer.last++) = 0x80 + ((value >> 6) & 0x3F);
-                *(parser->buffer.last++) = 0x80 + (value & 0x3F);
-            }
-            /* 0001 0000-0010 FFFF -> 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx */
-            else {
-                *(parser->buffer.last++) = 0xF0 + (value >> 18);
-                *(parser->buffer.last++) = 0x80 + ((value >> 12) & 0x3F);
-                *(parser->buffer.last++) = 0x80 + ((value >> 6) & 0x3F);
-                *(parser->buffer.last++) = 0x80 + (value & 0x3F);
-            }
+MYYAML_API int yaml_parser_get_profile(const YamlParser *parser, YamlParserProfile *profile) {
+    MYYAML_ASSERT(parser);  /* Non-NULL parser object expected. */
+    MYYAML_ASSERT(profile); /* Non-NULL profile object expected. */
 
-            parser->unread++;
-        }
+#if MYYAML_PROFILING
+    *profile = parser->profile.counters;
+    profile->bytes_decoded = parser->offset - parser->profile.offset;
 
-        /* On EOF, put NUL into the buffer and return. */
+    return MYYAML_SUCCESS;
+#else
+    memset(profile, 0, sizeof(YamlParserProfile));
 
-        if (parser->eof) {
-            *(parser->buffer.last++) = '\0';
-            parser->unread++;
-            return MYYAML_SUCCESS;
-        }
-    }
+    return MYYAML_FAILURE;
+#endif
+}
 
-    if (parser->offset >= MYYAML_MAX_FILE_SIZE) {
-        return yaml_parser_set_reader_error(parser, "input is too long", parser->offset, -1);
-    }
+MYYAML_API void yaml_parser_reset_profile(YamlParser *parser) {
+    MYYAML_ASSERT(parser); /* Non-NULL parser object expected. */
 
-    return MYYAML_SUCCESS;
+#if MYYAML_PROFILING
+    memset(&parser->profile.counters, 0, sizeof(YamlParserProfile));
+    parser->profile.offset = parser->offset;
+    parser->profile.start = yaml_profile_ticks();
+#endif
 }
 
-MYYAML_API void yaml_parser_set_input_string(YamlParser *parser, const unsigned char *input, size_t size) {
-    MYYAML_ASSERT(parser);                /* Non-NULL parser object expected. */
-    MYYAML_ASSERT(!parser->read_handler); /* You can set the source only once. */
-    MYYAML_ASSERT(input);                 /* Non-NULL input string expected. */
+#if MYYAML_PROFILING
 
-    parser->read_handler = yaml_string_read_handler;
-    parser->read_handler_data = parser;
+/*
+ * Read the profile clock.
+ */
 
-    parser->input.string.start = input;
-    parser->input.string.current = input;
-    parser->input.string.end = input + size;
+static uint64_t yaml_profile_ticks(void) {
+#if MYYAML_PROFILE_RDTSC
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
 }
 
-MYYAML_API void yaml_parser_set_input_file(YamlParser *parser, FILE *file) {
-    MYYAML_ASSERT(parser);                /* Non-NULL parser object expected. */
-    MYYAML_ASSERT(!parser->read_handler); /* You can set the source only once. */
-    MYYAML_ASSERT(file);                  /* Non-NULL file object expected. */
+/*
+ * Enter a stage: charge the time so far to the stage it interrupts, and make
+ * the profile current on this thread for the outermost stage.
+ */
 
-    parser->read_handler = yaml_file_read_handler;
-    parser->read_handler_data = parser;
+static void yaml_parser_enter_stage(YamlParser *parser, YamlParserStage stage) {
+    uint64_t now = yaml_profile_ticks();
+    int depth = parser->profile.depth;
 
-    parser->input.file = file;
-}
+    MYYAML_ASSERT(depth < (int)(sizeof(parser->profile.stages) / sizeof(parser->profile.stages[0]))); /* Stages nest four deep. */
 
-MYYAML_API void yaml_parser_set_input(YamlParser *parser, YamlReadHandler *handler, void *data) {
-    MYYAML_ASSERT(parser);                /* Non-NULL parser object expected. */
-    MYYAML_ASSERT(!parser->read_handler); /* You can set the source only once. */
-    MYYAML_ASSERT(handler);               /* Non-NULL read handler expected. */
+    if (depth) {
+        parser->profile.counters.ticks[parser->profile.stages[depth - 1]] += now - parser->profile.start;
+    } else {
+        parser->profile.outer = yaml_profile_current;
+        yaml_profile_current = &parser->profile.counters;
+    }
 
-    parser->read_handler = handler;
-    parser->read_handler_data = data;
+    parser->profile.stages[depth] = stage;
+    parser->profile.depth = depth + 1;
+    parser->profile.start = now;
 }
 
-MYYAML_API void yaml_parser_set_encoding(YamlParser *parser, YamlEncoding encoding) {
-    MYYAML_ASSERT(parser);            /* Non-NULL parser object expected. */
-    MYYAML_ASSERT(!parser->encoding); /* Encoding is already set or detected. */
+/*
+ * Leave the innermost stage, passing the result of its call through.
+ */
 
-    parser->encoding = encoding;
+static int yaml_parser_leave_stage(YamlParser *parser, int result) {
+    uint64_t now = yaml_profile_ticks();
+    int depth = --parser->profile.depth;
+
+    parser->profile.counters.ticks[parser->profile.stages[depth]] += now - parser->profile.start;
+    parser->profile.start = now;
+
+    if (!depth) yaml_profile_current = parser->profile.outer;
+
+    return result;
 }
 
+#endif // MYYAML_PROFILING
+
 MYYAML_API int yaml_parser_scan(YamlParser *parser, YamlToken *token) {
     MYYAML_ASSERT(parser); /* Non-NULL parser object is expected. */
     MYYAML_ASSERT(token);  /* Non-NULL token object is expected. */
@@ -9378,14 +13542,18 @@ MYYAML_API int yaml_parser_scan(YamlParser *parser, YamlToken *token) {
     /* Ensure that the tokens queue contains enough tokens. */
 
     if (!parser->token_available) {
-        if (!yaml_parser_fetch_more_tokens(parser)) return MYYAML_FAILURE;
+        if (!PROFILE_STAGE(parser, YAML_SCANNER_STAGE, yaml_parser_fetch_more_tokens(parser))) {
+            return parser->feed.starved ? YAML_NEED_MORE_INPUT : MYYAML_FAILURE;
+        }
     }
 
     /* Fetch the next token from the queue. */
 
     *token = DEQUEUE(parser, parser->tokens);
+    token->allocator = parser->allocator;
     parser->token_available = 0;
     parser->tokens_parsed++;
+    PROFILE_COUNT(parser, tokens[token->type]);
 
     if (token->type == YAML_STREAM_END_TOKEN) {
         parser->stream_end_produced = 1;
@@ -9408,18 +13576,221 @@ MYYAML_API int yaml_parser_parse(YamlParser *parser, YamlEvent *event) {
         return MYYAML_SUCCESS;
     }
 
-    /* Generate the next event. */
+    /* With fed input, wait until the whole event can be produced. */
+
+    if (FEEDING(parser)) {
+        if (!PROFILE_STAGE(parser, YAML_SCANNER_STAGE, yaml_parser_fetch_lookahead(parser))) {
+            return parser->feed.starved ? YAML_NEED_MORE_INPUT : MYYAML_FAILURE;
+        }
+    }
+
+    /* Generate the next event; its data comes from the parser allocator. */
+
+    if (!PROFILE_STAGE(parser, YAML_PARSER_STAGE, yaml_parser_state_machine(parser, event))) return MYYAML_FAILURE;
+    event->allocator = parser->allocator;
+    PROFILE_COUNT(parser, events[event->type]);
+
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Pass an event to its handler.
+ */
+
+static int yaml_parser_dispatch_event(const YamlParserCallbacks *callbacks, YamlEvent *event) {
+    void *data = callbacks->data;
+
+    switch (event->type) {
+        case YAML_STREAM_START_EVENT:
+            return callbacks->stream_start ? callbacks->stream_start(data, event->data.stream_start.encoding) : 1;
+
+        case YAML_STREAM_END_EVENT:
+            return callbacks->stream_end ? callbacks->stream_end(data) : 1;
+
+        case YAML_DOCUMENT_START_EVENT:
+            return callbacks->document_start
+                       ? callbacks->document_start(data, event->data.document_start.version_directive, event->data.document_start.tag_directives.start,
+                                                   event->data.document_start.tag_directives.end, event->data.document_start.implicit)
+                       : 1;
+
+        case YAML_DOCUMENT_END_EVENT:
+            return callbacks->document_end ? callbacks->document_end(data, event->data.document_end.implicit) : 1;
+
+        case YAML_ALIAS_EVENT:
+            return callbacks->alias ? callbacks->alias(data, event->data.alias.anchor) : 1;
+
+        case YAML_SCALAR_EVENT:
+            return callbacks->scalar ? callbacks->scalar(data, event->data.scalar.value, event->data.scalar.length, event->data.scalar.tag,
+                                                         event->data.scalar.style, event->data.scalar.anchor)
+                                     : 1;
+
+        case YAML_SEQUENCE_START_EVENT:
+            return callbacks->sequence_start ? callbacks->sequence_start(data, event->data.sequence_start.tag, event->data.sequence_start.style,
+                                                                         event->data.sequence_start.anchor)
+                                             : 1;
+
+        case YAML_SEQUENCE_END_EVENT:
+            return callbacks->sequence_end ? callbacks->sequence_end(data) : 1;
+
+        case YAML_MAPPING_START_EVENT:
+            return callbacks->mapping_start ? callbacks->mapping_start(data, event->data.mapping_start.tag, event->data.mapping_start.style,
+                                                                       event->data.mapping_start.anchor)
+                                            : 1;
+
+        case YAML_MAPPING_END_EVENT:
+            return callbacks->mapping_end ? callbacks->mapping_end(data) : 1;
+
+        default:
+            return 1;
+    }
+}
+
+/*
+ * Have the scanners copy the scalar values into the arena of the parser
+ * rather than allocate them, for events that are dropped as soon as they
+ * have been handled.
+ */
+
+static int yaml_parser_start_values(YamlParser *parser) {
+    if (!parser->values && !(parser->values = yaml_arena_create(parser->allocator))) {
+        parser->error = YAML_MEMORY_ERROR;
+        return MYYAML_FAILURE;
+    }
+
+    parser->callbacks = 1;
+
+    return MYYAML_SUCCESS;
+}
+
+/*
+ * Start the arena over once no scanned value is waiting for its event.
+ */
+
+static void yaml_parser_recycle_values(YamlParser *parser) {
+    size_t index;
+
+    for (index = 0; index < QUEUE_LENGTH(parser, parser->tokens); index++) {
+        if (QUEUE_AT(parser, parser->tokens, index).type == YAML_SCALAR_TOKEN) return;
+    }
+
+    yaml_arena_reset(parser->values);
+}
+
+/*
+ * Go back to allocated values.  The tokens the scanners have queued ahead
+ * get their own copies, so that the events made of them later do not point
+ * into the arena.
+ */
+
+static int yaml_parser_stop_values(YamlParser *parser) {
+    size_t index;
+
+    parser->callbacks = 0;
+
+    for (index = 0; index < QUEUE_LENGTH(parser, parser->tokens); index++) {
+        YamlToken *token = &QUEUE_AT(parser, parser->tokens, index);
+        YamlChar_t *value;
+
+        if (token->type != YAML_SCALAR_TOKEN || !yaml_arena_contains(parser->values, token->data.scalar.value)) continue;
+
+        value = YAML_MALLOC(parser->allocator, token->data.scalar.length + 1);
+        if (!value) {
+            parser->error = YAML_MEMORY_ERROR;
+            return MYYAML_FAILURE;
+        }
+        memcpy(value, token->data.scalar.value, token->data.scalar.length + 1);
+        token->data.scalar.value = value;
+        token->data.scalar.borrowed = 0;
+    }
+
+    yaml_arena_reset(parser->values);
+
+    return MYYAML_SUCCESS;
+}
+
+MYYAML_API int yaml_parser_parse_callbacks(YamlParser *parser, const YamlParserCallbacks *callbacks) {
+    YamlEvent event;
+    int status = MYYAML_SUCCESS;
+
+    MYYAML_ASSERT(parser);    /* Non-NULL parser object is expected. */
+    MYYAML_ASSERT(callbacks); /* Non-NULL callbacks are expected. */
+
+    if (!yaml_parser_start_values(parser)) return MYYAML_FAILURE;
+
+    for (;;) {
+        int proceed;
+
+        status = yaml_parser_parse(parser, &event);
+        if (status != MYYAML_SUCCESS || event.type == YAML_NO_EVENT) break;
+
+        proceed = yaml_parser_dispatch_event(callbacks, &event) && event.type != YAML_STREAM_END_EVENT;
+        yaml_event_delete(&event);
+        yaml_parser_recycle_values(parser);
+
+        if (!proceed) break;
+    }
+
+    if (!yaml_parser_stop_values(parser)) return MYYAML_FAILURE;
+
+    return status;
+}
+
+MYYAML_API int yaml_parser_skip_node(YamlParser *parser) {
+    YamlEvent event;
+    int status = MYYAML_SUCCESS;
+
+    MYYAML_ASSERT(parser); /* Non-NULL parser object is expected. */
+
+    /* Unless a skip waits for more input, skip the innermost open collection. */
+
+    if (!parser->skip_depth) {
+        if (parser->state < YAML_PARSE_BLOCK_SEQUENCE_FIRST_ENTRY_STATE || parser->state > YAML_PARSE_FLOW_MAPPING_EMPTY_VALUE_STATE) {
+            return MYYAML_SUCCESS;
+        }
+        parser->skip_depth = 1;
+    }
+
+    if (!yaml_parser_start_values(parser)) return MYYAML_FAILURE;
+
+    while (parser->skip_depth) {
+        status = yaml_parser_parse(parser, &event);
+        if (status != MYYAML_SUCCESS || event.type == YAML_NO_EVENT) break;
+
+        if (event.type == YAML_SEQUENCE_START_EVENT || event.type == YAML_MAPPING_START_EVENT) {
+            parser->skip_depth++;
+        } else if (event.type == YAML_SEQUENCE_END_EVENT || event.type == YAML_MAPPING_END_EVENT) {
+            parser->skip_depth--;
+        }
+        yaml_event_delete(&event);
+        yaml_parser_recycle_values(parser);
+    }
+
+    if (status != YAML_NEED_MORE_INPUT) {
+        parser->skip_depth = 0;
+    }
+
+    if (!yaml_parser_stop_values(parser)) return MYYAML_FAILURE;
 
-    return yaml_parser_state_machine(parser, event);
+    return status;
 }
 
 MYYAML_API void yaml_parser_delete(YamlParser *parser) {
+    int slot;
+
     MYYAML_ASSERT(parser); /* Non-NULL parser object expected. */
 
     BUFFER_DEL(parser, parser->raw_buffer);
-    BUFFER_DEL(parser, parser->buffer);
+    if (!parser->mapping.passthrough) {
+        BUFFER_DEL(parser, parser->buffer);
+    }
+    if (parser->mapping.start) {
+        yaml_parser_unmap_input(parser);
+    }
+    _myyaml_free(parser->allocator, parser->feed.start);
+    STACK_DEL(parser, parser->checkpoint.indents);
+    STACK_DEL(parser, parser->checkpoint.simple_keys);
     while (!QUEUE_EMPTY(parser, parser->tokens)) {
-        yaml_token_delete(&DEQUEUE(parser, parser->tokens));
+        yaml_parser_delete_token(parser, &DEQUEUE(parser, parser->tokens));
     }
     QUEUE_DEL(parser, parser->tokens);
     STACK_DEL(parser, parser->indents);
@@ -9428,12 +13799,96 @@ MYYAML_API void yaml_parser_delete(YamlParser *parser) {
     STACK_DEL(parser, parser->marks);
     while (!STACK_EMPTY(parser, parser->tag_directives)) {
         YamlTagDirective tag_directive = POP(parser, parser->tag_directives);
-        _myyaml_free(tag_directive.handle);
-        _myyaml_free(tag_directive.prefix);
+        _myyaml_free(parser->allocator, tag_directive.handle);
+        _myyaml_free(parser->allocator, tag_directive.prefix);
     }
     STACK_DEL(parser, parser->tag_directives);
+    for (slot = 0; slot < 4; slot++) {
+        _myyaml_free(parser->allocator, parser->scratch[slot].start);
+    }
+    yaml_arena_destroy(parser->values);
+
+    memset(parser, 0, sizeof(YamlParser));
+}
+
+MYYAML_API int yaml_parser_reset(YamlParser *parser) {
+    YamlParser kept;
+    int slot;
+
+    MYYAML_ASSERT(parser); /* Non-NULL parser object expected. */
+
+    /* Drop what belongs to the current input. */
+
+    while (!QUEUE_EMPTY(parser, parser->tokens)) {
+        yaml_parser_delete_token(parser, &DEQUEUE(parser, parser->tokens));
+    }
+    while (!STACK_EMPTY(parser, parser->tag_directives)) {
+        YamlTagDirective tag_directive = POP(parser, parser->tag_directives);
+        _myyaml_free(parser->allocator, tag_directive.handle);
+        _myyaml_free(parser->allocator, tag_directive.prefix);
+    }
+    if (parser->mapping.passthrough) {
+        parser->buffer.start = parser->buffer.end = NULL;
+    }
+    if (parser->mapping.start) {
+        yaml_parser_unmap_input(parser);
+    }
+    _myyaml_free(parser->allocator, parser->feed.start);
+
+#if MYYAML_PROFILING
+    parser->profile.counters.bytes_decoded += parser->offset - parser->profile.offset;
+    parser->profile.offset = 0;
+#endif
 
+    /* Start over with the settings, the buffers, the queue and the stacks. */
+
+    memcpy(&kept, parser, sizeof(YamlParser));
     memset(parser, 0, sizeof(YamlParser));
+
+    parser->allocator = kept.allocator;
+    parser->zero_copy = kept.zero_copy;
+    parser->arena = kept.arena;
+    parser->index_mappings = kept.index_mappings;
+    parser->max_expanded_nodes = kept.max_expanded_nodes;
+    parser->max_alias_depth = kept.max_alias_depth;
+    parser->max_document_length = kept.max_document_length;
+#if MYYAML_PROFILING
+    parser->profile = kept.profile;
+#endif
+
+    parser->raw_buffer.start = parser->raw_buffer.pointer = parser->raw_buffer.last = kept.raw_buffer.start;
+    parser->raw_buffer.end = kept.raw_buffer.end;
+    parser->buffer.start = parser->buffer.pointer = parser->buffer.last = kept.buffer.start;
+    parser->buffer.end = kept.buffer.end;
+    parser->tokens.start = kept.tokens.start;
+    parser->tokens.end = kept.tokens.end;
+    parser->indents.start = parser->indents.top = kept.indents.start;
+    parser->indents.end = kept.indents.end;
+    parser->simple_keys.start = parser->simple_keys.top = kept.simple_keys.start;
+    parser->simple_keys.end = kept.simple_keys.end;
+    parser->checkpoint.indents.start = parser->checkpoint.indents.top = kept.checkpoint.indents.start;
+    parser->checkpoint.indents.end = kept.checkpoint.indents.end;
+    parser->checkpoint.simple_keys.start = parser->checkpoint.simple_keys.top = kept.checkpoint.simple_keys.start;
+    parser->checkpoint.simple_keys.end = kept.checkpoint.simple_keys.end;
+    parser->states.start = parser->states.top = kept.states.start;
+    parser->states.end = kept.states.end;
+    parser->marks.start = parser->marks.top = kept.marks.start;
+    parser->marks.end = kept.marks.end;
+    parser->tag_directives.start = parser->tag_directives.top = kept.tag_directives.start;
+    parser->tag_directives.end = kept.tag_directives.end;
+    for (slot = 0; slot < 4; slot++) {
+        parser->scratch[slot].start = parser->scratch[slot].pointer = kept.scratch[slot].start;
+        parser->scratch[slot].end = kept.scratch[slot].end;
+    }
+    if ((parser->values = kept.values)) {
+        yaml_arena_reset(parser->values);
+    }
+
+    /* The working buffer was the mapping of the last input. */
+
+    if (!parser->buffer.start && !MYYAML_BUFFER_INIT(parser, parser->buffer, MYYAML_INPUT_BUFFER_SIZE)) return MYYAML_FAILURE;
+
+    return MYYAML_SUCCESS;
 }
 
 #pragma endregion  // Parser
@@ -9448,6 +13903,21 @@ MYYAML_API int yaml_emitter_initialize(YamlEmitter *emitter) {
     MYYAML_ASSERT(emitter); /* Non-NULL emitter object expected. */
 
     memset(emitter, 0, sizeof(YamlEmitter));
+
+    return yaml_emitter_allocate(emitter);
+}
+
+MYYAML_API int yaml_emitter_set_allocator(YamlEmitter *emitter, const YamlAllocator *allocator) {
+    MYYAML_ASSERT(emitter);                 /* Non-NULL emitter object expected. */
+    MYYAML_ASSERT(!emitter->write_handler); /* The allocator must be set before the output. */
+
+    yaml_emitter_delete(emitter);
+    emitter->allocator = allocator;
+
+    return yaml_emitter_allocate(emitter);
+}
+
+static int yaml_emitter_allocate(YamlEmitter *emitter) {
     if (!MYYAML_BUFFER_INIT(emitter, emitter->buffer, MYYAML_OUPUT_BUFFER_SIZE)) goto error;
     if (!MYYAML_BUFFER_INIT(emitter, emitter->raw_buffer, MYYAML_OUTPUT_RAW_BUFFER_SIZE)) goto error;
     if (!STACK_INIT(emitter, emitter->states, YamlEmitterState *)) goto error;
@@ -9482,13 +13952,58 @@ MYYAML_API void yaml_emitter_delete(YamlEmitter *emitter) {
     STACK_DEL(emitter, emitter->indents);
     while (!STACK_EMPTY(empty, emitter->tag_directives)) {
         YamlTagDirective tag_directive = POP(emitter, emitter->tag_directives);
-        _myyaml_free(tag_directive.handle);
-        _myyaml_free(tag_directive.prefix);
+        _myyaml_free(emitter->allocator, tag_directive.handle);
+        _myyaml_free(emitter->allocator, tag_directive.prefix);
     }
     STACK_DEL(emitter, emitter->tag_directives);
-    _myyaml_free(emitter->anchors);
+    _myyaml_free(emitter->allocator, emitter->anchors);
+    _myyaml_free(emitter->allocator, emitter->anchor_names);
+
+    memset(emitter, 0, sizeof(YamlEmitter));
+}
+
+MYYAML_API void yaml_emitter_reset(YamlEmitter *emitter) {
+    YamlEmitter kept;
+
+    MYYAML_ASSERT(emitter); /* Non-NULL emitter object expected. */
+
+    /* Drop what belongs to the current output. */
+
+    while (!QUEUE_EMPTY(emitter, emitter->events)) {
+        yaml_event_delete(&DEQUEUE(emitter, emitter->events));
+    }
+    while (!STACK_EMPTY(emitter, emitter->tag_directives)) {
+        YamlTagDirective tag_directive = POP(emitter, emitter->tag_directives);
+        _myyaml_free(emitter->allocator, tag_directive.handle);
+        _myyaml_free(emitter->allocator, tag_directive.prefix);
+    }
+    _myyaml_free(emitter->allocator, emitter->anchors);
+    _myyaml_free(emitter->allocator, emitter->anchor_names);
+
+    /* Start over with the settings, the buffers, the queue and the stacks. */
 
+    memcpy(&kept, emitter, sizeof(YamlEmitter));
     memset(emitter, 0, sizeof(YamlEmitter));
+
+    emitter->allocator = kept.allocator;
+    emitter->line_break = kept.line_break;
+    emitter->best_indent = kept.best_indent;
+    emitter->best_width = kept.best_width;
+    emitter->canonical = kept.canonical;
+    emitter->unicode = kept.unicode;
+
+    emitter->buffer.start = emitter->buffer.pointer = emitter->buffer.last = kept.buffer.start;
+    emitter->buffer.end = kept.buffer.end;
+    emitter->raw_buffer.start = emitter->raw_buffer.pointer = emitter->raw_buffer.last = kept.raw_buffer.start;
+    emitter->raw_buffer.end = kept.raw_buffer.end;
+    emitter->states.start = emitter->states.top = kept.states.start;
+    emitter->states.end = kept.states.end;
+    emitter->events.start = kept.events.start;
+    emitter->events.end = kept.events.end;
+    emitter->indents.start = emitter->indents.top = kept.indents.start;
+    emitter->indents.end = kept.indents.end;
+    emitter->tag_directives.start = emitter->tag_directives.top = kept.tag_directives.start;
+    emitter->tag_directives.end = kept.tag_directives.end;
 }
 
 MYYAML_API int yaml_emitter_emit(YamlEmitter *emitter, YamlEvent *event) {
@@ -9498,8 +14013,8 @@ MYYAML_API int yaml_emitter_emit(YamlEmitter *emitter, YamlEvent *event) {
     }
 
     while (!yaml_emitter_need_more_events(emitter)) {
-        if (!yaml_emitter_analyze_event(emitter, emitter->events.head)) return MYYAML_FAILURE;
-        if (!yaml_emitter_state_machine(emitter, emitter->events.head)) return MYYAML_FAILURE;
+        if (!yaml_emitter_analyze_event(emitter, &QUEUE_AT(emitter, emitter->events, 0))) return MYYAML_FAILURE;
+        if (!yaml_emitter_state_machine(emitter, &QUEUE_AT(emitter, emitter->events, 0))) return MYYAML_FAILURE;
         yaml_event_delete(&DEQUEUE(emitter, emitter->events));
     }
 
@@ -9527,7 +14042,7 @@ MYYAML_API int yaml_emitter_dump(YamlEmitter *emitter, YamlDocument *document) {
 
     MYYAML_ASSERT(emitter->opened); /* Emitter should be opened. */
 
-    emitter->anchors = (YamlAnchors *)_myyaml_malloc(sizeof(*(emitter->anchors)) * (document->nodes.top - document->nodes.start));
+    emitter->anchors = (YamlAnchors *)_myyaml_malloc(emitter->allocator, sizeof(*(emitter->anchors)) * (document->nodes.top - document->nodes.start));
     if (!emitter->anchors) goto error;
     memset(emitter->anchors, 0, sizeof(*(emitter->anchors)) * (document->nodes.top - document->nodes.start));
 
@@ -9535,6 +14050,7 @@ MYYAML_API int yaml_emitter_dump(YamlEmitter *emitter, YamlDocument *document) {
     event.type = YAML_DOCUMENT_START_EVENT;
     event.start_mark = mark;
     event.end_mark = mark;
+    event.allocator = document->allocator;
     event.data.document_start.version_directive = document->version_directive;
     event.data.document_start.tag_directives.start = document->tag_directives.start;
     event.data.document_start.tag_directives.end = document->tag_directives.end;
@@ -9542,7 +14058,7 @@ MYYAML_API int yaml_emitter_dump(YamlEmitter *emitter, YamlDocument *document) {
 
     if (!yaml_emitter_emit(emitter, &event)) goto error;
 
-    yaml_emitter_anchor_node(emitter, 1);
+    if (!yaml_emitter_anchor_nodes(emitter)) goto error;
     if (!yaml_emitter_dump_node(emitter, 1)) goto error;
 
     memset((&event), 0, sizeof(YamlEvent));
@@ -9719,6 +14235,15 @@ MYYAML_API int yaml_emitter_flush(YamlEmitter *emitter) {
         unsigned int value;
         size_t k;
 
+        /* Widen a run of ASCII characters in one go. */
+
+        k = yaml_get_kernels()->utf8_ascii_widen(emitter->buffer.pointer, emitter->buffer.last - emitter->buffer.pointer, high == 0,
+                                                 emitter->raw_buffer.last);
+        emitter->buffer.pointer += k;
+        emitter->raw_buffer.last += 2 * k;
+
+        if (emitter->buffer.pointer == emitter->buffer.last) break;
+
         /*
          * See the "reader.c" code for more details on UTF-8 encoding.  Note
          * that we assume that the buffer contains a valid UTF-8 sequence.